@@ -0,0 +1,63 @@
+/*
+ * benchmarks of the asynchronous log: the cost on the calling thread.
+ * Every iteration logs a burst that fits in the ring, then flushes (not timed),
+ * so the numbers are records and not drops. ns_per_log is the cost of one call.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <string>
+#include "util/async_log.h"
+
+#define BENCH_LOG_BURST 256
+
+template <typename LogCall>
+static void benchLogBursts(benchmark::State& state, LogCall logCall)
+{
+	logSetStdout(false);
+	double timedSeconds(0.0);
+	for (auto _ : state)
+	{
+		std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+		for (int index(0); index < BENCH_LOG_BURST; index++)
+		{
+			logCall(index);
+		}
+		double seconds(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		state.SetIterationTime(seconds);
+		timedSeconds += seconds;
+		logFlush();
+	}
+	logSetStdout(true);
+	state.SetItemsProcessed(state.iterations() * BENCH_LOG_BURST);
+	state.counters["ns_per_log"] = timedSeconds * 1.0e9 / (state.iterations() * BENCH_LOG_BURST);
+}
+
+static void BM_LogNoArgs(benchmark::State& state)
+{
+	benchLogBursts(state, [](int) { logMessage(logInfo, "Sending command"); });
+}
+BENCHMARK(BM_LogNoArgs)->UseManualTime();
+
+static void BM_LogNumbers(benchmark::State& state)
+{
+	benchLogBursts(state, [](int index) { logMessage(logInfo, "set %d sent, %u in flight, late %.1f us", index, 3u, 12.5); });
+}
+BENCHMARK(BM_LogNumbers)->UseManualTime();
+
+static void BM_LogString(benchmark::State& state)
+{
+	std::string port("/dev/ttyACM0");
+	benchLogBursts(state, [&port](int) { logMessage(logWarning, "read bytes: %s", port); });
+}
+BENCHMARK(BM_LogString)->UseManualTime();
+
+static void BM_LogFiltered(benchmark::State& state)
+{
+	for (auto _ : state)
+	{
+		logMessage(logDebug, "filtered %d", 1);
+	}
+}
+BENCHMARK(BM_LogFiltered);
@@ -0,0 +1,156 @@
+/*
+ * benchmarks of the command grid model (load, extract and drawing a page).
+ * The string table cases format every cell and parse them back, which is
+ * the part of the old grid that did not depend on wx.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "com/catheter_commands.h"
+#include "gui/command_grid_model.h"
+#include "hardware/digital_analog_conversions.h"
+
+// rows drawn by a grid that fills the screen.
+#define BENCH_PAGE_ROWS 40
+
+/**
+ * \brief nRows commands, NCHANNELS per set.
+ */
+static void benchCommands(int nRows, std::vector<CatheterChannelCmdSet>& cmdVect)
+{
+	cmdVect.clear();
+	CatheterChannelCmdSet cmdSet;
+	for (int i(0); i < nRows; i++)
+	{
+		CatheterChannelCmd cmd;
+		cmd.channel = (i % NCHANNELS) + 1;
+		setCmdMilliAmp(cmd, ((i * 7) % 600) - 300.0);
+		cmdSet.commandList.push_back(cmd);
+		if (cmd.channel == NCHANNELS || i + 1 == nRows)
+		{
+			cmdSet.delayTime = 5;
+			cmdVect.push_back(cmdSet);
+			cmdSet.commandList.clear();
+		}
+	}
+}
+
+static void BM_GridSetCommands(benchmark::State& state)
+{
+	std::vector<CatheterChannelCmdSet> cmdVect;
+	benchCommands(state.range(0), cmdVect);
+	CommandGridModel model;
+	for (auto _ : state)
+	{
+		model.setCommands(cmdVect);
+		benchmark::DoNotOptimize(model.rowCount());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_GridGetCommands(benchmark::State& state)
+{
+	std::vector<CatheterChannelCmdSet> cmdVect;
+	benchCommands(state.range(0), cmdVect);
+	CommandGridModel model;
+	model.setCommands(cmdVect);
+	for (auto _ : state)
+	{
+		model.getCommands(cmdVect);
+		benchmark::DoNotOptimize(cmdVect.data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// what the grid does on a repaint: format the visible cells.
+static void BM_GridFormatPage(benchmark::State& state)
+{
+	std::vector<CatheterChannelCmdSet> cmdVect;
+	benchCommands(state.range(0), cmdVect);
+	CommandGridModel model;
+	model.setCommands(cmdVect);
+	size_t firstRow(model.rowCount() / 2);
+	for (auto _ : state)
+	{
+		for (size_t row(firstRow); row < firstRow + BENCH_PAGE_ROWS; row++)
+		{
+			for (int col(0); col < NFIELDS; col++)
+			{
+				std::string text(model.cellText(row, col));
+				benchmark::DoNotOptimize(text.data());
+			}
+		}
+	}
+}
+
+// formats every cell into a string table (the old SetCommands).
+static void BM_StringTableSetCommands(benchmark::State& state)
+{
+	std::vector<CatheterChannelCmdSet> cmdVect;
+	benchCommands(state.range(0), cmdVect);
+	CommandGridModel model;
+	model.setCommands(cmdVect);
+	std::vector<std::string> cells;
+	for (auto _ : state)
+	{
+		cells.clear();
+		for (size_t row(0); row < model.commandCount(); row++)
+		{
+			for (int col(0); col < NFIELDS; col++)
+			{
+				cells.push_back(model.cellText(row, col));
+			}
+		}
+		benchmark::DoNotOptimize(cells.data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// parses every cell of a string table (the old GetCommands).
+static void BM_StringTableGetCommands(benchmark::State& state)
+{
+	std::vector<CatheterChannelCmdSet> cmdVect;
+	benchCommands(state.range(0), cmdVect);
+	CommandGridModel model;
+	model.setCommands(cmdVect);
+	std::vector<std::string> cells;
+	for (size_t row(0); row < model.commandCount(); row++)
+	{
+		for (int col(0); col < NFIELDS; col++)
+		{
+			cells.push_back(model.cellText(row, col));
+		}
+	}
+	for (auto _ : state)
+	{
+		cmdVect.clear();
+		CatheterChannelCmdSet newSet;
+		for (size_t row(0); row < model.commandCount(); row++)
+		{
+			CatheterChannelCmd newCmd;
+			const std::string &channel(cells[row * NFIELDS + CHANNEL_COL]);
+			newCmd.channel = (channel == GLOBALSTR) ? GLOBAL_ADDR : atoi(channel.c_str());
+			setCmdMilliAmp(newCmd, atof(cells[row * NFIELDS + CURRENT_COL].c_str()));
+			newSet.commandList.push_back(newCmd);
+			long delayTime(atoi(cells[row * NFIELDS + DELAY_COL].c_str()));
+			if (delayTime > 0)
+			{
+				newSet.delayTime = delayTime;
+				cmdVect.push_back(newSet);
+				newSet.commandList.clear();
+			}
+		}
+		benchmark::DoNotOptimize(cmdVect.data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_GridSetCommands)->Arg(10000)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_GridGetCommands)->Arg(10000)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_GridFormatPage)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_StringTableSetCommands)->Arg(10000)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_StringTableGetCommands)->Arg(10000)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,216 @@
+/*
+ * benchmarks of the playfile storage:
+ * std::vector<CatheterChannelCmdSet> against the packed CatheterCmdSequence.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "com/catheter_commands.h"
+#include "com/command_sequence.h"
+#include "com/pc_utils.h"
+#include "hardware/digital_analog_conversions.h"
+
+/**
+ * \brief writes (once) a synthetic playfile with nSets sets of NCHANNELS commands.
+ */
+static std::string benchPlayfile(int nSets)
+{
+	char fname[64];
+	sprintf(fname, "bench_sequence_%d.local.play", nSets);
+	FILE *test(fopen(fname, "r"));
+	if (test != NULL)
+	{
+		fclose(test);
+		return fname;
+	}
+	FILE *f(fopen(fname, "w"));
+	for (int i(0); i < nSets; i++)
+	{
+		for (int channel(1); channel <= NCHANNELS; channel++)
+		{
+			fprintf(f, "%d, %.3f, %d\n", channel, ((i * 7 + channel * 13) % 600) - 300.0, (channel == NCHANNELS) ? 5 : 0);
+		}
+	}
+	fclose(f);
+	return fname;
+}
+
+/**
+ * \brief heap bytes held by the nested vectors (not counting allocator overhead).
+ */
+static size_t vectorMemory(const std::vector<CatheterChannelCmdSet>& cmdVect)
+{
+	size_t bytes(sizeof(cmdVect) + cmdVect.capacity() * sizeof(CatheterChannelCmdSet));
+	for (size_t i(0); i < cmdVect.size(); i++)
+	{
+		bytes += cmdVect[i].commandList.capacity() * sizeof(CatheterChannelCmd);
+	}
+	return bytes;
+}
+
+static void BM_LoadPlayFileVector(benchmark::State& state)
+{
+	std::string fname(benchPlayfile(state.range(0)));
+	std::vector<CatheterChannelCmdSet> cmdVect;
+	for (auto _ : state)
+	{
+		loadPlayFile(fname.c_str(), cmdVect);
+		benchmark::DoNotOptimize(cmdVect.data());
+	}
+	state.counters["bytes"] = vectorMemory(cmdVect);
+	state.counters["allocations"] = cmdVect.size() + 1;
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_LoadPlayFileSequence(benchmark::State& state)
+{
+	std::string fname(benchPlayfile(state.range(0)));
+	CatheterCmdSequence cmdSequence;
+	for (auto _ : state)
+	{
+		loadPlayFile(fname.c_str(), cmdSequence);
+		benchmark::DoNotOptimize(cmdSequence.size());
+	}
+	state.counters["bytes"] = cmdSequence.memoryUsage();
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// encoding every set is what the serial thread does with a sequence.
+static void BM_EncodeVector(benchmark::State& state)
+{
+	std::vector<CatheterChannelCmdSet> cmdVect;
+	loadPlayFile(benchPlayfile(state.range(0)).c_str(), cmdVect);
+	for (auto _ : state)
+	{
+		size_t checksum(0);
+		for (size_t i(0); i < cmdVect.size(); i++)
+		{
+			std::vector<uint8_t> bytes(encodeCommandSet(cmdVect[i], i));
+			checksum += bytes.back();
+		}
+		benchmark::DoNotOptimize(checksum);
+	}
+	state.SetItemsProcessed(state.iterations() * cmdVect.size());
+}
+
+static void BM_EncodeSequence(benchmark::State& state)
+{
+	CatheterCmdSequence cmdSequence;
+	loadPlayFile(benchPlayfile(state.range(0)).c_str(), cmdSequence);
+	uint8_t bytes[PCK_LEN(15)];
+	for (auto _ : state)
+	{
+		size_t checksum(0);
+		for (size_t i(0); i < cmdSequence.size(); i++)
+		{
+			int len(encodeCommandSet(cmdSequence[i], i, bytes));
+			checksum += bytes[len - 1];
+		}
+		benchmark::DoNotOptimize(checksum);
+	}
+	state.SetItemsProcessed(state.iterations() * cmdSequence.size());
+}
+
+// a NCHANNELS x nSteps current matrix (column major, like MATLAB).
+static std::vector<double> benchCurrentMatrix(int nSteps)
+{
+	std::vector<double> milliAmp(static_cast<size_t> (nSteps) * NCHANNELS);
+	for (size_t i(0); i < milliAmp.size(); i++)
+	{
+		milliAmp[i] = ((i * 7) % 600) - 300.0;
+	}
+	return milliAmp;
+}
+
+// the old mex path: one packet (one call) per step.
+static void BM_EncodeMatrixPerStep(benchmark::State& state)
+{
+	std::vector<double> milliAmp(benchCurrentMatrix(state.range(0)));
+	for (auto _ : state)
+	{
+		std::vector< std::vector<uint8_t> > packets;
+		for (int step(0); step < state.range(0); step++)
+		{
+			CatheterChannelCmdSet cmdSet;
+			for (int chan(0); chan < NCHANNELS; chan++)
+			{
+				CatheterChannelCmd cmd;
+				cmd.channel = chan + 1;
+				setCmdMilliAmp(cmd, milliAmp[step * NCHANNELS + chan]);
+				cmdSet.commandList.push_back(cmd);
+			}
+			packets.push_back(encodeCommandSet(cmdSet, step));
+		}
+		benchmark::DoNotOptimize(packets.data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// the batched mex path: one sequence, one preallocated buffer and offset table.
+static void BM_EncodeMatrixBatched(benchmark::State& state)
+{
+	std::vector<double> milliAmp(benchCurrentMatrix(state.range(0)));
+	double delayMS(5.0);
+	CatheterCmdSequence cmdSequence;
+	for (auto _ : state)
+	{
+		currentMatrix2Sequence(milliAmp.data(), NCHANNELS, state.range(0), &delayMS, 1, false, cmdSequence);
+		std::vector<uint8_t> bytes(encodedLength(cmdSequence));
+		std::vector<uint32_t> offsets(cmdSequence.size() + 1);
+		encodeSequence(cmdSequence, 0, bytes.data(), offsets.data());
+		benchmark::DoNotOptimize(bytes.data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// a plain walk over every command.
+static void BM_IterateVector(benchmark::State& state)
+{
+	std::vector<CatheterChannelCmdSet> cmdVect;
+	loadPlayFile(benchPlayfile(state.range(0)).c_str(), cmdVect);
+	for (auto _ : state)
+	{
+		long sum(0);
+		for (size_t i(0); i < cmdVect.size(); i++)
+		{
+			for (size_t j(0); j < cmdVect[i].commandList.size(); j++)
+			{
+				sum += cmdVect[i].commandList[j].dacCounts;
+			}
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * cmdVect.size());
+}
+
+static void BM_IterateSequence(benchmark::State& state)
+{
+	CatheterCmdSequence cmdSequence;
+	loadPlayFile(benchPlayfile(state.range(0)).c_str(), cmdSequence);
+	for (auto _ : state)
+	{
+		long sum(0);
+		for (size_t i(0); i < cmdSequence.size(); i++)
+		{
+			CmdSetView cmdSet(cmdSequence[i]);
+			for (size_t j(0); j < cmdSet.size(); j++)
+			{
+				sum += cmdSet[j].dacCounts();
+			}
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * cmdSequence.size());
+}
+
+BENCHMARK(BM_LoadPlayFileVector)->Arg(10000)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LoadPlayFileSequence)->Arg(10000)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_EncodeVector)->Arg(100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_EncodeSequence)->Arg(100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_EncodeMatrixPerStep)->Arg(100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_EncodeMatrixBatched)->Arg(100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_IterateVector)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_IterateSequence)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
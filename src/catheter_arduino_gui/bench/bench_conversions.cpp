@@ -0,0 +1,128 @@
+/*
+ * benchmarks of the current conversions, one sample at a time against the batch versions.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+#include "hardware/digital_analog_conversions.h"
+
+#define BENCH_CHANNEL 3
+
+static void benchCounts(size_t count, std::vector<uint16_t>& counts, std::vector<dir_t>& dirs)
+{
+	counts.resize(count);
+	dirs.resize(count);
+	for (size_t i(0); i < count; i++)
+	{
+		counts[i] = static_cast<uint16_t> ((i * 2654435761u) & 4095);
+		dirs[i] = (i & 1) ? DIR_POS : DIR_NEG;
+	}
+}
+
+static void benchMilliAmps(size_t count, std::vector<double>& milliAmp)
+{
+	milliAmp.resize(count);
+	for (size_t i(0); i < count; i++)
+	{
+		milliAmp[i] = static_cast<double> ((i * 37) % 800) - 400.0;
+	}
+}
+
+static void BM_Adc2MilliAmp(benchmark::State& state)
+{
+	std::vector<uint16_t> counts;
+	std::vector<dir_t> dirs;
+	benchCounts(state.range(0), counts, dirs);
+	std::vector<double> milliAmp(counts.size());
+	for (auto _ : state)
+	{
+		for (size_t i(0); i < counts.size(); i++)
+		{
+			milliAmp[i] = adc2MilliAmp(counts[i], BENCH_CHANNEL);
+		}
+		benchmark::DoNotOptimize(milliAmp.data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_Adc2MilliAmpBatch(benchmark::State& state)
+{
+	std::vector<uint16_t> counts;
+	std::vector<dir_t> dirs;
+	benchCounts(state.range(0), counts, dirs);
+	std::vector<double> milliAmp(counts.size());
+	for (auto _ : state)
+	{
+		adc2MilliAmpBatch(counts.data(), milliAmp.data(), counts.size(), BENCH_CHANNEL);
+		benchmark::DoNotOptimize(milliAmp.data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_MilliAmp2Dac(benchmark::State& state)
+{
+	std::vector<double> milliAmp;
+	benchMilliAmps(state.range(0), milliAmp);
+	std::vector<uint16_t> counts(milliAmp.size());
+	for (auto _ : state)
+	{
+		for (size_t i(0); i < milliAmp.size(); i++)
+		{
+			counts[i] = milliAmp2Dac(milliAmp[i], BENCH_CHANNEL);
+		}
+		benchmark::DoNotOptimize(counts.data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_MilliAmp2DacBatch(benchmark::State& state)
+{
+	std::vector<double> milliAmp;
+	benchMilliAmps(state.range(0), milliAmp);
+	std::vector<uint16_t> counts(milliAmp.size());
+	for (auto _ : state)
+	{
+		milliAmp2DacBatch(milliAmp.data(), counts.data(), milliAmp.size(), BENCH_CHANNEL);
+		benchmark::DoNotOptimize(counts.data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_Dac2MilliAmp(benchmark::State& state)
+{
+	std::vector<uint16_t> counts;
+	std::vector<dir_t> dirs;
+	benchCounts(state.range(0), counts, dirs);
+	std::vector<double> milliAmp(counts.size());
+	for (auto _ : state)
+	{
+		for (size_t i(0); i < counts.size(); i++)
+		{
+			milliAmp[i] = dac2MilliAmp(counts[i], dirs[i], BENCH_CHANNEL);
+		}
+		benchmark::DoNotOptimize(milliAmp.data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_Dac2MilliAmpBatch(benchmark::State& state)
+{
+	std::vector<uint16_t> counts;
+	std::vector<dir_t> dirs;
+	benchCounts(state.range(0), counts, dirs);
+	std::vector<double> milliAmp(counts.size());
+	for (auto _ : state)
+	{
+		dac2MilliAmpBatch(counts.data(), dirs.data(), milliAmp.data(), counts.size(), BENCH_CHANNEL);
+		benchmark::DoNotOptimize(milliAmp.data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_Adc2MilliAmp)->Arg(4096)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Adc2MilliAmpBatch)->Arg(4096)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_MilliAmp2Dac)->Arg(4096)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_MilliAmp2DacBatch)->Arg(4096)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Dac2MilliAmp)->Arg(4096)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Dac2MilliAmpBatch)->Arg(4096)->Unit(benchmark::kMicrosecond);
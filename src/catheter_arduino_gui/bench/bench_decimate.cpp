@@ -0,0 +1,65 @@
+/*
+ * benchmarks of the strip chart decimation kernel.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <vector>
+#include "com/communication_definitions.h"
+#include "util/decimate.h"
+
+// a typical strip width in pixels
+#define BENCH_PLOT_COLUMNS 800
+
+static void benchSignal(size_t count, std::vector<float>& values)
+{
+	values.resize(count);
+	for (size_t index(0); index < count; index++)
+	{
+		values[index] = 300.0f * std::sin(index * 0.01f) + ((index * 7919) % 13);
+	}
+}
+
+static void BM_DecimateMinMax(benchmark::State& state)
+{
+	std::vector<float> values;
+	benchSignal(state.range(0), values);
+	std::vector<float> low(BENCH_PLOT_COLUMNS), high(BENCH_PLOT_COLUMNS);
+	for (auto _ : state)
+	{
+		decimateMinMax(values.data(), values.size(), BENCH_PLOT_COLUMNS, low.data(), high.data());
+		benchmark::DoNotOptimize(low.data());
+		benchmark::DoNotOptimize(high.data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// one plot frame: set and sensed traces of every channel from full histories.
+static void BM_DecimateFrame(benchmark::State& state)
+{
+	std::vector<SampleHistory> histories(2 * NCHANNELS, SampleHistory(state.range(0)));
+	std::vector<float> values;
+	benchSignal(state.range(0), values);
+	for (size_t index(0); index < histories.size(); index++)
+	{
+		for (size_t sample(0); sample < values.size(); sample++)
+		{
+			histories[index].push(values[sample]);
+		}
+	}
+	std::vector<float> low(BENCH_PLOT_COLUMNS), high(BENCH_PLOT_COLUMNS);
+	for (auto _ : state)
+	{
+		for (size_t index(0); index < histories.size(); index++)
+		{
+			const SampleHistory &history(histories[index]);
+			decimateMinMax(history.newest(history.size()), history.size(), BENCH_PLOT_COLUMNS, low.data(), high.data());
+			benchmark::DoNotOptimize(low.data());
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0) * histories.size());
+}
+
+BENCHMARK(BM_DecimateMinMax)->Arg(10000)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_DecimateFrame)->Arg(10000)->Unit(benchmark::kMicrosecond);
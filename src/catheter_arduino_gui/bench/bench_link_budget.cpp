@@ -0,0 +1,41 @@
+/*
+ * benchmarks of the playfile link budget preflight.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "com/command_sequence.h"
+#include "com/link_budget.h"
+
+/**
+ * \brief a synthetic sequence of nSets single channel sets, every NCHANNELS-th one with a dwell.
+ */
+static void benchSequence(int nSets, CatheterCmdSequence &cmdSequence)
+{
+	cmdSequence.clear();
+	cmdSequence.reserve(nSets, nSets);
+	for (int i(0); i < nSets; i++)
+	{
+		CatheterChannelCmd cmd;
+		cmd.channel = 1 + i % NCHANNELS;
+		cmd.dacCounts = static_cast<uint16_t> ((i * 7) % 4096);
+		cmd.poll = (i % 10) == 0;
+		cmdSequence.addCommand(cmd);
+		cmdSequence.endSet((i % NCHANNELS == NCHANNELS - 1) ? 2 : 0);
+	}
+}
+
+static void BM_AnalyzeLinkBudget(benchmark::State& state)
+{
+	CatheterCmdSequence cmdSequence;
+	benchSequence(state.range(0), cmdSequence);
+	LinkBudgetOptions options;
+	options.baud = 115200;
+	for (auto _ : state)
+	{
+		LinkBudgetReport report(analyzeLinkBudget(cmdSequence, options));
+		benchmark::DoNotOptimize(report.maxLagUs);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_AnalyzeLinkBudget)->Arg(100000)->Arg(3000000)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,71 @@
+/*
+ * benchmarks of the link log: the cost of recording one write or read chunk
+ * on the serial threads, page faults and window remaps included (the file
+ * keeps growing over the run).
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <vector>
+#include "com/catheter_commands.h"
+#include "util/link_log.h"
+
+#define BENCH_LINK_LOG_FILE "bench_link_log.local.link"
+
+static void BM_LinkRecord(benchmark::State& state)
+{
+	LinkRecorder recorder;
+	if (!recorder.open(BENCH_LINK_LOG_FILE, "benchmark"))
+	{
+		state.SkipWithError("unable to open the link log");
+		return;
+	}
+	std::vector<uint8_t> bytes(static_cast<size_t> (state.range(0)), 0x5a);
+	for (auto _ : state)
+	{
+		recorder.record(linkRecordOut, bytes.data(), bytes.size());
+	}
+	state.SetItemsProcessed(state.iterations());
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+	state.counters["log_mb"] = recorder.bytesUsed() * 1.0e-6;
+	recorder.close();
+	remove(BENCH_LINK_LOG_FILE);
+}
+// a six channel packet, and a full read chunk.
+BENCHMARK(BM_LinkRecord)->Arg(PCK_LEN(NCHANNELS))->Arg(256);
+
+static void BM_LinkLogRead(benchmark::State& state)
+{
+	LinkRecorder recorder;
+	if (!recorder.open(BENCH_LINK_LOG_FILE, "benchmark"))
+	{
+		state.SkipWithError("unable to open the link log");
+		return;
+	}
+	std::vector<uint8_t> bytes(PCK_LEN(NCHANNELS), 0x5a);
+	const int records(100000);
+	for (int index(0); index < records; index++)
+	{
+		recorder.record((index % 2) ? linkRecordIn : linkRecordOut, bytes.data(), bytes.size());
+	}
+	recorder.close();
+
+	LinkLogReader reader;
+	reader.open(BENCH_LINK_LOG_FILE);
+	for (auto _ : state)
+	{
+		uint64_t offset(reader.begin());
+		LinkRecordView view;
+		uint64_t total(0);
+		while (reader.next(offset, view))
+		{
+			total += view.length;
+		}
+		benchmark::DoNotOptimize(total);
+	}
+	state.SetItemsProcessed(state.iterations() * records);
+	reader.close();
+	remove(BENCH_LINK_LOG_FILE);
+}
+BENCHMARK(BM_LinkLogRead);
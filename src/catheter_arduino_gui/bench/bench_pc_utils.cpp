@@ -0,0 +1,104 @@
+/*
+ * benchmarks of the playfile writing and the ros current publishing helpers.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <vector>
+#include "com/catheter_commands.h"
+#include "com/command_sequence.h"
+#include "com/pc_utils.h"
+#include "hardware/digital_analog_conversions.h"
+
+/**
+ * \brief nSets sets of NCHANNELS commands, like a loaded playfile.
+ */
+static void benchCmdVect(int nSets, std::vector<CatheterChannelCmdSet>& cmdVect)
+{
+	cmdVect.clear();
+	cmdVect.resize(nSets);
+	for (int i(0); i < nSets; i++)
+	{
+		for (int channel(1); channel <= NCHANNELS; channel++)
+		{
+			CatheterChannelCmd cmd;
+			cmd.channel = channel;
+			setCmdMilliAmp(cmd, ((i * 7 + channel * 13) % 600) - 300.0);
+			cmdVect[i].commandList.push_back(cmd);
+		}
+		cmdVect[i].delayTime = 5;
+	}
+}
+
+static void BM_WritePlayFileVector(benchmark::State& state)
+{
+	std::vector<CatheterChannelCmdSet> cmdVect;
+	benchCmdVect(state.range(0), cmdVect);
+	const char *fname("bench_write_vector.local.play");
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(writePlayFile(fname, cmdVect));
+	}
+	remove(fname);
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_WritePlayFileSequence(benchmark::State& state)
+{
+	std::vector<CatheterChannelCmdSet> cmdVect;
+	benchCmdVect(state.range(0), cmdVect);
+	CatheterCmdSequence cmdSequence;
+	cmdSequence.assign(cmdVect);
+	const char *fname("bench_write_sequence.local.play");
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(writePlayFile(fname, cmdSequence));
+	}
+	remove(fname);
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_CurrentGen(benchmark::State& state)
+{
+	std::vector<CatheterChannelCmdSet> cmdVect;
+	benchCmdVect(state.range(0), cmdVect);
+	std::vector<double> timeSlice;
+	std::vector< std::vector<double> > currentList;
+	for (auto _ : state)
+	{
+		currentGen(cmdVect, timeSlice, currentList, NCHANNELS, 1);
+		benchmark::DoNotOptimize(currentList.data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_PublishCurrent(benchmark::State& state)
+{
+	std::vector<CatheterChannelCmdSet> cmdVect;
+	benchCmdVect(state.range(0), cmdVect);
+	std::vector<double> timeSlice;
+	std::vector< std::vector<double> > currentList;
+	currentGen(cmdVect, timeSlice, currentList, NCHANNELS, 1);
+
+	// one lookup per ros tick, walking through the whole playfile
+	// (between the slice times, publishCurrent() does not handle a tick at exactly 0).
+	double step(timeSlice.back() / 997.0);
+	double timeTicker(0.5 * step);
+	for (auto _ : state)
+	{
+		std::vector<double> currents(publishCurrent(timeTicker, timeSlice, currentList));
+		benchmark::DoNotOptimize(currents.data());
+		timeTicker += step;
+		if (timeTicker > timeSlice.back())
+		{
+			timeTicker = 0.5 * step;
+		}
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_WritePlayFileVector)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_WritePlayFileSequence)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CurrentGen)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_PublishCurrent)->Arg(10000)->Arg(100000);
@@ -0,0 +1,103 @@
+/*
+ * benchmarks of the packet encoding and the reply parsing.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+#include "com/catheter_commands.h"
+#include "hardware/digital_analog_conversions.h"
+#include "sim/arduino_sim.h"
+
+/**
+ * \brief a set of nCmds commands (channels 1..nCmds) at varied currents.
+ */
+static CatheterChannelCmdSet benchCmdSet(int nCmds, bool poll)
+{
+	CatheterChannelCmdSet cmdSet;
+	for (int channel(1); channel <= nCmds; channel++)
+	{
+		CatheterChannelCmd cmd;
+		cmd.channel = channel;
+		cmd.poll = poll;
+		setCmdMilliAmp(cmd, ((channel * 37) % 400) - 200.0);
+		cmdSet.commandList.push_back(cmd);
+	}
+	cmdSet.delayTime = 2;
+	return cmdSet;
+}
+
+/**
+ * \brief the reply the arduino sends back for a packet (with the sensed current when polled).
+ */
+static std::vector<uint8_t> benchReply(const CatheterChannelCmdSet& cmds, int pseqnum)
+{
+	std::vector<uint8_t> packet(encodeCommandSet(cmds, pseqnum));
+	ArduinoChannelState channels[NCHANNELS];
+	uint8_t reply[SIM_MAX_REPLY_LEN];
+	size_t replyLen(arduinoReply(packet.data(), packet.size(), channels, reply));
+	return std::vector<uint8_t>(reply, reply + replyLen);
+}
+
+static void BM_Fletcher8(benchmark::State& state)
+{
+	std::vector<uint8_t> bytes(encodeCommandSet(benchCmdSet(state.range(0), false), 1));
+	int len(bytes.size() - 1);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(fletcher8(len, bytes.data()));
+	}
+	state.SetBytesProcessed(state.iterations() * len);
+}
+
+static void BM_EncodeCommandSet(benchmark::State& state)
+{
+	CatheterChannelCmdSet cmdSet(benchCmdSet(state.range(0), false));
+	for (auto _ : state)
+	{
+		std::vector<uint8_t> bytes(encodeCommandSet(cmdSet, 1));
+		benchmark::DoNotOptimize(bytes.data());
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_ParseBytes2Cmds(benchmark::State& state)
+{
+	std::vector<uint8_t> reply(benchReply(benchCmdSet(state.range(0), state.range(1) != 0), 1));
+	std::vector<CatheterChannelCmd> cmds;
+	for (auto _ : state)
+	{
+		// parseBytes2Cmds consumes the reply.
+		std::vector<uint8_t> bytes(reply);
+		benchmark::DoNotOptimize(parseBytes2Cmds(bytes, cmds));
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_DecodeReplyStream(benchmark::State& state)
+{
+	CatheterChannelCmdSet cmdSet(benchCmdSet(NCHANNELS, state.range(1) != 0));
+	std::vector<uint8_t> stream;
+	for (int i(0); i < state.range(0); i++)
+	{
+		std::vector<uint8_t> reply(benchReply(cmdSet, i));
+		stream.insert(stream.end(), reply.begin(), reply.end());
+	}
+	std::vector<CatheterChannelCmd> cmds;
+	std::vector<uint32_t> packetIndex;
+	size_t skipped(0);
+	for (auto _ : state)
+	{
+		// the decoder appends, like the serial thread draining its read buffer.
+		cmds.clear();
+		packetIndex.clear();
+		benchmark::DoNotOptimize(decodeReplyStream(stream.data(), stream.size(), cmds, packetIndex, skipped));
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+	state.SetBytesProcessed(state.iterations() * stream.size());
+}
+
+BENCHMARK(BM_Fletcher8)->Arg(1)->Arg(NCHANNELS);
+BENCHMARK(BM_EncodeCommandSet)->Arg(1)->Arg(NCHANNELS);
+BENCHMARK(BM_ParseBytes2Cmds)->Args({1, 0})->Args({NCHANNELS, 0})->Args({NCHANNELS, 1});
+BENCHMARK(BM_DecodeReplyStream)->Args({10000, 0})->Args({10000, 1})->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+"""Overhead of the python bindings per 6 channel update.
+
+Compares one call per update against one call for the whole array, for the
+encoder and for queuing on a session (no port is needed, nothing is sent
+until a session is opened). Run from the build directory:
+
+    PYTHONPATH=. python3 ../bench/bench_python.py
+"""
+
+import time
+
+import numpy as np
+
+import catheter_py as catheter
+
+STEPS = 100000
+SINGLE_STEPS = 10000
+
+
+def per_update_us(fun, updates):
+    start = time.perf_counter()
+    fun()
+    return (time.perf_counter() - start) * 1.0e6 / updates
+
+
+def main():
+    rng = np.random.default_rng(0)
+    currents = rng.uniform(-200.0, 200.0, size=(STEPS, catheter.NCHANNELS))
+    delays = np.full(STEPS, 2.0)
+
+    def encode_single():
+        for t in range(SINGLE_STEPS):
+            catheter.encode(currents[t:t + 1], delays[t:t + 1], first_seq=t)
+
+    def encode_batched():
+        catheter.encode(currents, delays)
+
+    session = catheter.Session()
+
+    def enqueue_single():
+        for t in range(SINGLE_STEPS):
+            session.enqueue(currents[t:t + 1], delays[t:t + 1])
+
+    def enqueue_batched():
+        session.enqueue(currents, delays)
+
+    results = [
+        ("encode, one call per update", per_update_us(encode_single, SINGLE_STEPS)),
+        ("encode, one call per array", per_update_us(encode_batched, STEPS)),
+        ("enqueue, one call per update", per_update_us(enqueue_single, SINGLE_STEPS)),
+        ("enqueue, one call per array", per_update_us(enqueue_batched, STEPS)),
+    ]
+    session.close()
+
+    for name, us in results:
+        print("%-32s %8.3f us/update" % (name, us))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,63 @@
+/*
+ * benchmarks of the trace points (the cost a CATHETER_TRACE build adds per event).
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "util/trace.h"
+
+// a span while tracing is on, the buffer is cleared before it fills up.
+static void BM_TraceScopeEnabled(benchmark::State& state)
+{
+	traceClear();
+	traceEnable(true);
+	size_t recorded(0);
+	for (auto _ : state)
+	{
+		TraceScope scope("bench span");
+		if (++recorded == TRACE_BUFFER_EVENTS)
+		{
+			state.PauseTiming();
+			traceClear();
+			recorded = 0;
+			state.ResumeTiming();
+		}
+	}
+	traceEnable(false);
+	traceClear();
+}
+
+static void BM_TraceCounterEnabled(benchmark::State& state)
+{
+	traceClear();
+	traceEnable(true);
+	size_t recorded(0);
+	for (auto _ : state)
+	{
+		traceRecord("bench counter", 'C', traceNowNs(), 0, static_cast<int64_t> (recorded));
+		if (++recorded == TRACE_BUFFER_EVENTS)
+		{
+			state.PauseTiming();
+			traceClear();
+			recorded = 0;
+			state.ResumeTiming();
+		}
+	}
+	traceEnable(false);
+	traceClear();
+}
+
+// a trace point compiled in but with tracing off.
+static void BM_TraceScopeDisabled(benchmark::State& state)
+{
+	traceEnable(false);
+	for (auto _ : state)
+	{
+		TraceScope scope("bench span");
+		benchmark::ClobberMemory();
+	}
+}
+
+BENCHMARK(BM_TraceScopeEnabled);
+BENCHMARK(BM_TraceCounterEnabled);
+BENCHMARK(BM_TraceScopeDisabled);
@@ -0,0 +1,58 @@
+/*
+ * benchmarks of the offline tracking analysis: parsing and aligning recorded
+ * telemetry, on one thread and on one per core.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include "com/command_sequence.h"
+#include "com/tracking_error.h"
+
+// a six channel step every 10 ms, polled at 1 kHz for a minute.
+#define BENCH_TRACKING_SETS 6000
+#define BENCH_TRACKING_ROWS (60000 * NCHANNELS)
+
+static void benchSession(CatheterCmdSequence &cmdSequence, std::string &csv)
+{
+	cmdSequence.clear();
+	for (int i(0); i < BENCH_TRACKING_SETS; i++)
+	{
+		CatheterChannelCmd cmd;
+		cmd.channel = GLOBAL_ADDR;
+		cmd.dacCounts = static_cast<uint16_t> ((i * 397) % 4096);
+		cmd.dir = (i % 2) ? DIR_POS : DIR_NEG;
+		cmdSequence.addCommand(cmd);
+		cmdSequence.endSet(10);
+	}
+	csv = "time_s,channel,dir,dac_counts,adc_counts,set_ma,sensed_ma,polled\n";
+	csv.reserve(static_cast<size_t> (BENCH_TRACKING_ROWS) * 48);
+	char line[128];
+	for (int i(0); i < BENCH_TRACKING_ROWS; i++)
+	{
+		snprintf(line, sizeof(line), "%.6f,%d,1,%d,%d,%.4f,%.4f,1\n", (i / NCHANNELS) * 1.0e-3, 1 + i % NCHANNELS,
+			(i * 7) % 4096, (i * 13) % 4096, 50.0 * std::sin(i * 1.0e-3), 50.0 * std::sin(i * 1.0e-3 - 0.01));
+		csv += line;
+	}
+}
+
+static void BM_AnalyzeTracking(benchmark::State& state)
+{
+	CatheterCmdSequence cmdSequence;
+	std::string csv;
+	benchSession(cmdSequence, csv);
+	TrackingOptions options;
+	options.threads = static_cast<unsigned int> (state.range(0));
+	for (auto _ : state)
+	{
+		TrackingReport report;
+		analyzeTracking(cmdSequence, csv.data(), csv.size(), options, report);
+		benchmark::DoNotOptimize(report.samples);
+	}
+	state.SetBytesProcessed(state.iterations() * csv.size());
+	state.SetItemsProcessed(state.iterations() * BENCH_TRACKING_ROWS);
+}
+// one thread, and one per core.
+BENCHMARK(BM_AnalyzeTracking)->Arg(1)->Arg(0)->Unit(benchmark::kMillisecond)->UseRealTime();
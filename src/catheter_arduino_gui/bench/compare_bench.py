@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+"""Compares two catheter_bench JSON results (see the bench_json target).
+
+    python3 compare_bench.py baseline.json new.json
+
+Prints the time per iteration of every benchmark found in both files and the
+ratio new / baseline (below 1 is faster).
+"""
+
+import json
+import sys
+
+
+def load(fname):
+    with open(fname) as f:
+        data = json.load(f)
+    times = {}
+    for bench in data["benchmarks"]:
+        # with repetitions only the mean is compared.
+        if bench.get("run_type") == "aggregate" and bench.get("aggregate_name") != "mean":
+            continue
+        name = bench.get("run_name", bench["name"])
+        times[name] = (bench["real_time"], bench["time_unit"])
+    return data.get("context", {}), times
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__.strip())
+        return 1
+    base_context, base = load(sys.argv[1])
+    new_context, new = load(sys.argv[2])
+    for key in ("build_type", "lto", "host_name", "date"):
+        print("%-12s %-28s %s" % (key, base_context.get(key, "-"), new_context.get(key, "-")))
+    print()
+    print("%-48s %14s %14s %8s" % ("benchmark", "baseline", "new", "ratio"))
+    for name in sorted(set(base) & set(new)):
+        base_time, unit = base[name]
+        new_time, new_unit = new[name]
+        if unit != new_unit:
+            continue
+        ratio = new_time / base_time if base_time > 0 else float("nan")
+        print("%-48s %11.3f %2s %11.3f %2s %8.3f" % (name, base_time, unit, new_time, unit, ratio))
+    missing = sorted(set(base) ^ set(new))
+    if missing:
+        print()
+        print("only in one file: " + ", ".join(missing))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -26,6 +26,11 @@ enum comStatus {
 
  It contains a channel, poll information, an enable flag,
  And update flag, and both a DAC and ADC setting.
+
+ The DAC and ADC settings are carried as raw 12 bit counts (plus the direction bit),
+ which is exactly what goes over the wire. The milliAmp fields are only used at the
+ UI and file boundaries (see setCmdMilliAmp() and cmdMilliAmp() in digital_analog_conversions.h),
+ replies from the arduino only fill in the counts.
  */
 struct CatheterChannelCmd {
 	int channel;
@@ -33,11 +38,14 @@ struct CatheterChannelCmd {
 	bool enable;
 	bool update;
 	dir_t dir;
+	uint16_t dacCounts;
+	uint16_t adcCounts;
 	double currentMilliAmp;
 	double currentMilliAmp_ADC;
 
 	// default constructor:
-	CatheterChannelCmd() : channel(0), poll(false), currentMilliAmp(0), currentMilliAmp_ADC(0) {}
+	CatheterChannelCmd() : channel(0), poll(false), enable(true), update(true), dir(DIR_NEG),
+		dacCounts(0), adcCounts(0), currentMilliAmp(0), currentMilliAmp_ADC(0) {}
 };
 
 
@@ -64,6 +72,12 @@ CatheterChannelCmdSet resetCmd();
 // automatically create a global poll command
 CatheterChannelCmdSet pollCmd();
 
+// the firmware ignores the setpoint of a polled command, so to poll with a set
+// this appends a polled copy of each channel command (or one global poll when the
+// set writes the global channel, or when the copies would not fit in a packet)
+// after the setpoints. A set that is already full is left as it is.
+void appendPollCmds(CatheterChannelCmdSet &cmdSet);
+
 /**
  * \brief std::vector<uint8_t> encodeCommandSet(const CatheterChannelCmdSet&, int pseqnum);
  */
@@ -90,6 +104,11 @@ std::vector<uint8_t> encodePostamble(int pseqnum);
  */
 std::vector<uint8_t> encodeSingleCommand(const CatheterChannelCmd& cmd);
 
+/**
+ * \brief encodes a single command into the CMD_LEN bytes at bytesOut (pure bit packing).
+ */
+void encodeSingleCommand(const CatheterChannelCmd& cmd, uint8_t *bytesOut);
+
 
 /** \brief uint8_t fletcher8(int len, uint8_t bytes[]):
 compute the fletcher checksum of an array of bytes of length 'len' using blocksize=8.
@@ -101,10 +120,30 @@ uint8_t fletcher8(int len, uint8_t bytes[]);
  \brief bool parseBytes2Cmds(const std::vector<unsigned char>& reply, std::vector<CatheterChannelCmd>& cmds):
  validates returned bytes for a packet containing commands for all channels and
  returns the channel data parsesd from the return values (or -1 on error)
- NB: the currentMilliAmp field is filled with DAC RES data!
+ NB: only the dacCounts and adcCounts fields are filled in, convert them in the calling method!
+ badChecksum (if given) is set when the reply was complete but failed the fletcher check.
 
 */
-comStatus parseBytes2Cmds(std::vector<uint8_t>& reply, std::vector<CatheterChannelCmd>& cmds);
+comStatus parseBytes2Cmds(std::vector<uint8_t>& reply, std::vector<CatheterChannelCmd>& cmds, bool *badChecksum = NULL);
+
+
+/**
+ * \brief decodes back to back replies straight from a buffer (nothing is copied or erased).
+ * The commands of every valid packet are appended to cmds, packetIndex gets the packet
+ * number (counted from 0 in this call) of each command. Bytes that do not start a valid
+ * packet are skipped and counted. Returns the bytes consumed, a partial packet at the
+ * end is not consumed.
+ */
+size_t decodeReplyStream(const uint8_t *bytes, size_t length, std::vector<CatheterChannelCmd>& cmds,
+	std::vector<uint32_t>& packetIndex, size_t &skippedBytes);
+
+
+/**
+ * \brief decodes the command packet (as sent to the arduino) at the start of a buffer,
+ * the inverse of encodeCommandSet(). Returns the packet length, or 0 if the buffer does
+ * not start with a complete packet that passes the firmware checks (cmd_check).
+ */
+size_t decodeCommandPacket(const uint8_t *bytes, size_t length, CatheterChannelCmdSet &cmdSet, int &pseqnum);
 
 
 /**
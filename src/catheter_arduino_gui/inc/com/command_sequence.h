@@ -0,0 +1,152 @@
+#pragma once
+
+#ifndef CATHETER_COMMAND_SEQUENCE_H
+#define CATHETER_COMMAND_SEQUENCE_H
+
+#include "com/catheter_commands.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+
+// This file defines a compact storage for long command sequences (playfiles).
+// Commands are packed into 4 bytes each and all of the commands of a sequence are
+// stored contiguously, the sets only record an offset, a count and a delay.
+// CatheterChannelCmd and CatheterChannelCmdSet can still be produced from it.
+// The milliAmps a playfile gave a command are kept in a parallel float array, so a
+// command costs 8 bytes and writing a loaded sequence back does not quantize it.
+
+
+/**
+ \brief A catheter channel command packed into 4 bytes.
+
+ bits 28-31: channel
+ bits 24-27: command value (POL_BIT, ENA_BIT, UPD_BIT, DIR_BIT), same as on the wire
+ bits 12-23: DAC counts
+ bits  0-11: ADC counts
+ */
+struct PackedChannelCmd {
+	uint32_t bits;
+
+	PackedChannelCmd() : bits(0) {}
+
+	int channel() const { return (bits >> 28) & 15; }
+	uint8_t cmdValue() const { return (bits >> 24) & 15; }
+	bool poll() const { return (bits >> (24 + POL_BIT)) & 1; }
+	bool enable() const { return (bits >> (24 + ENA_BIT)) & 1; }
+	bool update() const { return (bits >> (24 + UPD_BIT)) & 1; }
+	dir_t dir() const { return ((bits >> (24 + DIR_BIT)) & 1) ? DIR_POS : DIR_NEG; }
+	uint16_t dacCounts() const { return (bits >> 12) & 4095; }
+	uint16_t adcCounts() const { return bits & 4095; }
+};
+
+/**
+ * \brief packs a command (the milliAmp fields are not stored).
+ */
+PackedChannelCmd packCmd(const CatheterChannelCmd& cmd);
+
+/**
+ * \brief unpacks a command. currentMilliAmp is recomputed from the DAC counts.
+ */
+CatheterChannelCmd unpackCmd(const PackedChannelCmd& cmd);
+
+
+/**
+ \brief A read only view of one set of a CatheterCmdSequence.
+ */
+struct CmdSetView {
+	const PackedChannelCmd *cmds;
+	const float *milliAmps;
+	size_t count;
+	long delayTime;
+
+	size_t size() const { return count; }
+	const PackedChannelCmd& operator[](size_t index) const { return cmds[index]; }
+	// the milliAmps command index was built from.
+	double milliAmp(size_t index) const { return milliAmps[index]; }
+	const PackedChannelCmd* begin() const { return cmds; }
+	const PackedChannelCmd* end() const { return cmds + count; }
+};
+
+
+/**
+ \brief A flat container for a sequence of command sets.
+
+ All of the commands live in one array and all of the sets in another, so
+ loading a playfile does a handful of (geometric) allocations instead of one per set.
+ clear() keeps the memory for reuse and is O(1).
+ */
+class CatheterCmdSequence {
+public:
+	CatheterCmdSequence();
+
+	void reserve(size_t nSets, size_t nCmds);
+	void clear();
+
+	// build a sequence one set at a time.
+	// milliAmp is the value the counts were encoded from, the other overloads keep
+	// the milliAmps of the DAC counts.
+	void addCommand(const PackedChannelCmd& cmd, double milliAmp);
+	void addCommand(const PackedChannelCmd& cmd);
+	void addCommand(const CatheterChannelCmd& cmd);
+	void endSet(long delayTime);
+
+	// the number of commands added since the last endSet()
+	size_t pendingCommands() const;
+	void discardPending();
+
+	void push_back(const CatheterChannelCmdSet& cmdSet);
+	void assign(const std::vector<CatheterChannelCmdSet>& cmdVect);
+
+	// appends the complete sets of another sequence, commands pending here are discarded first.
+	void append(const CatheterCmdSequence& other);
+
+	// exchanges the contents with another sequence (O(1)).
+	void swap(CatheterCmdSequence& other);
+
+	size_t size() const;
+	size_t commandCount() const;
+	bool empty() const;
+
+	CmdSetView operator[](size_t index) const;
+
+	// the legacy structures, currentMilliAmp is the stored value.
+	CatheterChannelCmdSet getSet(size_t index) const;
+	void toCmdSets(std::vector<CatheterChannelCmdSet>& cmdVect) const;
+
+	// bytes reserved by the sequence.
+	size_t memoryUsage() const;
+
+private:
+	struct SetEntry {
+		uint32_t offset;
+		uint32_t count;
+		int32_t delayTime;
+	};
+
+	std::vector<PackedChannelCmd> cmds;
+	std::vector<float> milliAmps;
+	std::vector<SetEntry> sets;
+};
+
+
+/**
+ * \brief encodes a set straight from its packed commands.
+ * bytesOut needs room for PCK_LEN(set.size()) bytes, the packet length is returned.
+ */
+int encodeCommandSet(const CmdSetView& cmdSet, int pseqnum, uint8_t *bytesOut);
+
+/**
+ * \brief the number of bytes needed to encode every set of a sequence.
+ */
+size_t encodedLength(const CatheterCmdSequence& cmdSequence);
+
+/**
+ * \brief encodes a whole sequence back to back into one buffer.
+ * bytesOut needs room for encodedLength() bytes and offsets for size() + 1 entries,
+ * set i is written at bytesOut + offsets[i] (the last offset is the total length).
+ * Set i uses the sequence number firstSeq + i. The total length is returned.
+ */
+size_t encodeSequence(const CatheterCmdSequence& cmdSequence, int firstSeq, uint8_t *bytesOut, uint32_t *offsets);
+
+#endif
@@ -19,6 +19,9 @@
 #define POST_LEN 1
 #define PCK_CHK_LEN 1
 
+/* most commands in a packet (the preamble count is 4 bits) */
+#define PCK_MAX_CMDS 15
+
 /* error codes for arduino to send back to PC */
 #define PRE_ERR 1
 #define POST_ERR 2
@@ -36,6 +39,7 @@
 
 #define PCK_OK 1
 #define DAC_RES 4096
+#define ADC_RES 4096
 #define DAC_RES_OFF 0 //4095
 
 /* command value bits */
@@ -0,0 +1,32 @@
+#pragma once
+#ifndef CATHETER_CURRENT_SAMPLE_H
+#define CATHETER_CURRENT_SAMPLE_H
+
+#include <cstdint>
+#include "com/catheter_commands.h"
+
+// This file defines a single telemetry sample of a channel.
+// The serial thread records the raw counts of each reply, the current is
+// converted (calibrated) by whoever reads the samples.
+
+/**
+ \brief The commanded and sensed state of a channel at one time.
+ */
+struct CurrentSample
+{
+	double time;         // seconds (steady clock)
+	int channel;
+	dir_t dir;
+	uint16_t dacCounts;  // commanded current
+	uint16_t adcCounts;  // sensed current, only valid if polled
+	bool polled;
+
+	CurrentSample() : time(0.0), channel(0), dir(DIR_NEG), dacCounts(0), adcCounts(0), polled(false)
+	{};
+
+	CurrentSample(const CatheterChannelCmd &cmd, double time_) : time(time_), channel(cmd.channel),
+		dir(cmd.dir), dacCounts(cmd.dacCounts), adcCounts(cmd.adcCounts), polled(cmd.poll)
+	{};
+};
+
+#endif
@@ -0,0 +1,130 @@
+#pragma once
+#ifndef CATHETER_LINK_BUDGET_H
+#define CATHETER_LINK_BUDGET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "com/catheter_commands.h"
+#include "com/command_sequence.h"
+
+// This file defines the link budget preflight of a playfile: how long every
+// set keeps the link and the firmware busy, and whether the sets fit in the
+// delays the playfile gives them.
+//
+// A set costs the wire time of its packet and of its reply (PCK_LEN and
+// RESPONSE_LEN bytes, 10 bits each at the baud) plus the firmware time
+// (packet handling, one DAC write per channel addressed, one ADC read per
+// channel polled). The sum is conservative, the two directions of the port
+// overlap in practice.
+//
+// The serial thread sends set i at the sum of the delays before it, or as
+// soon as the link is free when it is late. The analysis replays that
+// schedule with the budgets, the lag of a set is how late it goes out.
+
+// standard rates tried for the minimum baud, in increasing order.
+#define LINK_BUDGET_N_BAUDS 12
+extern const unsigned int linkBudgetBauds[LINK_BUDGET_N_BAUDS];
+
+// segments kept in the report (all of them are counted).
+#define LINK_BUDGET_MAX_SEGMENTS 1000
+
+/**
+ \brief The link and firmware model of the analysis.
+ */
+struct LinkBudgetOptions
+{
+	unsigned int baud;       // 0: native usb (no wire limit, only the firmware time counts)
+	double packetUs;         // firmware time per packet (parse, checksum, reply)
+	double dacUs;            // firmware time per channel written
+	double adcUs;            // firmware time per channel polled
+	double lagToleranceUs;   // a set later than this is infeasible
+
+	LinkBudgetOptions() : baud(9600), packetUs(50.0), dacUs(10.0), adcUs(10.0), lagToleranceUs(1000.0)
+	{};
+};
+
+/**
+ \brief How the sets are packed into packets, from the least to the most intrusive change to the playfile.
+ */
+enum PacketMode
+{
+	packetAsIs = 0,          // one packet per set
+	packetCoalesced,         // zero delay sets merged into the next one (SerialThreadObject::setCoalescing())
+	packetNoPoll,            // no sensed current requested
+	packetCoalescedNoPoll,   // both
+	packetModeCount
+};
+
+/**
+ \brief The name of a packet mode, for reports.
+ */
+const char* packetModeName(PacketMode mode);
+
+/**
+ \brief The budget of one set (as is, at the configured baud).
+ */
+struct SetBudget
+{
+	float wireUs;
+	float firmwareUs;
+	float lagUs;   // how late the set goes out
+};
+
+/**
+ \brief A run of consecutive sets later than the tolerance.
+ */
+struct InfeasibleSegment
+{
+	size_t first;
+	size_t last;
+	double startUs;   // the scheduled time of the first set
+	double maxLagUs;
+};
+
+/**
+ \brief The result of analyzeLinkBudget().
+ */
+struct LinkBudgetReport
+{
+	size_t sets;
+	double scheduledUs;      // the sum of the delays
+	double busyUs;           // the sum of the set budgets
+	size_t tightSets;        // sets with a delay shorter than their budget
+	size_t infeasibleSets;   // sets later than the tolerance
+	size_t segmentCount;     // runs of infeasible sets (segments holds the first ones)
+	std::vector<InfeasibleSegment> segments;
+	double maxLagUs;
+	double meanLagUs;
+	double finalLagUs;       // how much later than scheduled the last set goes out
+	bool feasible;
+
+	// the lowest standard baud that is feasible as is, 0 if none is.
+	unsigned int minBaud;
+	// the first packet mode that is feasible at the configured baud, packetModeCount if none is.
+	PacketMode suggestedMode;
+
+	LinkBudgetReport() : sets(0), scheduledUs(0.0), busyUs(0.0), tightSets(0), infeasibleSets(0), segmentCount(0),
+		maxLagUs(0.0), meanLagUs(0.0), finalLagUs(0.0), feasible(true), minBaud(0), suggestedMode(packetAsIs)
+	{};
+};
+
+/**
+ * \brief the wire time of a set in microseconds (0 at baud 0).
+ */
+double setWireUs(size_t nCmds, bool global, size_t nPolled, unsigned int baud);
+
+/**
+ * \brief analyzes a sequence. perSet (if not NULL) gets the budget of every set.
+ */
+LinkBudgetReport analyzeLinkBudget(const CatheterCmdSequence &cmdSequence, const LinkBudgetOptions &options,
+	std::vector<SetBudget> *perSet = NULL);
+
+/**
+ * \brief analyzes the legacy structures.
+ */
+LinkBudgetReport analyzeLinkBudget(const std::vector<CatheterChannelCmdSet> &cmdSets,
+	const LinkBudgetOptions &options, std::vector<SetBudget> *perSet = NULL);
+
+#endif
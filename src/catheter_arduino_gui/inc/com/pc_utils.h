@@ -9,11 +9,44 @@
 #define PC_UTILS_H
 
 #include "com/catheter_commands.h"
+#include "com/command_sequence.h"
+
+#include <string>
+
+/** \brief bool parsePlayLine(const std::string&, int&, double&, int&): parses one playfile line.
+ * The line is "channel, current (mA), delay (ms)". Returns false if the line should be skipped. */
+bool parsePlayLine(const std::string& line, int& channelIn, double& milliAmp, int& waitTime);
 
 /** \brief int loadPlayFile(const char*,std::vector<CatheterChannelCmd> &): Loads and parses a playfile.
  * The playfile is a recorded vector of computed commands with inter command delay. */
 int loadPlayFile(const char * fname, std::vector<CatheterChannelCmdSet>& cmdVect);
 
+/** \brief int loadPlayFile(const char*, CatheterCmdSequence&): Loads a playfile into a packed sequence.
+ * Same parsing rules as above, but the commands are stored contiguously (see command_sequence.h). */
+int loadPlayFile(const char * fname, CatheterCmdSequence& cmdSequence);
+
+/**
+ * \brief Builds a sequence from a column major current matrix (the MATLAB layout).
+ * \param const double* milliAmp:              nChannels x nSteps currents, column t is step t (channels 1..nChannels)
+ * \param const double* delayMS:               the delay after each step (nSteps values, or a single value for all)
+ * \param size_t nDelays:                      the number of delays (1 or nSteps)
+ * \param bool poll:                           poll every channel after the setpoints of each step
+ * \param       CatheterCmdSequence& cmdSequence: the output (cleared first)
+ * \return      int:                           0 on success, -1 if the sizes are invalid
+ */
+int currentMatrix2Sequence(const double* milliAmp, size_t nChannels, size_t nSteps, const double* delayMS, size_t nDelays,
+	bool poll, CatheterCmdSequence& cmdSequence);
+
+/**
+ * \brief Expands a sequence into a timeline of every channel's commanded current.
+ * \param const CatheterCmdSequence& cmdSequence: the input sequence
+ * \param       double* timeMS:                  the start time of each set (size() values, the first set starts at 0)
+ * \param       double* milliAmp:                size() x NCHANNELS, row major: the current of channels 1..NCHANNELS
+ *                                               after each set (a channel holds its value until it is commanded again,
+ *                                               global commands set every channel)
+ */
+void sequenceTimeline(const CatheterCmdSequence& cmdSequence, double* timeMS, double* milliAmp);
+
 /**
  * \brief Given the command list, generating a list of fixed-size group of current based on the actuator dofs and the number of the actuator. 
  *        also generating a list of time slice. 
@@ -35,7 +68,11 @@ int currentGen(const std::vector<CatheterChannelCmdSet>& cmdVect, std::vector<do
  */
 std::vector<double> publishCurrent(double timeTicker, const std::vector<double>& timeSlice, const std::vector< std::vector<double> >& currentList);
 
+/** \brief writes a playfile. Both overloads write the milliAmps the commands were loaded
+ * from (6 significant digits), so a loaded file is written back the same either way.
+ */
 bool writePlayFile(const char * fname, const std::vector<CatheterChannelCmdSet>& cmdVect);
+bool writePlayFile(const char * fname, const CatheterCmdSequence& cmdSequence);
 bool writeBytes(const char* fname, const std::vector<uint8_t>& bytes);
 
 /** \brief void summarizeCmd(const CatheterChannelCmd& cmd): summarizes a command reply.
@@ -0,0 +1,97 @@
+#pragma once
+#ifndef CATHETER_STATUS_DATA_H
+#define CATHETER_STATUS_DATA_H
+
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "com/catheter_commands.h"
+#include "com/communication_definitions.h"
+#include "util/triple_buffer.h"
+
+// This file defines the latest channel status shared by the serial thread
+// and its consumers (the status grid, the command line player).
+// It has no gui dependencies.
+//
+// The serial thread folds every reply into a fixed size snapshot and
+// publishes it through one triple buffer per reader, so it never waits for
+// a reader and a reader always gets the latest complete snapshot.
+
+// readers that can be attached at the same time.
+#define STATUS_MAX_READERS 8
+
+/**
+ \brief The last reply of every channel.
+ */
+struct StatusSnapshot
+{
+	CatheterChannelCmd channels[NCHANNELS];  // index channel - 1, only the counts, enable and dir are filled in
+	uint8_t reported;    // bit channel - 1: the channel has replied at least once
+	uint64_t replies;    // replies folded in so far
+
+	StatusSnapshot() : reported(0), replies(0)
+	{
+		for (int index(0); index < NCHANNELS; index++)
+		{
+			channels[index].channel = index + 1;
+		}
+	};
+
+	bool hasChannel(int channel) const
+	{
+		return channel >= 1 && channel <= NCHANNELS && ((reported >> (channel - 1)) & 1);
+	}
+};
+
+// the status shared between the serial thread (the writer) and its readers (see StatusReader).
+struct statusData
+{
+	// called whenever new data arrives.
+	// The gui uses it to queue a refresh instead of polling.
+	boost::function<void()> notify;
+	boost::mutex notifyMutex;
+
+	// folds a reply into the snapshot and publishes it, serial thread only.
+	void updateCmdList(const std::vector<CatheterChannelCmd> & inputCommands);
+
+	// sets (or clears) the notification callback.
+	void setNotify(const boost::function<void()> &notifyFcn);
+
+	statusData();
+
+private:
+	friend class StatusReader;
+
+	StatusSnapshot current;  // owned by the writer
+	TripleBuffer<StatusSnapshot> buffers[STATUS_MAX_READERS];
+	std::atomic<bool> claimed[STATUS_MAX_READERS];
+};
+
+/**
+ \brief One reader of a statusData, for one thread at a time.
+ Readers are wait free, a reader beyond STATUS_MAX_READERS is not attached.
+ */
+class StatusReader
+{
+public:
+	explicit StatusReader(statusData &status);
+	~StatusReader();
+
+	bool attached() const;
+
+	// copies the latest snapshot, returns true if it has replies this reader has not seen.
+	bool read(StatusSnapshot &snapshot);
+
+private:
+	StatusReader(const StatusReader&);
+	StatusReader& operator=(const StatusReader&);
+
+	statusData &status;
+	int slot;
+	uint64_t lastReplies;
+};
+
+#endif
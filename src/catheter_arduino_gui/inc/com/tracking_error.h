@@ -0,0 +1,142 @@
+#pragma once
+#ifndef CATHETER_TRACKING_ERROR_H
+#define CATHETER_TRACKING_ERROR_H
+
+#include <cstddef>
+#include <vector>
+
+#include "com/command_sequence.h"
+
+// This file defines the offline tracking analysis of a session: how well the
+// sensed current of every channel followed the current the playfile commanded.
+//
+// The reference is the playfile's schedule: set i starts at the sum of the
+// delays before it (the time base of the catheter_play telemetry, which
+// starts at the first send) and a channel holds its current until it is
+// commanded again. A telemetry row is "time_s, channel, ..., sensed_ma"
+// with the columns found by name in the header line; "dir" signs the sensed
+// current (the ADC reads the magnitude) and rows with "polled" 0 carry no
+// sensed current. Both are optional.
+//
+// The schedule drifts from the session by whatever the link adds (retries,
+// queueing, the host's sleeps), so with a "set_ma" column every change of a
+// channel's current is re-anchored on the first row that echoes it: a step
+// starts when the board took it, and its drift is that time minus the
+// scheduled one. A change that is never echoed keeps the drift of the step
+// before it.
+//
+// Every change of a channel's current by at least minStepMa is a step, it
+// lasts until the channel's next change. The settling time of a step is the
+// time of its last sample outside the band, the lag the time of its first
+// sample past the midpoint of the step; both resolve to the poll period.
+//
+// The file is split into chunks at line boundaries that are parsed on
+// separate threads, the partial sums are merged in file order and the
+// channels are finished in parallel.
+
+// bytes of telemetry per parallel chunk.
+#define TRACKING_CHUNK_BYTES (4 << 20)
+
+/**
+ \brief The alignment and the step model of the analysis.
+ */
+struct TrackingOptions
+{
+	double offsetMs;       // added to the telemetry times before they are aligned
+	bool anchorSteps;      // start the steps at their set_ma change (if the column is there)
+	double minStepMa;      // smaller changes of the commanded current are not analyzed as steps
+	double bandFraction;   // settling band, fraction of the step
+	double bandMa;         // settling band floor
+	unsigned int threads;  // 0: one per core
+	size_t chunkBytes;
+
+	TrackingOptions() : offsetMs(0.0), anchorSteps(true), minStepMa(5.0), bandFraction(0.05), bandMa(1.0), threads(0),
+		chunkBytes(TRACKING_CHUNK_BYTES)
+	{};
+};
+
+/**
+ \brief The response of a channel to one step.
+ */
+struct StepTracking
+{
+	int channel;
+	size_t set;         // the set that made the step
+	double startMs;     // when the board took the set (the scheduled time without anchoring)
+	double driftMs;     // startMs minus the scheduled time
+	bool anchored;      // startMs is the set_ma change of the set
+	double fromMa;
+	double toMa;
+	size_t samples;     // sensed samples until the channel's next change
+	double settleMs;    // -1: the last sample is outside the band (or there is none)
+	double lagMs;       // -1: no sample reached the midpoint
+	double maxErrorMa;  // largest absolute error
+
+	StepTracking() : channel(0), set(0), startMs(0.0), driftMs(0.0), anchored(false), fromMa(0.0), toMa(0.0),
+		samples(0), settleMs(-1.0), lagMs(-1.0), maxErrorMa(0.0)
+	{};
+};
+
+/**
+ \brief The tracking of one channel over the session.
+ */
+struct ChannelTracking
+{
+	int channel;
+	size_t samples;
+	double meanErrorMa;   // sensed minus commanded
+	double rmsErrorMa;
+	double maxErrorMa;    // largest absolute error
+	double maxErrorMs;    // when it happened
+	size_t steps;
+	size_t settledSteps;
+	double meanSettleMs;  // over the settled steps
+	double maxSettleMs;
+	size_t lagSteps;      // steps with a lag
+	double meanLagMs;
+	double medianLagMs;
+	double maxLagMs;
+
+	ChannelTracking() : channel(0), samples(0), meanErrorMa(0.0), rmsErrorMa(0.0), maxErrorMa(0.0), maxErrorMs(0.0),
+		steps(0), settledSteps(0), meanSettleMs(0.0), maxSettleMs(0.0), lagSteps(0), meanLagMs(0.0),
+		medianLagMs(0.0), maxLagMs(0.0)
+	{};
+};
+
+/**
+ \brief The result of analyzeTracking().
+ */
+struct TrackingReport
+{
+	size_t rows;          // telemetry rows after the header
+	size_t samples;       // rows with a sensed current of channel 1..NCHANNELS
+	size_t skippedRows;   // rows that could not be parsed or name another channel
+	double firstMs;       // aligned time of the first and last sample
+	double lastMs;
+	unsigned int threads;
+	size_t chunks;
+	bool anchored;        // the steps were re-anchored on set_ma
+	size_t anchoredSteps;
+	double maxDriftMs;    // largest absolute drift of an anchored step
+	std::vector<ChannelTracking> channels;  // channels 1..NCHANNELS
+	std::vector<StepTracking> steps;        // by channel, then by time
+
+	TrackingReport() : rows(0), samples(0), skippedRows(0), firstMs(0.0), lastMs(0.0), threads(0), chunks(0),
+		anchored(false), anchoredSteps(0), maxDriftMs(0.0)
+	{};
+};
+
+/**
+ * \brief analyzes telemetry held in memory. Returns false if the header lacks a required column.
+ */
+bool analyzeTracking(const CatheterCmdSequence &cmdSequence, const char *csv, size_t length,
+	const TrackingOptions &options, TrackingReport &report);
+
+/**
+ * \brief analyzes a telemetry file (mapped, not read, where the platform allows it).
+ * Returns 0 on success, -1 if the file could not be read, -2 if the header lacks a required column.
+ */
+int analyzeTrackingFile(const CatheterCmdSequence &cmdSequence, const char *fname, const TrackingOptions &options,
+	TrackingReport &report);
+
+#endif
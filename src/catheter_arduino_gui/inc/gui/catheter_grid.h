@@ -11,48 +11,69 @@
 
 #include "com/communication_definitions.h"
 #include "com/catheter_commands.h"
+#include "gui/command_grid_model.h"
 
 // This file defines the grid in which commands are entered and run.
 // This object does not require any threaded communication as it is only 
 // changed by the main thread.
+// The grid is virtual: the commands live in a CommandGridModel and only
+// the visible cells are formatted.
+
+
+/**
+ \brief wxGrid table over the command grid model.
+ The cell attributes (editors and renderers) are shared by all of the rows of a column.
+ */
+class CatheterGridTable : public wxGridTableBase {
+public:
+	CatheterGridTable();
+	~CatheterGridTable();
+
+	virtual int GetNumberRows();
+	virtual int GetNumberCols();
+	virtual bool IsEmptyCell(int row, int col);
+	virtual wxString GetValue(int row, int col);
+	virtual void SetValue(int row, int col, const wxString& value);
+	virtual wxString GetColLabelValue(int col);
+	virtual bool CanHaveAttributes();
+	virtual wxGridCellAttr* GetAttr(int row, int col, wxGridCellAttr::wxAttrKind kind);
+
+	CommandGridModel& getModel();
+
+private:
+	CommandGridModel model;
+
+	// one attribute per column for editable rows and one for read only rows.
+	wxGridCellAttr* editableAttr[NFIELDS];
+	wxGridCellAttr* readOnlyAttr[NFIELDS];
+};
+
 
 class CatheterGrid : public wxGrid {
     public:
     CatheterGrid(wxPanel* parent);
     ~CatheterGrid();
 
-    void OnGridCellChanging(wxGridEvent& e);
+    void OnGridCellChanged(wxGridEvent& e);
 
     void SetCommands(const std::vector<CatheterChannelCmdSet>& cmds);
 	void GetCommands(std::vector<CatheterChannelCmdSet>& cmds);
     void ResetDefault();
 
+	// replaces the grid contents with a model built elsewhere (O(1) swap).
+	void SwapModel(CommandGridModel& model);
+
+	// whether a cell was edited since the contents were last replaced.
+	bool IsEdited() const;
+
     wxDECLARE_EVENT_TABLE();
 
     private:
-	void RecalculateGridSize(int rows);
-    void setRowReadOnly(int row, bool readOnly);
-    void formatDefaultRow(int row);
-    void formatDefaultGrid(int nrows);
-    void resetDefaultGrid(int nrows);
-    bool isGridRowNumValid(int row);
-    bool isGridCellEmpty(int row, int col);
-    bool isGridRowComplete(int row);
-
-	long parseGridRow(int row, CatheterChannelCmd& c); 
-
-    void addGridRow(bool readOnly);
-    void setGridRowChannel(int row, int channel);
-    void setGridRowChannel(int row, const wxString& channel);
-    void setGridRowcurrentMilliAmp(int row, double currentMilliAmp);
-    void setGridRowDirection(int row, dir_t direction);
-    void setGridRowDelayMS(int row, int delayMS);
-    int getGridRowChannel(int row);
-    double getGridRowcurrentMilliAmp(int row);
-    dir_t getGridRowDirection(int row);
-    int getGridRowDelayMS(int row);
-
-    unsigned int cmdCount;
+	// tells the grid how many rows the model has now.
+	void syncRows();
+
+	CatheterGridTable* table;
+	bool edited;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -6,6 +6,11 @@
 #include "ser/serial_thread.h"
 
 #include <wx/wx.h>
+#include <wx/timer.h>
+#include <wx/stopwatch.h>
+#include <wx/gauge.h>
+
+#include <atomic>
 
 #include <boost/bind.hpp>
 #include <boost/thread.hpp>
@@ -14,6 +19,8 @@
 #include "gui/status_text.h"
 
 #include "gui/status_frame.h"
+#include "gui/playfile_loader.h"
+#include "gui/current_plot.h"
 
 //This file defines the gui layout
 
@@ -31,7 +38,15 @@ public:
     void OnSendCommandsButtonClicked(wxCommandEvent& e);
     void OnSendResetButtonClicked(wxCommandEvent& e);
 	void OnSendPollButtonClicked(wxCommandEvent& e);
-	void onIdle(wxIdleEvent& e);
+
+	// status refresh (queued by the serial thread)
+	void onStatusUpdate(wxThreadEvent& e);
+	void onRefreshTimer(wxTimerEvent& e);
+
+	// background playfile loading
+	void OnCancelLoadButtonClicked(wxCommandEvent& e);
+	void onLoadProgress(wxThreadEvent& e);
+	void onLoadFinished(wxThreadEvent& e);
 
     enum {
         ID_SELECT_PLAYFILE_BUTTON = 1024,
@@ -40,7 +55,12 @@ public:
         ID_SEND_COMMANDS_BUTTON,
         ID_SEND_RESET_BUTTON, 
         ID_REFRESH_SERIAL_BUTTON,
-		ID_SEND_POLL_BUTTON
+		ID_SEND_POLL_BUTTON,
+		ID_STATUS_UPDATE,
+		ID_REFRESH_TIMER,
+		ID_CANCEL_LOAD_BUTTON,
+		ID_LOAD_PROGRESS,
+		ID_LOAD_FINISHED
     };
 
     wxDECLARE_EVENT_TABLE();
@@ -49,18 +69,26 @@ public:
 
 private:
     // status panel
-    void setStatusText(const wxString& msg);
+    void setStatusText(const wxString& msg, logSeverity severity = logInfo);
+	void queueStatusRefresh();
+	void queueThreadEvent(int id);
+	void refreshStatus();
     // control buttons
     void warnSavePlayfile();
     void savePlayfile();
     wxString openPlayfile();
     void loadPlayfile(const wxString& path);
     void unloadPlayfile(const wxString& path);
+	void streamLoadedSets();
+	void discardLoad();
+	// warns when the loaded playfile does not fit the serial link (see link_budget.h).
+	void warnLinkBudget(const CatheterCmdSequence &cmdSequence);
     bool sendCommands(const std::vector<CatheterChannelCmdSet> &cmdVect);
     bool sendGridCommands();
     bool sendResetCommand();
 	bool sendPollCommand();
     bool refreshSerialConnection();
+	int selectSerialPort(const std::vector<std::string> &ports);
     bool closeSerialConnection();
     wxString wxToString(const CatheterChannelCmd &cmd);
     void wxSummarizeCmds(const std::vector<CatheterChannelCmd> &cmds);
@@ -71,12 +99,23 @@ private:
     // status panel
     //wxStaticText* statusText;
 	CatheterStatusText *statusText;
-	incomingText* statusTextData;
+	ConsoleLog* statusTextData;
 
 	//status Grid
 	statusData * statusGridCmdPtr;
+	StatusReader * statusReader;
 	StatusGrid * statusGridPtr;
 
+	// current plots, fed by the serial thread through the sample ring.
+	SpscRing<CurrentSample> * sampleRing;
+	CurrentPlotPanel * plotPanel;
+
+	// set while a refresh is queued or waiting on the timer,
+	// so that a burst of replies produces a single refresh.
+	std::atomic<bool> refreshQueued;
+	wxTimer refreshTimer;
+	wxStopWatch sinceRefresh;
+
     // control buttons
     wxButton* selectPlayfileButton;
     wxButton* newPlayfileButton;
@@ -85,13 +124,24 @@ private:
     wxButton* sendResetButton;
 	wxButton* pollButton;
     wxButton* refreshSerialButton;
+	wxButton* cancelLoadButton;
+	wxGauge* loadGauge;
     bool playfileSaved;
     wxString playfilePath;
 
+	// the playfile loads on a worker thread.
+	PlayfileLoader *playfileLoader;
+	bool previewShown;   // the head of the file is in the grid
+	bool streamToSerial; // loaded sets are sent as they arrive
+	size_t streamedSets;
+
 	SerialThreadObject *serialObject;
 	
 };
 
+class IpcServer;
+class LinkRecorder;
+
 class CatheterGuiApp : public wxApp {
 public:
     bool OnInit();
@@ -101,6 +151,11 @@ private:
 	CatheterGuiFrame* gui;
 	// thead object pointer
 	SerialThreadObject *serialObject;
+	MetricsRegistry *metrics;
+	// raw link traffic of the session, deleted after the serial thread.
+	LinkRecorder *linkRecorder;
+	// setpoints from external controllers (NULL on windows or if the socket is taken).
+	IpcServer *ipcServer;
 };
 
 
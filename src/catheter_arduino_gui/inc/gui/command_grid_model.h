@@ -0,0 +1,104 @@
+#pragma once
+#ifndef CATHETER_COMMAND_GRID_MODEL_H
+#define CATHETER_COMMAND_GRID_MODEL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "com/communication_definitions.h"
+#include "com/catheter_commands.h"
+#include "com/command_sequence.h"
+
+// This file defines the data behind the command grid.
+// Each row is one channel command stored as typed values (no strings).
+// The grid table only formats the rows that are drawn.
+// This object has no wx dependencies.
+
+#define CHANNEL_COL 0
+#define CURRENT_COL 1
+#define DIRECTION_COL 2
+#define DELAY_COL 3
+
+#define NFIELDS 4
+
+#define MAX_DELAY 50000
+
+// cell choice string definitions
+#define DIRNEGSTR "neg"
+#define DIRPOSSTR "pos"
+#define GLOBALSTR "global"
+
+
+/**
+ \brief One row of the command grid.
+ */
+struct CommandGridRow
+{
+	int channel;
+	double currentMilliAmp;
+	dir_t dir;
+	int delayMS;
+	uint8_t filled;  // bit per column, set once the cell has a value.
+
+	CommandGridRow() : channel(GLOBAL_ADDR), currentMilliAmp(0.0), dir(DIR_NEG), delayMS(0),
+		filled(1 << DELAY_COL)
+	{};
+
+	bool isFilled(int col) const { return (filled >> col) & 1; }
+	bool isComplete() const { return filled == ((1 << NFIELDS) - 1); }
+};
+
+
+/**
+ \brief The command grid contents.
+
+ The first commandCount() rows are complete commands. They are followed by one
+ editable row, once it is complete another row is added after it.
+ Rows past commandCount() are never turned into commands.
+ */
+class CommandGridModel
+{
+public:
+	CommandGridModel();
+
+	// back to a single empty row.
+	void reset();
+
+	// exchanges the contents with another model (O(1)).
+	void swap(CommandGridModel& other);
+
+	// one row per command, the set delay goes on the last row of each set.
+	void setCommands(const std::vector<CatheterChannelCmdSet>& cmds);
+	void setCommands(const CatheterCmdSequence& cmdSequence);
+
+	// a set ends at each row with a positive delay.
+	void getCommands(std::vector<CatheterChannelCmdSet>& cmds) const;
+
+	size_t rowCount() const;
+	size_t commandCount() const;
+	bool isRowEditable(size_t row) const;
+	bool isCellEmpty(size_t row, int col) const;
+
+	const CommandGridRow& getRow(size_t row) const;
+
+	// typed edits, these keep the current and the direction consistent.
+	// false is returned if the row is not editable or the value is invalid.
+	bool setChannel(size_t row, int channel);
+	bool setCurrent(size_t row, double currentMilliAmp);
+	bool setDirection(size_t row, dir_t direction);
+	bool setDelay(size_t row, int delayMS);
+
+	// the text shown in a cell ("" when empty) and the text entry path of the editors.
+	std::string cellText(size_t row, int col) const;
+	bool setCellText(size_t row, int col, const std::string& text);
+
+private:
+	// advances the command count when the editable row is complete.
+	void rowEdited(size_t row);
+
+	std::vector<CommandGridRow> rows;
+	size_t cmdCount;
+};
+
+#endif
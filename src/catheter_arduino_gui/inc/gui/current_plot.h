@@ -0,0 +1,57 @@
+#pragma once
+#ifndef CATHETER_CURRENT_PLOT_H
+#define CATHETER_CURRENT_PLOT_H
+
+#include <wx/wx.h>
+#include <vector>
+
+#include "com/communication_definitions.h"
+#include "com/current_sample.h"
+#include "util/spsc_ring.h"
+#include "util/decimate.h"
+
+// This file defines the strip charts of the commanded and sensed current.
+// The serial thread pushes samples into a lock free ring, the panel drains it
+// on each status refresh and draws one strip per channel.
+// Each pixel column shows the min/max of the samples under it.
+
+// samples shown per channel (10 s at 1 kHz)
+#define PLOT_WINDOW_SAMPLES 10000
+
+// smallest vertical range of a strip (mA)
+#define PLOT_MIN_RANGE_MA 10.0f
+
+class CurrentPlotPanel : public wxPanel
+{
+public:
+	CurrentPlotPanel(wxWindow *parent, SpscRing<CurrentSample> *ring);
+
+	// moves the queued samples into the histories (returns true if there were any).
+	bool updateSamples();
+
+	wxDECLARE_EVENT_TABLE();
+
+private:
+	void onPaint(wxPaintEvent &e);
+	void onSize(wxSizeEvent &e);
+
+	void drawChannel(wxDC &dc, int channelIndex, const wxRect &strip);
+
+	// adds a min/max trace to the point list, returns the number of points.
+	size_t tracePoints(const SampleHistory &history, const wxRect &strip, float range);
+
+	SpscRing<CurrentSample> *sampleRing;
+
+	// one history per channel (index 0 is channel 1).
+	std::vector<SampleHistory> setHistory;
+	std::vector<SampleHistory> sensedHistory;
+	float lastSensed[NCHANNELS];
+
+	// scratch space (kept to avoid allocating while drawing).
+	std::vector<CurrentSample> drainBuffer;
+	std::vector<float> minBuffer;
+	std::vector<float> maxBuffer;
+	std::vector<wxPoint> points;
+};
+
+#endif
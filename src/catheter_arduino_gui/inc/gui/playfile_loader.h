@@ -0,0 +1,112 @@
+#pragma once
+#ifndef CATHETER_PLAYFILE_LOADER_H
+#define CATHETER_PLAYFILE_LOADER_H
+
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "com/catheter_commands.h"
+#include "com/command_sequence.h"
+#include "gui/command_grid_model.h"
+
+// This file defines the background playfile loader.
+// A worker thread reads and parses the playfile, the sets are published in batches
+// so the gui can show (or start sending) the head of the file while the rest loads.
+// When the file is done the grid model is built on the worker too, the gui only swaps it in.
+// Starting another load does not wait for the one it replaces: that worker is told to stop,
+// its results are dropped and it is only joined later (or by the destructor).
+// This object has no wx dependencies.
+
+// sets parsed before they are published to the gui.
+#define PLAYFILE_BATCH_SETS 1024
+
+// minimum time between progress notifications.
+#define PLAYFILE_PROGRESS_MS 50
+
+
+class PlayfileLoader
+{
+public:
+	enum LoadState {
+		idle, loading, done, cancelled, failed
+	};
+
+	PlayfileLoader();
+
+	// cancels every load and waits for the workers.
+	~PlayfileLoader();
+
+	// starts loading a file, a load in progress is discarded (without waiting for it).
+	// returns false if the file can not be opened.
+	bool start(const std::string &fname);
+
+	// asks the worker to stop, the loaded sets are kept.
+	void cancel();
+
+	// drops the current load (without waiting for it), the loader goes back to idle.
+	void discard();
+
+	// waits for the worker of the current load to finish.
+	void wait();
+
+	LoadState getState() const;
+
+	// fraction of the file read (0 - 1).
+	double getProgress() const;
+
+	// number of sets published so far.
+	size_t setsLoaded() const;
+
+	// appends up to maxSets published sets starting at firstSet, returns the number appended.
+	size_t copySets(size_t firstSet, size_t maxSets, std::vector<CatheterChannelCmdSet> &cmdVect) const;
+
+	// hands over the result once the load has finished (done or cancelled).
+	// The model and the sequence are swapped out, the loader goes back to idle.
+	bool takeResult(CommandGridModel &model, CatheterCmdSequence &cmdSequence);
+
+	// progress is called as batches are published, finished once the worker is done.
+	// both are called from the worker thread.
+	void setNotify(const boost::function<void()> &progressFcn, const boost::function<void()> &finishedFcn);
+
+private:
+	// one load, its worker keeps it alive after it is replaced.
+	struct LoadJob
+	{
+		std::atomic<bool> cancelRequested;
+		LoadState state;
+		uint64_t totalBytes;
+		uint64_t bytesDone;
+		CatheterCmdSequence sets;
+		CommandGridModel model;
+
+		LoadJob() : cancelRequested(false), state(idle), totalBytes(0), bytesDone(0), sets(), model()
+		{};
+	};
+
+	// This is the worker function.
+	void loadLoop(boost::shared_ptr<LoadJob> job, std::string fname);
+
+	// appends a batch to the published sets.
+	void publish(LoadJob &job, CatheterCmdSequence &batch, uint64_t bytesRead);
+
+	// cancels the current load and moves its worker to the retired ones, without waiting.
+	void retireCurrent();
+
+	// joins the retired workers, only the finished ones unless all is set.
+	void joinRetired(bool all);
+
+	mutable boost::mutex loaderMutex;
+	boost::shared_ptr<LoadJob> current;   // the load the getters report on (NULL: idle)
+	boost::thread thrd;                   // its worker
+	std::vector<boost::shared_ptr<boost::thread> > retired;
+
+	boost::function<void()> progressNotify;
+	boost::function<void()> finishedNotify;
+};
+
+#endif
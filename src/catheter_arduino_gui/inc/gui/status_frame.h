@@ -6,29 +6,15 @@
 
 #include <boost/bind.hpp>
 #include <boost/thread.hpp>
+#include <boost/function.hpp>
 #include "com/catheter_commands.h"
+#include "com/status_data.h"
 
 
 // This files defines the display class which shows the current status of individual
 // catheter channels. (ADC and DAC)
 // This is the status frame.
 
-// a shared object is included to avoid race conditions.
-struct statusData
-{
-	boost::mutex statusMutex;
-	std::vector<CatheterChannelCmd> inputCommands;
-	bool updated;
-
-	// update function.
-	void updateCmdList(std::vector<CatheterChannelCmd> & inputCommands);
-
-	statusData() : updated(false)
-	{};
-};
-
-
-
 class StatusGrid: public wxFlexGridSizer
 {
 
@@ -36,7 +22,8 @@ public:
 	 StatusGrid(wxPanel* parent);
     ~StatusGrid();
 
-    bool updateStatus(statusData*);
+    // shows the channels of a snapshot (see StatusReader), formatting needs no lock.
+    void updateStatus(const StatusSnapshot &snapshot);
 
     // void SetCommands(const std::vector<CatheterChannelCmdSet>& cmds);
 	// void GetCommands(std::vector<CatheterChannelCmdSet>& cmds);
@@ -44,9 +31,14 @@ public:
 
 private:
 	
+	// only changes the control if the displayed text is different.
+	void setCell(int index, const wxString &value);
 
 	std::vector < wxTextCtrl* > textCtrl;
 
+	// the text currently shown in each control.
+	std::vector < wxString > cellText;
+
 
 
 };
@@ -1,47 +1,43 @@
-
-
-
 #ifndef GUI_STATUS_H
 #define GUI_STATUS_H
 #include <wx/wx.h>
+#include <wx/listctrl.h>
 #include <boost/thread.hpp>
 #include <boost/bind.hpp>
 
-// This file defines the status text box.
-
-struct incomingText
-{
-	boost::mutex textMutex;
-	std::string stringData;
-	bool update;
+#include "util/console_log.h"
 
-	incomingText() : update(false)
-	{
-	};
-
-	void appendText(const std::string  &newText);
-};
+// This file defines the status text box.
+// The messages live in a ConsoleLog, the box is a virtual list that only
+// formats the rows that are on screen.
 
-class CatheterStatusText : public wxScrolledWindow {
+class CatheterStatusText : public wxListCtrl {
 public:
 	
     // explicit constructor
-    explicit CatheterStatusText(wxWindow* parent, wxWindowID id);
+    explicit CatheterStatusText(wxWindow* parent, wxWindowID id, ConsoleLog *log);
+
+    // shows any new lines of the log (returns true if there were any)
+    bool addText();
 
     // public method to send text into the status box
-    bool addText(incomingText*);
-	bool addWxText(const wxString& msg);
+	bool addWxText(const wxString& msg, logSeverity severity = logInfo);
+
+protected:
+	// virtual list callbacks (only called for visible rows)
+	virtual wxString OnGetItemText(long item, long column) const;
+	virtual wxListItemAttr* OnGetItemAttr(long item) const;
 
 private:
-	wxStaticText *statusText;
+	ConsoleLog *consoleLog;
 
-    // the mutex is used to pass information forward
-    boost::mutex textMutex;
+	// sequence number of row 0.
+	uint64_t firstRow;
 
-    // appends text and scrolls down.
-    void SetCatheterStatusText(const wxString& msg);
+	// one attribute per severity.
+	mutable wxListItemAttr severityAttr[logError + 1];
 
 };
 
 
-#endif
\ No newline at end of file
+#endif
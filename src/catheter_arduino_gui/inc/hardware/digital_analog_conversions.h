@@ -5,26 +5,100 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <vector>
 #include "com/catheter_commands.h"
 
 // This file declares the functions capable of converting byte data to analog current
 // I.E. ADC data to mA and mA to DAC data.
+// Each channel has its own calibration profile. The profiles are compiled into
+// dense lookup tables (one entry per DAC/ADC value) so that decoding is a single load.
 
 
+/**
+ * @brief The calibration profile of a single channel.
+ *
+ * DAC (commanded current):  dac = dacGain * |mA| + dacOffset
+ * ADC (sensed current):     mA  = adcOffset + adcGain * adc + adcPoly[0] * adc^2 + adcPoly[1] * adc^3 ...
+ *
+ * The default constructor fills in the nominal (uncalibrated) board values.
+ */
+struct ChannelCalibration
+{
+	double dacGain;    // DAC counts per mA
+	double dacOffset;  // DAC counts at 0 mA
+	double adcGain;    // mA per ADC count
+	double adcOffset;  // mA at an ADC value of 0
+	std::vector<double> adcPoly;  // optional 2nd order and higher ADC terms
+
+	ChannelCalibration();
+};
+
+/**
+ * @brief Replaces the calibration profile of a channel and rebuilds its lookup tables.
+ * Channel 0 (GLOBAL_ADDR) is used for global commands and for out of range channels.
+ * The tables are not locked, so calibrate before starting serial traffic.
+ */
+void setChannelCalibration(int channel, const ChannelCalibration& profile);
+
+/**
+ * @brief Returns the calibration profile that is currently in use for a channel.
+ */
+const ChannelCalibration& getChannelCalibration(int channel);
+
+/**
+ * @brief Restores the nominal calibration on every channel.
+ */
+void resetChannelCalibration();
+
+/**
+ * @brief Loads a calibration file and applies it.
+ * Each line is "channel, dacGain, dacOffset, adcGain, adcOffset[, adcPoly2, adcPoly3, ...]",
+ * '#' starts a comment. Returns the number of channels calibrated, -1 or -2 if the file could not be read.
+ */
+int loadCalibrationFile(const char * fname);
+
 /**
  * @brief This function converts up to a 16 bit adc input to a milliAmp current.
+ * Values past the table are evaluated from the profile (in every conversion below too).
 */
-double adc2MilliAmp(uint16_t dataIn);
+double adc2MilliAmp(uint16_t dataIn, int channel = GLOBAL_ADDR);
 
 /**
 * @brief This function converts up to a milliAmp current into a dac bit value.
+* The result is truncated (never above the requested magnitude) and clamped to the DAC range.
 */
-uint16_t milliAmp2Dac(double mA);
+uint16_t milliAmp2Dac(double mA, int channel = GLOBAL_ADDR);
 
 /**
 * @brief This function converts the dac bit value to a milliAmp current.
 */
-double dac2MilliAmp(uint16_t dacVal, dir_t dir);
+double dac2MilliAmp(uint16_t dacVal, dir_t dir, int channel = GLOBAL_ADDR);
+
+/**
+ * @brief Batch versions of the conversions above for a run of samples on one channel.
+ * The loops are tight table lookups, out of range counts are evaluated from the profile like the scalar versions.
+ */
+void adc2MilliAmpBatch(const uint16_t *dataIn, double *milliAmpOut, size_t count, int channel = GLOBAL_ADDR);
+
+void milliAmp2DacBatch(const double *milliAmp, uint16_t *dacOut, size_t count, int channel = GLOBAL_ADDR);
+
+void dac2MilliAmpBatch(const uint16_t *dacVal, const dir_t *dir, double *milliAmpOut, size_t count, int channel = GLOBAL_ADDR);
+
+/**
+ * @brief Sets the current of a command from a milliAmp value (UI and file boundary).
+ * Fills in currentMilliAmp, dacCounts and dir. The channel must already be set.
+ */
+void setCmdMilliAmp(CatheterChannelCmd& cmd, double milliAmp);
+
+/**
+ * @brief The commanded current of a command (from its DAC counts and direction).
+ */
+double cmdMilliAmp(const CatheterChannelCmd& cmd);
+
+/**
+ * @brief The sensed current of a polled command (from its ADC counts).
+ */
+double cmdSensedMilliAmp(const CatheterChannelCmd& cmd);
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+#ifndef CATHETER_IPC_CLIENT_H
+#define CATHETER_IPC_CLIENT_H
+
+#include <string>
+#include <vector>
+
+#include "com/current_sample.h"
+#include "ipc/ipc_protocol.h"
+
+// This file defines the client side of the setpoint server (see ipc_server.h).
+// Requests are written with blocking sends, read() collects the acks and the
+// telemetry. One thread may send while another reads.
+
+/**
+ \brief A connection to a setpoint server.
+ */
+class IpcClient
+{
+public:
+	IpcClient();
+	~IpcClient();
+
+	bool connect(const std::string &socketPath = IPC_DEFAULT_SOCKET);
+	void close();
+	bool isConnected() const;
+
+	// the requests return their sequence number (echoed in the ack), 0 if nothing was sent.
+
+	// a nChannels x nSteps column major milliamp matrix, flags are IPC_FLAG_POLL and IPC_FLAG_FLUSH.
+	uint64_t sendSetpoints(const double *milliAmp, size_t nChannels, size_t nSteps, const double *delayMS,
+		size_t nDelays, uint8_t flags = 0);
+	// drops the queue and zeroes every channel.
+	uint64_t reset();
+	// queues a global poll.
+	uint64_t poll();
+	// drops the queue, the channels keep their last setting.
+	uint64_t abort();
+	uint64_t subscribe(bool enable = true);
+
+	// waits up to timeoutMs (0 to not wait) for data and appends what arrived.
+	// dropped counts the telemetry samples the server could not keep.
+	// returns false when the connection is closed or broken.
+	bool read(int timeoutMs, std::vector<IpcAckMessage> &acks, std::vector<CurrentSample> &samples,
+		uint64_t *dropped = NULL);
+
+private:
+	IpcClient(const IpcClient&);
+	IpcClient& operator=(const IpcClient&);
+
+	uint64_t sendRequest(uint8_t type, uint8_t flags);
+	bool sendFrame();
+
+	int fd;
+	uint64_t nextSequence;
+	IpcFrameReader reader;
+	std::vector<uint8_t> output;
+	std::vector<uint8_t> input;
+};
+
+#endif
@@ -0,0 +1,157 @@
+#pragma once
+#ifndef CATHETER_IPC_PROTOCOL_H
+#define CATHETER_IPC_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "com/current_sample.h"
+
+// This file defines the framing of the setpoint server (see ipc_server.h).
+// Client and server run on the same machine, so the structs go over the
+// socket as they are (native byte order). Every frame is a header followed
+// by length bytes of payload. Times are steady clock nanoseconds, which is
+// CLOCK_MONOTONIC and so shared between processes.
+
+#define IPC_MAGIC 0xCA7E
+#define IPC_HEADER_LEN 8
+
+// frames longer than this are a protocol error (the client is dropped).
+#define IPC_MAX_PAYLOAD (1 << 20)
+
+#define IPC_DEFAULT_SOCKET "/tmp/catheter_ipc.sock"
+
+enum IpcType
+{
+	// client to server
+	ipcSetpoints = 1, ipcReset, ipcPoll, ipcAbort, ipcSubscribe,
+	// server to client
+	ipcAck = 16, ipcTelemetry
+};
+
+// ipcSetpoints flags
+#define IPC_FLAG_POLL 1    // poll the channels after the setpoints of every step
+#define IPC_FLAG_FLUSH 2   // replace the queued sets instead of appending
+#define IPC_FLAG_LATEST 4  // one step written to the setpoint mailbox (latest value mode)
+// ipcSubscribe flags
+#define IPC_FLAG_ENABLE 1
+
+enum IpcAckStatus
+{
+	ipcOk = 0, ipcInvalid = -1
+};
+
+struct IpcHeader
+{
+	uint16_t magic;
+	uint8_t type;
+	uint8_t flags;
+	uint32_t length;
+};
+
+/**
+ \brief The start of every client request. The sequence is echoed in the ack.
+ */
+struct IpcRequest
+{
+	uint64_t sequence;
+	uint64_t sendNs;
+};
+
+/**
+ \brief ipcSetpoints: followed by nChannels x nSteps column major milliamps
+ (doubles, channels 1..nChannels) and nDelays (1 or nSteps) delays in ms.
+ */
+struct IpcSetpoints
+{
+	IpcRequest request;
+	uint16_t nChannels;
+	uint16_t nSteps;
+	uint16_t nDelays;
+	uint16_t reserved;
+};
+
+/**
+ \brief The answer to every request. queuedNs is when the sets were in the
+ serial thread's queue (or the mailbox), so queuedNs - sendNs is the process
+ to queue latency.
+ */
+struct IpcAckMessage
+{
+	uint64_t sequence;
+	uint64_t sendNs;
+	uint64_t queuedNs;
+	int32_t status;
+	uint32_t queuedSets;
+};
+
+/**
+ \brief ipcTelemetry: a count, the samples dropped since the last message, then the samples.
+ */
+struct IpcTelemetryHeader
+{
+	uint32_t count;
+	uint32_t dropped;
+};
+
+struct IpcSample
+{
+	double time;
+	uint16_t dacCounts;
+	uint16_t adcCounts;
+	uint8_t channel;
+	uint8_t dir;
+	uint8_t polled;
+	uint8_t reserved;
+};
+
+static_assert(sizeof(IpcHeader) == IPC_HEADER_LEN, "the ipc header is sent as is");
+static_assert(sizeof(IpcSetpoints) == 24, "the ipc setpoint header is sent as is");
+static_assert(sizeof(IpcAckMessage) == 32, "the ipc ack is sent as is");
+static_assert(sizeof(IpcSample) == 16, "the ipc samples are sent as is");
+
+/**
+ * \brief appends a frame (header and payload) to out.
+ */
+void ipcAppendFrame(std::vector<uint8_t> &out, uint8_t type, uint8_t flags, const void *payload, size_t length);
+
+/**
+ * \brief appends a setpoint frame, returns false (and appends nothing) if the sizes are invalid.
+ */
+bool ipcAppendSetpoints(std::vector<uint8_t> &out, const IpcRequest &request, const double *milliAmp,
+	size_t nChannels, size_t nSteps, const double *delayMS, size_t nDelays, uint8_t flags);
+
+IpcSample ipcSampleFromCurrent(const CurrentSample &sample);
+CurrentSample ipcSampleToCurrent(const IpcSample &sample);
+
+/**
+ * \brief steady clock nanoseconds.
+ */
+uint64_t ipcNowNs();
+
+enum IpcFrameStatus
+{
+	ipcFrameReady = 0, ipcFrameNeedMore, ipcFrameBad
+};
+
+/**
+ \brief Splits a byte stream into frames.
+ */
+class IpcFrameReader
+{
+public:
+	IpcFrameReader();
+
+	void feed(const uint8_t *bytes, size_t count);
+
+	// the payload pointer stays valid until the next feed().
+	IpcFrameStatus next(IpcHeader &header, const uint8_t *&payload);
+
+	size_t buffered() const;
+
+private:
+	std::vector<uint8_t> buffer;
+	size_t offset;
+};
+
+#endif
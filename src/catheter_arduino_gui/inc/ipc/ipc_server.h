@@ -0,0 +1,111 @@
+#pragma once
+#ifndef CATHETER_IPC_SERVER_H
+#define CATHETER_IPC_SERVER_H
+
+#include <boost/thread.hpp>
+#include <string>
+#include <vector>
+
+#include "com/current_sample.h"
+#include "ipc/ipc_protocol.h"
+#include "ser/serial_thread.h"
+#include "ser/setpoint_mailbox.h"
+#include "util/spsc_ring.h"
+
+// This file defines the setpoint server: a unix domain socket in the
+// controller process that external programs (navigation, scripts) use to
+// stream setpoints, send reset, poll and abort, and subscribe to the
+// telemetry. One thread serves every client with poll(), decoded setpoints
+// go straight into the serial thread's queue and are acked with the time
+// they got there.
+
+#define IPC_MAX_CLIENTS 16
+
+// replies buffered for the subscribers between server wake ups.
+#define IPC_TELEMETRY_RING 65536
+
+// the server wakes up this often to send telemetry when someone subscribed.
+#define IPC_TELEMETRY_PERIOD_MS 5
+
+// a client that lets this much output pile up is disconnected.
+#define IPC_MAX_BACKLOG (4 << 20)
+
+struct IpcServerStats
+{
+	uint64_t clientsAccepted;
+	uint64_t clientsRejected;
+	uint64_t framesIn;
+	uint64_t framesBad;
+	uint64_t setsQueued;
+	uint64_t samplesOut;
+	uint64_t samplesDropped;
+	int clientsActive;
+
+	IpcServerStats() : clientsAccepted(0), clientsRejected(0), framesIn(0), framesBad(0), setsQueued(0),
+		samplesOut(0), samplesDropped(0), clientsActive(0)
+	{};
+};
+
+/**
+ \brief Serves setpoints from other processes into a serial thread.
+ The serial thread must outlive the server.
+ */
+class IpcServer
+{
+public:
+	explicit IpcServer(SerialThreadObject &serialObject);
+	~IpcServer();
+
+	// fails if the socket cannot be created or another server is answering on it.
+	bool start(const std::string &socketPath = IPC_DEFAULT_SOCKET);
+	void stop();
+	bool running() const;
+
+	void getStats(IpcServerStats &stats);
+
+	// where IPC_FLAG_LATEST setpoints go (they are refused while NULL), set before start().
+	void setMailbox(SetpointMailbox *mailbox);
+
+private:
+	IpcServer(const IpcServer&);
+	IpcServer& operator=(const IpcServer&);
+
+	struct Client
+	{
+		int fd;
+		bool subscribed;
+		IpcFrameReader reader;
+		std::vector<uint8_t> output;
+	};
+
+	void serverLoop();
+	void acceptClients();
+	// false when the client should be dropped.
+	bool readClient(Client &client);
+	bool handleFrame(Client &client, const IpcHeader &header, const uint8_t *payload);
+	bool flushClient(Client &client);
+	void sendTelemetry();
+	void closeClient(size_t index);
+
+	SerialThreadObject &serialObject;
+	SetpointMailbox *mailbox;
+	SpscRing<CurrentSample> telemetryRing;
+	std::vector<Client> clients;
+	std::vector<CurrentSample> drainBuffer;
+	std::vector<IpcSample> sampleBuffer;
+	std::vector<uint8_t> telemetryFrame;
+	std::vector<double> currentBuffer;
+	std::vector<double> delayBuffer;
+
+	std::string socketPath;
+	int listenFd;
+	int wakePipe[2];
+	uint64_t droppedReported;
+	bool active;
+
+	boost::mutex statsMutex;
+	IpcServerStats stats;
+	boost::thread thrd;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#pragma once
+#ifndef CATHETER_INFLIGHT_TABLE_H
+#define CATHETER_INFLIGHT_TABLE_H
+
+#include <vector>
+#include "com/catheter_commands.h"
+
+// This file defines the table that matches arduino replies to the packets sent.
+// The packet index on the wire is 3 bits, so there are 8 slots. A slot reused
+// before its reply arrives queues the new packet behind the old one. The firmware
+// answers in order, so a reply that echoes a newer packet of its slot means the
+// replies of the packets before it were lost, they are retired at once.
+
+#define INFLIGHT_SLOTS 8
+
+// packets queued per slot, the oldest is dropped (and counted as timed out) past this.
+// The replies still owed to dropped or expired packets are skipped when they arrive,
+// they are assumed lost after twice the timeout.
+#define INFLIGHT_DEPTH 8
+
+// a reply that takes longer than this is counted as timed out.
+#define REPLY_TIMEOUT_MS 500
+
+enum ReplyMatch
+{
+	replyMatched = 0, replyMismatch, replyUnmatched,
+	replyLate  // the reply of a packet already dropped or expired (no round trip)
+};
+
+/**
+ \brief The packets waiting for their reply, keyed by packet index.
+
+ Each slot keeps the send time and the echo the firmware should send back:
+ one entry per channel command (global commands expand to every channel).
+ Polled commands only check the channel, the firmware echoes its state.
+ */
+class InFlightTable
+{
+public:
+	InFlightTable();
+
+	// records a packet, returns true if its slot was full and the oldest packet was dropped.
+	bool sent(int packetIndex, const CatheterChannelCmdSet &cmdSet, double sendTime);
+
+	// matches a valid reply to the oldest packet of its slot that it echoes (or else to the
+	// oldest packet, as a mismatch). rttUs is set unless the reply is unmatched or late,
+	// lost is set to the older packets retired because their reply never came.
+	ReplyMatch reply(int packetIndex, const std::vector<CatheterChannelCmd> &echo, double replyTime, double &rttUs,
+		int &lost);
+
+	// a reply failed its checks (its index can not be trusted): retires the oldest packet
+	// waiting in any slot, returns false if none was.
+	bool replyInvalid();
+
+	// frees the packets sent before now - timeout, returns how many.
+	int expire(double now, double timeoutSeconds);
+
+	// the packets waiting for a reply.
+	int pending() const;
+
+	void clear();
+
+private:
+	struct Entry
+	{
+		double sendTime;
+		std::vector<CatheterChannelCmd> expected;
+
+		Entry() : sendTime(0.0)
+		{};
+	};
+
+	// a fifo of the packets sent with one index.
+	struct Slot
+	{
+		Entry entries[INFLIGHT_DEPTH];
+		int first;
+		int count;
+		// replies owed to packets dropped or expired, and the newest of their send times.
+		int owed;
+		double owedTime;
+
+		Slot() : first(0), count(0), owed(0), owedTime(0.0)
+		{};
+	};
+
+	// moves the oldest packet of a slot to the owed replies.
+	void dropOldest(Slot &slot);
+
+	// removes the oldest packet of a slot.
+	void popOldest(Slot &slot);
+
+	static bool echoes(const Entry &entry, const std::vector<CatheterChannelCmd> &echo);
+
+	Slot slots[INFLIGHT_SLOTS];
+};
+
+#endif
@@ -0,0 +1,89 @@
+#pragma once
+#ifndef CATHETER_LINK_DECODE_H
+#define CATHETER_LINK_DECODE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "com/catheter_commands.h"
+#include "util/link_log.h"
+
+// This file defines the decoder that turns the records of a link log back
+// into packets: the command packets written to the board and the replies read
+// back, framed across the chunks they arrived in. A reply is matched to the
+// last command packet with the same packet index for its round trip.
+
+enum LinkPacketKind
+{
+	linkPacketCommand = 0,  // written to the board
+	linkPacketReply,        // read from the board
+	linkPacketGarbage,      // bytes of either stream that did not frame a valid packet
+	linkPacketMark          // a mark record (port opened or closed)
+};
+
+/**
+ \brief One decoded packet.
+ */
+struct LinkPacket
+{
+	LinkPacketKind kind;
+	bool outgoing;
+	uint64_t timeNs;         // of the record that completed the packet
+	uint64_t streamOffset;   // of the first byte in its stream (bytes written or read so far)
+	size_t length;
+	int packetIndex;         // on the wire (3 bits), -1 for garbage and marks
+	double rttUs;            // replies: from the matching command packet, -1 if none
+	std::vector<CatheterChannelCmd> cmds;  // the commands sent or the echo (counts only)
+	std::string text;        // marks
+
+	LinkPacket() : kind(linkPacketGarbage), outgoing(false), timeNs(0), streamOffset(0), length(0),
+		packetIndex(-1), rttUs(-1.0)
+	{};
+};
+
+/**
+ \brief Frames the records of a link log into packets, in record order.
+ */
+class LinkPacketDecoder
+{
+public:
+	LinkPacketDecoder();
+
+	// decodes one record, appends the packets it completes.
+	void feed(const LinkRecordView &record, std::vector<LinkPacket> &packets);
+
+	// reports the bytes still waiting for the rest of a packet as garbage.
+	void finish(uint64_t timeNs, std::vector<LinkPacket> &packets);
+
+	uint64_t garbageBytes() const;
+
+private:
+	struct Stream
+	{
+		std::vector<uint8_t> pending;
+		uint64_t offset;        // stream offset of pending[0]
+		size_t garbageRun;      // bytes at the front of pending already known to be garbage
+
+		Stream() : offset(0), garbageRun(0)
+		{};
+	};
+
+	void frame(Stream &stream, bool outgoing, uint64_t timeNs, std::vector<LinkPacket> &packets);
+	void flushGarbage(Stream &stream, bool outgoing, uint64_t timeNs, std::vector<LinkPacket> &packets);
+
+	// length of the packet starting at bytes, 0 if it can not start one, SIZE_MAX if more bytes are needed.
+	size_t decodePacket(bool outgoing, const uint8_t *bytes, size_t length, LinkPacket &packet);
+
+	Stream out;
+	Stream in;
+	uint64_t sentNs[8];
+	bool sentPending[8];
+	uint64_t garbage;
+};
+
+/**
+ * \brief the command of a packet as text, "ch2 +1234 en poll" (dac counts, the adc as "adc 1234" in replies).
+ */
+std::string linkCommandText(const CatheterChannelCmd &cmd, bool reply);
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+#ifndef CATHETER_QUEUE_COALESCE_H
+#define CATHETER_QUEUE_COALESCE_H
+
+#include <cstddef>
+#include <deque>
+#include "com/catheter_commands.h"
+
+// This file defines the coalescing pass of the serial thread queue (see
+// SerialThreadObject::setCoalescing()). A set with no delay is replaced by
+// the next set as soon as it is sent, so its channel updates only matter
+// for the channels the next set does not touch. Such a set is merged into
+// the next one, dropping the updates the next set supersedes.
+//
+// A set is kept as it is when it has a delay (a dwell), polls (a
+// measurement was asked for) or holds a global command (the firmware
+// answers global packets for every channel, they are not mixed with
+// channel commands). A zero delay set followed by a global set that writes
+// is dropped whole, the global command supersedes all of it. One followed by
+// a global poll is sent as it is, and a channel poll does not supersede the
+// update of its channel.
+
+// most commands in a packet (the preamble count is 4 bits), larger merges are skipped.
+#define COALESCE_MAX_CMDS 15
+
+/**
+ \brief What a coalescing pass removed.
+ */
+struct CoalesceCounts
+{
+	size_t setsMerged;      // sets folded into the set after them
+	size_t updatesDropped;  // channel commands superseded by a later set
+
+	CoalesceCounts() : setsMerged(0), updatesDropped(0)
+	{};
+};
+
+/**
+ * \brief true if the set can be folded into the set after it.
+ */
+bool coalescible(const CatheterChannelCmdSet &cmdSet);
+
+/**
+ * \brief coalesces the queue from index first to the end (the sets before first are left alone).
+ * Sends the same final channel state at the same times, in fewer packets.
+ */
+CoalesceCounts coalesceQueue(std::deque<CatheterChannelCmdSet> &queue, size_t first = 0);
+
+#endif
@@ -9,6 +9,7 @@
 
 #include "ser/simple_serial.h"
 #include "com/catheter_commands.h"
+#include "util/metrics.h"
 
 
 #define PAD_CMDS false
@@ -22,6 +23,11 @@ private:
 	// The serial port pointer of the interface?
 	SerialPort *sp;
 	std::vector< unsigned char> bytesAvailable;
+
+	// link counters (invalid handles until setMetrics()).
+	MetricCounter bytesIn;
+	MetricCounter bytesOut;
+	MetricCounter checksumFailures;
 public:
 	CatheterSerialSender();
 	~CatheterSerialSender();
@@ -42,8 +48,16 @@ public:
 
 	bool dataAvailable();
 	comStatus getData(std::vector< CatheterChannelCmd > &);
+	// also gives the packet index of the reply (-1 when nothing was buffered).
+	comStatus getData(std::vector< CatheterChannelCmd > &, int &packetIndex);
 
 	void sendCommand(const CatheterChannelCmdSet &, int);
+
+	// registers the byte and checksum counters (call before the sender is used from another thread).
+	void setMetrics(MetricsRegistry*);
+
+	// records the port traffic in a link log (NULL to stop).
+	void setRecorder(LinkRecorder*);
 };
 
 
@@ -0,0 +1,67 @@
+#pragma once
+#ifndef CATHETER_SERIAL_SESSION_H
+#define CATHETER_SERIAL_SESSION_H
+
+#include <string>
+#include <vector>
+
+#include "com/current_sample.h"
+#include "ser/serial_thread.h"
+#include "util/console_log.h"
+#include "util/spsc_ring.h"
+
+// This file defines a serial session for scripting front ends (MATLAB, Python).
+// It owns the serial thread, the reply ring and a small console log, so a
+// script only feeds setpoint arrays and drains the telemetry. Neither call blocks,
+// the sets are sent by the serial thread on its own schedule.
+
+// replies kept between telemetry polls (older ones are dropped).
+#define SESSION_RING_SAMPLES 262144
+
+// console messages kept.
+#define SESSION_LOG_LINES 64
+
+
+/**
+ \brief A serial connection with its own scheduler and telemetry.
+ */
+class SerialSession
+{
+public:
+	explicit SerialSession(size_t ringSamples = SESSION_RING_SAMPLES, size_t logLines = SESSION_LOG_LINES);
+
+	// zeroes every channel (when connected) before the port closes.
+	~SerialSession();
+
+	bool open(const std::string &portName);
+	bool isOpen();
+
+	// queues a nChannels x nSteps column major milliamp matrix (see currentMatrix2Sequence()).
+	// returns -1 (and queues nothing) if the sizes are invalid.
+	int enqueue(const double *milliAmp, size_t nChannels, size_t nSteps, const double *delayMS, size_t nDelays, bool poll);
+
+	// drops the queue and zeroes every channel.
+	void reset();
+
+	// copies up to maxCount replies (oldest first), returns the number copied.
+	size_t pollTelemetry(CurrentSample *samples, size_t maxCount);
+	size_t pendingTelemetry() const;
+	size_t droppedTelemetry() const;
+
+	size_t queuedSets();
+	bool idle();
+	void getStats(PlaybackStats &stats);
+
+	const ConsoleLog& log() const;
+
+private:
+	// not copyable.
+	SerialSession(const SerialSession&);
+	SerialSession& operator=(const SerialSession&);
+
+	ConsoleLog consoleLog;
+	SpscRing<CurrentSample> sampleRing;
+	SerialThreadObject serialObject;
+};
+
+#endif
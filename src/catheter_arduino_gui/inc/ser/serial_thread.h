@@ -4,22 +4,160 @@
 
 #include <boost/thread.hpp>
 #include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <deque>
+#include <string>
+#include <vector>
 #include "com/catheter_commands.h"
+#include "com/status_data.h"
+#include "ser/inflight_table.h"
+#include "ser/queue_coalesce.h"
 #include "ser/serial_sender.h"
-#include "gui/status_text.h"
-#include "gui/status_frame.h"
+#include "ser/setpoint_mailbox.h"
+#include "util/console_log.h"
+#include "util/metrics.h"
+#include "util/spsc_ring.h"
+#include "com/current_sample.h"
 
 
+// lateness and round trip samples kept per playback (the counters and the maximum keep going).
+#define PLAYBACK_MAX_SAMPLES 1048576
+
+// round trip histogram, bin b counts [2^b, 2^(b+1)) us, the last bin is open ended.
+#define RTT_HISTOGRAM_BINS 24
+
+// longest serialCommand(resetArduino) waits for the reset to be written.
+#define RESET_WRITE_WAIT_MS 100
+
+// picks one of the available ports (returns the index, or -1 to cancel).
+typedef boost::function<int (const std::vector<std::string>&)> PortSelector;
+
+/**
+ \brief Counters of a playback, filled in by the serial loop.
+
+ Lateness is how far past its deadline each set was written. Deadlines are
+ absolute (the previous deadline plus the set delay) so waiting and loop
+ overhead do not accumulate over a playfile.
+
+ Valid replies are matched to the packet sent (see InFlightTable): the round
+ trip is from writing the packet to parsing its reply, and the echoed
+ DAC, enable and direction are checked against what was sent.
+
+ In mailbox mode (see SerialThreadObject::setMailbox()) the staleness is from
+ the producer writing a setpoint to the reply of the packet that carried it.
+ */
+struct PlaybackStats
+{
+	uint64_t setsSent;
+	uint64_t repliesValid;
+	uint64_t repliesInvalid;
+	uint64_t repliesMatched;    // valid replies that echoed the packet sent
+	uint64_t echoMismatches;    // valid replies that echoed something else
+	uint64_t repliesUnmatched;  // valid replies with no packet waiting in their slot
+	uint64_t replyTimeouts;
+	uint64_t mailboxSends;       // packets built from the mailbox
+	uint64_t mailboxSuperseded;  // mailbox writes overwritten before the link was free
+	uint64_t setsCoalesced;      // zero delay sets folded into the next set (see setCoalescing())
+	uint64_t updatesCoalesced;   // channel commands superseded before they were sent
+	double firstSendTime;   // steady clock seconds
+	double lastSendTime;
+	double maxLatenessUs;
+	double maxRttUs;
+	double maxStalenessUs;
+	std::vector<double> latenessUs;
+	std::vector<double> rttUs;
+	std::vector<double> stalenessUs;
+	uint64_t rttHistogram[RTT_HISTOGRAM_BINS];
+
+	PlaybackStats() : setsSent(0), repliesValid(0), repliesInvalid(0), repliesMatched(0),
+		echoMismatches(0), repliesUnmatched(0), replyTimeouts(0), mailboxSends(0), mailboxSuperseded(0),
+		setsCoalesced(0), updatesCoalesced(0),
+		firstSendTime(0.0), lastSendTime(0.0), maxLatenessUs(0.0), maxRttUs(0.0), maxStalenessUs(0.0)
+	{
+		for (int i(0); i < RTT_HISTOGRAM_BINS; i++)
+		{
+			rttHistogram[i] = 0;
+		}
+	};
+};
+
+/**
+ * \brief the lateness (us) below which the given fraction of the recorded sets fall (nearest rank).
+ */
+double latenessPercentile(const PlaybackStats &stats, double fraction);
+
+/**
+ * \brief the round trip (us) below which the given fraction of the matched replies fall (nearest rank).
+ */
+double rttPercentile(const PlaybackStats &stats, double fraction);
+
+/**
+ * \brief the mailbox staleness (us) below which the given fraction of the acked mailbox packets fall.
+ */
+double stalenessPercentile(const PlaybackStats &stats, double fraction);
+
+/**
+ \brief The serial thread metrics (see MetricsRegistry). Packets are command
+ sets; acked means matched to a reply with the expected echo, errored means a
+ reply that failed to parse. The round trips are in microseconds.
+ */
+struct SerialThreadMetrics
+{
+	MetricCounter packetsQueued;
+	MetricCounter packetsSent;
+	MetricCounter packetsAcked;
+	MetricCounter packetsErrored;
+	MetricCounter echoMismatches;
+	MetricCounter repliesUnmatched;
+	MetricCounter replyTimeouts;
+	MetricCounter loopWakeups;
+	MetricCounter mailboxSends;
+	MetricCounter mailboxSuperseded;
+	MetricCounter setsCoalesced;
+	MetricCounter updatesCoalesced;
+	MetricGauge queueDepth;
+	MetricGauge connected;
+	MetricHistogram rttUs;
+	MetricHistogram stalenessUs;
+
+	SerialThreadMetrics() {};
+	explicit SerialThreadMetrics(MetricsRegistry &registry);
+};
+
 // This class acts a thread manager for offloading the serial communication. (high-level)
-// Prevents gui hangs.
+// Prevents gui hangs. It has no gui dependencies, the gui only supplies the port selector.
 class SerialThreadObject
 {
 public:
 	
-	SerialThreadObject();
-	void setStatusTextPtr(incomingText*);
+	// the metrics are registered in (and must outlive) the registry given, if any.
+	explicit SerialThreadObject(MetricsRegistry *metricsRegistry = NULL);
+	void setStatusTextPtr(ConsoleLog*);
 	void setStatusGrid(statusData*);
 
+	// every channel of every valid reply is pushed into the ring (NULL to stop).
+	void setSampleRing(SpscRing<CurrentSample>*);
+
+	// a second ring getting the same samples, for a consumer besides the plots (the setpoint server, NULL to stop).
+	void setSampleTap(SpscRing<CurrentSample>*);
+
+	// latest value mode (NULL to stop): once the queue is empty, the freshest mailbox
+	// setpoints are sent whenever no packet is waiting for its reply, only the
+	// channels that changed. Queued sets (reset, poll) still go first.
+	void setMailbox(SetpointMailbox*);
+
+	// coalesces the queue as sets are added (see queue_coalesce.h): zero delay sets
+	// without a poll are merged into the next set, so a backlog of superseded
+	// updates collapses. Off by default, the sets are then sent exactly as queued.
+	void setCoalescing(bool enable);
+
+	// records every byte written to and read from the port (see link_log.h, NULL to stop).
+	// The recorder must outlive the serial thread.
+	void setLinkRecorder(LinkRecorder*);
+
+	// asked to choose when resetSerial finds several ports (the first port is used if unset).
+	void setPortSelector(const PortSelector&);
+
 	
 enum ThreadCmd {
 		noCmd = 0, resetArduino = -2, resetSerial = -1, poll  = 1, connect, disconnect
@@ -42,6 +180,7 @@ enum ThreadStatus{
 
 	/*
 	 * @brief: This sends a command to the  loop thread
+	 * resetArduino drops the queue, and returns once the reset is written (it does not wait for its deadline).
 	 */
 	void serialCommand(const ThreadCmd&);
 	
@@ -49,6 +188,20 @@ enum ThreadStatus{
 
 	void restartThread();
 
+	// opens a known port directly (blocking), returns true when connected.
+	bool connectPort(const std::string &portName);
+
+	bool isConnected();
+
+	// sets still waiting to be sent.
+	size_t queuedSets();
+
+	// true once the queue is empty and the last set delay has elapsed.
+	bool playbackIdle();
+
+	void getStats(PlaybackStats &stats);
+	void resetStats();
+
 private:
 
 	ThreadCmd incomingCommand;
@@ -75,7 +228,31 @@ private:
 
 
     // data to send to arduino.
-	std::vector< CatheterChannelCmdSet > commandsToArd;
+	std::deque< CatheterChannelCmdSet > commandsToArd;
+
+	bool coalescing;
+
+	// runs the coalescing pass from index first (with the lock held).
+	void coalesceFrom(size_t first);
+
+	// the mailbox packet in flight got no matching reply: its channels are no longer
+	// known to hold what it sent (with the lock held).
+	void mailboxLost();
+
+	// set when the queue ran dry after the last deadline passed.
+	// The next queued set is then sent right away.
+	bool idle;
+
+	// a reset is at the front of the queue, it goes out without waiting for the deadline.
+	bool resetQueued;
+	boost::condition_variable resetWritten;
+
+	PlaybackStats stats;
+
+	// the packets waiting for their reply.
+	InFlightTable inFlight;
+
+	SerialThreadMetrics metrics;
 
 	// reply from arduino.
 	CatheterChannelCmdSet commandFromArd;
@@ -84,7 +261,25 @@ private:
 	// gui handles
 	statusData * statusGridData;
 	
-	incomingText* textStatusData;
+	ConsoleLog* textStatusData;
+
+	PortSelector portSelector;
+
+	// telemetry for the plots (the serial thread is the only producer).
+	SpscRing<CurrentSample>* sampleRing;
+	SpscRing<CurrentSample>* sampleTap;
+
+	// latest value mode, the version last read and what each channel was sent.
+	SetpointMailbox* mailbox;
+	uint64_t mailboxVersion;
+	MailboxChannelState mailboxSent[NCHANNELS];
+	CatheterChannelCmdSet mailboxSet;
+	// the slot of the mailbox packet waiting for its reply (-1 if none), and set when
+	// that packet was lost so the setpoints are read and sent again.
+	int mailboxSlot;
+	bool mailboxResend;
+	// the write time of the mailbox setpoints each packet slot carries (0 for queued sets).
+	uint64_t slotWriteNs[INFLIGHT_SLOTS];
 };
 
 
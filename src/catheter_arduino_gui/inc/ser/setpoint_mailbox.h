@@ -0,0 +1,76 @@
+#pragma once
+#ifndef CATHETER_SETPOINT_MAILBOX_H
+#define CATHETER_SETPOINT_MAILBOX_H
+
+#include <cstddef>
+#include <cstdint>
+#include "com/catheter_commands.h"
+#include "util/seqlock.h"
+
+// This file defines the latest value setpoint mailbox (teleoperation mode).
+// Producers (a joystick, the setpoint server) overwrite the desired current
+// of each channel, they never queue. The serial thread takes the freshest
+// setpoints whenever the link is free and sends only the channels that
+// changed since its last packet, so a fast producer cannot build a backlog
+// of stale sets (see SerialThreadObject::setMailbox()).
+
+/**
+ \brief The desired current of every channel, as written by the producers.
+ */
+struct MailboxSetpoints
+{
+	double milliAmp[NCHANNELS];  // channel c at index c - 1
+	uint64_t writeNs;            // steady clock nanoseconds of the last write
+	bool poll;                   // request the sensed current with the commands sent
+};
+
+/**
+ \brief What the serial thread last sent to a channel from the mailbox.
+ */
+struct MailboxChannelState
+{
+	bool known;
+	uint16_t dacCounts;
+	dir_t dir;
+
+	MailboxChannelState() : known(false), dacCounts(0), dir(DIR_NEG)
+	{};
+};
+
+/**
+ \brief Latest setpoints, written and read from any thread without blocking the reader.
+ */
+class SetpointMailbox
+{
+public:
+	SetpointMailbox();
+
+	// sets channels 1..nChannels (the others keep their setpoint), returns the new version.
+	uint64_t write(const double *milliAmp, size_t nChannels, bool poll = false);
+
+	uint64_t writeChannel(int channel, double milliAmp);
+
+	// the freshest complete setpoints, returns their version.
+	uint64_t read(MailboxSetpoints &setpoints) const;
+
+	// the number of writes so far, cheap enough to check every loop.
+	uint64_t version() const;
+
+private:
+	Seqlock<MailboxSetpoints> setpoints;
+};
+
+/**
+ * \brief the commands for the channels whose DAC counts or direction differ from sent, sent is updated.
+ * With setpoints.poll the changed channels are polled after the updates.
+ * Returns the number of commands added to cmdSet (which is cleared first).
+ */
+size_t mailboxChangedCommands(const MailboxSetpoints &setpoints, MailboxChannelState sent[NCHANNELS],
+	CatheterChannelCmdSet &cmdSet);
+
+/**
+ * \brief steady clock nanoseconds (the clock of MailboxSetpoints::writeNs).
+ */
+uint64_t mailboxNowNs();
+
+#endif
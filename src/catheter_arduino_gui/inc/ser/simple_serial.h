@@ -9,12 +9,14 @@
 #include <boost/bind.hpp>
 #include <boost/thread.hpp>
  
+#include <atomic>
 #include <string>
 #include <vector>
-#include <time.h>
 
 // This file defines the low level serial interface.
 
+class LinkRecorder;
+
 typedef boost::shared_ptr<boost::asio::serial_port> serial_port_ptr;
  
 #define SERIAL_PORT_READ_BUF_SIZE 256
@@ -40,12 +42,12 @@ protected:
 private:
 	SerialPort(const SerialPort &p);
 	SerialPort &operator=(const SerialPort &p); 
- 
-	clock_t tSend;
-	clock_t tRecieve;
 
 	boost::thread t;
 
+	// every write (before it is made) and read chunk goes to the link log (NULL: not recorded).
+	std::atomic<LinkRecorder*> recorder_;
+
 public:
 	enum Baud {
 		BR_9600 = 9600,
@@ -70,6 +72,9 @@ public:
 	std::vector<std::string> get_port_names();
 
 	bool isOpen();
+
+	// records the traffic in a link log from now on (NULL to stop), the recorder must outlive the port.
+	void setRecorder(LinkRecorder *recorder);
  
 	//std::string flushData();
 	std::vector<unsigned char> flushData();
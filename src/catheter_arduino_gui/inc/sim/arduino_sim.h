@@ -0,0 +1,103 @@
+#pragma once
+#ifndef ARDUINO_SIM_H
+#define ARDUINO_SIM_H
+
+#include <boost/thread.hpp>
+#include <stdint.h>
+#include <string>
+#include "com/communication_definitions.h"
+
+// This file defines a simulated arduino for running the serial stack without hardware.
+// It answers the packet protocol of catheter_arduino_ard_ide (cmd_check, cmd_parse)
+// on a pseudo terminal, so the pc side opens it like the real port (POSIX only).
+
+// largest firmware reply: 15 global polled commands.
+#define SIM_MAX_REPLY_LEN (3 + 15 * NCHANNELS * 5)
+
+/**
+ \brief link and firmware timing of the simulated arduino.
+ */
+struct ArduinoSimOptions
+{
+	int baud;             // bits/s on the wire (10 bits per byte), 0 for no limit (native usb)
+	double processingUs;  // firmware time per packet
+	double jitterUs;      // extra processing time, uniform in [0, jitterUs)
+	unsigned int seed;
+	unsigned int dropReply;  // the reply of every dropReply-th packet is lost (0: none), the packet is still applied
+
+	ArduinoSimOptions() : baud(0), processingUs(0.0), jitterUs(0.0), seed(1), dropReply(0)
+	{};
+};
+
+struct ArduinoSimStats
+{
+	uint64_t packetsIn;
+	uint64_t packetsRejected;
+	uint64_t bytesIn;
+	uint64_t bytesOut;
+
+	ArduinoSimStats() : packetsIn(0), packetsRejected(0), bytesIn(0), bytesOut(0)
+	{};
+};
+
+/**
+ \brief the state of one firmware channel (what the replies echo).
+ */
+struct ArduinoChannelState
+{
+	uint16_t dacCounts;
+	bool enable;
+	bool dir;
+
+	ArduinoChannelState() : dacCounts(0), enable(false), dir(false)
+	{};
+};
+
+/**
+ * \brief the firmware reply to one request packet, written to replyOut (at least SIM_MAX_REPLY_LEN bytes).
+ * Returns the reply length, or 0 if the packet fails cmd_check (the firmware then writes a single error byte).
+ */
+size_t arduinoReply(const uint8_t *packet, size_t length, ArduinoChannelState channels[NCHANNELS], uint8_t *replyOut);
+
+/**
+ \brief a firmware on a pseudo terminal, answered from its own thread.
+
+ Request bytes are timed as if they came over the configured baud rate, each
+ packet takes the processing time (plus jitter) and packets are processed one
+ at a time, so replies queue up like on the board when the pc sends too fast.
+ */
+class ArduinoSim
+{
+public:
+	explicit ArduinoSim(const ArduinoSimOptions &options = ArduinoSimOptions());
+	~ArduinoSim();
+
+	// opens the pseudo terminal and starts answering, false if none could be opened.
+	bool start();
+	void stop();
+
+	// the device the pc side opens (e.g. /dev/pts/3).
+	std::string portName() const;
+
+	void getStats(ArduinoSimStats &stats);
+
+private:
+	ArduinoSim(const ArduinoSim&);
+	ArduinoSim& operator=(const ArduinoSim&);
+
+	void simLoop();
+
+	ArduinoSimOptions options;
+	ArduinoChannelState channels[NCHANNELS];
+
+	int masterFd;
+	int slaveFd;
+	std::string slaveName;
+
+	bool active;
+	ArduinoSimStats stats;
+	boost::mutex simMutex;
+	boost::thread thrd;
+};
+
+#endif
@@ -0,0 +1,191 @@
+#pragma once
+#ifndef CATHETER_ASYNC_LOG_H
+#define CATHETER_ASYNC_LOG_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "util/console_log.h"
+
+// This file defines the asynchronous log. A log call only records a
+// timestamp, the severity, the format (a string literal, only the pointer
+// is kept) and its arguments in binary into a lock free ring of the calling
+// thread. A background thread formats the records printf style and writes
+// them to the log file, to the console log given with the record (the gui
+// console) or else to stdout.
+//
+// Nothing is formatted, locked or allocated on the calling thread (the first
+// call of a thread claims a ring). A record that does not fit in the ring is
+// dropped and counted.
+
+// records per thread ring.
+#define LOG_RING_RECORDS 1024
+
+// most threads logging at the same time (a ring is reused when its thread exits).
+#define LOG_MAX_THREADS 32
+
+#define LOG_MAX_ARGS 4
+
+// bytes for the string arguments of a record (longer strings are truncated).
+#define LOG_TEXT_LEN 48
+
+// longest formatted message.
+#define LOG_LINE_LEN_MAX 256
+
+// how often the background thread looks at the rings.
+#define LOG_DRAIN_PERIOD_MS 2
+
+enum logArgType
+{
+	logArgSigned = 0, logArgUnsigned, logArgDouble, logArgText, logArgPointer
+};
+
+/**
+ \brief One log call, as captured on the calling thread.
+ */
+struct LogRecord
+{
+	uint64_t timeNs;        // steady clock
+	const char *format;
+	ConsoleLog *console;    // NULL: stdout
+	logSeverity severity;
+	uint8_t nArgs;
+	uint8_t textUsed;
+	uint8_t types[LOG_MAX_ARGS];
+	union ArgValue
+	{
+		int64_t i;
+		uint64_t u;
+		double d;
+	};
+	ArgValue args[LOG_MAX_ARGS];   // a text argument holds its offset in text
+	char text[LOG_TEXT_LEN];
+};
+
+extern std::atomic<int> logMinSeverity;
+
+/**
+ * \brief queues a record on the ring of the calling thread.
+ */
+void logPush(const LogRecord &record);
+
+/**
+ * \brief formats the message of a record (no timestamp or severity), returns its length.
+ */
+size_t logFormat(const LogRecord &record, char *out, size_t size);
+
+// messages below this severity are not recorded (default logInfo).
+void logSetLevel(logSeverity severity);
+
+// also writes every message to a file (an empty name closes it), false if it can not be opened.
+bool logOpenFile(const std::string &fileName);
+
+// whether messages without a console go to stdout (default true).
+void logSetStdout(bool enable);
+
+// waits until everything logged before the call is written.
+void logFlush();
+
+// records dropped because a ring was full (or every ring was taken).
+uint64_t logDropped();
+
+// the log thread calls flushSuppressed() on a console after each drain until it returns true
+// (ConsoleLog registers itself when it starts suppressing, and forgets itself when destroyed).
+void logWatchConsole(ConsoleLog *console);
+void logForgetConsole(ConsoleLog *console);
+
+
+namespace logDetail
+{
+	inline void setArg(LogRecord &record, logArgType type)
+	{
+		record.types[record.nArgs] = static_cast<uint8_t> (type);
+		record.nArgs++;
+	}
+
+	inline void captureArg(LogRecord &record, int value) { record.args[record.nArgs].i = value; setArg(record, logArgSigned); }
+	inline void captureArg(LogRecord &record, long value) { record.args[record.nArgs].i = value; setArg(record, logArgSigned); }
+	inline void captureArg(LogRecord &record, long long value) { record.args[record.nArgs].i = value; setArg(record, logArgSigned); }
+	inline void captureArg(LogRecord &record, unsigned int value) { record.args[record.nArgs].u = value; setArg(record, logArgUnsigned); }
+	inline void captureArg(LogRecord &record, unsigned long value) { record.args[record.nArgs].u = value; setArg(record, logArgUnsigned); }
+	inline void captureArg(LogRecord &record, unsigned long long value) { record.args[record.nArgs].u = value; setArg(record, logArgUnsigned); }
+	inline void captureArg(LogRecord &record, double value) { record.args[record.nArgs].d = value; setArg(record, logArgDouble); }
+	inline void captureArg(LogRecord &record, const void *value)
+	{
+		record.args[record.nArgs].u = reinterpret_cast<uintptr_t> (value);
+		setArg(record, logArgPointer);
+	}
+
+	// strings are copied, they may be gone by the time the record is formatted.
+	inline void captureText(LogRecord &record, const char *value, size_t length)
+	{
+		// textUsed stays below LOG_TEXT_LEN, the last byte is always a terminator.
+		size_t used(record.textUsed);
+		size_t room(LOG_TEXT_LEN - 1 - used);
+		length = (length < room) ? length : room;
+		memcpy(record.text + used, value, length);
+		record.text[used + length] = '\0';
+		record.args[record.nArgs].u = used;
+		size_t next(used + length + 1);
+		record.textUsed = static_cast<uint8_t> ((next < LOG_TEXT_LEN - 1) ? next : LOG_TEXT_LEN - 1);
+		setArg(record, logArgText);
+	}
+
+	inline void captureArg(LogRecord &record, const char *value)
+	{
+		value = (value != NULL) ? value : "(null)";
+		captureText(record, value, strlen(value));
+	}
+
+	inline void captureArg(LogRecord &record, const std::string &value)
+	{
+		captureText(record, value.data(), value.size());
+	}
+
+	inline void captureArgs(LogRecord &)
+	{
+	}
+
+	template <typename T, typename... Rest>
+	inline void captureArgs(LogRecord &record, const T &value, const Rest&... rest)
+	{
+		captureArg(record, value);
+		captureArgs(record, rest...);
+	}
+}
+
+
+/**
+ * \brief logs a printf style message, format must be a string literal.
+ * console (if not NULL) also gets the message, it must outlive the record (ConsoleLog flushes the log when destroyed).
+ */
+template <typename... Args>
+inline void logToConsole(ConsoleLog *console, logSeverity severity, const char *format, const Args&... args)
+{
+	static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+	if (severity < logMinSeverity.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+	LogRecord record;
+	record.timeNs = static_cast<uint64_t> (std::chrono::duration_cast<std::chrono::nanoseconds> (
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+	record.format = format;
+	record.console = console;
+	record.severity = severity;
+	record.nArgs = 0;
+	record.textUsed = 0;
+	logDetail::captureArgs(record, args...);
+	logPush(record);
+}
+
+template <typename... Args>
+inline void logMessage(logSeverity severity, const char *format, const Args&... args)
+{
+	logToConsole(NULL, severity, format, args...);
+}
+
+#endif
@@ -0,0 +1,125 @@
+#pragma once
+#ifndef CATHETER_CONSOLE_LOG_H
+#define CATHETER_CONSOLE_LOG_H
+
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// This file defines the console log model.
+// The log is a fixed size ring of fixed size lines, so memory use is constant
+// and appending a message costs the same no matter how long the session has run.
+// It has no gui dependencies, the status text box only draws the visible lines.
+
+// longest message kept (longer messages are truncated).
+#define LOG_LINE_LEN 128
+
+// default number of lines retained.
+#define LOG_DEFAULT_CAPACITY 2048
+
+/**
+ \brief The severity of a console message.
+ */
+enum logSeverity {
+	logDebug = 0, logInfo = 1, logWarning = 2, logError = 3
+};
+
+/**
+ * \brief returns a short name for a severity ("debug", "info", ...).
+ */
+const char* logSeverity2String(logSeverity severity);
+
+/**
+ \brief A single line of the console log.
+ */
+struct ConsoleLine
+{
+	uint64_t seq;            // the line number since the log was created
+	double timeStamp;        // seconds since the log was created
+	logSeverity severity;
+	uint16_t length;
+	char text[LOG_LINE_LEN];
+
+	ConsoleLine() : seq(0), timeStamp(0.0), severity(logInfo), length(0)
+	{
+		text[0] = 0;
+	};
+};
+
+/**
+ \brief A thread safe, fixed capacity console log.
+
+ Lines are addressed by their sequence number. Lines older than the capacity
+ are overwritten. The rate limit (lines per second) protects the gui from a
+ flood of messages from the serial thread, errors are never rate limited.
+ */
+class ConsoleLog
+{
+public:
+	explicit ConsoleLog(size_t capacity = LOG_DEFAULT_CAPACITY);
+	// waits for the asynchronous log records addressed to this log (see async_log.h).
+	~ConsoleLog();
+
+	// adds a message (splitting it at newlines).
+	void appendText(const std::string &newText, logSeverity severity = logInfo);
+
+	// sequence number of the oldest retained line and one past the newest.
+	uint64_t firstSeq() const;
+	uint64_t endSeq() const;
+
+	// number of retained lines.
+	size_t size() const;
+	size_t capacity() const;
+
+	// copies out a line, returns false if it was overwritten (or not written yet).
+	bool getLine(uint64_t seq, ConsoleLine &line) const;
+
+	// returns true (once) if lines were added since the last call
+	// (also writing the summary of a rate limit window that has ended).
+	bool takeUpdate();
+
+	// sets the maximum number of lines per second (0 disables the limit).
+	void setRateLimit(unsigned int linesPerSecond);
+
+	// lines dropped by the rate limit since the log was created.
+	uint64_t suppressedLines() const;
+
+	// writes (and notifies) the summary of a rate limit window that has ended, returns
+	// false while a summary is still to come. The log thread calls this after a burst.
+	bool flushSuppressed();
+
+	// called (with the mutex held) whenever a line is added.
+	void setNotify(const boost::function<void()> &notifyFcn);
+
+	void clear();
+
+private:
+	// these assume the mutex is held.
+	void addLine(const char *text, size_t length, logSeverity severity, double timeStamp);
+	bool rateLimited(logSeverity severity, double timeStamp);
+	double elapsed() const;
+	bool writeSuppressed(double timeStamp);
+
+	mutable boost::mutex logMutex;
+	std::vector<ConsoleLine> lines;
+	uint64_t nextSeq;
+	uint64_t oldestSeq;
+	bool updated;
+
+	// rate limiting
+	unsigned int rateLimit;
+	double windowStart;
+	unsigned int windowCount;
+	unsigned int windowSuppressed;
+	uint64_t totalSuppressed;
+
+	boost::posix_time::ptime startTime;
+	boost::function<void()> notify;
+};
+
+#endif
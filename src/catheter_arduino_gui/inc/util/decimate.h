@@ -0,0 +1,53 @@
+#pragma once
+#ifndef CATHETER_DECIMATE_H
+#define CATHETER_DECIMATE_H
+
+#include <cstdlib>
+#include <vector>
+
+// This file defines the min/max decimation used by the strip charts.
+// Each pixel column shows the range of the samples that fall in it,
+// so spikes survive no matter how many samples share a column.
+
+
+/**
+ * \brief reduces count samples to buckets (min, max) pairs.
+ * Bucket i covers samples [i * count / buckets, (i + 1) * count / buckets).
+ * If there are fewer samples than buckets, only count buckets are written.
+ * Returns the number of buckets written.
+ */
+size_t decimateMinMax(const float *values, size_t count, size_t buckets, float *minOut, float *maxOut);
+
+
+/**
+ \brief A fixed size history of one signal.
+
+ Every sample is written twice (capacity apart), so the newest n samples are
+ always one contiguous array and can be decimated without copying.
+ */
+class SampleHistory
+{
+public:
+	explicit SampleHistory(size_t capacity);
+
+	void push(float value);
+	void clear();
+
+	// the number of samples held (up to the capacity).
+	size_t size() const;
+	size_t capacity() const;
+
+	// the value most recently pushed (0 if empty).
+	float latest() const;
+
+	// pointer to the newest count samples (oldest first), count must be <= size().
+	const float* newest(size_t count) const;
+
+private:
+	std::vector<float> values;
+	size_t cap;
+	size_t next;
+	size_t filled;
+};
+
+#endif
@@ -0,0 +1,220 @@
+#pragma once
+#ifndef CATHETER_LINK_LOG_H
+#define CATHETER_LINK_LOG_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <boost/thread/mutex.hpp>
+
+// This file defines the link log: every byte written to and read from the
+// serial port, with steady clock timestamps, appended to a memory mapped file.
+// A record is a memcpy into the mapping under an uncontended lock, nothing is
+// formatted or written with a system call on the calling thread (the kernel
+// writes the pages back). The log survives a crash of the process: the header
+// holds the end of the last complete record.
+//
+// The file is a header page followed by fixed size blocks. Every block starts
+// with an index record (time of the first record, records and stream bytes
+// before it), so a reader can find a time by bisecting the blocks without
+// reading the records in between. Records never cross a block, the zeroed rest
+// of a block is skipped.
+//
+// The log is only kept on POSIX systems (open() fails elsewhere).
+
+#define LINK_LOG_MAGIC 0x4b4e4c43
+#define LINK_LOG_VERSION 1
+
+#define LINK_LOG_HEADER_BYTES 4096
+#define LINK_LOG_BLOCK_BYTES 65536
+
+// bytes mapped at a time (whole blocks), the file grows by this much.
+#define LINK_LOG_MAP_BYTES (16 * 1024 * 1024)
+
+// longest record payload, longer writes and reads are split.
+#define LINK_LOG_MAX_PAYLOAD 1024
+
+#define LINK_LOG_NOTE_LEN 256
+
+// most names openUnique() tries (name, name_2 ... name_N).
+#define LINK_LOG_MAX_SUFFIX 100
+
+enum LinkRecordType
+{
+	linkRecordEnd = 0,   // unused space (the rest of the block)
+	linkRecordIndex,     // payload is a LinkIndexEntry
+	linkRecordOut,       // bytes written to the board
+	linkRecordIn,        // bytes read from the board
+	linkRecordMark       // text: port opened or closed, short writes, replay markers
+};
+
+/**
+ \brief The start of every record, the payload follows (padded to 8 bytes).
+ */
+struct LinkRecordHeader
+{
+	uint64_t timeNs;   // steady clock
+	uint32_t length;   // payload bytes
+	uint32_t type;
+};
+
+/**
+ \brief The payload of the index record at the start of a block.
+ */
+struct LinkIndexEntry
+{
+	uint64_t records;  // data records before this block
+	uint64_t bytesOut; // stream offsets at the start of the block
+	uint64_t bytesIn;
+};
+
+/**
+ \brief The first page of the file.
+ */
+struct LinkLogHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t headerBytes;
+	uint32_t blockBytes;
+	uint64_t startNs;               // steady clock at open
+	double startTime;               // unix seconds at open
+	std::atomic<uint64_t> used;     // file offset past the last complete record
+	std::atomic<uint64_t> records;  // data records (not counting the index)
+	std::atomic<uint64_t> dropped;  // records lost because the file could not grow
+	char note[LINK_LOG_NOTE_LEN];
+};
+
+static_assert(sizeof(LinkLogHeader) <= LINK_LOG_HEADER_BYTES, "the link log header must fit its page");
+static_assert(LINK_LOG_MAP_BYTES % LINK_LOG_BLOCK_BYTES == 0, "the map size must be whole blocks");
+
+/**
+ * \brief steady clock nanoseconds (the link log time base, the same as the trace).
+ */
+inline uint64_t linkLogNowNs()
+{
+	return static_cast<uint64_t> (std::chrono::duration_cast<std::chrono::nanoseconds> (
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/**
+ * \brief prefix_YYYYMMDD_HHMMSS.link in the working directory (open it with openUnique()).
+ */
+std::string linkLogDefaultName(const std::string &prefix);
+
+
+/**
+ \brief Appends records to a link log. record() may be called from any thread.
+ */
+class LinkRecorder
+{
+public:
+	LinkRecorder();
+	~LinkRecorder();
+
+	// creates (or truncates) the file, the note is kept in the header.
+	bool open(const std::string &fileName, const std::string &note = "");
+
+	// creates a new file, never overwriting one: when the name is taken _2, _3 ... is added
+	// before the extension (fileName() gives the name used). For the default names.
+	bool openUnique(const std::string &fileName, const std::string &note = "");
+
+	// trims the file to what was recorded.
+	void close();
+
+	bool isOpen() const;
+
+	void record(LinkRecordType type, const void *bytes, size_t length);
+	void record(LinkRecordType type, uint64_t timeNs, const void *bytes, size_t length);
+
+	// marks with text (e.g. "open /dev/ttyACM0").
+	void mark(const std::string &text);
+
+	uint64_t records() const;
+	uint64_t bytesUsed() const;
+	uint64_t dropped() const;
+	std::string fileName() const;
+
+private:
+	LinkRecorder(const LinkRecorder&);
+	LinkRecorder& operator=(const LinkRecorder&);
+
+	// appends the bytes as records of at most LINK_LOG_MAX_PAYLOAD (with the lock held).
+	void append(LinkRecordType type, uint64_t timeNs, const uint8_t *bytes, size_t length);
+	void appendRecord(LinkRecordType type, uint64_t timeNs, const uint8_t *bytes, size_t length);
+
+	// maps the window holding the file offset, growing the file.
+	bool mapWindow(uint64_t offset);
+
+	// open() and openUnique(), exclusive fails (errno EEXIST) if the file exists.
+	bool create(const std::string &fileName, const std::string &note, bool exclusive);
+
+	void unmapWindow();
+
+	mutable boost::mutex recordMutex;
+	std::string name;
+	int fd;
+	LinkLogHeader *header;
+	uint8_t *window;
+	uint64_t windowStart;  // file offset of the mapped window
+	uint64_t offset;       // file offset of the next record
+	uint64_t recordCount;
+	uint64_t bytesOut;
+	uint64_t bytesIn;
+	bool failed;           // the file could not grow, records are dropped
+};
+
+
+/**
+ \brief One record as read back.
+ */
+struct LinkRecordView
+{
+	uint64_t offset;  // in the file
+	uint64_t timeNs;
+	LinkRecordType type;
+	const uint8_t *bytes;
+	uint32_t length;
+};
+
+/**
+ \brief Reads a link log (also one that is still being written or was cut short by a crash).
+ */
+class LinkLogReader
+{
+public:
+	LinkLogReader();
+	~LinkLogReader();
+
+	bool open(const std::string &fileName);
+	void close();
+
+	const LinkLogHeader& header() const;
+
+	// the end of the committed records (moves while the log is written).
+	uint64_t endOffset() const;
+
+	// the first data record at or after offset, false at the end. Index records are skipped.
+	bool next(uint64_t &offset, LinkRecordView &view) const;
+
+	// the offset of the first record.
+	uint64_t begin() const;
+
+	// the offset of a block from which reading reaches the first record at or after timeNs.
+	uint64_t seek(uint64_t timeNs) const;
+
+	// the index record of a block, false if the block is not written.
+	bool blockIndex(uint64_t block, uint64_t &timeNs, LinkIndexEntry &entry) const;
+
+	uint64_t blocks() const;
+
+private:
+	LinkLogReader(const LinkLogReader&);
+	LinkLogReader& operator=(const LinkLogReader&);
+
+	const uint8_t *mapped;
+	uint64_t mappedBytes;
+};
+
+#endif
@@ -0,0 +1,238 @@
+#pragma once
+#ifndef CATHETER_METRICS_H
+#define CATHETER_METRICS_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+
+// This file defines the runtime metrics of the control process: counters,
+// gauges and log2 histograms kept in one page that can be published as
+// POSIX shared memory. Every metric has its own cache line, so updating one
+// is a single relaxed atomic add that does not bounce a line another thread
+// writes. An outside reader (catheter_stat) maps the page read only and never
+// takes a lock, so it can sample at any rate without touching the writer.
+
+#define METRICS_CACHE_LINE 64
+#define METRICS_NAME_LEN 48
+#define METRICS_MAX 48
+#define METRICS_MAX_HISTOGRAMS 8
+
+// bin b counts [2^b, 2^(b+1)) units, the last bin is open ended (as the playback round trips).
+#define METRICS_HISTOGRAM_BINS 24
+
+#define METRICS_MAGIC 0x4d535443
+#define METRICS_VERSION 1
+
+// the page the gui and catheter_play publish (by default).
+#define METRICS_DEFAULT_NAME "/catheter_metrics"
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the metrics page needs lock free 64 bit atomics to be shared");
+
+enum MetricType
+{
+	metricUnused = 0, metricCounter, metricGauge, metricHistogram
+};
+
+/**
+ \brief One metric, one cache line. The type is stored last so a reader
+ never sees a half registered slot.
+ */
+struct alignas(METRICS_CACHE_LINE) MetricSlot
+{
+	char name[METRICS_NAME_LEN];
+	std::atomic<uint32_t> type;
+	uint32_t histogram;           // index of the bins of a histogram
+	std::atomic<uint64_t> value;  // counter total, gauge value (two's complement) or histogram samples
+};
+
+struct alignas(METRICS_CACHE_LINE) MetricBins
+{
+	std::atomic<uint64_t> sum;
+	std::atomic<uint64_t> bins[METRICS_HISTOGRAM_BINS];
+};
+
+/**
+ \brief The shared layout. The header is written once before any slot.
+ */
+struct MetricsPage
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t pageSize;
+	uint32_t pid;
+	double startTime;  // unix seconds
+	std::atomic<uint32_t> count;
+	MetricSlot slots[METRICS_MAX];
+	MetricBins histograms[METRICS_MAX_HISTOGRAMS];
+};
+
+
+/**
+ \brief A counter handle. A default constructed handle does nothing, so code
+ can be instrumented whether or not there is a registry.
+ */
+class MetricCounter
+{
+public:
+	MetricCounter() : slot(NULL) {};
+	explicit MetricCounter(MetricSlot *slot_) : slot(slot_) {};
+
+	void add(uint64_t count = 1)
+	{
+		if (slot != NULL)
+		{
+			slot->value.fetch_add(count, std::memory_order_relaxed);
+		}
+	}
+
+	uint64_t value() const
+	{
+		return (slot != NULL) ? slot->value.load(std::memory_order_relaxed) : 0;
+	}
+
+private:
+	MetricSlot *slot;
+};
+
+class MetricGauge
+{
+public:
+	MetricGauge() : slot(NULL) {};
+	explicit MetricGauge(MetricSlot *slot_) : slot(slot_) {};
+
+	void set(int64_t level)
+	{
+		if (slot != NULL)
+		{
+			slot->value.store(static_cast<uint64_t> (level), std::memory_order_relaxed);
+		}
+	}
+
+	int64_t value() const
+	{
+		return (slot != NULL) ? static_cast<int64_t> (slot->value.load(std::memory_order_relaxed)) : 0;
+	}
+
+private:
+	MetricSlot *slot;
+};
+
+class MetricHistogram
+{
+public:
+	MetricHistogram() : slot(NULL), bins(NULL) {};
+	MetricHistogram(MetricSlot *slot_, MetricBins *bins_) : slot(slot_), bins(bins_) {};
+
+	// negative samples go to the first bin.
+	void record(double sample);
+
+	uint64_t count() const
+	{
+		return (slot != NULL) ? slot->value.load(std::memory_order_relaxed) : 0;
+	}
+
+private:
+	MetricSlot *slot;
+	MetricBins *bins;
+};
+
+/**
+ * \brief the histogram bin of a sample.
+ */
+int metricBin(double sample);
+
+
+/**
+ \brief The metrics of one process. Registering takes a lock, updating the
+ handles does not. Names are Prometheus names (the counters end in _total).
+ A name registered twice gives the same metric (if the type agrees).
+ */
+class MetricsRegistry
+{
+public:
+	// an empty name (or a failure to create the shared page) keeps the page in this process.
+	// A name held by another live process is left alone, a page left by a crash is replaced.
+	explicit MetricsRegistry(const std::string &shmName = std::string());
+	~MetricsRegistry();
+
+	// true when the page is in shared memory.
+	bool shared() const;
+	std::string name() const;
+
+	// invalid (do nothing) handles when the registry is full or the type differs.
+	MetricCounter counter(const std::string &metricName);
+	MetricGauge gauge(const std::string &metricName);
+	MetricHistogram histogram(const std::string &metricName);
+
+	const MetricsPage& page() const;
+
+	// writes a Prometheus text file (written aside and renamed, so a scraper never reads half a file).
+	bool writePrometheus(const std::string &fileName) const;
+
+private:
+	// not copyable.
+	MetricsRegistry(const MetricsRegistry&);
+	MetricsRegistry& operator=(const MetricsRegistry&);
+
+	MetricSlot* slotFor(const std::string &metricName, MetricType type);
+
+	boost::mutex registryMutex;
+	MetricsPage *metricsPage;
+	void *localBlock;
+	std::string shmName;
+	uint32_t histogramCount;
+};
+
+
+/**
+ \brief A copy of one metric.
+ */
+struct MetricValue
+{
+	std::string name;
+	MetricType type;
+	uint64_t value;
+	uint64_t sum;
+	std::vector<uint64_t> bins;
+
+	MetricValue() : type(metricUnused), value(0), sum(0) {};
+};
+
+/**
+ * \brief copies every registered metric of a page (lock free, each value is read once).
+ */
+void metricsSnapshot(const MetricsPage &page, std::vector<MetricValue> &values);
+
+/**
+ * \brief the Prometheus text exposition of a snapshot.
+ */
+std::string metricsPrometheusText(const std::vector<MetricValue> &values);
+
+
+/**
+ \brief A read only view of a page published by another process.
+ */
+class MetricsView
+{
+public:
+	MetricsView();
+	~MetricsView();
+
+	// false if there is no such page or it is not a metrics page of this version.
+	bool open(const std::string &shmName);
+	void close();
+
+	// NULL when not open.
+	const MetricsPage* page() const;
+
+private:
+	MetricsView(const MetricsView&);
+	MetricsView& operator=(const MetricsView&);
+
+	const MetricsPage *mappedPage;
+	size_t mappedSize;
+};
+
+#endif
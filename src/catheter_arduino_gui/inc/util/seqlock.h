@@ -0,0 +1,131 @@
+#pragma once
+#ifndef CATHETER_SEQLOCK_H
+#define CATHETER_SEQLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// This file defines a sequence lock: a single value that any number of
+// threads write and read without blocking the readers. A writer makes the
+// sequence odd while it copies, a reader retries if the sequence was odd or
+// changed during its copy. Writers are serialized among themselves (they
+// spin on the sequence), readers never slow the writers down.
+//
+// The value is kept in atomic words, so the racing copies are well defined.
+
+
+/**
+ \brief The latest value of a trivially copyable T, written and read from any thread.
+ */
+template <typename T>
+class Seqlock
+{
+	static_assert(std::is_trivially_copyable<T>::value, "a seqlock value is copied as bytes");
+
+public:
+	Seqlock() : sequence(0)
+	{
+		for (size_t index(0); index < WORDS; index++)
+		{
+			words[index].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	explicit Seqlock(const T &value) : sequence(0)
+	{
+		storeValue(value);
+	}
+
+	// replaces the value, returns its version (the number of writes so far).
+	uint64_t write(const T &value)
+	{
+		uint64_t current(lockWriter());
+		storeValue(value);
+		sequence.store(current + 2, std::memory_order_release);
+		return (current + 2) / 2;
+	}
+
+	// changes part of the value: modifier gets the current value and edits it in place.
+	template <typename Modifier>
+	uint64_t modify(Modifier modifier)
+	{
+		uint64_t current(lockWriter());
+		T value;
+		loadValue(value);
+		modifier(value);
+		storeValue(value);
+		sequence.store(current + 2, std::memory_order_release);
+		return (current + 2) / 2;
+	}
+
+	// a consistent copy of the value, returns its version.
+	uint64_t read(T &value) const
+	{
+		while (true)
+		{
+			uint64_t before(sequence.load(std::memory_order_acquire));
+			if ((before & 1) == 0)
+			{
+				loadValue(value);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (sequence.load(std::memory_order_relaxed) == before)
+				{
+					return before / 2;
+				}
+			}
+		}
+	}
+
+	// the version of the latest complete write.
+	uint64_t version() const
+	{
+		return sequence.load(std::memory_order_acquire) / 2;
+	}
+
+private:
+	Seqlock(const Seqlock&);
+	Seqlock& operator=(const Seqlock&);
+
+	static const size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	// makes the sequence odd, returns the even value it had.
+	uint64_t lockWriter()
+	{
+		uint64_t current(sequence.load(std::memory_order_relaxed));
+		while ((current & 1) != 0 || !sequence.compare_exchange_weak(current, current + 1, std::memory_order_acquire))
+		{
+			current = sequence.load(std::memory_order_relaxed);
+		}
+		// the value stores below stay after the odd sequence.
+		std::atomic_thread_fence(std::memory_order_release);
+		return current;
+	}
+
+	void storeValue(const T &value)
+	{
+		uint64_t buffer[WORDS];
+		buffer[WORDS - 1] = 0;
+		memcpy(buffer, &value, sizeof(T));
+		for (size_t index(0); index < WORDS; index++)
+		{
+			words[index].store(buffer[index], std::memory_order_relaxed);
+		}
+	}
+
+	void loadValue(T &value) const
+	{
+		uint64_t buffer[WORDS];
+		for (size_t index(0); index < WORDS; index++)
+		{
+			buffer[index] = words[index].load(std::memory_order_relaxed);
+		}
+		memcpy(&value, buffer, sizeof(T));
+	}
+
+	std::atomic<uint64_t> sequence;
+	std::atomic<uint64_t> words[WORDS];
+};
+
+#endif
@@ -0,0 +1,110 @@
+#pragma once
+#ifndef CATHETER_SPSC_RING_H
+#define CATHETER_SPSC_RING_H
+
+#include <atomic>
+#include <cstdlib>
+#include <vector>
+
+// This file defines a lock free single producer, single consumer ring buffer.
+// One thread may push and one (other) thread may pop. Neither side blocks,
+// a push to a full ring fails and is counted as dropped.
+
+// bytes between the producer and consumer indices (avoids false sharing).
+#define SPSC_CACHE_LINE 64
+
+
+/**
+ \brief A bounded lock free queue for one producer thread and one consumer thread.
+ The capacity is rounded up to a power of 2.
+ */
+template <typename T>
+class SpscRing
+{
+public:
+	explicit SpscRing(size_t capacity_) : buffer(), mask(0), head(0), tail(0), dropped(0)
+	{
+		size_t size(1);
+		while (size < capacity_)
+		{
+			size <<= 1;
+		}
+		buffer.resize(size);
+		mask = size - 1;
+	}
+
+	// producer side, returns false (and counts the item as dropped) if the ring is full.
+	bool push(const T &item)
+	{
+		size_t currentHead(head.load(std::memory_order_relaxed));
+		if (currentHead - tail.load(std::memory_order_acquire) > mask)
+		{
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		buffer[currentHead & mask] = item;
+		head.store(currentHead + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side, returns false if the ring is empty.
+	bool pop(T &item)
+	{
+		size_t currentTail(tail.load(std::memory_order_relaxed));
+		if (currentTail == head.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		item = buffer[currentTail & mask];
+		tail.store(currentTail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side, pops up to maxCount items, returns the number popped.
+	size_t popBulk(T *items, size_t maxCount)
+	{
+		size_t currentTail(tail.load(std::memory_order_relaxed));
+		size_t available(head.load(std::memory_order_acquire) - currentTail);
+		size_t count((available < maxCount) ? available : maxCount);
+		for (size_t index(0); index < count; index++)
+		{
+			items[index] = buffer[(currentTail + index) & mask];
+		}
+		tail.store(currentTail + count, std::memory_order_release);
+		return count;
+	}
+
+	// approximate when called while the other side is active.
+	size_t size() const
+	{
+		return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+	}
+
+	size_t capacity() const
+	{
+		return mask + 1;
+	}
+
+	// items the producer could not push.
+	size_t droppedCount() const
+	{
+		return dropped.load(std::memory_order_relaxed);
+	}
+
+private:
+	// not copyable.
+	SpscRing(const SpscRing&);
+	SpscRing& operator=(const SpscRing&);
+
+	std::vector<T> buffer;
+	size_t mask;
+
+	char padHead[SPSC_CACHE_LINE];
+	std::atomic<size_t> head;  // written by the producer
+	char padTail[SPSC_CACHE_LINE];
+	std::atomic<size_t> tail;  // written by the consumer
+	char padEnd[SPSC_CACHE_LINE];
+	std::atomic<size_t> dropped;
+};
+
+#endif
@@ -0,0 +1,121 @@
+#pragma once
+#ifndef CATHETER_TRACE_H
+#define CATHETER_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// This file defines the trace points of the send and receive pipeline. The
+// events go into a buffer per thread (no lock, no allocation after the first
+// event of a thread) and are written as Chrome trace event JSON on demand,
+// which chrome://tracing and ui.perfetto.dev open directly.
+//
+// The CATHETER_TRACE_* macros compile to nothing unless CATHETER_TRACE is
+// defined (cmake -DCATHETER_TRACE=ON). When compiled in they cost one relaxed
+// load while tracing is off.
+
+// events kept per thread, later events are dropped (and counted).
+#define TRACE_BUFFER_EVENTS 65536
+
+// most threads that can record.
+#define TRACE_MAX_THREADS 32
+
+#define TRACE_NAME_LEN 32
+
+/**
+ \brief One event: a complete span ('X'), an instant ('i') or a counter value ('C').
+ The name must be a string literal (only the pointer is kept).
+ */
+struct TraceEvent
+{
+	const char *name;
+	uint64_t startNs;
+	uint64_t durationNs;
+	int64_t value;
+	char phase;
+};
+
+/**
+ * \brief steady clock nanoseconds (the trace time base).
+ */
+inline uint64_t traceNowNs()
+{
+	return static_cast<uint64_t> (std::chrono::duration_cast<std::chrono::nanoseconds> (
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+extern std::atomic<bool> traceActive;
+
+inline bool traceEnabled()
+{
+	return traceActive.load(std::memory_order_relaxed);
+}
+
+// starts or stops recording (recorded events are kept).
+void traceEnable(bool enable);
+
+// true when the trace points are compiled in.
+bool traceCompiledIn();
+
+// records one event in the buffer of the calling thread.
+void traceRecord(const char *name, char phase, uint64_t startNs, uint64_t durationNs, int64_t value);
+
+// names the calling thread in the trace.
+void traceThreadName(const char *name);
+
+// drops every recorded event. Only call it while no thread records.
+void traceClear();
+
+// events dropped because a thread buffer was full.
+uint64_t traceDropped();
+
+// writes everything recorded so far (threads may keep recording), returns false if the file could not be written.
+bool traceWriteJson(const std::string &fileName);
+
+
+/**
+ \brief Records a span from construction to destruction (if tracing was on at the start).
+ */
+class TraceScope
+{
+public:
+	explicit TraceScope(const char *name_) : name(name_), startNs(traceEnabled() ? traceNowNs() : 0)
+	{};
+
+	~TraceScope()
+	{
+		if (startNs != 0)
+		{
+			traceRecord(name, 'X', startNs, traceNowNs() - startNs, 0);
+		}
+	}
+
+private:
+	TraceScope(const TraceScope&);
+	TraceScope& operator=(const TraceScope&);
+
+	const char *name;
+	uint64_t startNs;
+};
+
+
+#define CATHETER_TRACE_CONCAT_(a, b) a##b
+#define CATHETER_TRACE_CONCAT(a, b) CATHETER_TRACE_CONCAT_(a, b)
+
+#ifdef CATHETER_TRACE
+#define CATHETER_TRACE_SCOPE(name) TraceScope CATHETER_TRACE_CONCAT(traceScope, __LINE__)(name)
+#define CATHETER_TRACE_INSTANT(name, value) \
+	do { if (traceEnabled()) { traceRecord(name, 'i', traceNowNs(), 0, (value)); } } while (0)
+#define CATHETER_TRACE_COUNTER(name, value) \
+	do { if (traceEnabled()) { traceRecord(name, 'C', traceNowNs(), 0, (value)); } } while (0)
+#define CATHETER_TRACE_THREAD_NAME(name) traceThreadName(name)
+#else
+#define CATHETER_TRACE_SCOPE(name) do { } while (0)
+#define CATHETER_TRACE_INSTANT(name, value) do { } while (0)
+#define CATHETER_TRACE_COUNTER(name, value) do { } while (0)
+#define CATHETER_TRACE_THREAD_NAME(name) do { } while (0)
+#endif
+
+#endif
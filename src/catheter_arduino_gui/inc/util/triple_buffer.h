@@ -0,0 +1,90 @@
+#pragma once
+#ifndef CATHETER_TRIPLE_BUFFER_H
+#define CATHETER_TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// This file defines a wait free triple buffer: one writer thread publishes
+// whole values, one reader thread picks up the latest complete one. The
+// writer fills the back buffer and swaps it with the middle one, the reader
+// swaps the middle one with its front buffer when it is fresh. Neither side
+// ever waits or retries, intermediate values the reader did not pick up are
+// skipped.
+
+// bytes between the writer, shared and reader indices (avoids false sharing).
+#define TRIPLE_BUFFER_CACHE_LINE 64
+
+
+/**
+ \brief The latest value of a T, passed from one writer thread to one reader thread.
+ */
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() : buffers(), backIndex(0), middle(1), frontIndex(2)
+	{
+	}
+
+	// writer side: the buffer to fill before publish(), it keeps whatever was written three publishes ago.
+	T& writeBuffer()
+	{
+		return buffers[backIndex];
+	}
+
+	// writer side: makes the write buffer the latest value.
+	void publish()
+	{
+		backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	void write(const T &value)
+	{
+		buffers[backIndex] = value;
+		publish();
+	}
+
+	// reader side: moves to the latest value, returns false if there was nothing newer.
+	bool update()
+	{
+		if ((middle.load(std::memory_order_relaxed) & FRESH) == 0)
+		{
+			return false;
+		}
+		frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	// reader side: the value picked up by the last update() (a value initialized T before the first publish).
+	const T& readBuffer() const
+	{
+		return buffers[frontIndex];
+	}
+
+	// reader side: copies the latest value, returns true if it is newer than the last one read.
+	bool read(T &value)
+	{
+		bool fresh(update());
+		value = buffers[frontIndex];
+		return fresh;
+	}
+
+private:
+	// not copyable.
+	TripleBuffer(const TripleBuffer&);
+	TripleBuffer& operator=(const TripleBuffer&);
+
+	static const unsigned int INDEX_MASK = 3;
+	static const unsigned int FRESH = 4;
+
+	T buffers[3];
+
+	char padBack[TRIPLE_BUFFER_CACHE_LINE];
+	unsigned int backIndex;           // owned by the writer
+	char padMiddle[TRIPLE_BUFFER_CACHE_LINE];
+	std::atomic<unsigned int> middle; // index of the shared buffer, FRESH if the reader has not taken it
+	char padFront[TRIPLE_BUFFER_CACHE_LINE];
+	unsigned int frontIndex;          // owned by the reader
+};
+
+#endif
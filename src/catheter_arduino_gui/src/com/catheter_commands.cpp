@@ -1,6 +1,7 @@
 
 #include "com/catheter_commands.h"
-#include "hardware/digital_analog_conversions.h"
+
+#include <algorithm>
 
 
 #ifdef _MSC_VER
@@ -56,32 +57,27 @@ CatheterChannelCmd emptyCommand() {
 
 std::vector<uint8_t> encodeCommandSet(const CatheterChannelCmdSet& cmds, int pseqnum)
 {
-	std::vector<uint8_t> encodedSet;
-	std::vector<uint8_t> tempEncoding;
-
-	encodedSet.clear();
-	
 	int n(cmds.commandList.size());
 
-	tempEncoding = encodePreamble(pseqnum, n);
-
-
-	encodedSet.insert(encodedSet.end(), tempEncoding.begin(), tempEncoding.end());
+	// the packet is built in place (no intermediate vectors).
+	std::vector<uint8_t> encodedSet(PCK_LEN(n));
+	uint8_t *bytes(encodedSet.data());
 
-	tempEncoding.clear();
+	// encode the preamble.
+	bytes[0] = (PCK_OK << 7) | ((pseqnum & 7) << 4) | (n & 15);
+	bytes += PRE_LEN;
 
 	for (int ind(0); ind < n; ind++)
 	{
-		tempEncoding = encodeSingleCommand(cmds.commandList[ind]);
-		encodedSet.insert(encodedSet.end(), tempEncoding.begin(), tempEncoding.end());
-		tempEncoding.clear();
+		encodeSingleCommand(cmds.commandList[ind], bytes);
+		bytes += CMD_LEN;
 	}
 	
-	tempEncoding = encodePostamble(pseqnum);
-	encodedSet.insert(encodedSet.end(), tempEncoding.begin(), tempEncoding.end());
-	uint8_t chksum = fletcher8(encodedSet.size(), encodedSet.data());
-	encodedSet.insert(encodedSet.end(), 1, chksum);
-	// encode the preamble.
+	// encode the postamble.
+	bytes[0] = (pseqnum << 5) | (PCK_OK & 1);
+	bytes += POST_LEN;
+
+	bytes[0] = fletcher8(PCK_LEN(n) - PCK_CHK_LEN, encodedSet.data());
 	return encodedSet;
 }
 
@@ -101,39 +97,29 @@ std::vector<uint8_t> encodePreamble(int pseqnum, int ncmds)
 
 std::vector<uint8_t> encodeSingleCommand(const CatheterChannelCmd& cmd)
 {
-	std::vector<uint8_t> bytes;
-
+	std::vector<uint8_t> bytes(CMD_LEN);
+	encodeSingleCommand(cmd, bytes.data());
+	return bytes;
+}
 
+void encodeSingleCommand(const CatheterChannelCmd& cmd, uint8_t *bytesOut)
+{
 	uint8_t encodedByte = 0;
 	if (cmd.poll)   encodedByte |= (1 << POL_BIT);
 	if (cmd.enable)     encodedByte |= (1 << ENA_BIT);
 	encodedByte |= (1 << UPD_BIT); //always update.
 	//if (cmd.update)   encodedByte |= (1 << UPD_BIT);
-	encodedByte |= (cmd.currentMilliAmp > 0.0) ? (DIR_POS << DIR_BIT) : (DIR_NEG << DIR_BIT);
+	encodedByte |= (cmd.dir == DIR_POS) ? (DIR_POS << DIR_BIT) : (DIR_NEG << DIR_BIT);
 
 	// bit 1-4 is the channel number
 	// bit 5-8 is the encoded channel command information.
-	uint8_t firstByte(cmd.channel << 4 | (encodedByte & 15));
+	bytesOut[0] = (cmd.channel << 4) | (encodedByte & 15);
 
-	uint16_t dacSetting(milliAmp2Dac(cmd.currentMilliAmp));
+	// bits 8-15  (first 6 bits of DAC data (in the lower 6) (modified to match the arduin0
+	bytesOut[1] = (cmd.dacCounts >> 6) & 63;
 
-	for (int i(0); i < CMD_LEN; i++) {
-		if (i == 0)
-		{
-			bytes.push_back(firstByte);          // bits 1-4
-		}
-		else if (i == 1)
-		{
-			// bits 8-15  (first 6 bits of DAC data (in the lower 6) (modified to match the arduin0
-			bytes.push_back((dacSetting >> 6) & 63);   
-		}
-		else if (i == 2)
-		{
-			// bits 16-23 (last 6 bits of DAC data)
-			bytes.push_back((dacSetting & 63));   
-		}
-	}
-	return bytes;
+	// bits 16-23 (last 6 bits of DAC data)
+	bytesOut[2] = cmd.dacCounts & 63;
 }
 
 std::vector<uint8_t> encodePostamble(int pseqnum) {
@@ -149,7 +135,7 @@ std::vector<uint8_t> encodePostamble(int pseqnum) {
 }
 
 
-CatheterChannelCmd parseSingleCommand(const std::vector<uint8_t>& cmdBytes, int & index)
+CatheterChannelCmd parseSingleCommand(const uint8_t *cmdBytes, int & index)
 {
 	CatheterChannelCmd result;
 	// byte 1
@@ -166,10 +152,7 @@ CatheterChannelCmd parseSingleCommand(const std::vector<uint8_t>& cmdBytes, int
 
 	// bytes 2 and 3 (last 4 bits reserved)
 	// pull off the DAC value:
-	uint16_t cmdData(((uint16_t)(cmdBytes[index + 1]) << 6) + (cmdBytes[index + 2] % 64));
-
-	//convert the dac value to a double.
-	result.currentMilliAmp = dac2MilliAmp(cmdData, result.dir);
+	result.dacCounts = ((uint16_t)(cmdBytes[index + 1] & 63) << 6) + (cmdBytes[index + 2] & 63);
 
 	index += 3;
 	// If the Poll bit is true, pull off the adc value
@@ -181,9 +164,7 @@ CatheterChannelCmd parseSingleCommand(const std::vector<uint8_t>& cmdBytes, int
 		uint16_t adcd1b(adcd1a >> 4);
 		uint16_t adcd2(static_cast<uint16_t> (cmdBytes[index+1]));
 		uint16_t adcd2a(adcd2 >> 1);
-		uint16_t adcData(adcd1b+adcd2a);
-		//convert adc bits to a double.
-		result.currentMilliAmp_ADC = adc2MilliAmp(adcData);
+		result.adcCounts = adcd1b + adcd2a;
 		index += 2;
 	}
 	return result;
@@ -241,7 +222,7 @@ bool parseBytes2Cmds(const std::vector<unsigned char>& reply, std::vector<Cathet
 				{
 					data += (nextByte & 63);
 					CatheterChannelCmd c = emptyCommand();
-					c.currentMilliAmp = data; // this is dac resolution! convert this in the calling method!
+					c.dacCounts = data; // this is dac resolution! convert this in the calling method!
 					cmds.push_back(c);
 				}
 				break;
@@ -253,11 +234,15 @@ bool parseBytes2Cmds(const std::vector<unsigned char>& reply, std::vector<Cathet
 }
 
 
-comStatus parseBytes2Cmds(std::vector<unsigned char>& bytesRead, std::vector<CatheterChannelCmd>& cmds)
+comStatus parseBytes2Cmds(std::vector<unsigned char>& bytesRead, std::vector<CatheterChannelCmd>& cmds, bool *badChecksum)
 {
 	// reset the cmd...
 	// cmd.reset();
 	cmds.clear();
+	if (badChecksum != NULL)
+	{
+		*badChecksum = false;
+	}
 
 	// populate the top level command information
 	int sizeEst(parsePreamble(bytesRead));
@@ -273,6 +258,10 @@ comStatus parseBytes2Cmds(std::vector<unsigned char>& bytesRead, std::vector<Cat
 	uint8_t chksum(fletcher8(sizeEst - 1, bytesRead.data()));
 	if (chksum != bytesRead[sizeEst - 1])
 	{
+		if (badChecksum != NULL)
+		{
+			*badChecksum = true;
+		}
 		// clear
 		bytesRead.clear();
 		return invalid;
@@ -283,7 +272,7 @@ comStatus parseBytes2Cmds(std::vector<unsigned char>& bytesRead, std::vector<Cat
 
 	while (byteIndex + 3 < sizeEst)
 	{
-		cmds.push_back(parseSingleCommand(bytesRead, byteIndex));
+		cmds.push_back(parseSingleCommand(bytesRead.data(), byteIndex));
 	}
 
 	bytesRead.erase(bytesRead.begin(), bytesRead.begin() + sizeEst);
@@ -291,6 +280,94 @@ comStatus parseBytes2Cmds(std::vector<unsigned char>& bytesRead, std::vector<Cat
 
 }
 
+size_t decodeReplyStream(const uint8_t *bytes, size_t length, std::vector<CatheterChannelCmd>& cmds,
+	std::vector<uint32_t>& packetIndex, size_t &skippedBytes)
+{
+	size_t offset(0);
+	size_t decodedBytes(0);
+	// the start of a packet that runs past the end of the buffer. It only
+	// counts as a partial packet if no valid packet follows it.
+	size_t partialStart(length);
+	uint32_t packet(0);
+	while (offset + 2 <= length)
+	{
+		// a packet starts with the status bit and the ok bit set.
+		if ((bytes[offset] & 192) != 192)
+		{
+			offset++;
+			continue;
+		}
+		size_t packetLen(static_cast<size_t> (bytes[offset + 1] >> 4) * 3 + static_cast<size_t> (bytes[offset + 1] & 15) * 2 + 3);
+		if (offset + packetLen > length)
+		{
+			partialStart = std::min(partialStart, offset);
+			offset++;
+			continue;
+		}
+		if (fletcher8(static_cast<int> (packetLen - 1), const_cast<uint8_t*> (bytes + offset)) != bytes[offset + packetLen - 1])
+		{
+			offset++;
+			continue;
+		}
+		int byteIndex(2);
+		while (byteIndex + 3 < static_cast<int> (packetLen))
+		{
+			cmds.push_back(parseSingleCommand(bytes + offset, byteIndex));
+			packetIndex.push_back(packet);
+		}
+		packet++;
+		offset += packetLen;
+		decodedBytes += packetLen;
+		partialStart = length;
+	}
+
+	// a lone last byte may be the start of the next packet.
+	if (partialStart == length && offset < length && (bytes[offset] & 192) == 192)
+	{
+		partialStart = offset;
+	}
+	size_t consumed((partialStart < length) ? partialStart : length);
+	skippedBytes = consumed - decodedBytes;
+	return consumed;
+}
+
+size_t decodeCommandPacket(const uint8_t *bytes, size_t length, CatheterChannelCmdSet &cmdSet, int &pseqnum)
+{
+	if (length < PCK_LEN(0) || !(bytes[0] >> 7))
+	{
+		return 0;
+	}
+	int n(bytes[0] & 15);
+	size_t packetLen(PCK_LEN(n));
+	if (length < packetLen)
+	{
+		return 0;
+	}
+	int index((bytes[0] >> 4) & 7);
+	if (((bytes[packetLen - 2] >> 5) & 7) != index
+		|| fletcher8(static_cast<int> (packetLen - 1), const_cast<uint8_t*> (bytes)) != bytes[packetLen - 1])
+	{
+		return 0;
+	}
+	pseqnum = index;
+	cmdSet.commandList.resize(n);
+	cmdSet.delayTime = 0;
+	for (int ind(0); ind < n; ind++)
+	{
+		// the request has no adc bytes, so parseSingleCommand() does not apply.
+		const uint8_t *cmdBytes(bytes + PRE_LEN + ind * CMD_LEN);
+		CatheterChannelCmd &cmd(cmdSet.commandList[ind]);
+		cmd = CatheterChannelCmd();
+		cmd.channel = cmdBytes[0] >> 4;
+		cmd.poll = (cmdBytes[0] >> POL_BIT) & 1;
+		cmd.enable = (cmdBytes[0] >> ENA_BIT) & 1;
+		cmd.update = (cmdBytes[0] >> UPD_BIT) & 1;
+		cmd.dir = ((cmdBytes[0] >> DIR_BIT) & 1) ? DIR_POS : DIR_NEG;
+		cmd.dacCounts = (static_cast<uint16_t> (cmdBytes[1] & 63) << 6) + (cmdBytes[2] & 63);
+	}
+	return packetLen;
+}
+
 	/*if (!(bytesRead[0] & 128)) return false; // packet-status bit
 
 	unsigned int pindex = (bytesRead[0] & 7);
@@ -367,4 +444,37 @@ comStatus parseBytes2Cmds(std::vector<unsigned char>& bytesRead, std::vector<Cat
 		pollCmdSet.commandList[0].channel = 0;
 		return pollCmdSet;
 
-	}
\ No newline at end of file
+	}
+
+	void appendPollCmds(CatheterChannelCmdSet &cmdSet)
+	{
+		size_t nCmds(cmdSet.commandList.size());
+		if (nCmds >= PCK_MAX_CMDS)
+		{
+			return;
+		}
+		bool polled[NCHANNELS + 1] = {false};
+		std::vector<CatheterChannelCmd> pollCopies;
+		for (size_t index(0); index < nCmds; index++)
+		{
+			const CatheterChannelCmd &cmd(cmdSet.commandList[index]);
+			if (cmd.channel == GLOBAL_ADDR)
+			{
+				cmdSet.commandList.push_back(pollCmd().commandList[0]);
+				return;
+			}
+			if (cmd.channel <= NCHANNELS && !polled[cmd.channel])
+			{
+				polled[cmd.channel] = true;
+				pollCopies.push_back(cmd);
+				pollCopies.back().poll = true;
+			}
+		}
+		if (nCmds + pollCopies.size() > PCK_MAX_CMDS)
+		{
+			// one global poll reads every channel back.
+			cmdSet.commandList.push_back(pollCmd().commandList[0]);
+			return;
+		}
+		cmdSet.commandList.insert(cmdSet.commandList.end(), pollCopies.begin(), pollCopies.end());
+	}
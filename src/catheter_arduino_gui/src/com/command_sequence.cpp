@@ -0,0 +1,254 @@
+#include "com/command_sequence.h"
+#include "hardware/digital_analog_conversions.h"
+
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+
+PackedChannelCmd packCmd(const CatheterChannelCmd& cmd)
+{
+	uint32_t cmdValue(0);
+	if (cmd.poll)   cmdValue |= (1 << POL_BIT);
+	if (cmd.enable) cmdValue |= (1 << ENA_BIT);
+	if (cmd.update) cmdValue |= (1 << UPD_BIT);
+	if (cmd.dir == DIR_POS) cmdValue |= (1 << DIR_BIT);
+
+	PackedChannelCmd packed;
+	packed.bits = ((static_cast<uint32_t> (cmd.channel) & 15) << 28)
+		| (cmdValue << 24)
+		| ((static_cast<uint32_t> (cmd.dacCounts) & 4095) << 12)
+		| (static_cast<uint32_t> (cmd.adcCounts) & 4095);
+	return packed;
+}
+
+CatheterChannelCmd unpackCmd(const PackedChannelCmd& packed)
+{
+	CatheterChannelCmd cmd;
+	cmd.channel = packed.channel();
+	cmd.poll = packed.poll();
+	cmd.enable = packed.enable();
+	cmd.update = packed.update();
+	cmd.dir = packed.dir();
+	cmd.dacCounts = packed.dacCounts();
+	cmd.adcCounts = packed.adcCounts();
+	cmd.currentMilliAmp = cmdMilliAmp(cmd);
+	return cmd;
+}
+
+
+CatheterCmdSequence::CatheterCmdSequence() : cmds(), milliAmps(), sets()
+{
+}
+
+void CatheterCmdSequence::reserve(size_t nSets, size_t nCmds)
+{
+	sets.reserve(nSets);
+	cmds.reserve(nCmds);
+	milliAmps.reserve(nCmds);
+}
+
+void CatheterCmdSequence::clear()
+{
+	// both element types are trivial, so this only resets the sizes.
+	sets.clear();
+	cmds.clear();
+	milliAmps.clear();
+}
+
+void CatheterCmdSequence::addCommand(const PackedChannelCmd& cmd, double milliAmp)
+{
+	cmds.push_back(cmd);
+	milliAmps.push_back(static_cast<float> (milliAmp));
+}
+
+void CatheterCmdSequence::addCommand(const PackedChannelCmd& cmd)
+{
+	// (+ 0 turns the -0 of a zero count DIR_NEG command into 0)
+	addCommand(cmd, unpackCmd(cmd).currentMilliAmp + 0.0);
+}
+
+void CatheterCmdSequence::addCommand(const CatheterChannelCmd& cmd)
+{
+	addCommand(packCmd(cmd));
+}
+
+size_t CatheterCmdSequence::pendingCommands() const
+{
+	size_t used(sets.empty() ? 0 : (sets.back().offset + sets.back().count));
+	return cmds.size() - used;
+}
+
+void CatheterCmdSequence::discardPending()
+{
+	cmds.resize(cmds.size() - pendingCommands());
+	milliAmps.resize(cmds.size());
+}
+
+void CatheterCmdSequence::endSet(long delayTime)
+{
+	SetEntry entry;
+	entry.count = static_cast<uint32_t> (pendingCommands());
+	entry.offset = static_cast<uint32_t> (cmds.size() - entry.count);
+	entry.delayTime = static_cast<int32_t> (delayTime);
+	sets.push_back(entry);
+}
+
+void CatheterCmdSequence::push_back(const CatheterChannelCmdSet& cmdSet)
+{
+	for (size_t index(0); index < cmdSet.commandList.size(); index++)
+	{
+		addCommand(cmdSet.commandList[index]);
+	}
+	endSet(cmdSet.delayTime);
+}
+
+void CatheterCmdSequence::assign(const std::vector<CatheterChannelCmdSet>& cmdVect)
+{
+	clear();
+	size_t nCmds(0);
+	for (size_t index(0); index < cmdVect.size(); index++)
+	{
+		nCmds += cmdVect[index].commandList.size();
+	}
+	reserve(cmdVect.size(), nCmds);
+	for (size_t index(0); index < cmdVect.size(); index++)
+	{
+		push_back(cmdVect[index]);
+	}
+}
+
+void CatheterCmdSequence::append(const CatheterCmdSequence& other)
+{
+	// commands pending here would end up inside the first appended set.
+	discardPending();
+	uint32_t base(static_cast<uint32_t> (cmds.size()));
+	size_t nCmds(other.cmds.size() - other.pendingCommands());
+	cmds.insert(cmds.end(), other.cmds.begin(), other.cmds.begin() + nCmds);
+	milliAmps.insert(milliAmps.end(), other.milliAmps.begin(), other.milliAmps.begin() + nCmds);
+	size_t firstSet(sets.size());
+	sets.insert(sets.end(), other.sets.begin(), other.sets.end());
+	for (size_t index(firstSet); index < sets.size(); index++)
+	{
+		sets[index].offset += base;
+	}
+}
+
+void CatheterCmdSequence::swap(CatheterCmdSequence& other)
+{
+	cmds.swap(other.cmds);
+	milliAmps.swap(other.milliAmps);
+	sets.swap(other.sets);
+}
+
+size_t CatheterCmdSequence::size() const
+{
+	return sets.size();
+}
+
+size_t CatheterCmdSequence::commandCount() const
+{
+	return cmds.size();
+}
+
+bool CatheterCmdSequence::empty() const
+{
+	return sets.empty();
+}
+
+CmdSetView CatheterCmdSequence::operator[](size_t index) const
+{
+	const SetEntry &entry(sets[index]);
+	CmdSetView view;
+	view.cmds = cmds.data() + entry.offset;
+	view.milliAmps = milliAmps.data() + entry.offset;
+	view.count = entry.count;
+	view.delayTime = entry.delayTime;
+	return view;
+}
+
+CatheterChannelCmdSet CatheterCmdSequence::getSet(size_t index) const
+{
+	CmdSetView view((*this)[index]);
+	CatheterChannelCmdSet cmdSet;
+	cmdSet.delayTime = view.delayTime;
+	cmdSet.commandList.reserve(view.size());
+	for (size_t cmdIndex(0); cmdIndex < view.size(); cmdIndex++)
+	{
+		cmdSet.commandList.push_back(unpackCmd(view[cmdIndex]));
+		cmdSet.commandList.back().currentMilliAmp = view.milliAmp(cmdIndex);
+	}
+	return cmdSet;
+}
+
+void CatheterCmdSequence::toCmdSets(std::vector<CatheterChannelCmdSet>& cmdVect) const
+{
+	cmdVect.clear();
+	cmdVect.reserve(size());
+	for (size_t index(0); index < size(); index++)
+	{
+		cmdVect.push_back(getSet(index));
+	}
+}
+
+size_t CatheterCmdSequence::memoryUsage() const
+{
+	return sizeof(*this) + cmds.capacity() * sizeof(PackedChannelCmd) + milliAmps.capacity() * sizeof(float)
+		+ sets.capacity() * sizeof(SetEntry);
+}
+
+
+int encodeCommandSet(const CmdSetView& cmdSet, int pseqnum, uint8_t *bytesOut)
+{
+	int n(static_cast<int> (cmdSet.size()));
+	uint8_t *bytes(bytesOut);
+
+	// preamble
+	bytes[0] = (PCK_OK << 7) | ((pseqnum & 7) << 4) | (n & 15);
+	bytes += PRE_LEN;
+
+	for (int ind(0); ind < n; ind++)
+	{
+		uint32_t packed(cmdSet[ind].bits);
+		// the upper byte is already the channel and the command value.
+		// (the poll, enable and direction bits are kept, update is always set.)
+		uint8_t cmdValue(static_cast<uint8_t> ((packed >> 24) & ((1 << POL_BIT) | (1 << ENA_BIT) | (1 << DIR_BIT))));
+		bytes[0] = static_cast<uint8_t> ((packed >> 24) & 0xF0) | cmdValue | (1 << UPD_BIT);
+		bytes[1] = (packed >> 18) & 63;
+		bytes[2] = (packed >> 12) & 63;
+		bytes += CMD_LEN;
+	}
+
+	// postamble
+	bytes[0] = (pseqnum << 5) | (PCK_OK & 1);
+	bytes += POST_LEN;
+
+	bytes[0] = fletcher8(PCK_LEN(n) - PCK_CHK_LEN, bytesOut);
+	return PCK_LEN(n);
+}
+
+size_t encodedLength(const CatheterCmdSequence& cmdSequence)
+{
+	return cmdSequence.size() * PCK_LEN(0) + cmdSequence.commandCount() * CMD_LEN;
+}
+
+size_t encodeSequence(const CatheterCmdSequence& cmdSequence, int firstSeq, uint8_t *bytesOut, uint32_t *offsets)
+{
+	size_t offset(0);
+	for (size_t index(0); index < cmdSequence.size(); index++)
+	{
+		offsets[index] = static_cast<uint32_t> (offset);
+		offset += encodeCommandSet(cmdSequence[index], firstSeq + static_cast<int> (index), bytesOut + offset);
+	}
+	offsets[cmdSequence.size()] = static_cast<uint32_t> (offset);
+	return offset;
+}
@@ -0,0 +1,394 @@
+#include "com/link_budget.h"
+#include "com/communication_definitions.h"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+// most commands in a packet (the preamble count is 4 bits), same as COALESCE_MAX_CMDS.
+#define BUDGET_MAX_PACKET_CMDS 15
+
+// a serial byte is a start bit, 8 data bits and a stop bit.
+#define BITS_PER_BYTE 10
+
+const unsigned int linkBudgetBauds[LINK_BUDGET_N_BAUDS] = {
+	9600, 19200, 38400, 57600, 115200, 230400, 250000, 460800, 500000, 921600, 1000000, 2000000
+};
+
+namespace
+{
+	enum ShapeFlags
+	{
+		firstGlobal = 1,   // the reply covers every channel (see RESPONSE_LEN)
+		hasGlobal = 2,
+		globalWrite = 4    // a global command that is not a poll (it supersedes the sets before it)
+	};
+
+	// what the budget of a set depends on, 12 bytes per set.
+	struct SetShape
+	{
+		int32_t delayMs;
+		uint8_t nCmds;
+		uint8_t nPolled;    // commands with the poll bit
+		uint8_t writes;     // channels written (a global command writes all of them)
+		uint8_t polls;      // channels polled
+		uint8_t mask;       // bit c: a command for channel c + 1
+		uint8_t writeMask;  // bit c: a command for channel c + 1 that is not a poll
+		uint8_t extra;      // commands for channels above NCHANNELS
+		uint8_t flags;
+	};
+
+	inline uint8_t saturate(size_t value)
+	{
+		return static_cast<uint8_t> (std::min<size_t>(value, 255));
+	}
+
+	inline int cmdChannel(const PackedChannelCmd &cmd) { return cmd.channel(); }
+	inline bool cmdPoll(const PackedChannelCmd &cmd) { return cmd.poll(); }
+	inline bool cmdUpdate(const PackedChannelCmd &cmd) { return cmd.update(); }
+	inline int cmdChannel(const CatheterChannelCmd &cmd) { return cmd.channel; }
+	inline bool cmdPoll(const CatheterChannelCmd &cmd) { return cmd.poll; }
+	inline bool cmdUpdate(const CatheterChannelCmd &cmd) { return cmd.update; }
+
+	template <typename Cmd>
+	SetShape shapeOf(const Cmd *cmds, size_t count, long delayTime)
+	{
+		SetShape shape;
+		shape.delayMs = static_cast<int32_t> (std::max(delayTime, 0L));
+		shape.nCmds = saturate(count);
+		shape.flags = (count > 0 && cmdChannel(cmds[0]) == GLOBAL_ADDR) ? firstGlobal : 0;
+		size_t nPolled(0), writes(0), polls(0), extra(0);
+		uint8_t mask(0), writeMask(0);
+		for (size_t index(0); index < count; index++)
+		{
+			int channel(cmdChannel(cmds[index]));
+			size_t channels(1);
+			if (channel == GLOBAL_ADDR)
+			{
+				shape.flags |= cmdPoll(cmds[index]) ? hasGlobal : (hasGlobal | globalWrite);
+				channels = NCHANNELS;
+			}
+			else if (channel <= NCHANNELS)
+			{
+				mask |= 1 << (channel - 1);
+				writeMask |= cmdPoll(cmds[index]) ? 0 : 1 << (channel - 1);
+			}
+			else
+			{
+				extra++;
+			}
+			writes += cmdUpdate(cmds[index]) ? channels : 0;
+			if (cmdPoll(cmds[index]))
+			{
+				nPolled++;
+				polls += channels;
+			}
+		}
+		shape.nPolled = saturate(nPolled);
+		shape.writes = saturate(writes);
+		shape.polls = saturate(polls);
+		shape.mask = mask;
+		shape.writeMask = writeMask;
+		shape.extra = saturate(extra);
+		return shape;
+	}
+
+	inline int popCount(uint8_t bits)
+	{
+		int count(0);
+		for (; bits != 0; bits &= bits - 1)
+		{
+			count++;
+		}
+		return count;
+	}
+
+	// same test as coalescible() in ser/queue_coalesce.cpp.
+	inline bool shapeCoalescible(const SetShape &shape)
+	{
+		return shape.delayMs == 0 && shape.nCmds > 0 && shape.nPolled == 0 && !(shape.flags & hasGlobal);
+	}
+
+	// the set without its polled commands (the no polling modes).
+	inline void stripPolls(SetShape &shape)
+	{
+		shape.nCmds = saturate(shape.nCmds - std::min(shape.nCmds, shape.nPolled));
+		shape.nPolled = 0;
+		shape.polls = 0;
+		shape.mask = shape.writeMask;
+		if (!(shape.flags & globalWrite))
+		{
+			shape.flags &= ~(firstGlobal | hasGlobal);
+		}
+	}
+
+	// folds shape into next like mergeInto() in ser/queue_coalesce.cpp, false if it is sent on its own.
+	inline bool shapeMerge(const SetShape &shape, SetShape &next)
+	{
+		// a global write supersedes the set, a global poll writes nothing so the set still goes out.
+		if (next.flags & globalWrite)
+		{
+			return true;
+		}
+		if (next.flags & hasGlobal)
+		{
+			return false;
+		}
+		// a channel poll does not supersede the update of its channel.
+		int kept(popCount(shape.mask & ~next.writeMask) + shape.extra);
+		if (kept + next.nCmds > BUDGET_MAX_PACKET_CMDS)
+		{
+			return false;
+		}
+		next.nCmds = saturate(next.nCmds + kept);
+		next.writes = saturate(next.writes + kept);
+		next.mask |= shape.mask;
+		next.writeMask |= shape.mask;
+		next.extra = saturate(next.extra + shape.extra);
+		return true;
+	}
+
+	struct LinkModel
+	{
+		double usPerByte;   // 0 at baud 0
+		double packetUs;
+		double dacUs;
+		double adcUs;
+
+		LinkModel(const LinkBudgetOptions &options, unsigned int baud) :
+			usPerByte(baud == 0 ? 0.0 : BITS_PER_BYTE * 1.0e6 / baud), packetUs(options.packetUs),
+			dacUs(options.dacUs), adcUs(options.adcUs)
+		{};
+
+		double wireUs(const SetShape &shape) const
+		{
+			return usPerByte * (PCK_LEN(shape.nCmds)
+				+ RESPONSE_LEN(shape.nCmds, (shape.flags & firstGlobal) != 0, shape.nPolled));
+		}
+
+		double firmwareUs(const SetShape &shape) const
+		{
+			return packetUs + dacUs * shape.writes + adcUs * shape.polls;
+		}
+	};
+
+	// replays the schedule. Without a report, stops at the first set later than the tolerance.
+	// returns true if no set is later than the tolerance.
+	bool simulate(const std::vector<SetShape> &shapes, const LinkBudgetOptions &options, unsigned int baud,
+		PacketMode mode, LinkBudgetReport *report, std::vector<SetBudget> *perSet)
+	{
+		LinkModel model(options, baud);
+		bool coalesce(mode == packetCoalesced || mode == packetCoalescedNoPoll);
+		bool noPoll(mode == packetNoPoll || mode == packetCoalescedNoPoll);
+		double tolerance(options.lagToleranceUs);
+		double scheduled(0.0);
+		double linkFree(0.0);
+		double lagSum(0.0);
+		size_t packets(0);
+		bool inSegment(false);
+		bool feasible(true);
+		// the set the previous zero delay sets were folded into.
+		SetShape merged;
+		bool carried(false);
+
+		for (size_t index(0); index < shapes.size(); index++)
+		{
+			SetShape shape(carried ? merged : shapes[index]);
+			carried = false;
+			if (noPoll)
+			{
+				stripPolls(shape);
+			}
+			if (coalesce && index + 1 < shapes.size() && shapeCoalescible(shape))
+			{
+				merged = shapes[index + 1];
+				if (noPoll)
+				{
+					stripPolls(merged);
+				}
+				if (shapeMerge(shape, merged))
+				{
+					carried = true;
+					continue;
+				}
+			}
+			if (noPoll && shape.nCmds == 0)
+			{
+				// a set of polls only, nothing is sent.
+				scheduled += shape.delayMs * 1.0e3;
+				continue;
+			}
+
+			double wireUs(model.wireUs(shape));
+			double firmwareUs(model.firmwareUs(shape));
+			double budgetUs(wireUs + firmwareUs);
+			double start(std::max(scheduled, linkFree));
+			double lagUs(start - scheduled);
+			linkFree = start + budgetUs;
+			double delayUs(shape.delayMs * 1.0e3);
+			bool late(lagUs > tolerance);
+			feasible = feasible && !late;
+
+			if (report == NULL)
+			{
+				if (late)
+				{
+					return false;
+				}
+				scheduled += delayUs;
+				continue;
+			}
+
+			packets++;
+			lagSum += lagUs;
+			report->busyUs += budgetUs;
+			report->maxLagUs = std::max(report->maxLagUs, lagUs);
+			report->finalLagUs = lagUs;
+			if (budgetUs > delayUs)
+			{
+				report->tightSets++;
+			}
+			if (late)
+			{
+				report->infeasibleSets++;
+				if (!inSegment)
+				{
+					report->segmentCount++;
+					if (report->segments.size() < LINK_BUDGET_MAX_SEGMENTS)
+					{
+						InfeasibleSegment segment;
+						segment.first = index;
+						segment.last = index;
+						segment.startUs = scheduled;
+						segment.maxLagUs = lagUs;
+						report->segments.push_back(segment);
+					}
+				}
+				else if (report->segments.size() == report->segmentCount)
+				{
+					report->segments.back().last = index;
+					report->segments.back().maxLagUs = std::max(report->segments.back().maxLagUs, lagUs);
+				}
+			}
+			inSegment = late;
+			if (perSet != NULL)
+			{
+				SetBudget budget;
+				budget.wireUs = static_cast<float> (wireUs);
+				budget.firmwareUs = static_cast<float> (firmwareUs);
+				budget.lagUs = static_cast<float> (lagUs);
+				perSet->push_back(budget);
+			}
+			scheduled += delayUs;
+		}
+		if (report != NULL)
+		{
+			report->scheduledUs = scheduled;
+			report->meanLagUs = packets > 0 ? lagSum / packets : 0.0;
+			report->feasible = feasible;
+		}
+		return feasible;
+	}
+
+	LinkBudgetReport analyzeShapes(const std::vector<SetShape> &shapes, const LinkBudgetOptions &options,
+		std::vector<SetBudget> *perSet)
+	{
+		LinkBudgetReport report;
+		report.sets = shapes.size();
+		if (perSet != NULL)
+		{
+			perSet->clear();
+			perSet->reserve(shapes.size());
+		}
+		simulate(shapes, options, options.baud, packetAsIs, &report, perSet);
+
+		// feasibility only improves with the baud, bisect the standard rates.
+		size_t low(0), high(LINK_BUDGET_N_BAUDS);
+		while (low < high)
+		{
+			size_t middle((low + high) / 2);
+			if (simulate(shapes, options, linkBudgetBauds[middle], packetAsIs, NULL, NULL))
+			{
+				high = middle;
+			}
+			else
+			{
+				low = middle + 1;
+			}
+		}
+		report.minBaud = low < LINK_BUDGET_N_BAUDS ? linkBudgetBauds[low] : 0;
+
+		report.suggestedMode = packetModeCount;
+		for (int mode(packetAsIs); mode < packetModeCount; mode++)
+		{
+			if (mode == packetAsIs ? report.feasible
+				: simulate(shapes, options, options.baud, static_cast<PacketMode> (mode), NULL, NULL))
+			{
+				report.suggestedMode = static_cast<PacketMode> (mode);
+				break;
+			}
+		}
+		return report;
+	}
+}
+
+
+const char* packetModeName(PacketMode mode)
+{
+	switch (mode)
+	{
+	case packetAsIs:
+		return "as is";
+	case packetCoalesced:
+		return "coalesced";
+	case packetNoPoll:
+		return "no polling";
+	case packetCoalescedNoPoll:
+		return "coalesced, no polling";
+	default:
+		return "none";
+	}
+}
+
+double setWireUs(size_t nCmds, bool global, size_t nPolled, unsigned int baud)
+{
+	if (baud == 0)
+	{
+		return 0.0;
+	}
+	return (PCK_LEN(nCmds) + RESPONSE_LEN(nCmds, global, nPolled)) * BITS_PER_BYTE * 1.0e6 / baud;
+}
+
+LinkBudgetReport analyzeLinkBudget(const CatheterCmdSequence &cmdSequence, const LinkBudgetOptions &options,
+	std::vector<SetBudget> *perSet)
+{
+	std::vector<SetShape> shapes(cmdSequence.size());
+	for (size_t index(0); index < shapes.size(); index++)
+	{
+		CmdSetView cmdSet(cmdSequence[index]);
+		shapes[index] = shapeOf(cmdSet.cmds, cmdSet.count, cmdSet.delayTime);
+	}
+	return analyzeShapes(shapes, options, perSet);
+}
+
+LinkBudgetReport analyzeLinkBudget(const std::vector<CatheterChannelCmdSet> &cmdSets,
+	const LinkBudgetOptions &options, std::vector<SetBudget> *perSet)
+{
+	std::vector<SetShape> shapes(cmdSets.size());
+	for (size_t index(0); index < shapes.size(); index++)
+	{
+		const std::vector<CatheterChannelCmd> &cmds(cmdSets[index].commandList);
+		shapes[index] = shapeOf(cmds.empty() ? NULL : &cmds[0], cmds.size(), cmdSets[index].delayTime);
+	}
+	return analyzeShapes(shapes, options, perSet);
+}
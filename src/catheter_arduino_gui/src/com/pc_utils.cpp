@@ -1,4 +1,5 @@
-#include "com/catheter_commands.h"
+#include "com/pc_utils.h"
+#include "hardware/digital_analog_conversions.h"
 #include <algorithm>
 
 
@@ -16,6 +17,32 @@
 
 using namespace std;
 
+/* parse a single playfile line: "channel, current (mA), delay (ms)". returns false if the line should be skipped. */
+bool parsePlayLine(const string& line, int& channelIn, double& milliAmp, int& waitTime) {
+
+    size_t posComma1 = line.find (","); // after channel, before current
+    size_t posComma2 = line.find (",", posComma1 + 1); // after current (MilliAmp), before delay (MilliSec)
+
+    //verify the line's validity.
+    if(!((posComma1 < posComma2) && posComma2 != string::npos)) return false;
+
+    // the number parsers stop at the commas, so the line is not split.
+    const char* text = line.c_str();
+
+    /* parse channel */
+    channelIn = atoi(text);
+    if(!(channelIn >= 0 && channelIn <= NCHANNELS)) return false;   // bad channel; skip line
+
+    /* parse current data, given in MilliAamp */
+    milliAmp = atof(text + posComma1 + 1);
+
+    /* parse delay */
+    waitTime = atoi(text + posComma2 + 1);
+    if(!(waitTime >= 0)) return false;  // bad delay; skip line
+
+    return true;
+}
+
 /* parse a playfile into a command vector */
 int loadPlayFile(const char* fileIn, std::vector<CatheterChannelCmdSet>& outputCmdsVect) {
 
@@ -27,56 +54,127 @@ int loadPlayFile(const char* fileIn, std::vector<CatheterChannelCmdSet>& outputC
     outputCmdsVect.clear();
     int npackets = 0;
     string line;
-    int linenum = 0;
 	CatheterChannelCmdSet singleSet;
 
     while (getline (inFile, line)) {
-		
-        string item;
-        size_t posOcto1  = line.find ("#"); // line comment
-        size_t posComma1 = line.find (","); // after channel, before current
-        size_t posComma2 = line.find (",", posComma1 + 1); // after current (MilliAmp), before delay (MilliSec)
-
-        //verify the line's validity.
-        if((posComma1 < posComma2) && posComma2 != string::npos) {  //line is ok.
-
-            istringstream linestream(line);
-        
-            CatheterChannelCmd singleCmd;
-       
-            /* parse channel */
-            getline (linestream, item, ','); 
-            int channelIn = atoi(item.c_str());
-            //std::cout<<channelIn<<std::endl;
-            if(!(channelIn >= 0 && channelIn <= NCHANNELS)) continue;   // bad channel; skip line
-            singleCmd.channel = channelIn;
-
-            /* parse current data, given in MilliAamp */
-            getline (linestream, item, ',');
-            singleCmd.currentMilliAmp = atof(item.c_str());
-            //std::cout<<singleCmd.currentMilliAmp<<std::endl;
-            singleCmd.poll = false;
-
-            /* parse delay */
-            getline (linestream, item); //delay is delimitered by new line so using the default delimiter.
-            int waitTime = atoi(item.c_str());
-            if(!(waitTime >= 0)) continue;  // bad delay; skip line
-
-			singleSet.commandList.push_back(singleCmd);
-            if (waitTime > 0)
-			{
-				singleSet.delayTime = waitTime;
-				outputCmdsVect.push_back(singleSet);
-				singleSet.commandList.clear();
-				singleSet.delayTime = 0;
-			}
-            linenum++;
-        }
+        int channelIn, waitTime;
+        double milliAmp;
+        if (!parsePlayLine(line, channelIn, milliAmp, waitTime)) continue;
+
+        CatheterChannelCmd singleCmd;
+        singleCmd.channel = channelIn;
+        // the current is converted to DAC counts here.
+        setCmdMilliAmp(singleCmd, milliAmp);
+        singleCmd.poll = false;
+
+		singleSet.commandList.push_back(singleCmd);
+        if (waitTime > 0)
+		{
+			singleSet.delayTime = waitTime;
+			outputCmdsVect.push_back(singleSet);
+			singleSet.commandList.clear();
+			singleSet.delayTime = 0;
+		}
     }
     inFile.close();
     return npackets;
 }
 
+/* parse a playfile into a packed command sequence */
+int loadPlayFile(const char* fileIn, CatheterCmdSequence& outputSequence) {
+
+    ifstream inFile(fileIn, ifstream::in);
+
+    if(inFile.bad()) return -1;
+    if(!inFile.is_open()) return -2;
+
+    outputSequence.clear();
+    string line;
+
+    while (getline (inFile, line)) {
+        int channelIn, waitTime;
+        double milliAmp;
+        if (!parsePlayLine(line, channelIn, milliAmp, waitTime)) continue;
+
+        CatheterChannelCmd singleCmd;
+        singleCmd.channel = channelIn;
+        setCmdMilliAmp(singleCmd, milliAmp);
+        singleCmd.poll = false;
+        outputSequence.addCommand(packCmd(singleCmd), milliAmp);
+
+        if (waitTime > 0)
+        {
+            outputSequence.endSet(waitTime);
+        }
+    }
+    // commands without a closing delay are dropped (same as above).
+    outputSequence.discardPending();
+    inFile.close();
+    return 0;
+}
+
+int currentMatrix2Sequence(const double* milliAmp, size_t nChannels, size_t nSteps, const double* delayMS, size_t nDelays,
+	bool poll, CatheterCmdSequence& cmdSequence)
+{
+	cmdSequence.clear();
+	if (nChannels == 0 || nChannels > NCHANNELS || (nDelays != 1 && nDelays != nSteps))
+	{
+		return -1;
+	}
+	cmdSequence.reserve(nSteps, nSteps * nChannels);
+
+	CatheterChannelCmd cmd;
+	for (size_t step(0); step < nSteps; step++)
+	{
+		const double *column(milliAmp + step * nChannels);
+		for (size_t chan(0); chan < nChannels; chan++)
+		{
+			cmd.channel = static_cast<int> (chan) + 1;
+			setCmdMilliAmp(cmd, column[chan]);
+			cmdSequence.addCommand(packCmd(cmd), column[chan]);
+		}
+		// a polled command is not applied, so the polls follow the setpoints.
+		for (size_t chan(0); poll && chan < nChannels; chan++)
+		{
+			cmd.channel = static_cast<int> (chan) + 1;
+			setCmdMilliAmp(cmd, column[chan]);
+			cmd.poll = true;
+			cmdSequence.addCommand(packCmd(cmd), column[chan]);
+			cmd.poll = false;
+		}
+		cmdSequence.endSet(static_cast<long> (delayMS[(nDelays == 1) ? 0 : step]));
+	}
+	return 0;
+}
+
+void sequenceTimeline(const CatheterCmdSequence& cmdSequence, double* timeMS, double* milliAmp)
+{
+	double held[NCHANNELS] = {0.0};
+	double time(0.0);
+	for (size_t index(0); index < cmdSequence.size(); index++)
+	{
+		CmdSetView cmdSet(cmdSequence[index]);
+		for (size_t j(0); j < cmdSet.size(); j++)
+		{
+			int channel(cmdSet[j].channel());
+			if (channel == GLOBAL_ADDR)
+			{
+				for (int chan(1); chan <= NCHANNELS; chan++)
+				{
+					held[chan - 1] = dac2MilliAmp(cmdSet[j].dacCounts(), cmdSet[j].dir(), chan);
+				}
+			}
+			else if (channel <= NCHANNELS)
+			{
+				held[channel - 1] = dac2MilliAmp(cmdSet[j].dacCounts(), cmdSet[j].dir(), channel);
+			}
+		}
+		timeMS[index] = time;
+		std::copy(held, held + NCHANNELS, milliAmp + index * NCHANNELS);
+		time += cmdSet.delayTime;
+	}
+}
+
 int currentGen(const std::vector<CatheterChannelCmdSet>& cmdVect, std::vector<double>& timeSlice, std::vector<std::vector<double>>& currentList, int actuatorDofs,int numActuator){
     timeSlice.clear();        //clearing the input vector
     currentList.clear();      //clearing the input vector
@@ -132,6 +230,23 @@ bool writePlayFile(const char * fname, const std::vector<CatheterChannelCmdSet>&
     return true;
 }
 
+bool writePlayFile(const char * fname, const CatheterCmdSequence& cmdSequence) {
+    ofstream outFile(fname, ofstream::out);
+    if (outFile.bad())
+        return false;
+    for (size_t i = 0; i < cmdSequence.size(); i++) {
+        CmdSetView cmdSet(cmdSequence[i]);
+        for (size_t j(0); j < cmdSet.size(); j++)
+        {
+            // the milliAmps the command was loaded from, not the ones of its DAC counts.
+            outFile << cmdSet[j].channel() << ", " << cmdSet.milliAmp(j) << ", ";
+            outFile << (((j+1) < cmdSet.size()) ? 0 : cmdSet.delayTime) << std::endl;
+        }
+    }
+    outFile.close();
+    return true;
+}
+
 bool writeBytes(const char *fname, const std::vector<uint8_t>& bytes) {
 	FILE* f = fopen(fname, "w");
 	if (f == NULL)
@@ -0,0 +1,94 @@
+#include "com/status_data.h"
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+
+statusData::statusData()
+{
+	for (int slot(0); slot < STATUS_MAX_READERS; slot++)
+	{
+		claimed[slot].store(false, std::memory_order_relaxed);
+	}
+}
+
+void statusData::updateCmdList(const std::vector<CatheterChannelCmd> & inputCommands)
+{
+	for (size_t index(0); index < inputCommands.size(); index++)
+	{
+		int channel(inputCommands[index].channel);
+		if (channel < 1 || channel > NCHANNELS)
+		{
+			continue;  // global replies have no channel of their own.
+		}
+		current.channels[channel - 1] = inputCommands[index];
+		current.reported |= 1 << (channel - 1);
+	}
+	current.replies++;
+	// every slot is kept current, so a reader attaching later starts from the latest snapshot.
+	for (int slot(0); slot < STATUS_MAX_READERS; slot++)
+	{
+		buffers[slot].write(current);
+	}
+
+	// only contended while the callback is being replaced, the notification is skipped then.
+	boost::mutex::scoped_try_lock lock(notifyMutex);
+	if (lock.owns_lock() && notify)
+	{
+		notify();
+	}
+}
+
+void statusData::setNotify(const boost::function<void()> &notifyFcn)
+{
+	boost::mutex::scoped_lock lock(this->notifyMutex);
+	this->notify = notifyFcn;
+}
+
+
+StatusReader::StatusReader(statusData &status_) : status(status_), slot(-1), lastReplies(0)
+{
+	for (int index(0); index < STATUS_MAX_READERS; index++)
+	{
+		bool expected(false);
+		if (status.claimed[index].compare_exchange_strong(expected, true, std::memory_order_acquire))
+		{
+			slot = index;
+			break;
+		}
+	}
+}
+
+StatusReader::~StatusReader()
+{
+	if (slot >= 0)
+	{
+		status.claimed[slot].store(false, std::memory_order_release);
+	}
+}
+
+bool StatusReader::attached() const
+{
+	return slot >= 0;
+}
+
+bool StatusReader::read(StatusSnapshot &snapshot)
+{
+	if (slot < 0)
+	{
+		return false;
+	}
+	status.buffers[slot].read(snapshot);
+	bool fresh(snapshot.replies != lastReplies);
+	lastReplies = snapshot.replies;
+	return fresh;
+}
@@ -0,0 +1,899 @@
+#include "com/tracking_error.h"
+#include "hardware/digital_analog_conversions.h"
+
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+// longest number handed to strtod (exponents, nan and inf).
+#define TRACKING_NUMBER_LEN 64
+
+// forward searches of the reference before it is bisected.
+#define TRACKING_SCAN_SEGMENTS 8
+
+// set_ma changes looked at for the next change of the schedule before it is taken as never echoed.
+#define TRACKING_ANCHOR_SCAN 4
+
+// set_ma is written with 4 decimals.
+#define TRACKING_SET_TOLERANCE_MA 1.0e-3
+
+namespace
+{
+	const double infinity(std::numeric_limits<double>::infinity());
+
+	// a channel's commanded current from startMs until the next segment.
+	struct Segment
+	{
+		double startMs;
+		double milliAmp;
+		double fromMa;
+		size_t set;
+		bool step;
+		double driftMs;
+		bool anchored;
+	};
+
+	struct Columns
+	{
+		int time;
+		int channel;
+		int sensed;
+		int dir;      // -1 if absent
+		int polled;   // -1 if absent
+		int setMa;    // -1 if absent
+		int count;
+		int needed;   // columns parsed in a row
+	};
+
+	struct ErrorSum
+	{
+		size_t samples;
+		double sum;
+		double sumSq;
+		double maxAbs;
+		double maxAbsMs;
+
+		ErrorSum() : samples(0), sum(0.0), sumSq(0.0), maxAbs(-1.0), maxAbsMs(0.0)
+		{};
+	};
+
+	// the samples of one step seen in a chunk.
+	struct StepSum
+	{
+		size_t segment;
+		size_t samples;
+		double firstMs;
+		double lastMs;
+		double lastOutMs;  // last sample outside the band
+		double crossMs;    // first sample past the midpoint
+		double maxAbs;
+
+		explicit StepSum(size_t segment_) : segment(segment_), samples(0), firstMs(infinity), lastMs(-infinity),
+			lastOutMs(-infinity), crossMs(infinity), maxAbs(0.0)
+		{};
+
+		void merge(const StepSum &other)
+		{
+			samples += other.samples;
+			firstMs = std::min(firstMs, other.firstMs);
+			lastMs = std::max(lastMs, other.lastMs);
+			lastOutMs = std::max(lastOutMs, other.lastOutMs);
+			crossMs = std::min(crossMs, other.crossMs);
+			maxAbs = std::max(maxAbs, other.maxAbs);
+		}
+	};
+
+	struct ChunkResult
+	{
+		size_t rows;
+		size_t samples;
+		size_t skipped;
+		double firstMs;
+		double lastMs;
+		ErrorSum errors[NCHANNELS];
+		std::vector<StepSum> steps[NCHANNELS];
+
+		ChunkResult() : rows(0), samples(0), skipped(0), firstMs(infinity), lastMs(-infinity)
+		{};
+	};
+
+	// a row whose set_ma differs from the row of its channel before it.
+	struct SetChange
+	{
+		double timeMs;
+		double milliAmp;
+	};
+
+	struct ChunkChanges
+	{
+		std::vector<SetChange> channels[NCHANNELS];
+	};
+
+	struct Row
+	{
+		double time;
+		double channel;
+		double sensed;
+		double dir;
+		double polled;
+		double setMa;
+	};
+
+	bool stepLess(const StepSum &step, size_t segment)
+	{
+		return step.segment < segment;
+	}
+
+	// the sums of a step, samples mostly arrive in time order so it is usually the last one.
+	StepSum& stepFor(std::vector<StepSum> &steps, size_t segment)
+	{
+		if (!steps.empty() && steps.back().segment == segment)
+		{
+			return steps.back();
+		}
+		if (steps.empty() || steps.back().segment < segment)
+		{
+			steps.push_back(StepSum(segment));
+			return steps.back();
+		}
+		std::vector<StepSum>::iterator found(std::lower_bound(steps.begin(), steps.end(), segment, stepLess));
+		if (found == steps.end() || found->segment != segment)
+		{
+			found = steps.insert(found, StepSum(segment));
+		}
+		return *found;
+	}
+
+	// the segments of every channel, the first one holds the 0 mA before the first set.
+	void buildReference(const CatheterCmdSequence &cmdSequence, const TrackingOptions &options,
+		std::vector<Segment> (&segments)[NCHANNELS])
+	{
+		double held[NCHANNELS] = {0.0};
+		for (int chan(0); chan < NCHANNELS; chan++)
+		{
+			Segment initial = { -infinity, 0.0, 0.0, 0, false, 0.0, false };
+			segments[chan].assign(1, initial);
+		}
+		double time(0.0);
+		for (size_t index(0); index < cmdSequence.size(); index++)
+		{
+			// same holding rules as sequenceTimeline().
+			CmdSetView cmdSet(cmdSequence[index]);
+			for (size_t j(0); j < cmdSet.size(); j++)
+			{
+				int channel(cmdSet[j].channel());
+				if (channel == GLOBAL_ADDR)
+				{
+					for (int chan(1); chan <= NCHANNELS; chan++)
+					{
+						held[chan - 1] = dac2MilliAmp(cmdSet[j].dacCounts(), cmdSet[j].dir(), chan);
+					}
+				}
+				else if (channel <= NCHANNELS)
+				{
+					held[channel - 1] = dac2MilliAmp(cmdSet[j].dacCounts(), cmdSet[j].dir(), channel);
+				}
+			}
+			for (int chan(0); chan < NCHANNELS; chan++)
+			{
+				Segment &last(segments[chan].back());
+				if (held[chan] == last.milliAmp)
+				{
+					continue;
+				}
+				if (last.startMs == time)
+				{
+					// zero delay sets at the same time are one step.
+					last.milliAmp = held[chan];
+					last.set = index;
+				}
+				else
+				{
+					Segment next = { time, held[chan], last.milliAmp, index, false, 0.0, false };
+					segments[chan].push_back(next);
+				}
+				Segment &changed(segments[chan].back());
+				double size(fabs(changed.milliAmp - changed.fromMa));
+				changed.step = size > 0.0 && size >= options.minStepMa;
+			}
+			time += cmdSet.delayTime;
+		}
+	}
+
+	std::string trimmed(const char *begin, const char *end)
+	{
+		while (begin < end && (*begin == ' ' || *begin == '\t' || *begin == '"'))
+		{
+			begin++;
+		}
+		while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '"'))
+		{
+			end--;
+		}
+		return std::string(begin, end);
+	}
+
+	bool parseHeader(const char *begin, const char *end, Columns &columns)
+	{
+		columns.time = columns.channel = columns.sensed = columns.dir = columns.polled = columns.setMa = -1;
+		columns.count = 0;
+		const char *field(begin);
+		while (field <= end)
+		{
+			const char *comma(static_cast<const char*> (memchr(field, ',', end - field)));
+			const char *fieldEnd(comma != NULL ? comma : end);
+			std::string name(trimmed(field, fieldEnd));
+			if (name == "time_s")
+			{
+				columns.time = columns.count;
+			}
+			else if (name == "channel")
+			{
+				columns.channel = columns.count;
+			}
+			else if (name == "sensed_ma")
+			{
+				columns.sensed = columns.count;
+			}
+			else if (name == "dir")
+			{
+				columns.dir = columns.count;
+			}
+			else if (name == "polled")
+			{
+				columns.polled = columns.count;
+			}
+			else if (name == "set_ma")
+			{
+				columns.setMa = columns.count;
+			}
+			columns.count++;
+			field = fieldEnd + 1;
+		}
+		columns.needed = 3 + ((columns.dir >= 0) ? 1 : 0) + ((columns.polled >= 0) ? 1 : 0) +
+			((columns.setMa >= 0) ? 1 : 0);
+		return columns.time >= 0 && columns.channel >= 0 && columns.sensed >= 0;
+	}
+
+	// parses a plain decimal, anything else goes through strtod. p ends on the delimiter.
+	bool parseNumber(const char *&p, const char *end, double &value)
+	{
+		const char *start(p);
+		while (p < end && *p == ' ')
+		{
+			p++;
+		}
+		bool negative(p < end && *p == '-');
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			p++;
+		}
+		uint64_t mantissa(0);
+		int digits(0);
+		int scale(0);
+		for (; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+		{
+			if (digits < 18)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+			}
+			else
+			{
+				scale++;
+			}
+		}
+		if (p < end && *p == '.')
+		{
+			for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+			{
+				if (digits < 18)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					scale--;
+				}
+			}
+		}
+		if (digits > 0 && (p == end || *p == ',' || *p == '\r' || *p == ' '))
+		{
+			static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+				1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+			double result(static_cast<double> (mantissa));
+			int magnitude(std::abs(scale));
+			double power(magnitude <= 18 ? powers[magnitude] : pow(10.0, magnitude));
+			result = (scale < 0) ? result / power : result * power;
+			value = negative ? -result : result;
+			while (p < end && *p == ' ')
+			{
+				p++;
+			}
+			return true;
+		}
+
+		const char *fieldEnd(static_cast<const char*> (memchr(start, ',', end - start)));
+		fieldEnd = (fieldEnd != NULL) ? fieldEnd : end;
+		char text[TRACKING_NUMBER_LEN];
+		size_t length(std::min<size_t>(fieldEnd - start, TRACKING_NUMBER_LEN - 1));
+		memcpy(text, start, length);
+		text[length] = '\0';
+		char *parsedEnd(NULL);
+		value = strtod(text, &parsedEnd);
+		p = fieldEnd;
+		return parsedEnd != text && std::isfinite(value);
+	}
+
+	// the named columns of a row, false if one is missing or not a number (or the channel is not 1..NCHANNELS).
+	bool parseRow(const Columns &columns, const char *line, const char *lineEnd, Row &row, int &chan)
+	{
+		row.time = row.channel = row.sensed = row.setMa = 0.0;
+		row.dir = row.polled = 1.0;
+		int found(0);
+		const char *p(line);
+		for (int column(0); column < columns.count && p <= lineEnd; column++)
+		{
+			double *value(NULL);
+			if (column == columns.time)
+			{
+				value = &row.time;
+			}
+			else if (column == columns.channel)
+			{
+				value = &row.channel;
+			}
+			else if (column == columns.sensed)
+			{
+				value = &row.sensed;
+			}
+			else if (column == columns.dir)
+			{
+				value = &row.dir;
+			}
+			else if (column == columns.polled)
+			{
+				value = &row.polled;
+			}
+			else if (column == columns.setMa)
+			{
+				value = &row.setMa;
+			}
+			if (value != NULL)
+			{
+				if (!parseNumber(p, lineEnd, *value))
+				{
+					return false;
+				}
+				found++;
+			}
+			const char *comma(static_cast<const char*> (memchr(p, ',', lineEnd - p)));
+			p = (comma != NULL) ? comma + 1 : lineEnd + 1;
+		}
+		chan = static_cast<int> (row.channel);
+		return found >= columns.needed && chan >= 1 && chan <= NCHANNELS && chan == row.channel;
+	}
+
+	// calls parse(line, lineEnd) for every line of [begin, end) that is not empty.
+	template <typename Parse>
+	void forEachLine(const char *csv, size_t begin, size_t end, Parse &parse)
+	{
+		const char *line(csv + begin);
+		const char *stop(csv + end);
+		while (line < stop)
+		{
+			const char *lineEnd(static_cast<const char*> (memchr(line, '\n', stop - line)));
+			lineEnd = (lineEnd != NULL) ? lineEnd : stop;
+			if (lineEnd > line && !(lineEnd - line == 1 && *line == '\r'))
+			{
+				parse(line, lineEnd);
+			}
+			line = lineEnd + 1;
+		}
+	}
+
+	// runs worker on the calling thread or on threads of its own.
+	template <typename Worker>
+	void runWorkers(const Worker &worker, unsigned int threads)
+	{
+		if (threads == 1)
+		{
+			worker();
+			return;
+		}
+		boost::thread_group workers;
+		for (unsigned int index(0); index < threads; index++)
+		{
+			workers.create_thread(worker);
+		}
+		workers.join_all();
+	}
+
+	// finds the set_ma changes of every channel in a chunk (the first row of a channel always counts).
+	struct ChangeScanner
+	{
+		const char *csv;
+		const std::vector<size_t> *bounds;
+		const Columns *columns;
+		const TrackingOptions *options;
+		std::vector<ChunkChanges> *results;
+		std::atomic<size_t> *nextChunk;
+
+		void operator()() const
+		{
+			size_t chunk;
+			while ((chunk = nextChunk->fetch_add(1)) < results->size())
+			{
+				ChunkScan scan = { this, &(*results)[chunk], {0.0} };
+				std::fill(scan.last, scan.last + NCHANNELS, std::numeric_limits<double>::quiet_NaN());
+				forEachLine(csv, (*bounds)[chunk], (*bounds)[chunk + 1], scan);
+			}
+		}
+
+		struct ChunkScan
+		{
+			const ChangeScanner *scanner;
+			ChunkChanges *changes;
+			double last[NCHANNELS];
+
+			void operator()(const char *line, const char *lineEnd)
+			{
+				Row row;
+				int chan;
+				if (!parseRow(*scanner->columns, line, lineEnd, row, chan))
+				{
+					return;
+				}
+				// NaN: the first row of the channel in the chunk.
+				if (!(row.setMa == last[chan - 1]))
+				{
+					SetChange change = { row.time * 1.0e3 + scanner->options->offsetMs, row.setMa };
+					changes->channels[chan - 1].push_back(change);
+					last[chan - 1] = row.setMa;
+				}
+			}
+		};
+	};
+
+	// moves every change of the reference to the set_ma change that echoes it, in order.
+	// A change that is not seen before the one after it keeps the drift so far.
+	void anchorReference(const std::vector<ChunkChanges> &chunks, std::vector<Segment> (&segments)[NCHANNELS])
+	{
+		for (int chan(0); chan < NCHANNELS; chan++)
+		{
+			// the changes in file order, the board starts at 0 mA.
+			std::vector<SetChange> observed;
+			double held(0.0);
+			for (size_t chunk(0); chunk < chunks.size(); chunk++)
+			{
+				const std::vector<SetChange> &changes(chunks[chunk].channels[chan]);
+				for (size_t index(0); index < changes.size(); index++)
+				{
+					if (fabs(changes[index].milliAmp - held) > TRACKING_SET_TOLERANCE_MA)
+					{
+						observed.push_back(changes[index]);
+					}
+					held = changes[index].milliAmp;
+				}
+			}
+
+			std::vector<Segment> &channelSegments(segments[chan]);
+			size_t next(0);
+			double drift(0.0);
+			for (size_t index(1); index < channelSegments.size(); index++)
+			{
+				Segment &segment(channelSegments[index]);
+				double scheduled(segment.startMs);
+				size_t last(std::min(next + TRACKING_ANCHOR_SCAN, observed.size()));
+				for (size_t scan(next); scan < last; scan++)
+				{
+					if (fabs(observed[scan].milliAmp - segment.milliAmp) <= TRACKING_SET_TOLERANCE_MA)
+					{
+						drift = observed[scan].timeMs - scheduled;
+						segment.anchored = true;
+						next = scan + 1;
+						break;
+					}
+					if (index + 1 < channelSegments.size() &&
+						fabs(observed[scan].milliAmp - channelSegments[index + 1].milliAmp) <= TRACKING_SET_TOLERANCE_MA)
+					{
+						break;
+					}
+				}
+				segment.driftMs = drift;
+				segment.startMs = std::max(scheduled + drift, channelSegments[index - 1].startMs);
+			}
+		}
+	}
+
+	// the segment holding timeMs, starting from the last one found.
+	size_t findSegment(const std::vector<Segment> &segments, size_t cursor, double timeMs)
+	{
+		if (segments[cursor].startMs <= timeMs)
+		{
+			size_t last(std::min(cursor + TRACKING_SCAN_SEGMENTS, segments.size() - 1));
+			for (; cursor < last && segments[cursor + 1].startMs <= timeMs; cursor++)
+			{
+			}
+			if (cursor + 1 == segments.size() || segments[cursor + 1].startMs > timeMs)
+			{
+				return cursor;
+			}
+		}
+		size_t low(0), high(segments.size());
+		while (high - low > 1)
+		{
+			size_t middle((low + high) / 2);
+			if (segments[middle].startMs <= timeMs)
+			{
+				low = middle;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+		return low;
+	}
+
+	struct ChunkParser
+	{
+		const char *csv;
+		const std::vector<size_t> *bounds;
+		const Columns *columns;
+		const std::vector<Segment> *segments;
+		const TrackingOptions *options;
+		std::vector<ChunkResult> *results;
+		std::atomic<size_t> *nextChunk;
+
+		void operator()() const
+		{
+			size_t chunk;
+			while ((chunk = nextChunk->fetch_add(1)) < results->size())
+			{
+				parse((*bounds)[chunk], (*bounds)[chunk + 1], (*results)[chunk]);
+			}
+		}
+
+		void parse(size_t begin, size_t end, ChunkResult &result) const
+		{
+			ChunkSamples samples = { this, &result, {0} };
+			forEachLine(csv, begin, end, samples);
+		}
+
+		struct ChunkSamples
+		{
+			const ChunkParser *parser;
+			ChunkResult *result;
+			size_t cursor[NCHANNELS];
+
+			void operator()(const char *line, const char *lineEnd)
+			{
+				result->rows++;
+				parser->sample(line, lineEnd, cursor, *result);
+			}
+		};
+
+		void sample(const char *line, const char *lineEnd, size_t (&cursor)[NCHANNELS], ChunkResult &result) const
+		{
+			Row row;
+			int chan;
+			if (!parseRow(*columns, line, lineEnd, row, chan))
+			{
+				result.skipped++;
+				return;
+			}
+			if (row.polled == 0.0)
+			{
+				return;
+			}
+			// the ADC reads the magnitude, the direction of the reply signs it.
+			double sensed((row.dir == 0.0) ? -fabs(row.sensed) : row.sensed);
+			double timeMs(row.time * 1.0e3 + options->offsetMs);
+
+			const std::vector<Segment> &channelSegments(segments[chan - 1]);
+			size_t index(findSegment(channelSegments, cursor[chan - 1], timeMs));
+			cursor[chan - 1] = index;
+			const Segment &segment(channelSegments[index]);
+			double error(sensed - segment.milliAmp);
+			double absError(fabs(error));
+
+			result.samples++;
+			result.firstMs = std::min(result.firstMs, timeMs);
+			result.lastMs = std::max(result.lastMs, timeMs);
+			ErrorSum &errors(result.errors[chan - 1]);
+			errors.samples++;
+			errors.sum += error;
+			errors.sumSq += error * error;
+			if (absError > errors.maxAbs)
+			{
+				errors.maxAbs = absError;
+				errors.maxAbsMs = timeMs;
+			}
+
+			if (!segment.step)
+			{
+				return;
+			}
+			StepSum &step(stepFor(result.steps[chan - 1], index));
+			double size(segment.milliAmp - segment.fromMa);
+			double band(std::max(options->bandFraction * fabs(size), options->bandMa));
+			double midpoint(0.5 * (segment.milliAmp + segment.fromMa));
+			step.samples++;
+			step.firstMs = std::min(step.firstMs, timeMs);
+			step.lastMs = std::max(step.lastMs, timeMs);
+			step.maxAbs = std::max(step.maxAbs, absError);
+			if (absError > band)
+			{
+				step.lastOutMs = std::max(step.lastOutMs, timeMs);
+			}
+			if ((size > 0.0) ? (sensed >= midpoint) : (sensed <= midpoint))
+			{
+				step.crossMs = std::min(step.crossMs, timeMs);
+			}
+		}
+	};
+
+	// merges the chunk sums of a channel and fills its report.
+	struct ChannelFinisher
+	{
+		int chan;
+		const std::vector<ChunkResult> *results;
+		const std::vector<Segment> *segments;
+		ChannelTracking *tracking;
+		std::vector<StepTracking> *steps;
+
+		void operator()() const
+		{
+			ErrorSum errors;
+			std::vector<StepSum> sums;
+			for (size_t chunk(0); chunk < results->size(); chunk++)
+			{
+				const ChunkResult &result((*results)[chunk]);
+				const ErrorSum &partial(result.errors[chan - 1]);
+				errors.samples += partial.samples;
+				errors.sum += partial.sum;
+				errors.sumSq += partial.sumSq;
+				if (partial.maxAbs > errors.maxAbs)
+				{
+					errors.maxAbs = partial.maxAbs;
+					errors.maxAbsMs = partial.maxAbsMs;
+				}
+				const std::vector<StepSum> &partialSteps(result.steps[chan - 1]);
+				for (size_t index(0); index < partialSteps.size(); index++)
+				{
+					stepFor(sums, partialSteps[index].segment).merge(partialSteps[index]);
+				}
+			}
+
+			ChannelTracking &channel(*tracking);
+			channel.channel = chan;
+			channel.samples = errors.samples;
+			if (errors.samples > 0)
+			{
+				channel.meanErrorMa = errors.sum / errors.samples;
+				channel.rmsErrorMa = sqrt(errors.sumSq / errors.samples);
+				channel.maxErrorMa = errors.maxAbs;
+				channel.maxErrorMs = errors.maxAbsMs;
+			}
+
+			// every step is reported, the ones without samples too.
+			std::vector<double> lags;
+			double settleSum(0.0), lagSum(0.0);
+			size_t sum(0);
+			for (size_t index(0); index < segments->size(); index++)
+			{
+				const Segment &segment((*segments)[index]);
+				if (!segment.step)
+				{
+					continue;
+				}
+				StepTracking step;
+				step.channel = chan;
+				step.set = segment.set;
+				step.startMs = segment.startMs;
+				step.driftMs = segment.driftMs;
+				step.anchored = segment.anchored;
+				step.fromMa = segment.fromMa;
+				step.toMa = segment.milliAmp;
+				for (; sum < sums.size() && sums[sum].segment < index; sum++)
+				{
+				}
+				if (sum < sums.size() && sums[sum].segment == index)
+				{
+					const StepSum &stepSum(sums[sum]);
+					step.samples = stepSum.samples;
+					step.maxErrorMa = stepSum.maxAbs;
+					if (stepSum.lastOutMs < stepSum.lastMs)
+					{
+						step.settleMs = std::max(stepSum.lastOutMs - segment.startMs, 0.0);
+						channel.settledSteps++;
+						settleSum += step.settleMs;
+						channel.maxSettleMs = std::max(channel.maxSettleMs, step.settleMs);
+					}
+					if (stepSum.crossMs < infinity)
+					{
+						step.lagMs = std::max(stepSum.crossMs - segment.startMs, 0.0);
+						lags.push_back(step.lagMs);
+						lagSum += step.lagMs;
+						channel.maxLagMs = std::max(channel.maxLagMs, step.lagMs);
+					}
+				}
+				channel.steps++;
+				steps->push_back(step);
+			}
+			if (channel.settledSteps > 0)
+			{
+				channel.meanSettleMs = settleSum / channel.settledSteps;
+			}
+			channel.lagSteps = lags.size();
+			if (!lags.empty())
+			{
+				channel.meanLagMs = lagSum / lags.size();
+				std::nth_element(lags.begin(), lags.begin() + lags.size() / 2, lags.end());
+				channel.medianLagMs = lags[lags.size() / 2];
+			}
+		}
+	};
+}
+
+bool analyzeTracking(const CatheterCmdSequence &cmdSequence, const char *csv, size_t length,
+	const TrackingOptions &options, TrackingReport &report)
+{
+	report = TrackingReport();
+	const char *headerEnd(static_cast<const char*> (memchr(csv, '\n', length)));
+	headerEnd = (headerEnd != NULL) ? headerEnd : csv + length;
+	Columns columns;
+	if (!parseHeader(csv, headerEnd, columns))
+	{
+		return false;
+	}
+
+	std::vector<Segment> segments[NCHANNELS];
+	buildReference(cmdSequence, options, segments);
+
+	// chunk i holds the lines that start in [bounds[i], bounds[i + 1]).
+	size_t dataStart(std::min<size_t>(headerEnd - csv + 1, length));
+	size_t chunkBytes(std::max<size_t>(options.chunkBytes, 1));
+	std::vector<size_t> bounds(1, dataStart);
+	while (bounds.back() < length)
+	{
+		size_t next(bounds.back() + chunkBytes);
+		if (next >= length)
+		{
+			bounds.push_back(length);
+			break;
+		}
+		const char *newline(static_cast<const char*> (memchr(csv + next - 1, '\n', length - next + 1)));
+		bounds.push_back((newline != NULL) ? static_cast<size_t> (newline - csv + 1) : length);
+	}
+	std::vector<ChunkResult> results(bounds.size() - 1);
+
+	unsigned int threads(options.threads > 0 ? options.threads : boost::thread::hardware_concurrency());
+	threads = static_cast<unsigned int> (std::max<size_t>(std::min<size_t>(std::max(threads, 1u), results.size()), 1));
+
+	// the steps start when the board took them, not when the schedule says (a first pass over the chunks).
+	if (options.anchorSteps && columns.setMa >= 0)
+	{
+		std::vector<ChunkChanges> changes(results.size());
+		std::atomic<size_t> nextScan(0);
+		ChangeScanner scanner = { csv, &bounds, &columns, &options, &changes, &nextScan };
+		runWorkers(scanner, threads);
+		anchorReference(changes, segments);
+		report.anchored = true;
+	}
+
+	std::atomic<size_t> nextChunk(0);
+	ChunkParser parser = { csv, &bounds, &columns, segments, &options, &results, &nextChunk };
+	runWorkers(parser, threads);
+
+	report.threads = threads;
+	report.chunks = results.size();
+	double firstMs(infinity), lastMs(-infinity);
+	for (size_t chunk(0); chunk < results.size(); chunk++)
+	{
+		report.rows += results[chunk].rows;
+		report.samples += results[chunk].samples;
+		report.skippedRows += results[chunk].skipped;
+		firstMs = std::min(firstMs, results[chunk].firstMs);
+		lastMs = std::max(lastMs, results[chunk].lastMs);
+	}
+	if (report.samples > 0)
+	{
+		report.firstMs = firstMs;
+		report.lastMs = lastMs;
+	}
+
+	report.channels.resize(NCHANNELS);
+	std::vector<StepTracking> steps[NCHANNELS];
+	boost::thread_group finishers;
+	for (int chan(1); chan <= NCHANNELS; chan++)
+	{
+		ChannelFinisher finisher = { chan, &results, &segments[chan - 1], &report.channels[chan - 1], &steps[chan - 1] };
+		if (threads == 1)
+		{
+			finisher();
+		}
+		else
+		{
+			finishers.create_thread(finisher);
+		}
+	}
+	finishers.join_all();
+	for (int chan(0); chan < NCHANNELS; chan++)
+	{
+		report.steps.insert(report.steps.end(), steps[chan].begin(), steps[chan].end());
+	}
+	for (size_t index(0); index < report.steps.size(); index++)
+	{
+		if (report.steps[index].anchored)
+		{
+			report.anchoredSteps++;
+			report.maxDriftMs = std::max(report.maxDriftMs, fabs(report.steps[index].driftMs));
+		}
+	}
+	return true;
+}
+
+int analyzeTrackingFile(const CatheterCmdSequence &cmdSequence, const char *fname, const TrackingOptions &options,
+	TrackingReport &report)
+{
+#ifdef _WIN32
+	std::ifstream inFile(fname, std::ios::binary);
+	if (!inFile.is_open())
+	{
+		return -1;
+	}
+	std::vector<char> csv((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+	if (csv.empty())
+	{
+		return -1;
+	}
+	return analyzeTracking(cmdSequence, csv.data(), csv.size(), options, report) ? 0 : -2;
+#else
+	int file(::open(fname, O_RDONLY));
+	if (file < 0)
+	{
+		return -1;
+	}
+	struct stat info;
+	void *map(MAP_FAILED);
+	if (fstat(file, &info) == 0 && info.st_size > 0)
+	{
+		map = mmap(NULL, static_cast<size_t> (info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	}
+	::close(file);
+	if (map == MAP_FAILED)
+	{
+		return -1;
+	}
+	// the chunks are read front to back, each by its own thread.
+	madvise(map, static_cast<size_t> (info.st_size), MADV_WILLNEED);
+	bool parsed(analyzeTracking(cmdSequence, static_cast<const char*> (map), static_cast<size_t> (info.st_size),
+		options, report));
+	munmap(map, static_cast<size_t> (info.st_size));
+	return parsed ? 0 : -2;
+#endif
+}
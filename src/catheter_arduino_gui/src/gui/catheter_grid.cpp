@@ -1,4 +1,3 @@
-
 #include <wx/wx.h>
 
 
@@ -31,321 +30,210 @@
 #endif  // _DEBUG
 #endif  // __MSC_VER
 
-#define CHANNEL_COL 0
-#define CURRENT_COL 1
-#define DIRECTION_COL 2
-#define DELAY_COL 3
-
-#define MAX_DELAY 50000
-
-#define NFIELDS 4
-#define NROWS_DEFAULT 1//NCHANNELS
-
 // file definitions
 #define playfile_wildcard wxT("*.play")
 #define portfile wxT("ports.txt")
 
-// cell choice string definitions
-#define DIRNEGSTR wxT("neg")
-#define DIRPOSSTR wxT("pos")
-#define GLOBALSTR wxT("global")
-
-wxBEGIN_EVENT_TABLE(CatheterGrid, wxGrid)
-    EVT_GRID_CELL_CHANGING(CatheterGrid::OnGridCellChanging)
-wxEND_EVENT_TABLE()
+/////////////////////////
+// grid table methods  //
+/////////////////////////
 
-CatheterGrid::CatheterGrid(wxPanel* parentPanel) :
-    wxGrid(parentPanel, wxID_ANY)
+CatheterGridTable::CatheterGridTable() : wxGridTableBase(), model()
 {
+    const wxString direction_opts[] = { wxString(DIRNEGSTR), wxString(DIRPOSSTR) };
 
-    this->CreateGrid(0, 0);
-	this->SetMargins(0,0);
-    this->EnableDragGridSize(true);
-
-    this->AppendCols(NFIELDS);
-    this->AppendRows(NROWS_DEFAULT);
-
-    formatDefaultGrid(NROWS_DEFAULT);
+    wxString channel_opts[NCHANNELS + 1];
+    channel_opts[0] = wxString(GLOBALSTR);
+    for (int i = 1; i <= NCHANNELS; i++)
+        channel_opts[i] = wxString::Format("%d", i);
 
-    cmdCount = 0;
+	for (int col(0); col < NFIELDS; col++)
+	{
+		editableAttr[col] = new wxGridCellAttr;
+		readOnlyAttr[col] = new wxGridCellAttr;
+		readOnlyAttr[col]->SetReadOnly(true);
+	}
+
+	// the attributes own the editors and renderers (the read only ones share them).
+	editableAttr[CHANNEL_COL]->SetEditor(new wxGridCellChoiceEditor(WXSIZEOF(channel_opts), (const wxString*)channel_opts));
+	editableAttr[CURRENT_COL]->SetEditor(new wxGridCellFloatEditor(3, 3));
+	editableAttr[CURRENT_COL]->SetRenderer(new wxGridCellFloatRenderer());
+	editableAttr[DIRECTION_COL]->SetEditor(new wxGridCellChoiceEditor(WXSIZEOF(direction_opts), direction_opts));
+	editableAttr[DELAY_COL]->SetEditor(new wxGridCellNumberEditor(0, MAX_DELAY));
+	editableAttr[DELAY_COL]->SetRenderer(new wxGridCellNumberRenderer());
+
+	for (int col(0); col < NFIELDS; col++)
+	{
+		if (editableAttr[col]->HasEditor())
+		{
+			readOnlyAttr[col]->SetEditor(editableAttr[col]->GetEditor(0, 0, col));
+		}
+		if (editableAttr[col]->HasRenderer())
+		{
+			readOnlyAttr[col]->SetRenderer(editableAttr[col]->GetRenderer(0, 0, col));
+		}
+	}
 }
 
-CatheterGrid::~CatheterGrid()
+CatheterGridTable::~CatheterGridTable()
 {
-	bool(true);
+	for (int col(0); col < NFIELDS; col++)
+	{
+		editableAttr[col]->DecRef();
+		readOnlyAttr[col]->DecRef();
+	}
 }
 
-///////////////////////////
-// event handler methods //
-///////////////////////////
-
-void CatheterGrid::OnGridCellChanging(wxGridEvent& e)
+int CatheterGridTable::GetNumberRows()
 {
-    // called when edited cell loses focus
-    // last value: GetCellValue(row, col)
-    // pending value: e.GetString()
-
-    int row = e.GetRow();
-    int col = e.GetCol();
-
-    switch (col)
-    {
-    case CHANNEL_COL:
-        // setGridRowChannel(row, wxAtoi(e.GetString()));
-        setGridRowChannel(row, e.GetString());
-        break;
-    case CURRENT_COL:
-        setGridRowcurrentMilliAmp(row, wxAtof(e.GetString()));
-        break;
-    case DIRECTION_COL:
-        setGridRowDirection(row, (wxStrcmp(DIRPOSSTR, e.GetString()) ? DIR_NEG : DIR_POS));
-        break;
-    case DELAY_COL:
-        setGridRowDelayMS(row, wxAtoi(e.GetString()));
-        break;
-    }
-
-    if (row == cmdCount && isGridRowComplete(row)) {
-        cmdCount++;
-        if (cmdCount < GetNumberRows())
-            setRowReadOnly(cmdCount, false);
-        else
-            addGridRow(false);
-        // wxMessageBox(wxString::Format("completed command %d", cmdCount));
-    }
-
-    e.Skip();
+	return static_cast<int> (model.rowCount());
 }
 
-////////////////////
-// public methods //
-////////////////////
-
-void CatheterGrid::GetCommands(std::vector<CatheterChannelCmdSet>& cmds)
+int CatheterGridTable::GetNumberCols()
 {
-    cmds.clear();
-	CatheterChannelCmdSet newSet;
-    for (int i = 0; i < cmdCount; i++) {
-		CatheterChannelCmd newCmd;
-        long delayTime(parseGridRow(i,newCmd));
-		newSet.commandList.push_back(newCmd);
-		// advance the commands when necessary.
-		if(delayTime > 0)
-		{
-			newSet.delayTime = delayTime;
-			cmds.push_back(newSet);
-			newSet.commandList.clear();
-			newSet.delayTime = 0;
-		}
-    }
+	return NFIELDS;
 }
 
-void CatheterGrid::SetCommands(const std::vector<CatheterChannelCmdSet>& cmds)
+bool CatheterGridTable::IsEmptyCell(int row, int col)
 {
-    resetDefaultGrid(NROWS_DEFAULT);
-	int rowIndex(0);
-    for (int i = 0; i < cmds.size(); i++) {
-        
-		for( int j(0); j < cmds[i].commandList.size(); j++)
-		{
-			cmdCount++;
-			if (rowIndex >= GetNumberRows()) addGridRow(false);
-			setGridRowChannel(rowIndex, cmds[i].commandList[j].channel);
-			setGridRowcurrentMilliAmp(rowIndex, cmds[i].commandList[j].currentMilliAmp);
-			
-			if ( j + 1 <  cmds[i].commandList.size())
-			{
-				rowIndex++;
-			}
-		}
-		setGridRowDelayMS(rowIndex,cmds[i].delayTime);
-		rowIndex++;
-    }
-	// add the blank row
-    addGridRow(false);
+	return model.isCellEmpty(row, col);
 }
 
-void CatheterGrid::ResetDefault() {
-    resetDefaultGrid(NROWS_DEFAULT);
+wxString CatheterGridTable::GetValue(int row, int col)
+{
+	return wxString(model.cellText(row, col));
 }
 
-//////////////////////////////////
-// command grid private methods //
-//////////////////////////////////
-
-void CatheterGrid::setGridRowChannel(int row, int channel) {
-    if (isGridRowNumValid(row)) {
-        if (channel > 0 && channel <= NCHANNELS) {
-            SetCellValue(wxGridCellCoords(row, CHANNEL_COL), wxString::Format("%d", channel));
-        } else if (channel == GLOBAL_ADDR) {
-            SetCellValue(wxGridCellCoords(row, CHANNEL_COL), GLOBALSTR);
-        }
-    }
+void CatheterGridTable::SetValue(int row, int col, const wxString& value)
+{
+	model.setCellText(row, col, std::string(value.mb_str()));
 }
 
-void CatheterGrid::setGridRowChannel(int row, const wxString& channel) {
-    if (isGridRowNumValid(row)) {
-        SetCellValue(wxGridCellCoords(row, CHANNEL_COL), channel);
-    }
+wxString CatheterGridTable::GetColLabelValue(int col)
+{
+	switch (col)
+	{
+	case CHANNEL_COL:
+		return wxT("Channel");
+	case CURRENT_COL:
+		return wxT("Current (mA)");
+	case DIRECTION_COL:
+		return wxT("Direction");
+	case DELAY_COL:
+		return wxT("Delay (ms)");
+	}
+	return wxEmptyString;
+}
+
+bool CatheterGridTable::CanHaveAttributes()
+{
+	return true;
 }
 
-void CatheterGrid::setGridRowcurrentMilliAmp(int row, double currentMilliAmp) {
-    if (isGridRowNumValid(row)) {
-        SetCellValue(wxGridCellCoords(row, CURRENT_COL), wxString::Format("%3.3f", currentMilliAmp));
-        if (currentMilliAmp > 0)
-            setGridRowDirection(row, DIR_POS);
-        else if (currentMilliAmp < 0)
-            setGridRowDirection(row, DIR_NEG);
-    }
+wxGridCellAttr* CatheterGridTable::GetAttr(int row, int col, wxGridCellAttr::wxAttrKind kind)
+{
+	if (col < 0 || col >= NFIELDS)
+	{
+		return NULL;
+	}
+	wxGridCellAttr *attr(model.isRowEditable(row) ? editableAttr[col] : readOnlyAttr[col]);
+	// the caller releases its reference.
+	attr->IncRef();
+	return attr;
 }
 
-void CatheterGrid::setGridRowDirection(int row, dir_t direction) {
-    if (isGridRowNumValid(row)) {
-        switch (direction) {
-        case DIR_POS:
-            SetCellValue(wxGridCellCoords(row, DIRECTION_COL), DIRPOSSTR);
-            if (!isGridCellEmpty(row, CURRENT_COL) && getGridRowcurrentMilliAmp(row) < 0)
-                setGridRowcurrentMilliAmp(row, getGridRowcurrentMilliAmp(row) * -1);
-            break;
-        case DIR_NEG:
-            SetCellValue(wxGridCellCoords(row, DIRECTION_COL), DIRNEGSTR);
-            if (!isGridCellEmpty(row, CURRENT_COL) && getGridRowcurrentMilliAmp(row) > 0)
-                setGridRowcurrentMilliAmp(row, getGridRowcurrentMilliAmp(row) * -1);
-            break;
-        }
-    }
+CommandGridModel& CatheterGridTable::getModel()
+{
+	return model;
 }
 
-void CatheterGrid::setGridRowDelayMS(int row, int delayMS) {
-    if (isGridRowNumValid(row)) {
-        if (delayMS >= 0) {
-            SetCellValue(wxGridCellCoords(row, DELAY_COL), wxString::Format("%d", delayMS));
-        }
-    }
-}
 
-int CatheterGrid::getGridRowChannel(int row) {
-    const wxString& channel = GetCellValue(wxGridCellCoords(row, CHANNEL_COL));
-    if (!wxStrcmp(channel, "global"))
-        return GLOBAL_ADDR;
-    else
-        return wxAtoi(channel);
-}
+wxBEGIN_EVENT_TABLE(CatheterGrid, wxGrid)
+    EVT_GRID_CELL_CHANGED(CatheterGrid::OnGridCellChanged)
+wxEND_EVENT_TABLE()
 
-double CatheterGrid::getGridRowcurrentMilliAmp(int row) {
-    return wxAtof(GetCellValue(wxGridCellCoords(row, CURRENT_COL)));
+CatheterGrid::CatheterGrid(wxPanel* parentPanel) :
+    wxGrid(parentPanel, wxID_ANY), edited(false)
+{
+	table = new CatheterGridTable;
+	// the grid owns the table.
+    this->SetTable(table, true);
+	this->SetMargins(0,0);
+    this->EnableDragGridSize(true);
 }
 
-dir_t CatheterGrid::getGridRowDirection(int row) {
-    const wxString& dirStr = GetCellValue(wxGridCellCoords(row, DIRECTION_COL));
-    if (!wxStrcmp(dirStr, DIRPOSSTR)) {
-        return DIR_POS;
-    } else {
-        return DIR_NEG;
-    }
+CatheterGrid::~CatheterGrid()
+{
 }
 
-int CatheterGrid::getGridRowDelayMS(int row) {
-    return wxAtoi(GetCellValue(wxGridCellCoords(row, DELAY_COL)));
-}
+///////////////////////////
+// event handler methods //
+///////////////////////////
 
-long CatheterGrid::parseGridRow(int row, CatheterChannelCmd& c)
+void CatheterGrid::OnGridCellChanged(wxGridEvent& e)
 {
-    c.channel = getGridRowChannel(row);
-    c.currentMilliAmp = getGridRowcurrentMilliAmp(row);
-    // @TODO add the poll entry...
-	c.poll = false;  
-    return getGridRowDelayMS(row);
-}
-
-bool CatheterGrid::isGridRowNumValid(int row) {
-    return (row < GetNumberRows() && !IsReadOnly(row, 0));
-}
-bool CatheterGrid::isGridCellEmpty(int row, int col) {
-    return GetTable()->IsEmptyCell(row, col);
-    //return GetCellValue(row, col).IsEmpty();
+    // called after the table has the new value.
+    // An edit can change the other cells of the row (current sign and direction)
+    // and completing the last row adds a new one.
+    edited = true;
+    syncRows();
+    e.Skip();
 }
 
-bool CatheterGrid::isGridRowComplete(int row) {
-    bool row_complete = isGridRowNumValid(row);
-    if (row_complete) {
-        for (int i = 0; i < NFIELDS; i++) {
-            if (isGridCellEmpty(row, i)) {
-                row_complete = false;
-                break;
-            }
-        }
-    }
-    return row_complete;
-}
+////////////////////
+// public methods //
+////////////////////
 
-void CatheterGrid::addGridRow(bool readOnly) {
-    AppendRows(1);
-    formatDefaultRow(GetNumberRows() - 1);
-    setRowReadOnly(GetNumberRows() - 1, readOnly);
+void CatheterGrid::GetCommands(std::vector<CatheterChannelCmdSet>& cmds)
+{
+	table->getModel().getCommands(cmds);
 }
 
-void CatheterGrid::formatDefaultGrid(int nrows) {
-    SetColLabelValue(CHANNEL_COL, wxT("Channel"));
-    SetColLabelValue(CURRENT_COL, wxT("Current (mA)"));
-    SetColLabelValue(DIRECTION_COL, wxT("Direction"));
-    SetColLabelValue(DELAY_COL, wxT("Delay (ms)"));
-    //HideRowLabels();
-
-    SetColFormatNumber(CHANNEL_COL); //channel address
-    SetColFormatFloat(CURRENT_COL); // MA current
-                                          //default is String for Direction
-    SetColFormatNumber(DELAY_COL); //delay
-
-    for (int i = 0; i < nrows; i++)
-        formatDefaultRow(i);
-
-    setRowReadOnly(0, false);
+void CatheterGrid::SetCommands(const std::vector<CatheterChannelCmdSet>& cmds)
+{
+	table->getModel().setCommands(cmds);
+	edited = false;
+	syncRows();
 }
 
-void CatheterGrid::resetDefaultGrid(int nrows) {
-    cmdCount = 0;
-
-    DeleteRows(0, GetNumberRows());
-    for (int i = 0; i < nrows; i++)
-        addGridRow(true);
-
-    formatDefaultGrid(nrows);
-
-    setRowReadOnly(0, false);
+void CatheterGrid::SwapModel(CommandGridModel& model)
+{
+	table->getModel().swap(model);
+	edited = false;
+	syncRows();
 }
 
-void CatheterGrid::setRowReadOnly(int row, bool readOnly) {
-    if (row >= GetNumberRows())
-        return;
-    SetReadOnly(row, CHANNEL_COL, readOnly);
-    SetReadOnly(row, CURRENT_COL, readOnly);
-    SetReadOnly(row, DIRECTION_COL, readOnly);
-    SetReadOnly(row, DELAY_COL, readOnly);
+void CatheterGrid::ResetDefault() {
+	table->getModel().reset();
+	edited = false;
+	syncRows();
 }
 
-void CatheterGrid::formatDefaultRow(int row) {
-    if (row >= GetNumberRows())
-        return;
-    const wxString direction_opts[] = { DIRNEGSTR, DIRPOSSTR };
-
-    wxString channel_opts[NCHANNELS + 1];
-    channel_opts[0] = GLOBALSTR;
-    for (int i = 1; i <= NCHANNELS; i++)
-        channel_opts[i] = wxString::Format("%d", i);
-
-    SetCellEditor(row, CHANNEL_COL, new wxGridCellChoiceEditor(WXSIZEOF(channel_opts), (const wxString*)channel_opts));
-    SetCellEditor(row, CURRENT_COL, new wxGridCellFloatEditor(3, 3));
-    SetCellRenderer(row, CURRENT_COL, new wxGridCellFloatRenderer());
-    SetCellEditor(row, DIRECTION_COL, new wxGridCellChoiceEditor(WXSIZEOF(direction_opts), direction_opts));
-    SetCellEditor(row, DELAY_COL, new wxGridCellNumberEditor(0, MAX_DELAY));
-    SetCellRenderer(row, DELAY_COL, new wxGridCellNumberRenderer());
-	SetCellValue(row, DELAY_COL, wxT("0"));
-    setRowReadOnly(row, true);
+bool CatheterGrid::IsEdited() const
+{
+	return edited;
 }
 
+//////////////////////////////////
+// command grid private methods //
+//////////////////////////////////
 
-void CatheterGrid::RecalculateGridSize(int rows)
+void CatheterGrid::syncRows()
 {
-  this->GetMinHeight();  
-}
\ No newline at end of file
+	int gridRows(GetNumberRows());
+	int modelRows(table->GetNumberRows());
+
+	BeginBatch();
+	if (modelRows < gridRows)
+	{
+		wxGridTableMessage msg(table, wxGRIDTABLE_NOTIFY_ROWS_DELETED, modelRows, gridRows - modelRows);
+		ProcessTableMessage(msg);
+	}
+	else if (modelRows > gridRows)
+	{
+		wxGridTableMessage msg(table, wxGRIDTABLE_NOTIFY_ROWS_APPENDED, modelRows - gridRows);
+		ProcessTableMessage(msg);
+	}
+	EndBatch();
+	ForceRefresh();
+}
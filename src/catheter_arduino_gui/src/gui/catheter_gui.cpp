@@ -1,6 +1,13 @@
 #include "gui/catheter_gui.h"
 #include "com/pc_utils.h"
+#include "com/link_budget.h"
 #include "ser/serial_thread.h"
+#include "hardware/digital_analog_conversions.h"
+#include "util/link_log.h"
+#include "util/trace.h"
+#ifndef _WIN32
+#include "ipc/ipc_server.h"
+#endif
 #include <wx/wfstream.h>
 #include <wx/numdlg.h>
 
@@ -18,6 +25,22 @@
 
 // file definitions
 #define playfile_wildcard wxT("*.play")
+#define calibration_file "catheter_calibration.cal"
+
+// console messages per second accepted from the serial thread (errors always pass)
+#define CONSOLE_RATE_LIMIT 200
+
+// sets shown in the grid while the rest of a playfile loads
+#define PREVIEW_SETS 256
+
+// resolution of the load progress gauge
+#define LOAD_GAUGE_RANGE 1000
+
+// samples buffered between refreshes (~2.7 s of 1 kHz on every channel)
+#define PLOT_RING_SAMPLES 16384
+
+// minimum time between status refreshes (caps the refresh rate at ~30 Hz)
+#define STATUS_REFRESH_MS 33
 
 #define CATHETER_GUI_DEBUG 1
 #define DBG(do_something) if (CATHETER_GUI_DEBUG) { do_something; }
@@ -33,15 +56,53 @@ bool CatheterGuiApp::OnInit() {
 	_CrtSetReportMode( _CRT_ERROR, _CRTDBG_MODE_DEBUG );
     #endif
 
-	serialObject = new SerialThreadObject;
+	// a trace of the session is written at exit when CATHETER_TRACE_FILE is set.
+	if (getenv("CATHETER_TRACE_FILE") != NULL)
+	{
+		CATHETER_TRACE_THREAD_NAME("gui");
+		traceEnable(true);
+	}
+
+	// catheter_stat reads the metrics from outside the gui.
+	metrics = new MetricsRegistry(METRICS_DEFAULT_NAME);
+	serialObject = new SerialThreadObject(metrics);
+
+	// every session records its link traffic (CATHETER_LINK_LOG names the file).
+	linkRecorder = new LinkRecorder;
+	bool linkLogOpen((getenv("CATHETER_LINK_LOG") != NULL) ? linkRecorder->open(getenv("CATHETER_LINK_LOG"), "catheter_gui")
+		: linkRecorder->openUnique(linkLogDefaultName("catheter_gui"), "catheter_gui"));
+	if (linkLogOpen)
+	{
+		serialObject->setLinkRecorder(linkRecorder);
+	}
     gui = new CatheterGuiFrame(wxT("Catheter Gui"),serialObject);
     gui->Show(true);
+
+	ipcServer = NULL;
+#ifndef _WIN32
+	// a second gui (or catheter_server) keeps the socket, this one then only has the buttons.
+	ipcServer = new IpcServer(*serialObject);
+	if (!ipcServer->start())
+	{
+		delete ipcServer;
+		ipcServer = NULL;
+	}
+#endif
     return (gui != NULL);
 }
 
 int CatheterGuiApp::OnExit()
 {
+#ifndef _WIN32
+	delete ipcServer;
+#endif
 	delete serialObject;
+	delete linkRecorder;
+	delete metrics;
+	if (getenv("CATHETER_TRACE_FILE") != NULL)
+	{
+		traceWriteJson(getenv("CATHETER_TRACE_FILE"));
+	}
 	return 0;
 }
 
@@ -53,24 +114,132 @@ wxBEGIN_EVENT_TABLE(CatheterGuiFrame, wxFrame)
     EVT_BUTTON(CatheterGuiFrame::ID_SEND_COMMANDS_BUTTON, CatheterGuiFrame::OnSendCommandsButtonClicked)
     EVT_BUTTON(CatheterGuiFrame::ID_SEND_RESET_BUTTON, CatheterGuiFrame::OnSendResetButtonClicked)
 	EVT_BUTTON(CatheterGuiFrame::ID_SEND_POLL_BUTTON, CatheterGuiFrame::OnSendPollButtonClicked)
-	EVT_IDLE(CatheterGuiFrame::onIdle)
+	EVT_THREAD(CatheterGuiFrame::ID_STATUS_UPDATE, CatheterGuiFrame::onStatusUpdate)
+	EVT_TIMER(CatheterGuiFrame::ID_REFRESH_TIMER, CatheterGuiFrame::onRefreshTimer)
+	EVT_BUTTON(CatheterGuiFrame::ID_CANCEL_LOAD_BUTTON, CatheterGuiFrame::OnCancelLoadButtonClicked)
+	EVT_THREAD(CatheterGuiFrame::ID_LOAD_PROGRESS, CatheterGuiFrame::onLoadProgress)
+	EVT_THREAD(CatheterGuiFrame::ID_LOAD_FINISHED, CatheterGuiFrame::onLoadFinished)
 wxEND_EVENT_TABLE()
 
 
-void CatheterGuiFrame::onIdle(wxIdleEvent & e)
+void CatheterGuiFrame::onStatusUpdate(wxThreadEvent & e)
 {
-	bool update(false);
-	update |= this->statusGridPtr->updateStatus(statusGridCmdPtr);
-	update |= this->statusText->addText(statusTextData);
-	if (update)
+	if (refreshTimer.IsRunning())
 	{
-		this->Refresh();
+		return;  // the timer will pick this up.
 	}
-	e.RequestMore();
+	long elapsed(sinceRefresh.Time());
+	if (elapsed < STATUS_REFRESH_MS)
+	{
+		refreshTimer.StartOnce(STATUS_REFRESH_MS - elapsed);
+		return;
+	}
+	refreshStatus();
+}
+
+void CatheterGuiFrame::onRefreshTimer(wxTimerEvent & e)
+{
+	refreshStatus();
+}
+
+void CatheterGuiFrame::onLoadProgress(wxThreadEvent & e)
+{
+	if (playfileLoader->getState() != PlayfileLoader::loading)
+	{
+		return;  // a stale event, the finished event handles the rest.
+	}
+	loadGauge->SetValue(static_cast<int> (playfileLoader->getProgress() * LOAD_GAUGE_RANGE));
+
+	// show the head of the file so that it can be inspected.
+	if (!previewShown && playfileLoader->setsLoaded() > 0)
+	{
+		std::vector<CatheterChannelCmdSet> headSets;
+		playfileLoader->copySets(0, PREVIEW_SETS, headSets);
+		grid->SetCommands(headSets);
+		previewShown = true;
+	}
+	if (streamToSerial)
+	{
+		streamLoadedSets();
+	}
+}
+
+void CatheterGuiFrame::onLoadFinished(wxThreadEvent & e)
+{
+	PlayfileLoader::LoadState state(playfileLoader->getState());
+	if (state == PlayfileLoader::loading || state == PlayfileLoader::idle)
+	{
+		return;  // left over from a load that was replaced.
+	}
+	if (state == PlayfileLoader::failed)
+	{
+		setStatusText(wxString::Format(wxT("Could not read Playfile %s"), playfilePath), logError);
+	}
+	else
+	{
+		if (streamToSerial)
+		{
+			streamLoadedSets();
+		}
+		CommandGridModel model;
+		CatheterCmdSequence loadedSets;
+		// edits made to the preview while the file loaded are not thrown away without asking.
+		bool replace(true);
+		if (previewShown && grid->IsEdited())
+		{
+			replace = wxMessageBox(wxT("The preview was edited while the Playfile loaded. Replace the edits with the whole Playfile?"),
+				wxT("Warning!"), wxICON_QUESTION | wxYES_NO, this) == wxYES;
+		}
+		if (!replace)
+		{
+			playfileLoader->discard();
+			setStatusText(wxT("Kept the edited preview, the rest of the Playfile was not loaded"), logWarning);
+		}
+		else if (playfileLoader->takeResult(model, loadedSets))
+		{
+			// the whole model is swapped in at once.
+			grid->SwapModel(model);
+			if (state == PlayfileLoader::cancelled)
+			{
+				setStatusText(wxString::Format(wxT("Playfile load cancelled after %d sets"), (int)(loadedSets.size())), logWarning);
+			}
+			else
+			{
+				setStatusText(wxString::Format(wxT("Loaded %d sets from Playfile"), (int)(loadedSets.size())));
+				warnLinkBudget(loadedSets);
+			}
+		}
+	}
+	streamToSerial = false;
+	loadGauge->SetValue(LOAD_GAUGE_RANGE);
+	cancelLoadButton->Enable(false);
+}
+
+void CatheterGuiFrame::warnLinkBudget(const CatheterCmdSequence &cmdSequence)
+{
+	LinkBudgetOptions options;
+	LinkBudgetReport report(analyzeLinkBudget(cmdSequence, options));
+	if (report.feasible)
+	{
+		return;
+	}
+	wxString fix(report.minBaud != 0 ? wxString::Format(wxT("needs %u baud"), report.minBaud)
+		: wxString(wxT("no standard baud fits")));
+	if (report.suggestedMode != packetAsIs && report.suggestedMode != packetModeCount)
+	{
+		fix += wxString::Format(wxT(" or %s packets"), packetModeName(report.suggestedMode));
+	}
+	setStatusText(wxString::Format(wxT("Playfile falls behind at %u baud: %d sets up to %.1f ms late, ends %.1f ms late (%s)"),
+		options.baud, (int)(report.infeasibleSets), report.maxLagUs * 1.0e-3, report.finalLagUs * 1.0e-3, fix), logWarning);
+}
+
+void CatheterGuiFrame::OnCancelLoadButtonClicked(wxCommandEvent& e)
+{
+	playfileLoader->cancel();
 }
 
 CatheterGuiFrame::CatheterGuiFrame(const wxString& title, SerialThreadObject* thrdPtr) : 
-wxFrame(NULL, wxID_ANY, title)
+wxFrame(NULL, wxID_ANY, title), refreshQueued(false), refreshTimer(this, ID_REFRESH_TIMER)
 {
 
 	this->serialObject = thrdPtr;
@@ -82,13 +251,24 @@ wxFrame(NULL, wxID_ANY, title)
 	statusGridPtr = new StatusGrid(parentPanel);
     
 	statusGridCmdPtr = new statusData;
+	statusReader = new StatusReader(*statusGridCmdPtr);
+
+	// add the current plots.
+	sampleRing = new SpscRing<CurrentSample>(PLOT_RING_SAMPLES);
+	plotPanel = new CurrentPlotPanel(parentPanel, sampleRing);
+	serialObject->setSampleRing(sampleRing);
 
 	// add the status text.
-	statusText = new CatheterStatusText(parentPanel, wxID_ANY);
+	statusTextData = new ConsoleLog;
+	statusTextData->setRateLimit(CONSOLE_RATE_LIMIT);
+	statusText = new CatheterStatusText(parentPanel, wxID_ANY, statusTextData);
 
-	statusTextData = new incomingText;
+	// the serial thread notifies the gui when there is something to show.
+	statusGridCmdPtr->setNotify(boost::bind(&CatheterGuiFrame::queueStatusRefresh, this));
+	statusTextData->setNotify(boost::bind(&CatheterGuiFrame::queueStatusRefresh, this));
 	serialObject->setStatusTextPtr(statusTextData);
 	serialObject->setStatusGrid(statusGridCmdPtr);
+	serialObject->setPortSelector(boost::bind(&CatheterGuiFrame::selectSerialPort, this, _1));
     // control buttons (break this up into 2 rows)
 
     // row 1:
@@ -101,10 +281,23 @@ wxFrame(NULL, wxID_ANY, title)
     sendCommandsButton = new wxButton(parentPanel, ID_SEND_COMMANDS_BUTTON, wxT("Send Commands"));
     sendResetButton = new wxButton(parentPanel, ID_SEND_RESET_BUTTON, wxT("Send Reset"));
     refreshSerialButton = new wxButton(parentPanel, ID_REFRESH_SERIAL_BUTTON, wxT("Refresh Serial"));
+	cancelLoadButton = new wxButton(parentPanel, ID_CANCEL_LOAD_BUTTON, wxT("Cancel Load"));
+	cancelLoadButton->Enable(false);
+
+	// load progress
+	loadGauge = new wxGauge(parentPanel, wxID_ANY, LOAD_GAUGE_RANGE);
 
     playfileSaved = false;
     playfilePath = wxEmptyString;
 
+	playfileLoader = new PlayfileLoader;
+	playfileLoader->setNotify(
+		boost::bind(&CatheterGuiFrame::queueThreadEvent, this, (int)(ID_LOAD_PROGRESS)),
+		boost::bind(&CatheterGuiFrame::queueThreadEvent, this, (int)(ID_LOAD_FINISHED)));
+	previewShown = false;
+	streamToSerial = false;
+	streamedSets = 0;
+
     // add buttons to the frame
     wxFlexGridSizer* buttonBox = new wxFlexGridSizer(2, 4, wxSize(2, 2));
     buttonBox->Add(selectPlayfileButton);
@@ -114,17 +307,20 @@ wxFrame(NULL, wxID_ANY, title)
     buttonBox->Add(sendCommandsButton);
     buttonBox->Add(sendResetButton);
     buttonBox->Add(refreshSerialButton);
+	buttonBox->Add(cancelLoadButton);
 
     // Add the different boxes to the grid.
 	// This box is the top level one.
     wxBoxSizer* vbox = new wxBoxSizer(wxVERTICAL);
     vbox->Add(buttonBox, 0, wxALL, 5);
+	vbox->Add(loadGauge, 0, wxEXPAND | wxLEFT | wxRIGHT, 5);
 	
 	// add the status Grid 
 	wxStaticBoxSizer *statusBox = new wxStaticBoxSizer(wxHORIZONTAL, parentPanel, wxT("status information"));
 	
 	statusBox->Add(statusGridPtr);
-	vbox->Add(statusBox, 1, wxALL, 5);
+	statusBox->Add(plotPanel, 1, wxEXPAND | wxLEFT, 10);
+	vbox->Add(statusBox, 1, wxEXPAND | wxALL, 5);
 
     wxStaticBoxSizer *consoleBox = new wxStaticBoxSizer(wxVERTICAL, parentPanel, wxT("console information"));
     consoleBox->Add(statusText, 1, wxEXPAND | wxALL, 5);
@@ -143,12 +339,32 @@ wxFrame(NULL, wxID_ANY, title)
     this->Center();
 
     setStatusText(wxT("Welcome to Catheter Gui"));    
+
+	// load the per channel calibration (nothing has been sent yet).
+	int calibratedChannels(loadCalibrationFile(calibration_file));
+	if (calibratedChannels > 0)
+	{
+		setStatusText(wxString::Format(wxT("Loaded calibration for %d channels from %s"), calibratedChannels, wxT(calibration_file)));
+	}
+	else
+	{
+		setStatusText(wxT("Using nominal channel calibration"), logWarning);
+	}
 }
 
 CatheterGuiFrame::~CatheterGuiFrame()
 {
-	//do nothing here 
+	// cancels and joins the loader thread.
+	delete playfileLoader;
 	//All windows should be auto cleaned.
+	// stop the serial thread from queueing events to this frame.
+	statusGridCmdPtr->setNotify(boost::function<void()>());
+	statusTextData->setNotify(boost::function<void()>());
+	refreshTimer.Stop();
+	serialObject->setSampleRing(NULL);
+	serialObject->setPortSelector(PortSelector());
+	delete sampleRing;
+	delete statusReader;
 	delete statusGridCmdPtr;
 	delete statusTextData;
 }
@@ -176,6 +392,7 @@ void CatheterGuiFrame::OnSelectPlayfileButtonClicked(wxCommandEvent& e) {
 
 void CatheterGuiFrame::OnNewPlayfileButtonClicked(wxCommandEvent& e) {
     warnSavePlayfile();
+    discardLoad();
 
     grid->ResetDefault();
 
@@ -186,6 +403,10 @@ void CatheterGuiFrame::OnNewPlayfileButtonClicked(wxCommandEvent& e) {
 }
 
 void CatheterGuiFrame::OnSavePlayfileButtonClicked(wxCommandEvent& e) {
+    if (playfileLoader->getState() == PlayfileLoader::loading) {
+        setStatusText(wxT("The Playfile is still loading"), logWarning);
+        return;
+    }
     savePlayfile();
     if (playfileSaved) {
         // save contents of edit panel to playfilePath
@@ -199,7 +420,7 @@ void CatheterGuiFrame::OnSendCommandsButtonClicked(wxCommandEvent& e) {
     if (sendGridCommands()) {
         setStatusText(wxT("Commands Successfully Sent"));
     } else {
-        setStatusText(wxT("Error Sending Commands"));
+        setStatusText(wxT("Error Sending Commands"), logError);
     }
 }
 
@@ -218,13 +439,13 @@ void CatheterGuiFrame::OnSendResetButtonClicked(wxCommandEvent& e) {
     if (sendResetCommand()) {
         setStatusText(wxT("Reset Command Successfully Sent"));
     } else {
-        setStatusText(wxT("Error Sending Reset Command"));
+        setStatusText(wxT("Error Sending Reset Command"), logError);
     }
 }
 
 void CatheterGuiFrame::OnRefreshSerialButtonClicked(wxCommandEvent& e) {
     if (!refreshSerialConnection()) {
-        setStatusText(wxString::Format("Serial Disconnected"));
+        setStatusText(wxString::Format("Serial Disconnected"), logWarning);
     }
 }
 
@@ -232,11 +453,42 @@ void CatheterGuiFrame::OnRefreshSerialButtonClicked(wxCommandEvent& e) {
 // status panel private methods //
 //////////////////////////////////
 
-void CatheterGuiFrame::setStatusText(const wxString& msg) {
+void CatheterGuiFrame::setStatusText(const wxString& msg, logSeverity severity) {
 	// append the new message to the current status message
     //statusText->SetLabel(wxString::Format("%s\n%s", statusText->GetLabel(), msg));
 	//statusText->SetLabel(msg);
-	statusText->addWxText(msg);
+	statusText->addWxText(msg, severity);
+}
+
+// This is called from the serial thread.
+void CatheterGuiFrame::queueStatusRefresh() {
+	// only the first notification of a burst queues an event.
+	if (!refreshQueued.exchange(true))
+	{
+		wxQueueEvent(this, new wxThreadEvent(wxEVT_THREAD, ID_STATUS_UPDATE));
+	}
+}
+
+// This is called from the worker threads.
+void CatheterGuiFrame::queueThreadEvent(int id) {
+	wxQueueEvent(this, new wxThreadEvent(wxEVT_THREAD, id));
+}
+
+void CatheterGuiFrame::refreshStatus() {
+	// clear the flag first so that data arriving during the refresh queues another one.
+	refreshQueued = false;
+	CATHETER_TRACE_SCOPE("gui refresh");
+	StatusSnapshot snapshot;
+	if (statusReader->read(snapshot))
+	{
+		statusGridPtr->updateStatus(snapshot);
+	}
+	if (plotPanel->updateSamples())
+	{
+		plotPanel->Refresh();
+	}
+	statusText->addText();
+	sinceRefresh.Start();
 }
 
 ///////////////////////////////////
@@ -274,10 +526,34 @@ void CatheterGuiFrame::savePlayfile() {
     }
 }
 
+// the file is read on the loader thread, see onLoadProgress and onLoadFinished.
 void CatheterGuiFrame::loadPlayfile(const wxString& path) {
-    std::vector<CatheterChannelCmdSet> gridCmds;
-    loadPlayFile(path.mb_str(), gridCmds);
-    grid->SetCommands(gridCmds);
+    previewShown = false;
+    streamToSerial = false;
+    streamedSets = 0;
+    loadGauge->SetValue(0);
+    if (playfileLoader->start(std::string(path.mb_str()))) {
+        cancelLoadButton->Enable(true);
+    } else {
+        setStatusText(wxString::Format(wxT("Could not open Playfile %s"), path), logError);
+    }
+}
+
+// stops a load in progress and drops what it loaded (the worker is not waited for).
+void CatheterGuiFrame::discardLoad() {
+    playfileLoader->discard();
+    streamToSerial = false;
+    cancelLoadButton->Enable(false);
+}
+
+// queues the sets loaded since the last call.
+void CatheterGuiFrame::streamLoadedSets() {
+    std::vector<CatheterChannelCmdSet> newSets;
+    size_t count(playfileLoader->copySets(streamedSets, playfileLoader->setsLoaded(), newSets));
+    if (count > 0) {
+        serialObject->queueCommands(newSets);
+        streamedSets += count;
+    }
 }
 
 void CatheterGuiFrame::unloadPlayfile(const wxString& path) {
@@ -307,6 +583,14 @@ bool CatheterGuiFrame::sendCommands(const std::vector<CatheterChannelCmdSet> &cm
 }
 
 bool CatheterGuiFrame::sendGridCommands() {
+    if (playfileLoader->getState() == PlayfileLoader::loading) {
+        // start from the head of the file, the rest follows as it loads.
+        streamToSerial = true;
+        streamedSets = 0;
+        streamLoadedSets();
+        setStatusText(wxT("Sending the Playfile as it loads\n"));
+        return true;
+    }
     std::vector<CatheterChannelCmdSet> cmds;
     grid->GetCommands(cmds);
 	setStatusText(wxString::Format("Parsed %d Channel Commands\n", (int)(cmds.size())));
@@ -335,6 +619,20 @@ bool CatheterGuiFrame::refreshSerialConnection() {
 	return true;
 }
 
+// have the user select the correct port
+int CatheterGuiFrame::selectSerialPort(const std::vector<std::string> &ports) {
+	for (int i = 0; i < ports.size(); i++) {
+		wxMessageBox(wxString::Format("Found Serial Port: %s (%d/%d)", wxString(ports[i]), i + 1, ports.size()));
+	}
+	int which_port(wxGetNumberFromUser(wxEmptyString, wxT("Select Serial Port Number"), wxEmptyString, 0, 1, ports.size()) - 1);
+	if (which_port < 0)
+	{
+		return -1;
+	}
+	wxMessageBox(wxString::Format("Selected Serial Port: %s", wxString(ports[which_port])));
+	return which_port;
+}
+
 bool CatheterGuiFrame::closeSerialConnection() {
     // return ss->resetStop();
 	return false;
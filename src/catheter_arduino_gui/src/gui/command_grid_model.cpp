@@ -0,0 +1,258 @@
+#include "gui/command_grid_model.h"
+#include "hardware/digital_analog_conversions.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+
+CommandGridModel::CommandGridModel() : rows(1), cmdCount(0)
+{
+}
+
+void CommandGridModel::reset()
+{
+	rows.assign(1, CommandGridRow());
+	cmdCount = 0;
+}
+
+void CommandGridModel::swap(CommandGridModel& other)
+{
+	rows.swap(other.rows);
+	std::swap(cmdCount, other.cmdCount);
+}
+
+void CommandGridModel::setCommands(const std::vector<CatheterChannelCmdSet>& cmds)
+{
+	size_t nRows(0);
+	for (size_t i(0); i < cmds.size(); i++)
+	{
+		nRows += cmds[i].commandList.size();
+	}
+
+	rows.clear();
+	rows.reserve(nRows + 1);
+	for (size_t i(0); i < cmds.size(); i++)
+	{
+		const std::vector<CatheterChannelCmd> &cmdList(cmds[i].commandList);
+		for (size_t j(0); j < cmdList.size(); j++)
+		{
+			CommandGridRow row;
+			row.channel = cmdList[j].channel;
+			row.currentMilliAmp = cmdList[j].currentMilliAmp;
+			row.dir = (cmdList[j].currentMilliAmp > 0.0) ? DIR_POS : DIR_NEG;
+			row.delayMS = (j + 1 == cmdList.size()) ? static_cast<int> (cmds[i].delayTime) : 0;
+			row.filled = (1 << NFIELDS) - 1;
+			rows.push_back(row);
+		}
+	}
+	cmdCount = rows.size();
+
+	// add the blank row
+	rows.push_back(CommandGridRow());
+}
+
+void CommandGridModel::setCommands(const CatheterCmdSequence& cmdSequence)
+{
+	rows.clear();
+	rows.reserve(cmdSequence.commandCount() + 1);
+	for (size_t i(0); i < cmdSequence.size(); i++)
+	{
+		CmdSetView cmdSet(cmdSequence[i]);
+		for (size_t j(0); j < cmdSet.size(); j++)
+		{
+			CommandGridRow row;
+			row.channel = cmdSet[j].channel();
+			row.currentMilliAmp = cmdSet.milliAmp(j);
+			row.dir = (row.currentMilliAmp > 0.0) ? DIR_POS : DIR_NEG;
+			row.delayMS = (j + 1 == cmdSet.size()) ? static_cast<int> (cmdSet.delayTime) : 0;
+			row.filled = (1 << NFIELDS) - 1;
+			rows.push_back(row);
+		}
+	}
+	cmdCount = rows.size();
+
+	// add the blank row
+	rows.push_back(CommandGridRow());
+}
+
+void CommandGridModel::getCommands(std::vector<CatheterChannelCmdSet>& cmds) const
+{
+	cmds.clear();
+	CatheterChannelCmdSet newSet;
+	for (size_t i(0); i < cmdCount; i++)
+	{
+		CatheterChannelCmd newCmd;
+		newCmd.channel = rows[i].channel;
+		setCmdMilliAmp(newCmd, rows[i].currentMilliAmp);
+		// @TODO add the poll entry...
+		newCmd.poll = false;
+		newSet.commandList.push_back(newCmd);
+		// advance the commands when necessary.
+		if (rows[i].delayMS > 0)
+		{
+			newSet.delayTime = rows[i].delayMS;
+			cmds.push_back(newSet);
+			newSet.commandList.clear();
+			newSet.delayTime = 0;
+		}
+	}
+}
+
+size_t CommandGridModel::rowCount() const
+{
+	return rows.size();
+}
+
+size_t CommandGridModel::commandCount() const
+{
+	return cmdCount;
+}
+
+bool CommandGridModel::isRowEditable(size_t row) const
+{
+	return row <= cmdCount && row < rows.size();
+}
+
+bool CommandGridModel::isCellEmpty(size_t row, int col) const
+{
+	return row >= rows.size() || !rows[row].isFilled(col);
+}
+
+const CommandGridRow& CommandGridModel::getRow(size_t row) const
+{
+	return rows[row];
+}
+
+bool CommandGridModel::setChannel(size_t row, int channel)
+{
+	if (!isRowEditable(row) || channel < GLOBAL_ADDR || channel > NCHANNELS)
+	{
+		return false;
+	}
+	rows[row].channel = channel;
+	rows[row].filled |= (1 << CHANNEL_COL);
+	rowEdited(row);
+	return true;
+}
+
+bool CommandGridModel::setCurrent(size_t row, double currentMilliAmp)
+{
+	if (!isRowEditable(row))
+	{
+		return false;
+	}
+	CommandGridRow &gridRow(rows[row]);
+	gridRow.currentMilliAmp = currentMilliAmp;
+	gridRow.filled |= (1 << CURRENT_COL);
+	// the sign of a non zero current sets the direction.
+	if (currentMilliAmp != 0.0)
+	{
+		gridRow.dir = (currentMilliAmp > 0.0) ? DIR_POS : DIR_NEG;
+		gridRow.filled |= (1 << DIRECTION_COL);
+	}
+	rowEdited(row);
+	return true;
+}
+
+bool CommandGridModel::setDirection(size_t row, dir_t direction)
+{
+	if (!isRowEditable(row))
+	{
+		return false;
+	}
+	CommandGridRow &gridRow(rows[row]);
+	gridRow.dir = direction;
+	gridRow.filled |= (1 << DIRECTION_COL);
+	// flip the current to match the direction.
+	if ((direction == DIR_POS && gridRow.currentMilliAmp < 0.0) ||
+		(direction == DIR_NEG && gridRow.currentMilliAmp > 0.0))
+	{
+		gridRow.currentMilliAmp = -gridRow.currentMilliAmp;
+	}
+	rowEdited(row);
+	return true;
+}
+
+bool CommandGridModel::setDelay(size_t row, int delayMS)
+{
+	if (!isRowEditable(row) || delayMS < 0)
+	{
+		return false;
+	}
+	rows[row].delayMS = delayMS;
+	rows[row].filled |= (1 << DELAY_COL);
+	rowEdited(row);
+	return true;
+}
+
+std::string CommandGridModel::cellText(size_t row, int col) const
+{
+	if (isCellEmpty(row, col))
+	{
+		return std::string();
+	}
+	const CommandGridRow &gridRow(rows[row]);
+	char buffer[32];
+	switch (col)
+	{
+	case CHANNEL_COL:
+		if (gridRow.channel == GLOBAL_ADDR)
+		{
+			return std::string(GLOBALSTR);
+		}
+		snprintf(buffer, sizeof(buffer), "%d", gridRow.channel);
+		break;
+	case CURRENT_COL:
+		snprintf(buffer, sizeof(buffer), "%3.3f", gridRow.currentMilliAmp);
+		break;
+	case DIRECTION_COL:
+		return std::string((gridRow.dir == DIR_POS) ? DIRPOSSTR : DIRNEGSTR);
+	case DELAY_COL:
+		snprintf(buffer, sizeof(buffer), "%d", gridRow.delayMS);
+		break;
+	default:
+		return std::string();
+	}
+	return std::string(buffer);
+}
+
+bool CommandGridModel::setCellText(size_t row, int col, const std::string& text)
+{
+	switch (col)
+	{
+	case CHANNEL_COL:
+		return setChannel(row, (text == GLOBALSTR) ? GLOBAL_ADDR : atoi(text.c_str()));
+	case CURRENT_COL:
+		return setCurrent(row, atof(text.c_str()));
+	case DIRECTION_COL:
+		return setDirection(row, (text == DIRPOSSTR) ? DIR_POS : DIR_NEG);
+	case DELAY_COL:
+		return setDelay(row, atoi(text.c_str()));
+	}
+	return false;
+}
+
+void CommandGridModel::rowEdited(size_t row)
+{
+	if (row == cmdCount && rows[row].isComplete())
+	{
+		cmdCount++;
+		if (cmdCount >= rows.size())
+		{
+			rows.push_back(CommandGridRow());
+		}
+	}
+}
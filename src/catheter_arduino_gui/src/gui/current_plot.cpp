@@ -0,0 +1,160 @@
+#include "gui/current_plot.h"
+#include "hardware/digital_analog_conversions.h"
+
+#include <wx/dcbuffer.h>
+#include <cmath>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+// samples moved out of the ring at a time
+#define PLOT_DRAIN_BATCH 1024
+
+// left margin for the channel labels
+#define PLOT_LABEL_WIDTH 60
+
+wxBEGIN_EVENT_TABLE(CurrentPlotPanel, wxPanel)
+	EVT_PAINT(CurrentPlotPanel::onPaint)
+	EVT_SIZE(CurrentPlotPanel::onSize)
+wxEND_EVENT_TABLE()
+
+
+CurrentPlotPanel::CurrentPlotPanel(wxWindow *parent, SpscRing<CurrentSample> *ring) :
+	wxPanel(parent, wxID_ANY, wxDefaultPosition, wxSize(400, 60 * NCHANNELS)),
+	sampleRing(ring),
+	setHistory(NCHANNELS, SampleHistory(PLOT_WINDOW_SAMPLES)),
+	sensedHistory(NCHANNELS, SampleHistory(PLOT_WINDOW_SAMPLES)),
+	drainBuffer(PLOT_DRAIN_BATCH)
+{
+	// everything is drawn in onPaint (no background erase flicker).
+	SetBackgroundStyle(wxBG_STYLE_PAINT);
+	for (int index(0); index < NCHANNELS; index++)
+	{
+		lastSensed[index] = 0.0f;
+	}
+}
+
+bool CurrentPlotPanel::updateSamples()
+{
+	bool updated(false);
+	size_t count(0);
+	while ((count = sampleRing->popBulk(drainBuffer.data(), drainBuffer.size())) > 0)
+	{
+		for (size_t index(0); index < count; index++)
+		{
+			const CurrentSample &sample(drainBuffer[index]);
+			if (sample.channel < 1 || sample.channel > NCHANNELS)
+			{
+				continue;  // global replies are repeated per channel anyway.
+			}
+			int channelIndex(sample.channel - 1);
+			setHistory[channelIndex].push(static_cast<float> (dac2MilliAmp(sample.dacCounts, sample.dir, sample.channel)));
+			// the sensed current holds its value between polls.
+			if (sample.polled)
+			{
+				lastSensed[channelIndex] = static_cast<float> (adc2MilliAmp(sample.adcCounts, sample.channel));
+			}
+			sensedHistory[channelIndex].push(lastSensed[channelIndex]);
+		}
+		updated = true;
+	}
+	return updated;
+}
+
+void CurrentPlotPanel::onSize(wxSizeEvent &e)
+{
+	Refresh();
+	e.Skip();
+}
+
+void CurrentPlotPanel::onPaint(wxPaintEvent &e)
+{
+	wxAutoBufferedPaintDC dc(this);
+	dc.SetBackground(*wxBLACK_BRUSH);
+	dc.Clear();
+
+	wxSize size(GetClientSize());
+	int stripHeight(size.GetHeight() / NCHANNELS);
+	for (int channelIndex(0); channelIndex < NCHANNELS; channelIndex++)
+	{
+		wxRect strip(PLOT_LABEL_WIDTH, channelIndex * stripHeight, size.GetWidth() - PLOT_LABEL_WIDTH, stripHeight);
+		drawChannel(dc, channelIndex, strip);
+	}
+}
+
+void CurrentPlotPanel::drawChannel(wxDC &dc, int channelIndex, const wxRect &strip)
+{
+	const SampleHistory &setValues(setHistory[channelIndex]);
+	const SampleHistory &sensedValues(sensedHistory[channelIndex]);
+
+	// labels
+	dc.SetTextForeground(*wxWHITE);
+	dc.DrawText(wxString::Format(wxT("ch %d"), channelIndex + 1), 2, strip.GetTop() + 2);
+	dc.SetTextForeground(*wxYELLOW);
+	dc.DrawText(wxString::Format(wxT("%.1f"), setValues.latest()), 2, strip.GetTop() + 16);
+	dc.SetTextForeground(*wxCYAN);
+	dc.DrawText(wxString::Format(wxT("%.1f"), sensedValues.latest()), 2, strip.GetTop() + 30);
+
+	// zero line and strip border
+	dc.SetPen(*wxGREY_PEN);
+	int middle(strip.GetTop() + strip.GetHeight() / 2);
+	dc.DrawLine(strip.GetLeft(), middle, strip.GetRight(), middle);
+	dc.DrawLine(strip.GetLeft(), strip.GetBottom(), strip.GetRight(), strip.GetBottom());
+
+	if (strip.GetWidth() <= 0 || setValues.size() == 0)
+	{
+		return;
+	}
+
+	// symmetric range that fits both traces.
+	float range(PLOT_MIN_RANGE_MA);
+	const float *newestSet(setValues.newest(setValues.size()));
+	const float *newestSensed(sensedValues.newest(sensedValues.size()));
+	for (size_t index(0); index < setValues.size(); index++)
+	{
+		range = (std::fabs(newestSet[index]) > range) ? std::fabs(newestSet[index]) : range;
+		range = (std::fabs(newestSensed[index]) > range) ? std::fabs(newestSensed[index]) : range;
+	}
+
+	size_t count(tracePoints(setValues, strip, range));
+	dc.SetPen(*wxYELLOW_PEN);
+	dc.DrawLines(static_cast<int> (count), points.data());
+
+	count = tracePoints(sensedValues, strip, range);
+	dc.SetPen(*wxCYAN_PEN);
+	dc.DrawLines(static_cast<int> (count), points.data());
+}
+
+size_t CurrentPlotPanel::tracePoints(const SampleHistory &history, const wxRect &strip, float range)
+{
+	size_t columns(static_cast<size_t> (strip.GetWidth()));
+	minBuffer.resize(columns);
+	maxBuffer.resize(columns);
+	points.resize(2 * columns);
+
+	size_t count(history.size());
+	size_t buckets(decimateMinMax(history.newest(count), count, columns, minBuffer.data(), maxBuffer.data()));
+
+	// the newest sample is on the right edge.
+	float scale((strip.GetHeight() / 2 - 1) / range);
+	int middle(strip.GetTop() + strip.GetHeight() / 2);
+	int left(strip.GetRight() - static_cast<int> (buckets) + 1);
+	size_t nPoints(0);
+	for (size_t bucket(0); bucket < buckets; bucket++)
+	{
+		int x(left + static_cast<int> (bucket));
+		// zig-zag between the min and max so each column is a vertical segment.
+		points[nPoints++] = wxPoint(x, middle - static_cast<int> (minBuffer[bucket] * scale));
+		points[nPoints++] = wxPoint(x, middle - static_cast<int> (maxBuffer[bucket] * scale));
+	}
+	return nPoints;
+}
@@ -0,0 +1,275 @@
+#include "gui/playfile_loader.h"
+#include "com/pc_utils.h"
+#include "hardware/digital_analog_conversions.h"
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <fstream>
+#include <iterator>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+
+PlayfileLoader::PlayfileLoader() : current(), thrd(), retired()
+{
+}
+
+PlayfileLoader::~PlayfileLoader()
+{
+	retireCurrent();
+	joinRetired(true);
+}
+
+bool PlayfileLoader::start(const std::string &fname)
+{
+	std::ifstream inFile(fname.c_str(), std::ifstream::in | std::ifstream::ate);
+	if (!inFile.is_open())
+	{
+		return false;
+	}
+	uint64_t fileSize(static_cast<uint64_t> (inFile.tellg()));
+	inFile.close();
+
+	// the load in progress stops on its own, it is not waited for here.
+	retireCurrent();
+	joinRetired(false);
+
+	boost::shared_ptr<LoadJob> job(new LoadJob);
+	job->state = loading;
+	job->totalBytes = fileSize;
+	{
+		boost::mutex::scoped_lock lock(loaderMutex);
+		current = job;
+	}
+	thrd = boost::thread(boost::bind(&PlayfileLoader::loadLoop, this, job, fname));
+	return true;
+}
+
+void PlayfileLoader::cancel()
+{
+	boost::mutex::scoped_lock lock(loaderMutex);
+	if (current)
+	{
+		current->cancelRequested = true;
+	}
+}
+
+void PlayfileLoader::discard()
+{
+	retireCurrent();
+	joinRetired(false);
+}
+
+void PlayfileLoader::wait()
+{
+	if (thrd.joinable())
+	{
+		thrd.join();
+	}
+}
+
+void PlayfileLoader::retireCurrent()
+{
+	{
+		boost::mutex::scoped_lock lock(loaderMutex);
+		if (current)
+		{
+			current->cancelRequested = true;
+		}
+		// the worker sees that it was replaced and drops its results.
+		current.reset();
+	}
+	if (thrd.joinable())
+	{
+		retired.push_back(boost::shared_ptr<boost::thread>(new boost::thread(boost::move(thrd))));
+	}
+}
+
+void PlayfileLoader::joinRetired(bool all)
+{
+	std::vector<boost::shared_ptr<boost::thread> > running;
+	for (size_t i(0); i < retired.size(); i++)
+	{
+		if (all)
+		{
+			retired[i]->join();
+		}
+		else if (!retired[i]->timed_join(boost::posix_time::milliseconds(0)))
+		{
+			running.push_back(retired[i]);
+		}
+	}
+	retired.swap(running);
+}
+
+PlayfileLoader::LoadState PlayfileLoader::getState() const
+{
+	boost::mutex::scoped_lock lock(loaderMutex);
+	return current ? current->state : idle;
+}
+
+double PlayfileLoader::getProgress() const
+{
+	boost::mutex::scoped_lock lock(loaderMutex);
+	if (!current)
+	{
+		return 1.0;
+	}
+	if (current->totalBytes == 0)
+	{
+		return (current->state == loading) ? 0.0 : 1.0;
+	}
+	return static_cast<double> (current->bytesDone) / static_cast<double> (current->totalBytes);
+}
+
+size_t PlayfileLoader::setsLoaded() const
+{
+	boost::mutex::scoped_lock lock(loaderMutex);
+	return current ? current->sets.size() : 0;
+}
+
+size_t PlayfileLoader::copySets(size_t firstSet, size_t maxSets, std::vector<CatheterChannelCmdSet> &cmdVect) const
+{
+	boost::mutex::scoped_lock lock(loaderMutex);
+	if (!current || firstSet >= current->sets.size())
+	{
+		return 0;
+	}
+	size_t count(current->sets.size() - firstSet);
+	count = (count < maxSets) ? count : maxSets;
+	cmdVect.reserve(cmdVect.size() + count);
+	for (size_t index(firstSet); index < firstSet + count; index++)
+	{
+		cmdVect.push_back(current->sets.getSet(index));
+	}
+	return count;
+}
+
+bool PlayfileLoader::takeResult(CommandGridModel &modelOut, CatheterCmdSequence &cmdSequence)
+{
+	boost::mutex::scoped_lock lock(loaderMutex);
+	if (!current || (current->state != done && current->state != cancelled))
+	{
+		return false;
+	}
+	modelOut.swap(current->model);
+	cmdSequence.swap(current->sets);
+	current.reset();
+	return true;
+}
+
+void PlayfileLoader::setNotify(const boost::function<void()> &progressFcn, const boost::function<void()> &finishedFcn)
+{
+	boost::mutex::scoped_lock lock(loaderMutex);
+	progressNotify = progressFcn;
+	finishedNotify = finishedFcn;
+}
+
+void PlayfileLoader::publish(LoadJob &job, CatheterCmdSequence &batch, uint64_t bytesRead)
+{
+	boost::mutex::scoped_lock lock(loaderMutex);
+	job.sets.append(batch);
+	job.bytesDone = bytesRead;
+	batch.clear();
+}
+
+// This is the worker function, it uses the same rules as loadPlayFile.
+void PlayfileLoader::loadLoop(boost::shared_ptr<LoadJob> job, std::string fname)
+{
+	std::ifstream inFile(fname.c_str(), std::ifstream::in);
+	boost::function<void()> progressFcn;
+	boost::function<void()> finishedFcn;
+	{
+		boost::mutex::scoped_lock lock(loaderMutex);
+		progressFcn = progressNotify;
+		finishedFcn = finishedNotify;
+		if (!inFile.is_open())
+		{
+			job->state = failed;
+		}
+	}
+	if (!inFile.is_open())
+	{
+		if (finishedFcn) finishedFcn();
+		return;
+	}
+
+	CatheterCmdSequence batch;
+	batch.reserve(PLAYFILE_BATCH_SETS, PLAYFILE_BATCH_SETS * NCHANNELS);
+	std::string line;
+	uint64_t bytesRead(0);
+	boost::posix_time::ptime lastNotify(boost::posix_time::microsec_clock::local_time());
+	bool notified(false);
+
+	while (!job->cancelRequested && std::getline(inFile, line))
+	{
+		bytesRead += line.size() + 1;
+		int channelIn, waitTime;
+		double milliAmp;
+		if (!parsePlayLine(line, channelIn, milliAmp, waitTime)) continue;
+
+		CatheterChannelCmd singleCmd;
+		singleCmd.channel = channelIn;
+		setCmdMilliAmp(singleCmd, milliAmp);
+		singleCmd.poll = false;
+		batch.addCommand(packCmd(singleCmd), milliAmp);
+
+		if (waitTime > 0)
+		{
+			batch.endSet(waitTime);
+			if (batch.size() >= PLAYFILE_BATCH_SETS)
+			{
+				publish(*job, batch, bytesRead);
+				boost::posix_time::ptime now(boost::posix_time::microsec_clock::local_time());
+				// the first batch is announced right away so the head can be shown.
+				if (!notified || (now - lastNotify).total_milliseconds() >= PLAYFILE_PROGRESS_MS)
+				{
+					notified = true;
+					lastNotify = now;
+					if (progressFcn) progressFcn();
+				}
+			}
+		}
+	}
+	// commands without a closing delay are dropped (same as loadPlayFile).
+	batch.discardPending();
+	publish(*job, batch, bytesRead);
+	inFile.close();
+	bool wasCancelled(job->cancelRequested);
+
+	// a replaced load has nobody to hand its result to.
+	{
+		boost::mutex::scoped_lock lock(loaderMutex);
+		if (current != job)
+		{
+			return;
+		}
+	}
+
+	// The sets are no longer written, so the model is built without the lock.
+	CommandGridModel newModel;
+	newModel.setCommands(job->sets);
+
+	{
+		boost::mutex::scoped_lock lock(loaderMutex);
+		job->model.swap(newModel);
+		job->bytesDone = wasCancelled ? bytesRead : job->totalBytes;
+		job->state = wasCancelled ? cancelled : done;
+		if (current != job)
+		{
+			return;
+		}
+	}
+	if (finishedFcn) finishedFcn();
+}
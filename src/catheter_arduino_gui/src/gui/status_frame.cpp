@@ -1,4 +1,5 @@
 #include "gui/status_frame.h"
+#include "hardware/digital_analog_conversions.h"
 
 StatusGrid:: ~StatusGrid()
 {
@@ -19,6 +20,7 @@ StatusGrid::StatusGrid(wxPanel* parentPanel):
 	this->Add(enable);
 
 	textCtrl.clear();
+	cellText.assign(24, wxEmptyString);
 	for ( int index(0); index < 24; index++)
 	{
 		textCtrl.push_back(new wxTextCtrl(parentPanel, -1));
@@ -27,14 +29,14 @@ StatusGrid::StatusGrid(wxPanel* parentPanel):
 		switch (index % 4)
 		{
 		case 0: // channel number
-			textCtrl[index]->SetValue(wxString::Format(wxT("%d"), (index  >> 2)+1));
+			setCell(index, wxString::Format(wxT("%d"), (index  >> 2)+1));
 			break;
 		case 1:
 		case 2:
-			textCtrl[index]->SetValue(wxT("0.00"));
+			setCell(index, wxT("0.00"));
 			break;
 		case 3:
-			textCtrl[index]->SetValue(wxT("false"));
+			setCell(index, wxT("false"));
 			break;
 		}
 		this->Add(textCtrl[index]);
@@ -43,43 +45,34 @@ StatusGrid::StatusGrid(wxPanel* parentPanel):
    
 }
 
-bool StatusGrid::updateStatus(statusData* inputData)
+void StatusGrid::updateStatus(const StatusSnapshot &snapshot)
 {
-	
-	boost::mutex::scoped_lock lock(inputData->statusMutex);
-	if (inputData->updated)
+	for (int channelNum(1); channelNum <= NCHANNELS; channelNum++)
 	{
-		int cmdCount(inputData->inputCommands.size());
-		for (int index(0); index < cmdCount; index++)
+		if (!snapshot.hasChannel(channelNum))
 		{
-			int channelNum(inputData->inputCommands[index].channel);
-			int baseIndex(((channelNum - 1) << 2));
-			textCtrl[baseIndex + 1]->SetValue(wxString::Format(wxT("%f"), inputData->inputCommands[index].currentMilliAmp));
-			textCtrl[baseIndex + 2]->SetValue(wxString::Format(wxT("%f"), inputData->inputCommands[index].currentMilliAmp_ADC));
-			if (inputData->inputCommands[index].enable)
-			{
-				textCtrl[baseIndex + 3]->SetValue(wxT("true"));
-			}
-			else
-			{
-				textCtrl[baseIndex + 3]->SetValue(wxT("false"));
-			}
+			continue;
 		}
-		inputData->updated = false;
-		return true;
+		const CatheterChannelCmd &command(snapshot.channels[channelNum - 1]);
+		int baseIndex(((channelNum - 1) << 2));
+		// the replies carry DAC/ADC counts, convert them for display.
+		setCell(baseIndex + 1, wxString::Format(wxT("%f"), cmdMilliAmp(command)));
+		setCell(baseIndex + 2, wxString::Format(wxT("%f"), cmdSensedMilliAmp(command)));
+		setCell(baseIndex + 3, command.enable ? wxT("true") : wxT("false"));
 	}
-	return false;
 }
 
-
-void statusData::updateCmdList(std::vector<CatheterChannelCmd> & inputCommands_)
+void StatusGrid::setCell(int index, const wxString &value)
 {
-	boost::mutex::scoped_lock lock(this->statusMutex);
-	this->inputCommands = inputCommands_;
-	this->updated = true;
-
+	if (cellText[index] != value)
+	{
+		cellText[index] = value;
+		// ChangeValue does not generate a text event.
+		textCtrl[index]->ChangeValue(value);
+	}
 }
 
+
  /*  wxPanel *panel = new wxPanel(this, -1);
 
   wxBoxSizer *hbox = new wxBoxSizer(wxHORIZONTAL);
@@ -13,62 +13,75 @@
 #endif  // __MSC_VER
 
 
-
-void incomingText::appendText(const std::string  &newText)
-{
-	boost::mutex::scoped_lock lock(textMutex);
-	this->update = true;
-	stringData += "\n";
-	stringData += newText;
-}
-
-
 // explicit constructor
-CatheterStatusText::CatheterStatusText(wxWindow* parent, wxWindowID id) : wxScrolledWindow(parent, id, wxDefaultPosition, wxSize(50,150)) {
-		
+CatheterStatusText::CatheterStatusText(wxWindow* parent, wxWindowID id, ConsoleLog *log) :
+	wxListCtrl(parent, id, wxDefaultPosition, wxSize(50,150), wxLC_REPORT | wxLC_VIRTUAL | wxLC_NO_HEADER | wxLC_SINGLE_SEL),
+	consoleLog(log), firstRow(0)
+{
         this -> SetBackgroundColour(*wxBLACK);
         this -> SetForegroundColour(*wxYELLOW);
 
-        wxBoxSizer *sizer = new wxBoxSizer(wxVERTICAL);
-
-		statusText = new wxStaticText(this, wxID_ANY, wxEmptyString);
-		sizer->Add(statusText, 0, wxALL, 5);
+		this->InsertColumn(0, wxT("time"), wxLIST_FORMAT_RIGHT, 80);
+		this->InsertColumn(1, wxT("message"), wxLIST_FORMAT_LEFT, 600);
 
-		this->SetSizer(sizer);
-		this->FitInside();
-		this->SetScrollRate(5, 5);
+		severityAttr[logDebug].SetTextColour(*wxLIGHT_GREY);
+		severityAttr[logInfo].SetTextColour(*wxYELLOW);
+		severityAttr[logWarning].SetTextColour(wxColour(255, 165, 0));
+		severityAttr[logError].SetTextColour(*wxRED);
+		for (int index(0); index <= logError; index++)
+		{
+			severityAttr[index].SetBackgroundColour(*wxBLACK);
+		}
 	}
 
-    // public method to send text into the status box
-bool CatheterStatusText::addText(incomingText *incomingInfo)
+bool CatheterStatusText::addText()
 {
-        boost::mutex::scoped_lock lock(incomingInfo->textMutex);
-		if (incomingInfo->update)
+		if (!consoleLog->takeUpdate())
+		{
+			return false;
+		}
+
+		// only scroll with the log if the last line was already showing.
+		long count(GetItemCount());
+		bool atBottom((count == 0) || (GetTopItem() + GetCountPerPage() >= count));
+
+		firstRow = consoleLog->firstSeq();
+		count = static_cast<long> (consoleLog->endSeq() - firstRow);
+		SetItemCount(count);
+		if (atBottom && count > 0)
 		{
-			SetCatheterStatusText(wxString(incomingInfo->stringData));
-			incomingInfo->stringData.clear();
-			incomingInfo->update = false;
-			return true;
+			EnsureVisible(count - 1);
 		}
-		incomingInfo->update = false;
-        return false;
+		Refresh();
+		return true;
 }
 
-	bool CatheterStatusText::addWxText(const wxString& msg)
+	bool CatheterStatusText::addWxText(const wxString& msg, logSeverity severity)
     {
-        boost::mutex::scoped_lock lock(textMutex);
-        SetCatheterStatusText(msg);
-        return true;
+        consoleLog->appendText(std::string(msg.mb_str()), severity);
+        return addText();
     }
 
+wxString CatheterStatusText::OnGetItemText(long item, long column) const
+{
+	ConsoleLine line;
+	if (!consoleLog->getLine(firstRow + item, line))
+	{
+		return wxEmptyString;  // overwritten since the last refresh.
+	}
+	if (column == 0)
+	{
+		return wxString::Format(wxT("%.3f"), line.timeStamp);
+	}
+	return wxString(line.text, wxConvUTF8);
+}
 
-	    // appends text and scrolls down.
-void CatheterStatusText::SetCatheterStatusText(const wxString& msg) {
-        wxString current = statusText->GetLabelText();
-        current = current + wxT("\n") + msg;
-        statusText->SetLabelText(current);
-        
-        this->FitInside();
-        int r(this->GetScrollRange(wxVERTICAL));
-        this->Scroll(0, r);
-}
\ No newline at end of file
+wxListItemAttr* CatheterStatusText::OnGetItemAttr(long item) const
+{
+	ConsoleLine line;
+	if (!consoleLog->getLine(firstRow + item, line))
+	{
+		return NULL;
+	}
+	return &severityAttr[line.severity];
+}
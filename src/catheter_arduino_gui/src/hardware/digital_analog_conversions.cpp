@@ -2,41 +2,250 @@
 
 #include "hardware/digital_analog_conversions.h"
 
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
 
-double adc2MilliAmp(uint16_t dataIn)
+
+// nominal DAC scaling (DAC counts per mA). This constant is from previous code.
+#define NOMINAL_DAC_GAIN 12.8
+
+// The ADC currently uses 12 bits (0-4095) to measure the range of 0-5 V
+// The voltage is sampled from a 1 ohm resistor with a 10x gain amplifier.
+// (4095 samples -> 5 V -> 10x gain -> 1000 mA per V)
+#define NOMINAL_ADC_GAIN (5.0 * 1000.0 / (4095.0 * 10.0))
+
+
+ChannelCalibration::ChannelCalibration() :
+	dacGain(NOMINAL_DAC_GAIN), dacOffset(0.0),
+	adcGain(NOMINAL_ADC_GAIN), adcOffset(0.0), adcPoly()
+{
+}
+
+namespace
+{
+
+// a channel profile along with its decode tables.
+struct ChannelLut
 {
-    // The ADC currently uses 12 bits (0-4095) to measure the range of 0-5 V
-	// The voltage is sampled from a 1 ohm resistor with a 10x gain amplifier.
+	ChannelCalibration profile;
+	double dacMilliAmp[DAC_RES];  // magnitude of the current at each DAC setting
+	double adcMilliAmp[ADC_RES];  // sensed current at each ADC value
+};
 
-	double data_d(static_cast<double> (dataIn));
+double evaluateAdc(const ChannelCalibration &profile, double adc)
+{
+	// Horner's rule, highest order term first.
+	double result(0.0);
+	for (int order(static_cast<int> (profile.adcPoly.size()) - 1); order >= 0; order--)
+	{
+		result = (result + profile.adcPoly[order]) * adc;
+	}
+	return (result + profile.adcGain) * adc + profile.adcOffset;
+}
 
-	data_d /= 4095.0; // convert to digital samples (12 bits)
-	data_d *= 5.0;    // scale by the 5 V voltage range
-	data_d /= 10.0;   //divide by the gain amplifier (10x)
-	data_d *= 1000.0;    //convert from Volts to mA through a 1 Ohm resisitor. (1000x)
-	return data_d;
+double evaluateDac(const ChannelCalibration &profile, double dac)
+{
+	double milliAmp((dac - profile.dacOffset) / profile.dacGain);
+	return (milliAmp > 0.0) ? milliAmp : 0.0;
 }
 
+void buildLut(ChannelLut &lut, const ChannelCalibration &profile)
+{
+	lut.profile = profile;
+	for (int dac(0); dac < DAC_RES; dac++)
+	{
+		lut.dacMilliAmp[dac] = evaluateDac(profile, static_cast<double> (dac));
+	}
+	for (int adc(0); adc < ADC_RES; adc++)
+	{
+		lut.adcMilliAmp[adc] = evaluateAdc(profile, static_cast<double> (adc));
+	}
+}
 
+// index 0 is the global address, 1 - NCHANNELS are the channels.
+struct CalibrationTables
+{
+	ChannelLut channels[NCHANNELS + 1];
+
+	CalibrationTables()
+	{
+		ChannelCalibration nominal;
+		for (int index(0); index <= NCHANNELS; index++)
+		{
+			buildLut(channels[index], nominal);
+		}
+	}
+};
 
-uint16_t milliAmp2Dac(double milliAmp)
+CalibrationTables& calibrationTables()
 {
-	
-	double dacVal(milliAmp);
-	dacVal *= (dacVal < 0.0) ? (-1.0) : (1.0);  //ensure the data is positive.
-	dacVal *= 12.8;  // this constant is from previous code (needs to be defined)
-	
-	// cast the variable as a uint16_t and return.
-	uint16_t dacValInt(static_cast<uint16_t> (dacVal));
+	static CalibrationTables tables;
+	return tables;
+}
 
-	return dacValInt;
+ChannelLut& channelLut(int channel)
+{
+	if (channel < 0 || channel > NCHANNELS)
+	{
+		channel = GLOBAL_ADDR;
+	}
+	return calibrationTables().channels[channel];
 }
 
-double dac2MilliAmp(uint16_t dacVal, dir_t dir)
+// shared by the scalar and batch encoders.
+inline uint16_t encodeDac(double milliAmp, double gain, double offset)
 {
+	double dacVal(std::fabs(milliAmp) * gain + offset);  // truncated, as the board has always been sent
+	dacVal = (dacVal < 0.0) ? 0.0 : dacVal;
+	dacVal = (dacVal > (DAC_RES - 1)) ? (DAC_RES - 1) : dacVal;
+	return static_cast<uint16_t> (dacVal);
+}
+
+}  // namespace
+
+
+void setChannelCalibration(int channel, const ChannelCalibration& profile)
+{
+	buildLut(channelLut(channel), profile);
+}
+
+const ChannelCalibration& getChannelCalibration(int channel)
+{
+	return channelLut(channel).profile;
+}
+
+void resetChannelCalibration()
+{
+	ChannelCalibration nominal;
+	for (int index(0); index <= NCHANNELS; index++)
+	{
+		setChannelCalibration(index, nominal);
+	}
+}
+
+int loadCalibrationFile(const char * fname)
+{
+	std::ifstream inFile(fname, std::ifstream::in);
+
+	if (inFile.bad()) return -1;
+	if (!inFile.is_open()) return -2;
+
+	int channelsLoaded(0);
+	std::string line;
+	while (std::getline(inFile, line))
+	{
+		// strip the comment
+		size_t posOcto(line.find("#"));
+		if (posOcto != std::string::npos)
+		{
+			line.erase(posOcto);
+		}
+
+		std::istringstream lineStream(line);
+		std::string item;
+		std::vector<double> values;
+		while (std::getline(lineStream, item, ','))
+		{
+			values.push_back(atof(item.c_str()));
+		}
 
-	double dacOut(static_cast<double> (dacVal));
-	dacOut /= 12.8;  // this constant is from previous code (needs to be defined)
+		// channel, dacGain, dacOffset, adcGain, adcOffset are required.
+		if (values.size() < 5) continue;
+		int channel(static_cast<int> (values[0]));
+		if (!(channel >= 0 && channel <= NCHANNELS)) continue;  // bad channel; skip line
+		if (!(values[1] > 0.0)) continue;  // the DAC gain has to be invertible
+
+		ChannelCalibration profile;
+		profile.dacGain = values[1];
+		profile.dacOffset = values[2];
+		profile.adcGain = values[3];
+		profile.adcOffset = values[4];
+		profile.adcPoly.assign(values.begin() + 5, values.end());
+		setChannelCalibration(channel, profile);
+		channelsLoaded++;
+	}
+	inFile.close();
+	return channelsLoaded;
+}
+
+
+double adc2MilliAmp(uint16_t dataIn, int channel)
+{
+	const ChannelLut &lut(channelLut(channel));
+	if (dataIn < ADC_RES)
+	{
+		return lut.adcMilliAmp[dataIn];
+	}
+	// out of the table range, evaluate the profile directly.
+	return evaluateAdc(lut.profile, static_cast<double> (dataIn));
+}
+
+
+
+uint16_t milliAmp2Dac(double milliAmp, int channel)
+{
+	const ChannelCalibration &profile(channelLut(channel).profile);
+	return encodeDac(milliAmp, profile.dacGain, profile.dacOffset);
+}
+
+double dac2MilliAmp(uint16_t dacVal, dir_t dir, int channel)
+{
+	const ChannelLut &lut(channelLut(channel));
+	// out of the table range, evaluate the profile directly (as adc2MilliAmp does).
+	double dacOut((dacVal < DAC_RES) ? lut.dacMilliAmp[dacVal] : evaluateDac(lut.profile, static_cast<double> (dacVal)));
 	dacOut *= (dir) ? (1.0) : (-1.0);
 	return dacOut;
-}
\ No newline at end of file
+}
+
+
+void adc2MilliAmpBatch(const uint16_t *dataIn, double *milliAmpOut, size_t count, int channel)
+{
+	const ChannelLut &lut(channelLut(channel));
+	for (size_t index(0); index < count; index++)
+	{
+		uint16_t adc(dataIn[index]);
+		milliAmpOut[index] = (adc < ADC_RES) ? lut.adcMilliAmp[adc] : evaluateAdc(lut.profile, static_cast<double> (adc));
+	}
+}
+
+void milliAmp2DacBatch(const double *milliAmp, uint16_t *dacOut, size_t count, int channel)
+{
+	const ChannelCalibration &profile(channelLut(channel).profile);
+	const double gain(profile.dacGain);
+	const double offset(profile.dacOffset);
+	for (size_t index(0); index < count; index++)
+	{
+		dacOut[index] = encodeDac(milliAmp[index], gain, offset);
+	}
+}
+
+void dac2MilliAmpBatch(const uint16_t *dacVal, const dir_t *dir, double *milliAmpOut, size_t count, int channel)
+{
+	const ChannelLut &lut(channelLut(channel));
+	for (size_t index(0); index < count; index++)
+	{
+		double sign((dir[index] == DIR_POS) ? 1.0 : -1.0);
+		uint16_t dac(dacVal[index]);
+		milliAmpOut[index] = ((dac < DAC_RES) ? lut.dacMilliAmp[dac] : evaluateDac(lut.profile, static_cast<double> (dac))) * sign;
+	}
+}
+
+
+void setCmdMilliAmp(CatheterChannelCmd& cmd, double milliAmp)
+{
+	cmd.currentMilliAmp = milliAmp;
+	cmd.dacCounts = milliAmp2Dac(milliAmp, cmd.channel);
+	cmd.dir = (milliAmp > 0.0) ? DIR_POS : DIR_NEG;
+}
+
+double cmdMilliAmp(const CatheterChannelCmd& cmd)
+{
+	return dac2MilliAmp(cmd.dacCounts, cmd.dir, cmd.channel);
+}
+
+double cmdSensedMilliAmp(const CatheterChannelCmd& cmd)
+{
+	return adc2MilliAmp(cmd.adcCounts, cmd.channel);
+}
@@ -0,0 +1,222 @@
+#include "ipc/ipc_client.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define IPC_READ_CHUNK 65536
+
+IpcClient::IpcClient() : fd(-1), nextSequence(1), input(IPC_READ_CHUNK)
+{
+}
+
+IpcClient::~IpcClient()
+{
+	close();
+}
+
+bool IpcClient::connect(const std::string &socketPath)
+{
+	close();
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path))
+	{
+		return false;
+	}
+	strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		return false;
+	}
+	if (::connect(fd, reinterpret_cast<struct sockaddr*> (&address), sizeof(address)) != 0)
+	{
+		close();
+		return false;
+	}
+	reader = IpcFrameReader();
+	return true;
+}
+
+void IpcClient::close()
+{
+	if (fd >= 0)
+	{
+		::close(fd);
+		fd = -1;
+	}
+}
+
+bool IpcClient::isConnected() const
+{
+	return fd >= 0;
+}
+
+uint64_t IpcClient::sendSetpoints(const double *milliAmp, size_t nChannels, size_t nSteps, const double *delayMS,
+	size_t nDelays, uint8_t flags)
+{
+	IpcRequest request;
+	request.sequence = nextSequence;
+	request.sendNs = ipcNowNs();
+	output.clear();
+	if (!ipcAppendSetpoints(output, request, milliAmp, nChannels, nSteps, delayMS, nDelays, flags) || !sendFrame())
+	{
+		return 0;
+	}
+	return nextSequence++;
+}
+
+uint64_t IpcClient::reset()
+{
+	return sendRequest(ipcReset, 0);
+}
+
+uint64_t IpcClient::poll()
+{
+	return sendRequest(ipcPoll, 0);
+}
+
+uint64_t IpcClient::abort()
+{
+	return sendRequest(ipcAbort, 0);
+}
+
+uint64_t IpcClient::subscribe(bool enable)
+{
+	return sendRequest(ipcSubscribe, enable ? IPC_FLAG_ENABLE : 0);
+}
+
+uint64_t IpcClient::sendRequest(uint8_t type, uint8_t flags)
+{
+	IpcRequest request;
+	request.sequence = nextSequence;
+	request.sendNs = ipcNowNs();
+	output.clear();
+	ipcAppendFrame(output, type, flags, &request, sizeof(request));
+	if (!sendFrame())
+	{
+		return 0;
+	}
+	return nextSequence++;
+}
+
+bool IpcClient::sendFrame()
+{
+	if (fd < 0)
+	{
+		return false;
+	}
+	size_t sent(0);
+	while (sent < output.size())
+	{
+		ssize_t count(send(fd, output.data() + sent, output.size() - sent, MSG_NOSIGNAL));
+		if (count < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		sent += count;
+	}
+	return true;
+}
+
+bool IpcClient::read(int timeoutMs, std::vector<IpcAckMessage> &acks, std::vector<CurrentSample> &samples,
+	uint64_t *dropped)
+{
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	if (::poll(&pfd, 1, timeoutMs) <= 0)
+	{
+		return true;
+	}
+	while (true)
+	{
+		ssize_t count(recv(fd, input.data(), input.size(), MSG_DONTWAIT));
+		if (count == 0)
+		{
+			return false;
+		}
+		if (count < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				break;
+			}
+			return false;
+		}
+		reader.feed(input.data(), count);
+		if (static_cast<size_t> (count) < input.size())
+		{
+			break;
+		}
+	}
+
+	IpcHeader header;
+	const uint8_t *payload(NULL);
+	IpcFrameStatus status;
+	while ((status = reader.next(header, payload)) == ipcFrameReady)
+	{
+		if (header.type == ipcAck && header.length == sizeof(IpcAckMessage))
+		{
+			IpcAckMessage ack;
+			memcpy(&ack, payload, sizeof(ack));
+			acks.push_back(ack);
+		}
+		else if (header.type == ipcTelemetry && header.length >= sizeof(IpcTelemetryHeader))
+		{
+			IpcTelemetryHeader telemetry;
+			memcpy(&telemetry, payload, sizeof(telemetry));
+			if (header.length != sizeof(telemetry) + static_cast<size_t> (telemetry.count) * sizeof(IpcSample))
+			{
+				return false;
+			}
+			for (uint32_t index(0); index < telemetry.count; index++)
+			{
+				IpcSample sample;
+				memcpy(&sample, payload + sizeof(telemetry) + index * sizeof(IpcSample), sizeof(sample));
+				samples.push_back(ipcSampleToCurrent(sample));
+			}
+			if (dropped != NULL)
+			{
+				*dropped += telemetry.dropped;
+			}
+		}
+	}
+	return status != ipcFrameBad;
+}
@@ -0,0 +1,137 @@
+#include "ipc/ipc_protocol.h"
+
+#include <chrono>
+#include <cstring>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+void ipcAppendFrame(std::vector<uint8_t> &out, uint8_t type, uint8_t flags, const void *payload, size_t length)
+{
+	IpcHeader header;
+	header.magic = IPC_MAGIC;
+	header.type = type;
+	header.flags = flags;
+	header.length = static_cast<uint32_t> (length);
+	const uint8_t *headerBytes(reinterpret_cast<const uint8_t*> (&header));
+	out.insert(out.end(), headerBytes, headerBytes + sizeof(header));
+	if (length > 0)
+	{
+		const uint8_t *payloadBytes(static_cast<const uint8_t*> (payload));
+		out.insert(out.end(), payloadBytes, payloadBytes + length);
+	}
+}
+
+bool ipcAppendSetpoints(std::vector<uint8_t> &out, const IpcRequest &request, const double *milliAmp,
+	size_t nChannels, size_t nSteps, const double *delayMS, size_t nDelays, uint8_t flags)
+{
+	if (nChannels < 1 || nChannels > NCHANNELS || nSteps < 1 || nSteps > 65535 || (nDelays != 1 && nDelays != nSteps))
+	{
+		return false;
+	}
+	size_t currentBytes(nChannels * nSteps * sizeof(double));
+	size_t delayBytes(nDelays * sizeof(double));
+	size_t length(sizeof(IpcSetpoints) + currentBytes + delayBytes);
+	if (length > IPC_MAX_PAYLOAD)
+	{
+		return false;
+	}
+	IpcSetpoints setpoints;
+	setpoints.request = request;
+	setpoints.nChannels = static_cast<uint16_t> (nChannels);
+	setpoints.nSteps = static_cast<uint16_t> (nSteps);
+	setpoints.nDelays = static_cast<uint16_t> (nDelays);
+	setpoints.reserved = 0;
+
+	// header, setpoint header, currents and delays, written in place.
+	size_t start(out.size());
+	ipcAppendFrame(out, ipcSetpoints, flags, NULL, 0);
+	reinterpret_cast<IpcHeader*> (&out[start])->length = static_cast<uint32_t> (length);
+	out.resize(start + IPC_HEADER_LEN + length);
+	uint8_t *payload(&out[start + IPC_HEADER_LEN]);
+	memcpy(payload, &setpoints, sizeof(setpoints));
+	memcpy(payload + sizeof(setpoints), milliAmp, currentBytes);
+	memcpy(payload + sizeof(setpoints) + currentBytes, delayMS, delayBytes);
+	return true;
+}
+
+IpcSample ipcSampleFromCurrent(const CurrentSample &sample)
+{
+	IpcSample ipcSample;
+	ipcSample.time = sample.time;
+	ipcSample.dacCounts = sample.dacCounts;
+	ipcSample.adcCounts = sample.adcCounts;
+	ipcSample.channel = static_cast<uint8_t> (sample.channel);
+	ipcSample.dir = static_cast<uint8_t> (sample.dir);
+	ipcSample.polled = sample.polled ? 1 : 0;
+	ipcSample.reserved = 0;
+	return ipcSample;
+}
+
+CurrentSample ipcSampleToCurrent(const IpcSample &ipcSample)
+{
+	CurrentSample sample;
+	sample.time = ipcSample.time;
+	sample.channel = ipcSample.channel;
+	sample.dir = ipcSample.dir ? DIR_POS : DIR_NEG;
+	sample.dacCounts = ipcSample.dacCounts;
+	sample.adcCounts = ipcSample.adcCounts;
+	sample.polled = ipcSample.polled != 0;
+	return sample;
+}
+
+uint64_t ipcNowNs()
+{
+	return static_cast<uint64_t> (std::chrono::duration_cast<std::chrono::nanoseconds> (
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+
+IpcFrameReader::IpcFrameReader() : offset(0)
+{
+}
+
+void IpcFrameReader::feed(const uint8_t *bytes, size_t count)
+{
+	// drop the frames already handed out before growing the buffer.
+	if (offset > 0)
+	{
+		buffer.erase(buffer.begin(), buffer.begin() + offset);
+		offset = 0;
+	}
+	buffer.insert(buffer.end(), bytes, bytes + count);
+}
+
+IpcFrameStatus IpcFrameReader::next(IpcHeader &header, const uint8_t *&payload)
+{
+	if (buffer.size() - offset < IPC_HEADER_LEN)
+	{
+		return ipcFrameNeedMore;
+	}
+	memcpy(&header, &buffer[offset], sizeof(header));
+	if (header.magic != IPC_MAGIC || header.length > IPC_MAX_PAYLOAD)
+	{
+		return ipcFrameBad;
+	}
+	if (buffer.size() - offset < IPC_HEADER_LEN + header.length)
+	{
+		return ipcFrameNeedMore;
+	}
+	payload = buffer.data() + offset + IPC_HEADER_LEN;
+	offset += IPC_HEADER_LEN + header.length;
+	return ipcFrameReady;
+}
+
+size_t IpcFrameReader::buffered() const
+{
+	return buffer.size() - offset;
+}
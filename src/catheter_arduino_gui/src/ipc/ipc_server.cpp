@@ -0,0 +1,502 @@
+#include "ipc/ipc_server.h"
+#include "com/command_sequence.h"
+#include "com/pc_utils.h"
+#include "util/trace.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// replies moved out of the telemetry ring at a time.
+#define IPC_DRAIN_BATCH 4096
+
+#define IPC_READ_CHUNK 65536
+
+namespace
+{
+	bool setNonBlocking(int fd)
+	{
+		int flags(fcntl(fd, F_GETFL));
+		return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+	}
+
+	bool fillAddress(const std::string &path, struct sockaddr_un &address)
+	{
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		if (path.empty() || path.size() >= sizeof(address.sun_path))
+		{
+			return false;
+		}
+		strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+		return true;
+	}
+
+	// true if a server is already answering on the path.
+	bool socketInUse(const struct sockaddr_un &address)
+	{
+		int fd(socket(AF_UNIX, SOCK_STREAM, 0));
+		if (fd < 0)
+		{
+			return false;
+		}
+		bool inUse(connect(fd, reinterpret_cast<const struct sockaddr*> (&address), sizeof(address)) == 0);
+		close(fd);
+		return inUse;
+	}
+}
+
+IpcServer::IpcServer(SerialThreadObject &serialObject_) : serialObject(serialObject_), mailbox(NULL),
+	telemetryRing(IPC_TELEMETRY_RING), drainBuffer(IPC_DRAIN_BATCH), listenFd(-1), droppedReported(0), active(false)
+{
+	wakePipe[0] = -1;
+	wakePipe[1] = -1;
+}
+
+IpcServer::~IpcServer()
+{
+	stop();
+}
+
+bool IpcServer::start(const std::string &socketPath_)
+{
+	if (active)
+	{
+		return true;
+	}
+	struct sockaddr_un address;
+	if (!fillAddress(socketPath_, address) || socketInUse(address))
+	{
+		return false;
+	}
+	// a socket file left by a server that did not stop cleanly.
+	unlink(socketPath_.c_str());
+
+	listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenFd < 0)
+	{
+		return false;
+	}
+	if (bind(listenFd, reinterpret_cast<struct sockaddr*> (&address), sizeof(address)) != 0
+		|| listen(listenFd, IPC_MAX_CLIENTS) != 0 || !setNonBlocking(listenFd) || pipe(wakePipe) != 0)
+	{
+		close(listenFd);
+		listenFd = -1;
+		unlink(socketPath_.c_str());
+		return false;
+	}
+	setNonBlocking(wakePipe[0]);
+	socketPath = socketPath_;
+	active = true;
+	thrd = boost::thread(boost::bind(&IpcServer::serverLoop, this));
+	return true;
+}
+
+void IpcServer::stop()
+{
+	if (!active)
+	{
+		return;
+	}
+	// the loop exits when the pipe becomes readable.
+	char wake(0);
+	if (write(wakePipe[1], &wake, 1) != 1)
+	{
+		thrd.interrupt();
+	}
+	thrd.join();
+	active = false;
+
+	serialObject.setSampleTap(NULL);
+	while (!clients.empty())
+	{
+		closeClient(clients.size() - 1);
+	}
+	close(listenFd);
+	close(wakePipe[0]);
+	close(wakePipe[1]);
+	listenFd = -1;
+	wakePipe[0] = -1;
+	wakePipe[1] = -1;
+	unlink(socketPath.c_str());
+}
+
+bool IpcServer::running() const
+{
+	return active;
+}
+
+void IpcServer::getStats(IpcServerStats &stats_)
+{
+	boost::mutex::scoped_lock lock(statsMutex);
+	stats_ = stats;
+}
+
+void IpcServer::setMailbox(SetpointMailbox *mailbox_)
+{
+	mailbox = mailbox_;
+}
+
+void IpcServer::serverLoop()
+{
+	CATHETER_TRACE_THREAD_NAME("ipc server");
+	std::vector<struct pollfd> fds;
+	while (true)
+	{
+		bool subscribers(false);
+		fds.resize(2 + clients.size());
+		fds[0].fd = wakePipe[0];
+		fds[0].events = POLLIN;
+		fds[1].fd = listenFd;
+		fds[1].events = POLLIN;
+		for (size_t i(0); i < clients.size(); i++)
+		{
+			fds[2 + i].fd = clients[i].fd;
+			fds[2 + i].events = POLLIN | (clients[i].output.empty() ? 0 : POLLOUT);
+			subscribers = subscribers || clients[i].subscribed;
+		}
+		for (size_t i(0); i < fds.size(); i++)
+		{
+			fds[i].revents = 0;
+		}
+		int ready(poll(fds.data(), fds.size(), subscribers ? IPC_TELEMETRY_PERIOD_MS : -1));
+		if (ready < 0 && errno != EINTR)
+		{
+			break;
+		}
+		if (fds[0].revents != 0)
+		{
+			break;
+		}
+		if (fds[1].revents & POLLIN)
+		{
+			acceptClients();
+		}
+		// from the back, so closing a client does not move the ones still to do.
+		for (size_t i(fds.size() - 2); i-- > 0;)
+		{
+			short revents(fds[2 + i].revents);
+			bool keep(true);
+			if (revents & (POLLIN | POLLHUP | POLLERR))
+			{
+				keep = readClient(clients[i]);
+			}
+			if (keep && (revents & POLLOUT))
+			{
+				keep = flushClient(clients[i]);
+			}
+			if (!keep)
+			{
+				closeClient(i);
+			}
+		}
+		sendTelemetry();
+	}
+}
+
+void IpcServer::acceptClients()
+{
+	while (true)
+	{
+		int fd(accept(listenFd, NULL, NULL));
+		if (fd < 0)
+		{
+			return;
+		}
+		boost::mutex::scoped_lock lock(statsMutex);
+		if (clients.size() >= IPC_MAX_CLIENTS || !setNonBlocking(fd))
+		{
+			close(fd);
+			stats.clientsRejected++;
+			continue;
+		}
+		clients.push_back(Client());
+		clients.back().fd = fd;
+		clients.back().subscribed = false;
+		stats.clientsAccepted++;
+		stats.clientsActive = static_cast<int> (clients.size());
+	}
+}
+
+bool IpcServer::readClient(Client &client)
+{
+	uint8_t chunk[IPC_READ_CHUNK];
+	while (true)
+	{
+		ssize_t count(recv(client.fd, chunk, sizeof(chunk), 0));
+		if (count == 0)
+		{
+			return false;
+		}
+		if (count < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				break;
+			}
+			return false;
+		}
+		client.reader.feed(chunk, count);
+
+		IpcHeader header;
+		const uint8_t *payload(NULL);
+		IpcFrameStatus status;
+		while ((status = client.reader.next(header, payload)) == ipcFrameReady)
+		{
+			if (!handleFrame(client, header, payload))
+			{
+				return false;
+			}
+		}
+		if (status == ipcFrameBad)
+		{
+			boost::mutex::scoped_lock lock(statsMutex);
+			stats.framesBad++;
+			return false;
+		}
+		if (static_cast<size_t> (count) < sizeof(chunk))
+		{
+			break;
+		}
+	}
+	return flushClient(client);
+}
+
+bool IpcServer::handleFrame(Client &client, const IpcHeader &header, const uint8_t *payload)
+{
+	CATHETER_TRACE_SCOPE("ipc frame");
+	if (header.length < sizeof(IpcRequest))
+	{
+		boost::mutex::scoped_lock lock(statsMutex);
+		stats.framesBad++;
+		return false;
+	}
+	IpcRequest request;
+	memcpy(&request, payload, sizeof(request));
+
+	IpcAckMessage ack;
+	ack.sequence = request.sequence;
+	ack.sendNs = request.sendNs;
+	ack.status = ipcOk;
+	ack.queuedSets = 0;
+
+	switch (header.type)
+	{
+	case ipcSetpoints:
+	{
+		IpcSetpoints setpoints;
+		size_t currentCount(0);
+		bool valid(header.length >= sizeof(setpoints));
+		if (valid)
+		{
+			memcpy(&setpoints, payload, sizeof(setpoints));
+			currentCount = static_cast<size_t> (setpoints.nChannels) * setpoints.nSteps;
+			valid = header.length == sizeof(setpoints) + (currentCount + setpoints.nDelays) * sizeof(double);
+		}
+		if (valid && (header.flags & IPC_FLAG_LATEST) != 0)
+		{
+			// the first current of each channel, the delays do not apply.
+			if (mailbox == NULL || setpoints.nSteps != 1 || setpoints.nChannels > NCHANNELS)
+			{
+				ack.status = ipcInvalid;
+				break;
+			}
+			currentBuffer.resize(setpoints.nChannels);
+			memcpy(currentBuffer.data(), payload + sizeof(setpoints), setpoints.nChannels * sizeof(double));
+			mailbox->write(currentBuffer.data(), setpoints.nChannels, (header.flags & IPC_FLAG_POLL) != 0);
+			break;
+		}
+		CatheterCmdSequence cmdSequence;
+		if (valid)
+		{
+			// the payload is not aligned for doubles.
+			currentBuffer.resize(currentCount);
+			delayBuffer.resize(setpoints.nDelays);
+			memcpy(currentBuffer.data(), payload + sizeof(setpoints), currentCount * sizeof(double));
+			memcpy(delayBuffer.data(), payload + sizeof(setpoints) + currentCount * sizeof(double),
+				setpoints.nDelays * sizeof(double));
+			valid = currentMatrix2Sequence(currentBuffer.data(), setpoints.nChannels, setpoints.nSteps,
+				delayBuffer.data(), setpoints.nDelays, (header.flags & IPC_FLAG_POLL) != 0, cmdSequence) == 0;
+		}
+		if (!valid)
+		{
+			ack.status = ipcInvalid;
+			break;
+		}
+		std::vector<CatheterChannelCmdSet> cmdVect;
+		cmdSequence.toCmdSets(cmdVect);
+		serialObject.queueCommands(cmdVect, (header.flags & IPC_FLAG_FLUSH) != 0);
+		ack.queuedSets = static_cast<uint32_t> (cmdVect.size());
+		boost::mutex::scoped_lock lock(statsMutex);
+		stats.setsQueued += cmdVect.size();
+	}
+	break;
+	case ipcReset:
+		serialObject.serialCommand(SerialThreadObject::resetArduino);
+		break;
+	case ipcPoll:
+		// queued after the current stream, unlike the gui poll button.
+		serialObject.queueCommand(pollCmd());
+		ack.queuedSets = 1;
+		break;
+	case ipcAbort:
+		serialObject.queueCommands(std::vector<CatheterChannelCmdSet>(), true);
+		break;
+	case ipcSubscribe:
+	{
+		client.subscribed = (header.flags & IPC_FLAG_ENABLE) != 0;
+		bool subscribers(false);
+		for (size_t i(0); i < clients.size(); i++)
+		{
+			subscribers = subscribers || clients[i].subscribed;
+		}
+		// the tap is only fed while someone reads it.
+		serialObject.setSampleTap(subscribers ? &telemetryRing : NULL);
+	}
+	break;
+	default:
+		ack.status = ipcInvalid;
+	}
+	ack.queuedNs = ipcNowNs();
+	ipcAppendFrame(client.output, ipcAck, 0, &ack, sizeof(ack));
+
+	boost::mutex::scoped_lock lock(statsMutex);
+	stats.framesIn++;
+	return true;
+}
+
+bool IpcServer::flushClient(Client &client)
+{
+	size_t sent(0);
+	while (sent < client.output.size())
+	{
+		ssize_t count(send(client.fd, client.output.data() + sent, client.output.size() - sent,
+			MSG_NOSIGNAL | MSG_DONTWAIT));
+		if (count < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				break;
+			}
+			return false;
+		}
+		sent += count;
+	}
+	client.output.erase(client.output.begin(), client.output.begin() + sent);
+	return client.output.size() <= IPC_MAX_BACKLOG;
+}
+
+void IpcServer::sendTelemetry()
+{
+	bool subscribers(false);
+	for (size_t i(0); i < clients.size(); i++)
+	{
+		subscribers = subscribers || clients[i].subscribed;
+	}
+	if (!subscribers)
+	{
+		return;
+	}
+	size_t count;
+	while ((count = telemetryRing.popBulk(drainBuffer.data(), drainBuffer.size())) > 0)
+	{
+		sampleBuffer.resize(count);
+		for (size_t index(0); index < count; index++)
+		{
+			sampleBuffer[index] = ipcSampleFromCurrent(drainBuffer[index]);
+		}
+		uint64_t dropped(telemetryRing.droppedCount());
+		IpcTelemetryHeader telemetry;
+		telemetry.count = static_cast<uint32_t> (count);
+		telemetry.dropped = static_cast<uint32_t> (dropped - droppedReported);
+		droppedReported = dropped;
+
+		telemetryFrame.clear();
+		ipcAppendFrame(telemetryFrame, ipcTelemetry, 0, NULL, 0);
+		reinterpret_cast<IpcHeader*> (telemetryFrame.data())->length =
+			static_cast<uint32_t> (sizeof(telemetry) + count * sizeof(IpcSample));
+		const uint8_t *telemetryBytes(reinterpret_cast<const uint8_t*> (&telemetry));
+		const uint8_t *sampleBytes(reinterpret_cast<const uint8_t*> (sampleBuffer.data()));
+		telemetryFrame.insert(telemetryFrame.end(), telemetryBytes, telemetryBytes + sizeof(telemetry));
+		telemetryFrame.insert(telemetryFrame.end(), sampleBytes, sampleBytes + count * sizeof(IpcSample));
+
+		uint64_t samplesOut(0);
+		uint64_t samplesDropped(telemetry.dropped);
+		for (size_t i(clients.size()); i-- > 0;)
+		{
+			if (!clients[i].subscribed)
+			{
+				continue;
+			}
+			// a slow subscriber loses telemetry, it is not disconnected for it.
+			if (clients[i].output.size() > IPC_MAX_BACKLOG / 2)
+			{
+				samplesDropped += count;
+				continue;
+			}
+			clients[i].output.insert(clients[i].output.end(), telemetryFrame.begin(), telemetryFrame.end());
+			samplesOut += count;
+			if (!flushClient(clients[i]))
+			{
+				closeClient(i);
+			}
+		}
+		boost::mutex::scoped_lock lock(statsMutex);
+		stats.samplesOut += samplesOut;
+		stats.samplesDropped += samplesDropped;
+	}
+}
+
+void IpcServer::closeClient(size_t index)
+{
+	int fd(clients[index].fd);
+	bool wasSubscribed(clients[index].subscribed);
+	clients.erase(clients.begin() + index);
+	if (wasSubscribed)
+	{
+		bool subscribers(false);
+		for (size_t i(0); i < clients.size(); i++)
+		{
+			subscribers = subscribers || clients[i].subscribed;
+		}
+		if (!subscribers)
+		{
+			serialObject.setSampleTap(NULL);
+		}
+	}
+	{
+		boost::mutex::scoped_lock lock(statsMutex);
+		stats.clientsActive = static_cast<int> (clients.size());
+	}
+	// closed last, so a client seeing the hang up also sees the stats.
+	close(fd);
+}
@@ -0,0 +1,350 @@
+#include "com/catheter_commands.h"
+#include "com/command_sequence.h"
+#include "com/current_sample.h"
+#include "com/pc_utils.h"
+#include "hardware/digital_analog_conversions.h"
+#include "ser/serial_session.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+// Python bindings of the protocol core and the serial session.
+// Arrays are taken as C ordered NumPy buffers: a float64 (T, nchannels) array
+// is passed to the encoder as is (it has the same layout as the column major
+// nchannels x T matrix of currentMatrix2Sequence), other dtypes or orders are
+// converted once. Outputs are allocated as NumPy arrays and written in place.
+
+namespace py = pybind11;
+
+typedef py::array_t<double, py::array::c_style | py::array::forcecast> DoubleArray;
+typedef py::array_t<uint8_t, py::array::c_style | py::array::forcecast> ByteArray;
+
+namespace
+{
+	// the NumPy record type of a CurrentSample (the ring entries are copied as is).
+	py::dtype sampleDtype()
+	{
+		static_assert(sizeof(dir_t) == 4, "dir_t is expected to be 32 bits");
+		py::list names, formats, offsets;
+		names.append("time");       formats.append("<f8"); offsets.append(offsetof(CurrentSample, time));
+		names.append("channel");    formats.append("<i4"); offsets.append(offsetof(CurrentSample, channel));
+		names.append("dir");        formats.append("<i4"); offsets.append(offsetof(CurrentSample, dir));
+		names.append("dac_counts"); formats.append("<u2"); offsets.append(offsetof(CurrentSample, dacCounts));
+		names.append("adc_counts"); formats.append("<u2"); offsets.append(offsetof(CurrentSample, adcCounts));
+		names.append("polled");     formats.append("?");   offsets.append(offsetof(CurrentSample, polled));
+		return py::dtype(names, formats, offsets, sizeof(CurrentSample));
+	}
+
+	// checks a (T, nchannels) current array and its delays, returns T.
+	size_t checkSetpoints(const DoubleArray &currents, const DoubleArray &delays)
+	{
+		if (currents.ndim() != 2)
+		{
+			throw std::invalid_argument("currents must be a (steps, channels) array");
+		}
+		size_t nSteps(static_cast<size_t> (currents.shape(0)));
+		size_t nChannels(static_cast<size_t> (currents.shape(1)));
+		if (nChannels < 1 || nChannels > NCHANNELS)
+		{
+			throw std::invalid_argument("currents must have 1 to " + std::to_string(NCHANNELS) + " columns (channels)");
+		}
+		if (delays.size() != 1 && static_cast<size_t> (delays.size()) != nSteps)
+		{
+			throw std::invalid_argument("delays must be a scalar or have one value per step");
+		}
+		return nSteps;
+	}
+
+	py::tuple encode(const DoubleArray &currents, const DoubleArray &delays, int firstSeq, bool poll)
+	{
+		size_t nSteps(checkSetpoints(currents, delays));
+		size_t nChannels(static_cast<size_t> (currents.shape(1)));
+
+		CatheterCmdSequence cmdSequence;
+		{
+			py::gil_scoped_release release;
+			currentMatrix2Sequence(currents.data(), nChannels, nSteps, delays.data(), delays.size(), poll, cmdSequence);
+		}
+		py::array_t<uint8_t> bytes(encodedLength(cmdSequence));
+		py::array_t<uint32_t> offsets(nSteps + 1);
+		uint8_t *bytesOut(bytes.mutable_data());
+		uint32_t *offsetsOut(offsets.mutable_data());
+		{
+			py::gil_scoped_release release;
+			encodeSequence(cmdSequence, firstSeq, bytesOut, offsetsOut);
+		}
+		return py::make_tuple(bytes, offsets);
+	}
+
+	py::dict decode(const ByteArray &bytes)
+	{
+		std::vector<CatheterChannelCmd> cmds;
+		std::vector<uint32_t> packetIndex;
+		size_t skipped(0);
+		size_t consumed(0);
+		{
+			py::gil_scoped_release release;
+			consumed = decodeReplyStream(bytes.data(), static_cast<size_t> (bytes.size()), cmds, packetIndex, skipped);
+		}
+
+		size_t n(cmds.size());
+		py::array_t<int32_t> channel(n);
+		py::array_t<int8_t> dir(n);
+		py::array_t<uint16_t> dacCounts(n);
+		py::array_t<uint16_t> adcCounts(n);
+		py::array_t<bool> polled(n);
+		py::array_t<uint32_t> packet(n);
+		py::array_t<double> setMilliAmp(n);
+		py::array_t<double> sensedMilliAmp(n);
+		int32_t *channelOut(channel.mutable_data());
+		int8_t *dirOut(dir.mutable_data());
+		uint16_t *dacOut(dacCounts.mutable_data());
+		uint16_t *adcOut(adcCounts.mutable_data());
+		bool *polledOut(polled.mutable_data());
+		uint32_t *packetOut(packet.mutable_data());
+		double *setOut(setMilliAmp.mutable_data());
+		double *sensedOut(sensedMilliAmp.mutable_data());
+		{
+			py::gil_scoped_release release;
+			for (size_t i(0); i < n; i++)
+			{
+				const CatheterChannelCmd &cmd(cmds[i]);
+				channelOut[i] = cmd.channel;
+				dirOut[i] = static_cast<int8_t> (cmd.dir);
+				dacOut[i] = cmd.dacCounts;
+				adcOut[i] = cmd.adcCounts;
+				polledOut[i] = cmd.poll;
+				packetOut[i] = packetIndex[i];
+				setOut[i] = cmdMilliAmp(cmd);
+				sensedOut[i] = cmd.poll ? cmdSensedMilliAmp(cmd) : 0.0;
+			}
+		}
+
+		py::dict result;
+		result["channel"] = channel;
+		result["dir"] = dir;
+		result["dac_counts"] = dacCounts;
+		result["adc_counts"] = adcCounts;
+		result["polled"] = polled;
+		result["packet"] = packet;
+		result["set_ma"] = setMilliAmp;
+		result["sensed_ma"] = sensedMilliAmp;
+		result["consumed"] = consumed;
+		result["skipped"] = skipped;
+		return result;
+	}
+
+	py::dict loadPlayfile(const std::string &fname)
+	{
+		CatheterCmdSequence cmdSequence;
+		if (loadPlayFile(fname.c_str(), cmdSequence) < 0)
+		{
+			throw std::runtime_error("unable to read " + fname);
+		}
+		size_t nSets(cmdSequence.size());
+		py::array_t<double> timeMS(nSets);
+		py::array_t<double> delayMS(nSets);
+		py::array_t<double> currents(std::vector<py::ssize_t>{static_cast<py::ssize_t> (nSets), NCHANNELS});
+		double *timeOut(timeMS.mutable_data());
+		double *delayOut(delayMS.mutable_data());
+		double *currentsOut(currents.mutable_data());
+		{
+			py::gil_scoped_release release;
+			sequenceTimeline(cmdSequence, timeOut, currentsOut);
+			for (size_t i(0); i < nSets; i++)
+			{
+				delayOut[i] = static_cast<double> (cmdSequence[i].delayTime);
+			}
+		}
+
+		py::dict result;
+		result["time_ms"] = timeMS;
+		result["delay_ms"] = delayMS;
+		result["currents"] = currents;
+		return result;
+	}
+
+	// set and sensed milliamps of telemetry records (calibrated per channel).
+	py::tuple telemetryMilliAmp(const py::array &records)
+	{
+		if (!records.dtype().equal(sampleDtype()) || records.ndim() != 1 || !(records.flags() & py::array::c_style))
+		{
+			throw std::invalid_argument("expected a contiguous array of telemetry records");
+		}
+		size_t n(static_cast<size_t> (records.shape(0)));
+		const CurrentSample *samples(static_cast<const CurrentSample*> (records.data()));
+		py::array_t<double> setMilliAmp(n);
+		py::array_t<double> sensedMilliAmp(n);
+		double *setOut(setMilliAmp.mutable_data());
+		double *sensedOut(sensedMilliAmp.mutable_data());
+		{
+			py::gil_scoped_release release;
+			for (size_t i(0); i < n; i++)
+			{
+				setOut[i] = dac2MilliAmp(samples[i].dacCounts, samples[i].dir, samples[i].channel);
+				sensedOut[i] = samples[i].polled ? adc2MilliAmp(samples[i].adcCounts, samples[i].channel) : 0.0;
+			}
+		}
+		return py::make_tuple(setMilliAmp, sensedMilliAmp);
+	}
+
+	/**
+	 \brief The Python session, close() releases the port before the object is collected.
+	 */
+	class PySession
+	{
+	public:
+		explicit PySession(size_t ringSamples) : session(new SerialSession(ringSamples))
+		{
+		}
+
+		SerialSession& get()
+		{
+			if (!session)
+			{
+				throw std::runtime_error("the session is closed");
+			}
+			return *session;
+		}
+
+		void open(const std::string &portName)
+		{
+			bool opened(false);
+			{
+				py::gil_scoped_release release;
+				opened = get().open(portName);
+			}
+			if (!opened)
+			{
+				throw std::runtime_error("unable to open " + portName);
+			}
+		}
+
+		void enqueue(const DoubleArray &currents, const DoubleArray &delays, bool poll)
+		{
+			size_t nSteps(checkSetpoints(currents, delays));
+			SerialSession &serialSession(get());
+			py::gil_scoped_release release;
+			serialSession.enqueue(currents.data(), static_cast<size_t> (currents.shape(1)), nSteps,
+				delays.data(), delays.size(), poll);
+		}
+
+		// the replies are popped straight into the returned array.
+		py::array pollTelemetry()
+		{
+			SerialSession &serialSession(get());
+			// this is the only consumer, so at least this many can be popped.
+			size_t pending(serialSession.pendingTelemetry());
+			py::array records(sampleDtype(), std::vector<py::ssize_t>{static_cast<py::ssize_t> (pending)});
+			CurrentSample *samples(static_cast<CurrentSample*> (records.mutable_data()));
+			{
+				py::gil_scoped_release release;
+				serialSession.pollTelemetry(samples, pending);
+			}
+			return records;
+		}
+
+		py::dict stats()
+		{
+			SerialSession &serialSession(get());
+			PlaybackStats playback;
+			serialSession.getStats(playback);
+			py::dict result;
+			result["connected"] = serialSession.isOpen();
+			result["queued"] = serialSession.queuedSets();
+			result["idle"] = serialSession.idle();
+			result["sets_sent"] = playback.setsSent;
+			result["replies_valid"] = playback.repliesValid;
+			result["replies_invalid"] = playback.repliesInvalid;
+			result["lateness_p50_us"] = latenessPercentile(playback, 0.50);
+			result["lateness_p99_us"] = latenessPercentile(playback, 0.99);
+			result["lateness_max_us"] = playback.maxLatenessUs;
+			result["rtt_p50_us"] = rttPercentile(playback, 0.50);
+			result["rtt_p99_us"] = rttPercentile(playback, 0.99);
+			result["rtt_max_us"] = playback.maxRttUs;
+			result["echo_mismatches"] = playback.echoMismatches;
+			result["reply_timeouts"] = playback.replyTimeouts;
+			result["telemetry_dropped"] = serialSession.droppedTelemetry();
+			return result;
+		}
+
+		py::list messages()
+		{
+			const ConsoleLog &log(get().log());
+			py::list result;
+			ConsoleLine line;
+			for (uint64_t seq(log.firstSeq()); seq < log.endSeq(); seq++)
+			{
+				if (log.getLine(seq, line))
+				{
+					result.append(py::str(line.text));
+				}
+			}
+			return result;
+		}
+
+		void close()
+		{
+			py::gil_scoped_release release;
+			session.reset();
+		}
+
+	private:
+		std::unique_ptr<SerialSession> session;
+	};
+}
+
+
+PYBIND11_MODULE(catheter_py, m)
+{
+	m.doc() = "Catheter protocol encoding, playfile loading and serial streaming.";
+
+	m.attr("NCHANNELS") = NCHANNELS;
+	m.attr("GLOBAL_ADDR") = GLOBAL_ADDR;
+	m.attr("telemetry_dtype") = sampleDtype();
+
+	m.def("encode", &encode, py::arg("currents"), py::arg("delays"), py::arg("first_seq") = 0, py::arg("poll") = false,
+		"Encodes a (steps, channels) milliamp array, returns (bytes, offsets).\n"
+		"Packet i is bytes[offsets[i]:offsets[i + 1]].");
+	m.def("decode", &decode, py::arg("bytes"),
+		"Decodes back to back replies into per command arrays (channel, dir, dac_counts, adc_counts,\n"
+		"polled, packet, set_ma, sensed_ma) plus the consumed and skipped byte counts.");
+	m.def("load_playfile", &loadPlayfile, py::arg("path"),
+		"Loads a playfile into time_ms, delay_ms and a (sets, NCHANNELS) array of held currents.");
+	m.def("load_calibration", [](const std::string &fname) { return loadCalibrationFile(fname.c_str()); }, py::arg("path"),
+		"Loads a channel calibration file, returns the number of channels calibrated.");
+	m.def("telemetry_milliamp", &telemetryMilliAmp, py::arg("records"),
+		"Converts telemetry records to (set_ma, sensed_ma) arrays.");
+
+	py::class_<PySession>(m, "Session")
+		.def(py::init<size_t>(), py::arg("ring_samples") = SESSION_RING_SAMPLES)
+		.def("open", &PySession::open, py::arg("port"))
+		.def("enqueue", &PySession::enqueue, py::arg("currents"), py::arg("delays"), py::arg("poll") = false,
+			"Queues a (steps, channels) milliamp array without blocking.")
+		.def("reset", [](PySession &self) { self.get().reset(); })
+		.def("poll_telemetry", &PySession::pollTelemetry,
+			"Returns the replies received since the last call as telemetry_dtype records.")
+		.def("stats", &PySession::stats)
+		.def("messages", &PySession::messages)
+		.def("close", &PySession::close)
+		.def("__enter__", [](PySession &self) -> PySession& { return self; })
+		.def("__exit__", [](PySession &self, py::args) { self.close(); });
+}
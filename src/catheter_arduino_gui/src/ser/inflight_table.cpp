@@ -0,0 +1,186 @@
+#include "ser/inflight_table.h"
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+InFlightTable::InFlightTable()
+{
+	for (int i(0); i < INFLIGHT_SLOTS; i++)
+	{
+		for (int j(0); j < INFLIGHT_DEPTH; j++)
+		{
+			slots[i].entries[j].expected.reserve(NCHANNELS);
+		}
+	}
+}
+
+bool InFlightTable::sent(int packetIndex, const CatheterChannelCmdSet &cmdSet, double sendTime)
+{
+	Slot &slot(slots[packetIndex & (INFLIGHT_SLOTS - 1)]);
+	bool dropped(slot.count == INFLIGHT_DEPTH);
+	if (dropped)
+	{
+		dropOldest(slot);
+	}
+	Entry &entry(slot.entries[(slot.first + slot.count) % INFLIGHT_DEPTH]);
+	slot.count++;
+	entry.sendTime = sendTime;
+	entry.expected.clear();
+	for (size_t i(0); i < cmdSet.commandList.size(); i++)
+	{
+		const CatheterChannelCmd &cmd(cmdSet.commandList[i]);
+		if (cmd.channel == GLOBAL_ADDR)
+		{
+			for (int channel(1); channel <= NCHANNELS; channel++)
+			{
+				entry.expected.push_back(cmd);
+				entry.expected.back().channel = channel;
+			}
+		}
+		else
+		{
+			entry.expected.push_back(cmd);
+		}
+	}
+	return dropped;
+}
+
+ReplyMatch InFlightTable::reply(int packetIndex, const std::vector<CatheterChannelCmd> &echo, double replyTime, double &rttUs,
+	int &lost)
+{
+	Slot &slot(slots[packetIndex & (INFLIGHT_SLOTS - 1)]);
+	lost = 0;
+	// the firmware answers in order, an echo of a newer packet means the replies before it were lost.
+	for (int i(0); i < slot.count; i++)
+	{
+		const Entry &entry(slot.entries[(slot.first + i) % INFLIGHT_DEPTH]);
+		if (echoes(entry, echo))
+		{
+			rttUs = (replyTime - entry.sendTime) * 1.0e6;
+			for (int j(0); j <= i; j++)
+			{
+				popOldest(slot);
+			}
+			lost = i;
+			slot.owed = 0;
+			return replyMatched;
+		}
+	}
+	// the replies of dropped packets come before those of the packets still waiting.
+	if (slot.owed > 0)
+	{
+		slot.owed--;
+		return replyLate;
+	}
+	if (slot.count == 0)
+	{
+		return replyUnmatched;
+	}
+	rttUs = (replyTime - slot.entries[slot.first].sendTime) * 1.0e6;
+	popOldest(slot);
+	return replyMismatch;
+}
+
+bool InFlightTable::replyInvalid()
+{
+	Slot *oldest(NULL);
+	for (int i(0); i < INFLIGHT_SLOTS; i++)
+	{
+		Slot &slot(slots[i]);
+		if (slot.count > 0 && (oldest == NULL
+			|| slot.entries[slot.first].sendTime < oldest->entries[oldest->first].sendTime))
+		{
+			oldest = &slot;
+		}
+	}
+	if (oldest == NULL)
+	{
+		return false;
+	}
+	popOldest(*oldest);
+	return true;
+}
+
+bool InFlightTable::echoes(const Entry &entry, const std::vector<CatheterChannelCmd> &echo)
+{
+	if (echo.size() != entry.expected.size())
+	{
+		return false;
+	}
+	for (size_t i(0); i < echo.size(); i++)
+	{
+		const CatheterChannelCmd &sentCmd(entry.expected[i]);
+		if (echo[i].channel != sentCmd.channel)
+		{
+			return false;
+		}
+		if (!sentCmd.poll && (echo[i].dacCounts != sentCmd.dacCounts || echo[i].enable != sentCmd.enable
+			|| echo[i].dir != sentCmd.dir))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int InFlightTable::expire(double now, double timeoutSeconds)
+{
+	int expired(0);
+	for (int i(0); i < INFLIGHT_SLOTS; i++)
+	{
+		// the fifo is in send order, so only its front can be the oldest.
+		Slot &slot(slots[i]);
+		while (slot.count > 0 && now - slot.entries[slot.first].sendTime > timeoutSeconds)
+		{
+			dropOldest(slot);
+			expired++;
+		}
+		if (slot.owed > 0 && now - slot.owedTime > 2.0 * timeoutSeconds)
+		{
+			slot.owed = 0;
+		}
+	}
+	return expired;
+}
+
+void InFlightTable::dropOldest(Slot &slot)
+{
+	slot.owed++;
+	slot.owedTime = slot.entries[slot.first].sendTime;
+	popOldest(slot);
+}
+
+void InFlightTable::popOldest(Slot &slot)
+{
+	slot.first = (slot.first + 1) % INFLIGHT_DEPTH;
+	slot.count--;
+}
+
+int InFlightTable::pending() const
+{
+	int count(0);
+	for (int i(0); i < INFLIGHT_SLOTS; i++)
+	{
+		count += slots[i].count;
+	}
+	return count;
+}
+
+void InFlightTable::clear()
+{
+	for (int i(0); i < INFLIGHT_SLOTS; i++)
+	{
+		slots[i].first = 0;
+		slots[i].count = 0;
+		slots[i].owed = 0;
+	}
+}
@@ -0,0 +1,232 @@
+#include "ser/link_decode.h"
+
+#include <cstdio>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+namespace
+{
+	const size_t needMore(static_cast<size_t> (-1));
+}
+
+LinkPacketDecoder::LinkPacketDecoder() : garbage(0)
+{
+	for (int index(0); index < 8; index++)
+	{
+		sentNs[index] = 0;
+		sentPending[index] = false;
+	}
+}
+
+void LinkPacketDecoder::feed(const LinkRecordView &record, std::vector<LinkPacket> &packets)
+{
+	switch (record.type)
+	{
+	case linkRecordOut:
+		out.pending.insert(out.pending.end(), record.bytes, record.bytes + record.length);
+		frame(out, true, record.timeNs, packets);
+		break;
+	case linkRecordIn:
+		in.pending.insert(in.pending.end(), record.bytes, record.bytes + record.length);
+		frame(in, false, record.timeNs, packets);
+		break;
+	case linkRecordMark:
+	{
+		// the port was opened or closed: nothing pending completes across it.
+		finish(record.timeNs, packets);
+		for (int index(0); index < 8; index++)
+		{
+			sentPending[index] = false;
+		}
+		LinkPacket mark;
+		mark.kind = linkPacketMark;
+		mark.timeNs = record.timeNs;
+		mark.text.assign(reinterpret_cast<const char*> (record.bytes), record.length);
+		packets.push_back(mark);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+void LinkPacketDecoder::finish(uint64_t timeNs, std::vector<LinkPacket> &packets)
+{
+	out.garbageRun = out.pending.size();
+	flushGarbage(out, true, timeNs, packets);
+	in.garbageRun = in.pending.size();
+	flushGarbage(in, false, timeNs, packets);
+}
+
+uint64_t LinkPacketDecoder::garbageBytes() const
+{
+	return garbage;
+}
+
+void LinkPacketDecoder::frame(Stream &stream, bool outgoing, uint64_t timeNs, std::vector<LinkPacket> &packets)
+{
+	size_t position(stream.garbageRun);
+	while (position < stream.pending.size())
+	{
+		LinkPacket packet;
+		size_t length(decodePacket(outgoing, stream.pending.data() + position, stream.pending.size() - position, packet));
+		if (length == needMore)
+		{
+			// a packet that runs past the end only waits if no valid packet follows it (like decodeReplyStream).
+			size_t next(position + 1);
+			for (; next < stream.pending.size(); next++)
+			{
+				LinkPacket later;
+				size_t laterLength(decodePacket(outgoing, stream.pending.data() + next, stream.pending.size() - next, later));
+				if (laterLength != 0 && laterLength != needMore)
+				{
+					break;
+				}
+			}
+			if (next == stream.pending.size())
+			{
+				break;
+			}
+			position = next;
+			continue;
+		}
+		if (length == 0)
+		{
+			position++;
+			continue;
+		}
+
+		stream.garbageRun = position;
+		flushGarbage(stream, outgoing, timeNs, packets);
+		packet.outgoing = outgoing;
+		packet.timeNs = timeNs;
+		packet.streamOffset = stream.offset;
+		packet.length = length;
+		int slot(packet.packetIndex & 7);
+		if (outgoing)
+		{
+			sentNs[slot] = timeNs;
+			sentPending[slot] = true;
+		}
+		else if (sentPending[slot])
+		{
+			packet.rttUs = (timeNs - sentNs[slot]) * 1.0e-3;
+			sentPending[slot] = false;
+		}
+		packets.push_back(packet);
+		stream.pending.erase(stream.pending.begin(), stream.pending.begin() + length);
+		stream.offset += length;
+		position = 0;
+	}
+	stream.garbageRun = position;
+}
+
+void LinkPacketDecoder::flushGarbage(Stream &stream, bool outgoing, uint64_t timeNs, std::vector<LinkPacket> &packets)
+{
+	if (stream.garbageRun == 0)
+	{
+		return;
+	}
+	LinkPacket packet;
+	packet.kind = linkPacketGarbage;
+	packet.outgoing = outgoing;
+	packet.timeNs = timeNs;
+	packet.streamOffset = stream.offset;
+	packet.length = stream.garbageRun;
+	packets.push_back(packet);
+	stream.pending.erase(stream.pending.begin(), stream.pending.begin() + stream.garbageRun);
+	stream.offset += stream.garbageRun;
+	garbage += stream.garbageRun;
+	stream.garbageRun = 0;
+}
+
+size_t LinkPacketDecoder::decodePacket(bool outgoing, const uint8_t *bytes, size_t length, LinkPacket &packet)
+{
+	if (outgoing)
+	{
+		if (!(bytes[0] >> 7))
+		{
+			return 0;
+		}
+		int commands(bytes[0] & 15);
+		size_t packetLen(PCK_LEN(commands));
+		if (length < packetLen)
+		{
+			return needMore;
+		}
+		CatheterChannelCmdSet cmdSet;
+		int pseqnum(0);
+		if (decodeCommandPacket(bytes, packetLen, cmdSet, pseqnum) == 0)
+		{
+			return 0;
+		}
+		packet.kind = linkPacketCommand;
+		packet.packetIndex = pseqnum;
+		packet.cmds.swap(cmdSet.commandList);
+		return packetLen;
+	}
+
+	// a reply starts with the status bit and the ok bit set.
+	if ((bytes[0] & 192) != 192)
+	{
+		return 0;
+	}
+	if (length < 2)
+	{
+		return needMore;
+	}
+	size_t packetLen(static_cast<size_t> (bytes[1] >> 4) * 3 + static_cast<size_t> (bytes[1] & 15) * 2 + 3);
+	if (length < packetLen)
+	{
+		return needMore;
+	}
+	std::vector<CatheterChannelCmd> cmds;
+	std::vector<uint32_t> packetIndex;
+	size_t skipped(0);
+	if (decodeReplyStream(bytes, packetLen, cmds, packetIndex, skipped) != packetLen || skipped != 0)
+	{
+		return 0;
+	}
+	packet.kind = linkPacketReply;
+	packet.packetIndex = bytes[0] & 15;
+	packet.cmds.swap(cmds);
+	return packetLen;
+}
+
+std::string linkCommandText(const CatheterChannelCmd &cmd, bool reply)
+{
+	char text[64];
+	int length(0);
+	if (cmd.channel == GLOBAL_ADDR)
+	{
+		length = snprintf(text, sizeof(text), "all");
+	}
+	else
+	{
+		length = snprintf(text, sizeof(text), "ch%d", cmd.channel);
+	}
+	length += snprintf(text + length, sizeof(text) - length, " %c%u%s", (cmd.dir == DIR_POS) ? '+' : '-',
+		static_cast<unsigned int> (cmd.dacCounts), cmd.enable ? " en" : "");
+	if (cmd.poll)
+	{
+		if (reply)
+		{
+			snprintf(text + length, sizeof(text) - length, " adc %u", static_cast<unsigned int> (cmd.adcCounts));
+		}
+		else
+		{
+			snprintf(text + length, sizeof(text) - length, " poll");
+		}
+	}
+	return text;
+}
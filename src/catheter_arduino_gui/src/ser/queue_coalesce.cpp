@@ -0,0 +1,118 @@
+#include "ser/queue_coalesce.h"
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+namespace
+{
+	// a polled command only reads its channel back (the firmware ignores the rest of it).
+	bool hasGlobal(const CatheterChannelCmdSet &cmdSet, bool writesOnly)
+	{
+		for (size_t index(0); index < cmdSet.commandList.size(); index++)
+		{
+			const CatheterChannelCmd &cmd(cmdSet.commandList[index]);
+			if (cmd.channel == GLOBAL_ADDR && !(writesOnly && cmd.poll))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// folds cmdSet into next: the commands next does not supersede go first, in their order.
+	// false (and next unchanged) if the merged packet would hold too many commands.
+	bool mergeInto(const CatheterChannelCmdSet &cmdSet, CatheterChannelCmdSet &next, size_t &dropped)
+	{
+		if (hasGlobal(next, true))
+		{
+			dropped = cmdSet.commandList.size();
+			return true;
+		}
+		// a global poll writes nothing, so the set before it still has to be sent.
+		if (hasGlobal(next, false))
+		{
+			return false;
+		}
+		bool touched[NCHANNELS + 1] = {false};
+		for (size_t index(0); index < next.commandList.size(); index++)
+		{
+			int channel(next.commandList[index].channel);
+			if (channel > 0 && channel <= NCHANNELS && !next.commandList[index].poll)
+			{
+				touched[channel] = true;
+			}
+		}
+		std::vector<CatheterChannelCmd> kept;
+		// a channel set twice in cmdSet keeps its last command.
+		for (size_t index(cmdSet.commandList.size()); index-- > 0;)
+		{
+			int channel(cmdSet.commandList[index].channel);
+			if (channel > 0 && channel <= NCHANNELS)
+			{
+				if (touched[channel])
+				{
+					continue;
+				}
+				touched[channel] = true;
+			}
+			kept.insert(kept.begin(), cmdSet.commandList[index]);
+		}
+		if (kept.size() + next.commandList.size() > COALESCE_MAX_CMDS)
+		{
+			return false;
+		}
+		next.commandList.insert(next.commandList.begin(), kept.begin(), kept.end());
+		dropped = cmdSet.commandList.size() - kept.size();
+		return true;
+	}
+}
+
+bool coalescible(const CatheterChannelCmdSet &cmdSet)
+{
+	if (cmdSet.delayTime != 0 || cmdSet.commandList.empty())
+	{
+		return false;
+	}
+	for (size_t index(0); index < cmdSet.commandList.size(); index++)
+	{
+		const CatheterChannelCmd &cmd(cmdSet.commandList[index]);
+		if (cmd.poll || cmd.channel == GLOBAL_ADDR)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+CoalesceCounts coalesceQueue(std::deque<CatheterChannelCmdSet> &queue, size_t first)
+{
+	CoalesceCounts counts;
+	size_t write(first);
+	for (size_t read(first); read < queue.size(); read++)
+	{
+		size_t dropped(0);
+		if (read + 1 < queue.size() && coalescible(queue[read]) && mergeInto(queue[read], queue[read + 1], dropped))
+		{
+			counts.updatesDropped += dropped;
+			counts.setsMerged++;
+			continue;
+		}
+		if (write != read)
+		{
+			queue[write].commandList.swap(queue[read].commandList);
+			queue[write].delayTime = queue[read].delayTime;
+		}
+		write++;
+	}
+	queue.resize(write);
+	return counts;
+}
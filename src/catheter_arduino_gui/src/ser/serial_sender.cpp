@@ -7,6 +7,7 @@
 #include "com/pc_utils.h"
 #include "ser/serial_sender.h"
 #include "ser/simple_serial.h"
+#include "util/trace.h"
 
 #ifdef _MSC_VER
 #define _CRTDBG_MAP_ALLOC
@@ -187,6 +188,7 @@ bool CatheterSerialSender::resetStop() {
 bool CatheterSerialSender::dataAvailable()
 {
 	std::vector<unsigned char> temp = sp->flushData();
+	bytesIn.add(temp.size());
 	bytesAvailable.insert(bytesAvailable.end(), temp.begin(), temp.end());
 	if(bytesAvailable.size() > 0) return true;
 	else return false;
@@ -195,8 +197,22 @@ bool CatheterSerialSender::dataAvailable()
 
 comStatus CatheterSerialSender::getData(std::vector<CatheterChannelCmd> &cmd)
 {
+	CATHETER_TRACE_SCOPE("parse");
 	cmd.clear();
-	return parseBytes2Cmds(bytesAvailable, cmd);
+	bool badChecksum(false);
+	comStatus status(parseBytes2Cmds(bytesAvailable, cmd, &badChecksum));
+	if (badChecksum)
+	{
+		checksumFailures.add();
+	}
+	return status;
+}
+
+comStatus CatheterSerialSender::getData(std::vector<CatheterChannelCmd> &cmd, int &packetIndex)
+{
+	// the reply is parsed from the front of the buffer.
+	packetIndex = bytesAvailable.empty() ? -1 : (bytesAvailable[0] & 15);
+	return getData(cmd);
 }
 
 
@@ -212,14 +228,46 @@ bool CatheterSerialSender::connected()
 void CatheterSerialSender::sendCommand(const CatheterChannelCmdSet & outgoingData, int pseqnum)
 {
 	// parse the command:
-	std::vector< uint8_t > bytesOut(encodeCommandSet(outgoingData, pseqnum));
+	std::vector< uint8_t > packet;
+	{
+		CATHETER_TRACE_SCOPE("encode");
+		packet = encodeCommandSet(outgoingData, pseqnum);
+	}
 	if (connected())
 	{
 		// send it through the serial port:
-		sp->write_some_bytes(bytesOut, bytesOut.size());
+		int written(0);
+		{
+			CATHETER_TRACE_SCOPE("write");
+			written = sp->write_some_bytes(packet, packet.size());
+		}
+		if (written > 0)
+		{
+			bytesOut.add(written);
+		}
+		if (written < static_cast<int> (packet.size()))
+		{
+			CATHETER_TRACE_INSTANT("short write", written);
+		}
 	}
 }
 
+void CatheterSerialSender::setMetrics(MetricsRegistry *metrics)
+{
+	if (metrics == NULL)
+	{
+		return;
+	}
+	bytesIn = metrics->counter("catheter_serial_bytes_in_total");
+	bytesOut = metrics->counter("catheter_serial_bytes_out_total");
+	checksumFailures = metrics->counter("catheter_checksum_failures_total");
+}
+
+void CatheterSerialSender::setRecorder(LinkRecorder *recorder)
+{
+	sp->setRecorder(recorder);
+}
+
 std::string comStat2String(const comStatus& statIn)
 {
 	switch(statIn)
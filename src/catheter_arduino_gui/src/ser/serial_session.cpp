@@ -0,0 +1,95 @@
+#include "ser/serial_session.h"
+#include "com/command_sequence.h"
+#include "com/pc_utils.h"
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+
+SerialSession::SerialSession(size_t ringSamples, size_t logLines) : consoleLog(logLines), sampleRing(ringSamples)
+{
+	serialObject.setStatusTextPtr(&consoleLog);
+	serialObject.setSampleRing(&sampleRing);
+}
+
+SerialSession::~SerialSession()
+{
+	if (serialObject.isConnected())
+	{
+		// returns once the reset is written, before the port closes.
+		serialObject.serialCommand(SerialThreadObject::resetArduino);
+	}
+	serialObject.setSampleRing(NULL);
+}
+
+bool SerialSession::open(const std::string &portName)
+{
+	return serialObject.connectPort(portName);
+}
+
+bool SerialSession::isOpen()
+{
+	return serialObject.isConnected();
+}
+
+int SerialSession::enqueue(const double *milliAmp, size_t nChannels, size_t nSteps, const double *delayMS, size_t nDelays, bool poll)
+{
+	CatheterCmdSequence cmdSequence;
+	if (currentMatrix2Sequence(milliAmp, nChannels, nSteps, delayMS, nDelays, poll, cmdSequence) != 0)
+	{
+		return -1;
+	}
+	std::vector<CatheterChannelCmdSet> cmdVect;
+	cmdSequence.toCmdSets(cmdVect);
+	serialObject.queueCommands(cmdVect);
+	return 0;
+}
+
+void SerialSession::reset()
+{
+	serialObject.serialCommand(SerialThreadObject::resetArduino);
+}
+
+size_t SerialSession::pollTelemetry(CurrentSample *samples, size_t maxCount)
+{
+	return sampleRing.popBulk(samples, maxCount);
+}
+
+size_t SerialSession::pendingTelemetry() const
+{
+	return sampleRing.size();
+}
+
+size_t SerialSession::droppedTelemetry() const
+{
+	return sampleRing.droppedCount();
+}
+
+size_t SerialSession::queuedSets()
+{
+	return serialObject.queuedSets();
+}
+
+bool SerialSession::idle()
+{
+	return serialObject.playbackIdle();
+}
+
+void SerialSession::getStats(PlaybackStats &stats)
+{
+	serialObject.getStats(stats);
+}
+
+const ConsoleLog& SerialSession::log() const
+{
+	return consoleLog;
+}
@@ -1,9 +1,11 @@
 #include "ser/serial_thread.h"
+#include "util/async_log.h"
+#include "util/trace.h"
 
 #include <boost/bind.hpp>
 #include <boost/thread.hpp>
-#include <wx/wx.h>
-#include <wx/numdlg.h>
+#include <algorithm>
+#include <chrono>
 // Here is the serial thread.
 
 #ifdef _MSC_VER
@@ -22,22 +24,203 @@
 
 
 
+namespace
+{
+	typedef std::chrono::steady_clock SteadyClock;
+
+	double steadySeconds(const SteadyClock::time_point &timePoint)
+	{
+		return std::chrono::duration<double>(timePoint.time_since_epoch()).count();
+	}
+}
+
+namespace
+{
+	double samplePercentile(const std::vector<double> &samples, double fraction)
+	{
+		if (samples.empty())
+		{
+			return 0.0;
+		}
+		std::vector<double> values(samples);
+		size_t rank(static_cast<size_t> (fraction * (values.size() - 1) + 0.5));
+		std::nth_element(values.begin(), values.begin() + rank, values.end());
+		return values[rank];
+	}
+
+	void recordStaleness(PlaybackStats &stats, double stalenessUs)
+	{
+		if (stalenessUs > stats.maxStalenessUs)
+		{
+			stats.maxStalenessUs = stalenessUs;
+		}
+		if (stats.stalenessUs.size() < PLAYBACK_MAX_SAMPLES)
+		{
+			stats.stalenessUs.push_back(stalenessUs);
+		}
+	}
+
+	void recordRtt(PlaybackStats &stats, double rttUs)
+	{
+		if (rttUs > stats.maxRttUs)
+		{
+			stats.maxRttUs = rttUs;
+		}
+		if (stats.rttUs.size() < PLAYBACK_MAX_SAMPLES)
+		{
+			stats.rttUs.push_back(rttUs);
+		}
+		int bin(0);
+		while (bin + 1 < RTT_HISTOGRAM_BINS && rttUs >= static_cast<double> (2 << bin))
+		{
+			bin++;
+		}
+		stats.rttHistogram[bin]++;
+	}
+
+	// takes the lock, the wait is traced only when another thread held it.
+	void lockTraced(boost::mutex::scoped_lock &lock)
+	{
+#ifdef CATHETER_TRACE
+		if (lock.try_lock())
+		{
+			return;
+		}
+		CATHETER_TRACE_SCOPE("lock wait");
+#endif
+		lock.lock();
+	}
+}
+
+SerialThreadMetrics::SerialThreadMetrics(MetricsRegistry &registry) :
+	packetsQueued(registry.counter("catheter_packets_queued_total")),
+	packetsSent(registry.counter("catheter_packets_sent_total")),
+	packetsAcked(registry.counter("catheter_packets_acked_total")),
+	packetsErrored(registry.counter("catheter_packets_errored_total")),
+	echoMismatches(registry.counter("catheter_echo_mismatches_total")),
+	repliesUnmatched(registry.counter("catheter_replies_unmatched_total")),
+	replyTimeouts(registry.counter("catheter_reply_timeouts_total")),
+	loopWakeups(registry.counter("catheter_loop_wakeups_total")),
+	mailboxSends(registry.counter("catheter_mailbox_sends_total")),
+	mailboxSuperseded(registry.counter("catheter_mailbox_superseded_total")),
+	setsCoalesced(registry.counter("catheter_sets_coalesced_total")),
+	updatesCoalesced(registry.counter("catheter_updates_coalesced_total")),
+	queueDepth(registry.gauge("catheter_queue_depth")),
+	connected(registry.gauge("catheter_connected")),
+	rttUs(registry.histogram("catheter_rtt_us")),
+	stalenessUs(registry.histogram("catheter_staleness_us"))
+{
+}
+
+double latenessPercentile(const PlaybackStats &stats, double fraction)
+{
+	return samplePercentile(stats.latenessUs, fraction);
+}
+
+double rttPercentile(const PlaybackStats &stats, double fraction)
+{
+	return samplePercentile(stats.rttUs, fraction);
+}
+
+double stalenessPercentile(const PlaybackStats &stats, double fraction)
+{
+	return samplePercentile(stats.stalenessUs, fraction);
+}
+
 // This thread loop is created as part of 
 void SerialThreadObject::serialLoop()
 {
-
-	boost::posix_time::ptime t1(boost::posix_time::second_clock::local_time());
-    int64_t delay(0);
-	int delayCount(0);
+	// the deadline of the next set, each set moves it by its delay.
+	SteadyClock::time_point deadline(SteadyClock::now());
 	int cmdIndex(0);
+	CATHETER_TRACE_THREAD_NAME("serial loop");
 	while (active)
 	{
 		if(ss->dataAvailable())
 		{
 			
-			CatheterChannelCmd incomingData;
-			boost::mutex::scoped_lock lock(threadMutex);
-			comStatus newCom(ss->getData(commandFromArd.commandList));
+			boost::mutex::scoped_lock lock(threadMutex, boost::defer_lock);
+			lockTraced(lock);
+			int replyIndex(-1);
+			comStatus newCom(ss->getData(commandFromArd.commandList, replyIndex));
+			double replyTime(steadySeconds(SteadyClock::now()));
+			if (newCom == valid)
+			{
+				stats.repliesValid++;
+				double rttUs(0.0);
+				int lost(0);
+				ReplyMatch match(inFlight.reply(replyIndex, commandFromArd.commandList, replyTime, rttUs, lost));
+				// the packets this reply overtook never got theirs.
+				stats.replyTimeouts += lost;
+				metrics.replyTimeouts.add(lost);
+				switch (match)
+				{
+				case replyMatched:
+					stats.repliesMatched++;
+					recordRtt(stats, rttUs);
+					metrics.packetsAcked.add();
+					metrics.rttUs.record(rttUs);
+					break;
+				case replyMismatch:
+					stats.echoMismatches++;
+					recordRtt(stats, rttUs);
+					metrics.echoMismatches.add();
+					metrics.rttUs.record(rttUs);
+					break;
+				case replyLate:
+					// already counted as a timeout.
+					break;
+				default:
+					stats.repliesUnmatched++;
+					metrics.repliesUnmatched.add();
+				}
+				if ((replyIndex & (INFLIGHT_SLOTS - 1)) == mailboxSlot && match != replyLate && match != replyUnmatched)
+				{
+					// sent when nothing else was waiting, so it is the oldest packet of its slot.
+					if (match == replyMatched && lost == 0)
+					{
+						mailboxSlot = -1;
+					}
+					else
+					{
+						mailboxLost();
+					}
+				}
+				uint64_t &writeNs(slotWriteNs[replyIndex & (INFLIGHT_SLOTS - 1)]);
+				if ((match == replyMatched || match == replyMismatch) && writeNs != 0)
+				{
+					double stalenessUs(replyTime * 1.0e6 - writeNs * 1.0e-3);
+					recordStaleness(stats, stalenessUs);
+					metrics.stalenessUs.record(stalenessUs);
+					writeNs = 0;
+				}
+			}
+			else if (newCom != none)
+			{
+				stats.repliesInvalid++;
+				metrics.packetsErrored.add();
+				// it answered the oldest packet waiting, which will not get another reply.
+				if (inFlight.replyInvalid() && mailboxSlot >= 0)
+				{
+					mailboxLost();
+				}
+			}
+			if (newCom == valid && (sampleRing != NULL || sampleTap != NULL))
+			{
+				CATHETER_TRACE_SCOPE("hand off");
+				for (size_t index(0); index < commandFromArd.commandList.size(); index++)
+				{
+					CurrentSample sample(commandFromArd.commandList[index], replyTime);
+					if (sampleRing != NULL)
+					{
+						sampleRing->push(sample);
+					}
+					if (sampleTap != NULL)
+					{
+						sampleTap->push(sample);
+					}
+				}
+			}
 			lock.unlock();
 			//std::string comString(comStat2String(newCom));
 			//if(textStatus != NULL)
@@ -48,31 +231,118 @@ void SerialThreadObject::serialLoop()
 			{
 				if(statusGridData != NULL)
 				{
+					CATHETER_TRACE_SCOPE("status hand off");
 					statusGridData->updateCmdList(commandFromArd.commandList);
 				}
 			}
   
 		}
 		// This is a fifo command
-		// warning: no lock is used to read the vector size.
-		if (commandsToArd.size() > 0) 
 		{
-			boost::posix_time::time_duration diff(boost::posix_time::microsec_clock::local_time() - t1);
-			delayCount++;
-			int64_t diffAmt(diff.total_nanoseconds());
-			if (diffAmt > delay)
+			boost::mutex::scoped_lock lock(threadMutex, boost::defer_lock);
+			lockTraced(lock);
+			SteadyClock::time_point now(SteadyClock::now());
+			int expired(inFlight.expire(steadySeconds(now), REPLY_TIMEOUT_MS * 1.0e-3));
+			stats.replyTimeouts += expired;
+			metrics.replyTimeouts.add(expired);
+			if (expired > 0 && mailboxSlot >= 0)
+			{
+				// the oldest packets expire first.
+				mailboxLost();
+			}
+			metrics.loopWakeups.add();
+			if (!commandsToArd.empty())
+			{
+				if (idle || resetQueued)
+				{
+					// nothing was pending (or the schedule was dropped), start a new one now.
+					deadline = now;
+					idle = false;
+				}
+				if (now >= deadline)
+				{
+					CATHETER_TRACE_SCOPE("send set");
+					double nowSeconds(steadySeconds(now));
+					if (stats.setsSent == 0)
+					{
+						stats.firstSendTime = nowSeconds;
+					}
+					stats.lastSendTime = nowSeconds;
+					double latenessUs(std::chrono::duration<double, std::micro>(now - deadline).count());
+					if (latenessUs > stats.maxLatenessUs)
+					{
+						stats.maxLatenessUs = latenessUs;
+					}
+					if (stats.latenessUs.size() < PLAYBACK_MAX_SAMPLES)
+					{
+						stats.latenessUs.push_back(latenessUs);
+					}
+					stats.setsSent++;
+
+					ss->sendCommand(commandsToArd.front(), cmdIndex);
+					metrics.packetsSent.add();
+					if (connected && inFlight.sent(cmdIndex, commandsToArd.front(), nowSeconds))
+					{
+						// the slot was full, its oldest packet never got a reply.
+						stats.replyTimeouts++;
+						metrics.replyTimeouts.add();
+						if ((cmdIndex & (INFLIGHT_SLOTS - 1)) == mailboxSlot)
+						{
+							mailboxLost();
+						}
+					}
+					// the firmware state is no longer what the mailbox sent.
+					slotWriteNs[cmdIndex & (INFLIGHT_SLOTS - 1)] = 0;
+					for (int channel(0); channel < NCHANNELS; channel++)
+					{
+						mailboxSent[channel].known = false;
+					}
+					deadline += std::chrono::milliseconds(commandsToArd.front().delayTime);
+					commandsToArd.pop_front();
+					metrics.queueDepth.set(commandsToArd.size());
+					CATHETER_TRACE_COUNTER("queue depth", static_cast<int64_t> (commandsToArd.size()));
+					cmdIndex++;
+					if (resetQueued)
+					{
+						resetQueued = false;
+						resetWritten.notify_all();
+					}
+				}
+			}
+			else
 			{
-				// send the first command
-				printf("Sending command: \n");
-				t1 = boost::posix_time::microsec_clock::local_time();
-				boost::mutex::scoped_lock lock(threadMutex);
-				ss->sendCommand(commandsToArd[0],cmdIndex);
-				delayCount = 0 ;
-				delay = commandsToArd[0].delayTime*1000000;
-				commandsToArd.erase(commandsToArd.begin());
-				
-				lock.unlock();
-				cmdIndex++;
+				if (mailbox != NULL && now >= deadline && (!connected || inFlight.pending() == 0)
+					&& (mailbox->version() != mailboxVersion || mailboxResend))
+				{
+					MailboxSetpoints setpoints;
+					uint64_t version(mailbox->read(setpoints));
+					uint64_t superseded((version > mailboxVersion) ? version - mailboxVersion - 1 : 0);
+					stats.mailboxSuperseded += superseded;
+					metrics.mailboxSuperseded.add(superseded);
+					mailboxVersion = version;
+					mailboxResend = false;
+					if (mailboxChangedCommands(setpoints, mailboxSent, mailboxSet) > 0)
+					{
+						CATHETER_TRACE_SCOPE("send mailbox");
+						ss->sendCommand(mailboxSet, cmdIndex);
+						stats.mailboxSends++;
+						metrics.mailboxSends.add();
+						metrics.packetsSent.add();
+						if (connected && inFlight.sent(cmdIndex, mailboxSet, steadySeconds(now)))
+						{
+							stats.replyTimeouts++;
+							metrics.replyTimeouts.add();
+						}
+						// the channels count as sent, until the reply says otherwise.
+						mailboxSlot = connected ? (cmdIndex & (INFLIGHT_SLOTS - 1)) : -1;
+						slotWriteNs[cmdIndex & (INFLIGHT_SLOTS - 1)] = setpoints.writeNs;
+						cmdIndex++;
+					}
+				}
+				if (!idle && now >= deadline)
+				{
+					idle = true;
+				}
 			}
 		}
 		boost::this_thread::sleep(boost::posix_time::microseconds(1))
@@ -85,6 +355,136 @@ void SerialThreadObject::setStatusGrid(statusData* newPtr)
 	statusGridData = newPtr;
 }
 
+void SerialThreadObject::setSampleRing(SpscRing<CurrentSample>* newRing)
+{
+	// the loop only touches the ring with the mutex held.
+	boost::mutex::scoped_lock lock(threadMutex);
+	sampleRing = newRing;
+}
+
+void SerialThreadObject::setSampleTap(SpscRing<CurrentSample>* newTap)
+{
+	boost::mutex::scoped_lock lock(threadMutex);
+	sampleTap = newTap;
+}
+
+void SerialThreadObject::mailboxLost()
+{
+	for (size_t index(0); index < mailboxSet.commandList.size(); index++)
+	{
+		const CatheterChannelCmd &cmd(mailboxSet.commandList[index]);
+		if (!cmd.poll && cmd.channel >= 1 && cmd.channel <= NCHANNELS)
+		{
+			mailboxSent[cmd.channel - 1].known = false;
+		}
+	}
+	mailboxSlot = -1;
+	mailboxResend = true;
+}
+
+void SerialThreadObject::setMailbox(SetpointMailbox* newMailbox)
+{
+	boost::mutex::scoped_lock lock(threadMutex);
+	mailbox = newMailbox;
+	// the setpoints already written are sent once, all channels included.
+	mailboxVersion = (mailbox != NULL && mailbox->version() > 0) ? mailbox->version() - 1 : 0;
+	for (int channel(0); channel < NCHANNELS; channel++)
+	{
+		mailboxSent[channel] = MailboxChannelState();
+	}
+	mailboxSlot = -1;
+	mailboxResend = false;
+	for (int slot(0); slot < INFLIGHT_SLOTS; slot++)
+	{
+		slotWriteNs[slot] = 0;
+	}
+}
+
+void SerialThreadObject::setCoalescing(bool enable)
+{
+	boost::mutex::scoped_lock lock(threadMutex);
+	coalescing = enable;
+	if (coalescing)
+	{
+		coalesceFrom(0);
+	}
+}
+
+void SerialThreadObject::setLinkRecorder(LinkRecorder *recorder)
+{
+	// the port swaps the recorder atomically, the loop need not be stopped.
+	ss->setRecorder(recorder);
+}
+
+void SerialThreadObject::coalesceFrom(size_t first)
+{
+	if (!coalescing)
+	{
+		return;
+	}
+	CoalesceCounts counts(coalesceQueue(commandsToArd, first));
+	stats.setsCoalesced += counts.setsMerged;
+	stats.updatesCoalesced += counts.updatesDropped;
+	metrics.setsCoalesced.add(counts.setsMerged);
+	metrics.updatesCoalesced.add(counts.updatesDropped);
+}
+
+void SerialThreadObject::setPortSelector(const PortSelector& selector)
+{
+	boost::mutex::scoped_lock lock(threadMutex);
+	portSelector = selector;
+}
+
+bool SerialThreadObject::connectPort(const std::string &portName)
+{
+	boost::mutex::scoped_lock lock(threadMutex);
+	ss->setPort(portName);
+	connected = ss->start();
+	metrics.connected.set(connected ? 1 : 0);
+	if(textStatusData != NULL)
+	{
+		if (connected)
+		{
+			logToConsole(textStatusData, logInfo, "Connected to Port: %s", portName);
+		}
+		else
+		{
+			logToConsole(textStatusData, logError, "Unable to open Port: %s", portName);
+		}
+	}
+	return connected;
+}
+
+bool SerialThreadObject::isConnected()
+{
+	boost::mutex::scoped_lock lock(threadMutex);
+	return connected;
+}
+
+size_t SerialThreadObject::queuedSets()
+{
+	boost::mutex::scoped_lock lock(threadMutex);
+	return commandsToArd.size();
+}
+
+bool SerialThreadObject::playbackIdle()
+{
+	boost::mutex::scoped_lock lock(threadMutex);
+	return idle && commandsToArd.empty();
+}
+
+void SerialThreadObject::getStats(PlaybackStats &stats_)
+{
+	boost::mutex::scoped_lock lock(threadMutex);
+	stats_ = stats;
+}
+
+void SerialThreadObject::resetStats()
+{
+	boost::mutex::scoped_lock lock(threadMutex);
+	stats = PlaybackStats();
+}
+
 void SerialThreadObject::serialCommand(const ThreadCmd& incomingCommand)
 {
 	// check for avaiable data:
@@ -101,15 +501,25 @@ void SerialThreadObject::serialCommand(const ThreadCmd& incomingCommand)
 				//flush out the commands.
 				commandsToArd.clear();
 				commandsToArd.push_back(resetCmd());
-				//add the reset command:
-				;
+				metrics.packetsQueued.add();
+				metrics.queueDepth.set(commandsToArd.size());
+				resetQueued = true;
+				// callers close the port or stop the thread next, so wait for the write.
+				boost::system_time timeout(boost::get_system_time() + boost::posix_time::milliseconds(RESET_WRITE_WAIT_MS));
+				while (resetQueued && active)
+				{
+					if (!resetWritten.timed_wait(looplock, timeout))
+					{
+						break;
+					}
+				}
 			}
 			break;
 			case resetSerial:
 			{
 				if(textStatusData != NULL)
 				{
-					textStatusData->appendText(std::string("Attempting to reset Arduino Serial Connection"));
+					logToConsole(textStatusData, logInfo, "Attempting to reset Arduino Serial Connection");
 				}
 				//reset the serial bus.
 				std::vector<std::string> ports;
@@ -119,7 +529,7 @@ void SerialThreadObject::serialCommand(const ThreadCmd& incomingCommand)
 				{
 					if(textStatusData != NULL)
 					{
-						textStatusData->appendText(std::string("No Serial Ports found."));
+						logToConsole(textStatusData, logWarning, "No Serial Ports found.");
 					}
 				} 
 				else
@@ -129,27 +539,39 @@ void SerialThreadObject::serialCommand(const ThreadCmd& incomingCommand)
 						ss->setPort(ports[0]);
 						if(textStatusData != NULL)
 						{
-							textStatusData->appendText(std::string("Connecting to Port: ")+ports[0]);
+							logToConsole(textStatusData, logInfo, "Connecting to Port: %s", ports[0]);
 						}
 					}
 					else
 					{
-					// have user select the correct port
-					for (int i = 0; i < ports.size(); i++) {
-						wxMessageBox(wxString::Format("Found Serial Port: %s (%d/%d)", wxString(ports[i]), i + 1, ports.size()));
-					}
-						int which_port(wxGetNumberFromUser(wxEmptyString, wxT("Select Serial Port Number"), wxEmptyString, 0, 1, ports.size()) - 1);
-						wxMessageBox(wxString::Format("Selected Serial Port: %s", wxString(ports[which_port])));
-						ss->setPort(ports[which_port]);
+						// have the user (or the default) select the correct port
+						int whichPort(portSelector ? portSelector(ports) : 0);
+						if (whichPort < 0 || whichPort >= static_cast<int> (ports.size()))
+						{
+							if(textStatusData != NULL)
+							{
+								logToConsole(textStatusData, logWarning, "No Serial Port selected.");
+							}
+							break;
+						}
+						ss->setPort(ports[whichPort]);
 						if(textStatusData != NULL)
 						{
-							textStatusData->appendText(std::string("Connecting to Port: ")+ports[which_port]);
+							logToConsole(textStatusData, logInfo, "Connecting to Port: %s", ports[whichPort]);
 						}
 					}
 					connected = ss->start();
+					metrics.connected.set(connected ? 1 : 0);
 					if(textStatusData != NULL)
 					{
-						textStatusData->appendText(std::string("Connected!!"));
+						if (connected)
+						{
+							logToConsole(textStatusData, logInfo, "Connected!!");
+						}
+						else
+						{
+							logToConsole(textStatusData, logError, "Unable to open the Serial Port.");
+						}
 					}
 				}
 
@@ -164,11 +586,13 @@ void SerialThreadObject::serialCommand(const ThreadCmd& incomingCommand)
 			case poll:
 				commandsToArd.clear();
 				commandsToArd.push_back(pollCmd());
+				metrics.packetsQueued.add();
+				metrics.queueDepth.set(commandsToArd.size());
 			break;
 			default:
 				if(textStatusData != NULL)
 				{
-					textStatusData->appendText(std::string("Command not recognized"));
+					logToConsole(textStatusData, logWarning, "Command not recognized");
 				}
 			}
 			looplock.unlock();
@@ -178,9 +602,21 @@ void SerialThreadObject::serialCommand(const ThreadCmd& incomingCommand)
 }
 
 // explicit constructor
-SerialThreadObject::SerialThreadObject(): connected(false), active(true), ss(new CatheterSerialSender), thrd(),
-	textStatusData(NULL), statusGridData(NULL)
+SerialThreadObject::SerialThreadObject(MetricsRegistry *metricsRegistry): connected(false), active(true),
+	ss(new CatheterSerialSender), thrd(), coalescing(false), idle(true), resetQueued(false), textStatusData(NULL), statusGridData(NULL), sampleRing(NULL),
+	sampleTap(NULL), mailbox(NULL), mailboxVersion(0), mailboxSlot(-1), mailboxResend(false)
 {
+	for (int slot(0); slot < INFLIGHT_SLOTS; slot++)
+	{
+		slotWriteNs[slot] = 0;
+	}
+	// the handles are set before the loop starts, so it reads them without the lock.
+	if (metricsRegistry != NULL)
+	{
+		metrics = SerialThreadMetrics(*metricsRegistry);
+		ss->setMetrics(metricsRegistry);
+	}
+
 	// initialize all of the variables.
 	std::vector< CatheterChannelCmd > commandsToArd;
 	std::vector< CatheterChannelCmd > commandsFromArd;
@@ -191,7 +627,7 @@ SerialThreadObject::SerialThreadObject(): connected(false), active(true), ss(new
 
 }
 
-void SerialThreadObject::setStatusTextPtr(incomingText* textPtr)
+void SerialThreadObject::setStatusTextPtr(ConsoleLog* textPtr)
 {
 	this->textStatusData = textPtr;
 }
@@ -200,6 +636,7 @@ void SerialThreadObject::stopThreads()
 {
 	boost::mutex::scoped_lock lock(threadMutex);
 	active = false;
+	resetWritten.notify_all();
 	lock.unlock();
 	thrd.join();
 	return;
@@ -219,6 +656,7 @@ SerialThreadObject::~SerialThreadObject()
 	// status commands
 void SerialThreadObject::queueCommand(const CatheterChannelCmdSet &commandToArd_, bool flush)
 {
+	CATHETER_TRACE_SCOPE("queue set");
 	// lock the mutex
 	boost::mutex::scoped_lock
     lock(threadMutex);
@@ -228,10 +666,15 @@ void SerialThreadObject::queueCommand(const CatheterChannelCmdSet &commandToArd_
     	commandsToArd.clear();
     }
     commandsToArd.push_back(commandToArd_);
+    metrics.packetsQueued.add();
+    // the sets already queued were coalesced, only the last one can merge into the new set.
+    coalesceFrom(commandsToArd.size() > 1 ? commandsToArd.size() - 2 : 0);
+    metrics.queueDepth.set(commandsToArd.size());
 }
 
 void SerialThreadObject::queueCommands(const std::vector< CatheterChannelCmdSet > &commandsToArd_, bool flush)
 {
+	CATHETER_TRACE_SCOPE("queue sets");
 	// lock the mutex
 	boost::mutex::scoped_lock
     lock(threadMutex);
@@ -240,5 +683,9 @@ void SerialThreadObject::queueCommands(const std::vector< CatheterChannelCmdSet
     {
     	commandsToArd.clear();
     }
+    size_t queued(commandsToArd.size());
     commandsToArd.insert(commandsToArd.end(), commandsToArd_.begin(), commandsToArd_.end());
+    metrics.packetsQueued.add(commandsToArd_.size());
+    coalesceFrom(queued > 0 ? queued - 1 : 0);
+    metrics.queueDepth.set(commandsToArd.size());
 }
@@ -0,0 +1,108 @@
+#include "ser/setpoint_mailbox.h"
+#include "hardware/digital_analog_conversions.h"
+
+#include <chrono>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+namespace
+{
+	MailboxSetpoints zeroSetpoints()
+	{
+		MailboxSetpoints zero;
+		for (int i(0); i < NCHANNELS; i++)
+		{
+			zero.milliAmp[i] = 0.0;
+		}
+		zero.writeNs = 0;
+		zero.poll = false;
+		return zero;
+	}
+}
+
+SetpointMailbox::SetpointMailbox() : setpoints(zeroSetpoints())
+{
+}
+
+uint64_t SetpointMailbox::write(const double *milliAmp, size_t nChannels, bool poll)
+{
+	uint64_t now(mailboxNowNs());
+	size_t count((nChannels < NCHANNELS) ? nChannels : NCHANNELS);
+	return setpoints.modify([&](MailboxSetpoints &value)
+	{
+		for (size_t i(0); i < count; i++)
+		{
+			value.milliAmp[i] = milliAmp[i];
+		}
+		value.writeNs = now;
+		value.poll = poll;
+	});
+}
+
+uint64_t SetpointMailbox::writeChannel(int channel, double milliAmp)
+{
+	if (channel < 1 || channel > NCHANNELS)
+	{
+		return setpoints.version();
+	}
+	uint64_t now(mailboxNowNs());
+	return setpoints.modify([&](MailboxSetpoints &value)
+	{
+		value.milliAmp[channel - 1] = milliAmp;
+		value.writeNs = now;
+	});
+}
+
+uint64_t SetpointMailbox::read(MailboxSetpoints &setpoints_) const
+{
+	return setpoints.read(setpoints_);
+}
+
+uint64_t SetpointMailbox::version() const
+{
+	return setpoints.version();
+}
+
+size_t mailboxChangedCommands(const MailboxSetpoints &setpoints, MailboxChannelState sent[NCHANNELS],
+	CatheterChannelCmdSet &cmdSet)
+{
+	cmdSet.commandList.clear();
+	cmdSet.delayTime = 0;
+	for (int channel(1); channel <= NCHANNELS; channel++)
+	{
+		CatheterChannelCmd cmd;
+		cmd.channel = channel;
+		setCmdMilliAmp(cmd, setpoints.milliAmp[channel - 1]);
+		MailboxChannelState &state(sent[channel - 1]);
+		if (state.known && state.dacCounts == cmd.dacCounts && state.dir == cmd.dir)
+		{
+			continue;
+		}
+		state.known = true;
+		state.dacCounts = cmd.dacCounts;
+		state.dir = cmd.dir;
+		cmdSet.commandList.push_back(cmd);
+	}
+	// a polled command is not applied, the polls go after the updates.
+	if (setpoints.poll)
+	{
+		appendPollCmds(cmdSet);
+	}
+	return cmdSet.commandList.size();
+}
+
+uint64_t mailboxNowNs()
+{
+	return static_cast<uint64_t> (std::chrono::duration_cast<std::chrono::nanoseconds> (
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
@@ -1,7 +1,9 @@
  #include "ser/simple_serial.h"
+#include "util/async_log.h"
+#include "util/link_log.h"
+#include "util/trace.h"
 
 #include <stdio.h>
-#include <iostream>
 
 
 #ifdef _MSC_VER
@@ -16,7 +18,7 @@
 #endif  // _DEBUG
 #endif  // __MSC_VER
 
-SerialPort::SerialPort(void)
+SerialPort::SerialPort(void) : recorder_(NULL)
 {
 }
  
@@ -34,13 +36,12 @@ bool SerialPort::start(const char *com_port_name, Baud baud_rate) {
 	boost::system::error_code ec;
  
 	if (port_ != NULL && port_->is_open()) {
-		std::cout << "error : port is already opened..." << std::endl;
+		logMessage(logWarning, "error : port is already opened...");
 	} else {
 		port_ = serial_port_ptr(new boost::asio::serial_port(io_service_));
 		port_->open(com_port_name, ec);
 		if (ec) {
-			std::cout << "error : port_->open() failed...com_port_name="
-				<< com_port_name << ", e=" << ec.message().c_str() << std::endl;
+			logMessage(logError, "error : port_->open() failed...com_port_name=%s, e=%s", com_port_name, ec.message());
 			return false;
 		}
 		ec.clear();
@@ -53,10 +54,20 @@ bool SerialPort::start(const char *com_port_name, Baud baud_rate) {
 		port_->set_option(boost::asio::serial_port_base::parity(boost::asio::serial_port_base::parity::none), ec);
 		port_->set_option(boost::asio::serial_port_base::flow_control(boost::asio::serial_port_base::flow_control::none), ec);
 
+		// queue the first read before running the io_service: run() returns
+		// right away when it has no work, and then nothing is ever read.
+		io_service_.reset();
+		async_read_some_();
+
 		// this thread may need to be joined during destructor...
 		 t = boost::thread(boost::bind(&boost::asio::io_service::run, &io_service_));
 
-		async_read_some_();
+		LinkRecorder *recorder(recorder_.load(std::memory_order_acquire));
+		if (recorder != NULL) {
+			char text[LOG_LINE_LEN_MAX];
+			snprintf(text, sizeof(text), "open %s %u", com_port_name, baud);
+			recorder->mark(text);
+		}
 	} 
 	return true;
 }
@@ -73,6 +84,10 @@ void SerialPort::stop() {
 		port_->close(ec);
 		// reset() is not a member of the serial_port class.
 		port_.reset();
+		LinkRecorder *recorder(recorder_.load(std::memory_order_acquire));
+		if (recorder != NULL) {
+			recorder->mark("close");
+		}
 	}
 	io_service_.stop();
 	io_service_.reset();
@@ -138,12 +153,15 @@ bool SerialPort::isOpen() {
 	return false;
 }
 
+void SerialPort::setRecorder(LinkRecorder *recorder) {
+	recorder_.store(recorder, std::memory_order_release);
+}
+
 /////////////////////////////////
 // old (working) string functions
 /////////////////////////////////
 
 int SerialPort::write_some(const std::string &buf) {
-	tSend = clock();
 	return write_some(buf.c_str(), buf.size());
 }
  
@@ -152,8 +170,18 @@ int SerialPort::write_some(const char *buf, const int &size) {
  
 	if (!port_) return -1;
 	if (size == 0) return 0;
-	tSend = clock();
-	return port_->write_some(boost::asio::buffer(buf, size), ec);
+	// recorded before the write, so the reply can not land in the log ahead of it.
+	LinkRecorder *recorder(recorder_.load(std::memory_order_acquire));
+	if (recorder != NULL) {
+		recorder->record(linkRecordOut, buf, size);
+	}
+	int written(port_->write_some(boost::asio::buffer(buf, size), ec));
+	if (recorder != NULL && written < size) {
+		char text[LOG_LINE_LEN_MAX];
+		snprintf(text, sizeof(text), "short write %d of %d", written, size);
+		recorder->mark(text);
+	}
+	return written;
 }
 
 void SerialPort::async_read_some_() {
@@ -169,17 +197,14 @@ void SerialPort::async_read_some_() {
 
 void SerialPort::on_receive_(const boost::system::error_code& ec, size_t bytes_transferred) {
 	boost::mutex::scoped_lock look(mutex_);
-	tRecieve = clock();
-	clock_t dt = tRecieve - tSend;
-	printf("It took me %d clicks (%f seconds). to reply.\n", static_cast<int> (dt), ((float)dt) / CLOCKS_PER_SEC);
 
 	if (port_.get() == NULL || !port_->is_open()) 
 	{
-	 printf("Null or closed port");
+	 logMessage(logDebug, "Null or closed port");
 	 return;
 	}
 	if (ec) {
-		printf("read bytes");
+		logMessage(logWarning, "read bytes: %s", ec.message());
 		async_read_some_();
 		return;
 	}
@@ -187,6 +212,11 @@ void SerialPort::on_receive_(const boost::system::error_code& ec, size_t bytes_t
 	{
 		ec.message();
 	}
+	CATHETER_TRACE_INSTANT("receive chunk", static_cast<int64_t> (bytes_transferred));
+	LinkRecorder *recorder(recorder_.load(std::memory_order_acquire));
+	if (recorder != NULL && bytes_transferred > 0) {
+		recorder->record(linkRecordIn, read_buf_raw_, bytes_transferred);
+	}
 	for (unsigned int i = 0; i < bytes_transferred; ++i) {
 		unsigned char c = read_buf_raw_[i];
 		//read_buf_str_ += c;
@@ -213,14 +243,24 @@ int SerialPort::write_some_bytes(const std::vector<uint8_t> &buf, const int &siz
 	boost::system::error_code ec;
 	if (!port_) return -1;
 	if (!size) return 0;
-	tSend = clock();
-	return port_->write_some(boost::asio::buffer(buf, size), ec);
+	// recorded before the write, so the reply can not land in the log ahead of it.
+	LinkRecorder *recorder(recorder_.load(std::memory_order_acquire));
+	if (recorder != NULL) {
+		recorder->record(linkRecordOut, buf.data(), size);
+	}
+	int written(port_->write_some(boost::asio::buffer(buf, size), ec));
+	if (recorder != NULL && written < size) {
+		char text[LOG_LINE_LEN_MAX];
+		snprintf(text, sizeof(text), "short write %d of %d", written, size);
+		recorder->mark(text);
+	}
+	return written;
 }
 
 void SerialPort::async_read_some_bytes_() {
 	if (port_.get() == NULL || !port_->is_open())
 	{
-		printf("invalid port");	
+		logMessage(logDebug, "invalid port");	
 		return;
 	}
 
@@ -239,16 +279,13 @@ void SerialPort::async_read_some_bytes_() {
 
 void SerialPort::on_receive_bytes_(const boost::system::error_code& ec, size_t bytes_transferred) {
 	boost::mutex::scoped_lock look(mutex_);
-	tRecieve = clock();
-	clock_t dt = tRecieve - tSend;
-	printf("It took me %d clicks (%f seconds). to reply.\n", static_cast<int> (dt), ((float)dt) / CLOCKS_PER_SEC);
 	if (port_.get() == NULL || !port_->is_open())
 	{
-	 printf("Null or closed port");
+	 logMessage(logDebug, "Null or closed port");
 	 return;
 	}
 	if (ec) {
-		printf("read bytes");
+		logMessage(logWarning, "read bytes: %s", ec.message());
 		async_read_some_bytes_();
 		return;
 	}
@@ -257,6 +294,11 @@ void SerialPort::on_receive_bytes_(const boost::system::error_code& ec, size_t b
 		ec.message();
 	}
 
+	CATHETER_TRACE_INSTANT("receive chunk", static_cast<int64_t> (bytes_transferred));
+	LinkRecorder *recorder(recorder_.load(std::memory_order_acquire));
+	if (recorder != NULL && bytes_transferred > 0) {
+		recorder->record(linkRecordIn, read_buf_bytes_raw_, bytes_transferred);
+	}
 	for (unsigned int i = 0; i < bytes_transferred; ++i) {
 		uint8_t b = read_buf_bytes_raw_[i];
 		read_buf_bytes_.push_back(b);
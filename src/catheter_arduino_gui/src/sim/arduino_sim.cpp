@@ -0,0 +1,359 @@
+#include "sim/arduino_sim.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <random>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+// the loop wakes up at least this often to check for stop().
+#define SIM_POLL_MAX_US 1000
+
+namespace
+{
+	typedef std::chrono::steady_clock SteadyClock;
+
+	uint8_t simFletcher8(size_t len, const uint8_t *data)
+	{
+		uint8_t sum1 = 0, sum2 = 0;
+		for (size_t i = 0; i < len; i++) {
+			sum1 += (data[i] >> 4);
+			sum2 += sum1;
+
+			sum1 += (data[i] & 15);
+			sum2 += sum1;
+
+			sum1 %= 16;
+			sum2 %= 16;
+		}
+		return ((sum2) << 4) + (sum1);
+	}
+
+	// processSingleChannel() of the firmware (i is the channel index from 0).
+	uint8_t simChannel(ArduinoChannelState &channel, int i, uint8_t cmdVal, uint16_t cmdData,
+		uint8_t *replyOut, size_t &replyIndex)
+	{
+		bool poll((cmdVal >> POL_BIT) & 1);
+		bool upd((cmdVal >> UPD_BIT) & 1);
+		uint8_t response(static_cast<uint8_t> ((i + 1) << 4));
+		if (poll)
+		{
+			// a perfect current sensor: the adc reads the dac setting.
+			uint16_t adcCounts(channel.dacCounts);
+			response |= (1 << POL_BIT) | (channel.enable << ENA_BIT) | (channel.dir << DIR_BIT);
+			replyOut[replyIndex] = response;
+			replyOut[replyIndex + 1] = (channel.dacCounts >> 6) & 63;
+			replyOut[replyIndex + 2] = channel.dacCounts & 63;
+			replyOut[replyIndex + 3] = static_cast<uint8_t> (adcCounts >> 8);
+			replyOut[replyIndex + 4] = static_cast<uint8_t> (adcCounts & 255);
+			replyIndex += 5;
+			return 1;
+		}
+		channel.enable = (cmdVal >> ENA_BIT) & 1;
+		if (upd)
+		{
+			channel.dacCounts = cmdData;
+		}
+		channel.dir = (cmdVal >> DIR_BIT) & 1;
+		response |= (upd << UPD_BIT) | (channel.enable << ENA_BIT) | (channel.dir << DIR_BIT);
+		replyOut[replyIndex] = response;
+		replyOut[replyIndex + 1] = (channel.dacCounts >> 6) & 63;
+		replyOut[replyIndex + 2] = channel.dacCounts & 63;
+		replyIndex += 3;
+		return 0;
+	}
+
+	struct PendingReply
+	{
+		SteadyClock::time_point due;
+		std::vector<uint8_t> bytes;
+	};
+}
+
+size_t arduinoReply(const uint8_t *packet, size_t length, ArduinoChannelState channels[NCHANNELS], uint8_t *replyOut)
+{
+	// cmd_check()
+	if (length < PCK_LEN(0) || !(packet[0] >> 7))
+	{
+		return 0;
+	}
+	uint8_t packetIndex((packet[0] >> 4) & 7);
+	uint8_t cmdCount(packet[0] & 15);
+	if (static_cast<size_t> (PCK_LEN(cmdCount)) != length || ((packet[length - 2] >> 5) & 7) != packetIndex
+		|| simFletcher8(length - 1, packet) != packet[length - 1])
+	{
+		return 0;
+	}
+
+	// cmd_parse()
+	size_t replyIndex(2);
+	uint8_t pollCount(0);
+	uint8_t responses(0);
+	for (int i(0); i < cmdCount; i++)
+	{
+		const uint8_t *cmdBytes(packet + PRE_LEN + i * CMD_LEN);
+		uint8_t addr(cmdBytes[0] >> 4);
+		uint8_t cmdVal(cmdBytes[0] & 15);
+		uint16_t cmdData((static_cast<uint16_t> (cmdBytes[1]) << 6) + cmdBytes[2]);
+		if (addr == GLOBAL_ADDR)
+		{
+			for (int channel(0); channel < NCHANNELS; channel++)
+			{
+				pollCount += simChannel(channels[channel], channel, cmdVal, cmdData, replyOut, replyIndex);
+			}
+			responses += NCHANNELS;
+		}
+		else if (addr <= NCHANNELS)
+		{
+			pollCount += simChannel(channels[addr - 1], addr - 1, cmdVal, cmdData, replyOut, replyIndex);
+			responses++;
+		}
+	}
+	replyOut[0] = 128 + 64 + (packetIndex & 15);
+	replyOut[1] = static_cast<uint8_t> ((responses << 4) + (pollCount & 15));
+	replyOut[replyIndex] = simFletcher8(replyIndex, replyOut);
+	return replyIndex + 1;
+}
+
+
+ArduinoSim::ArduinoSim(const ArduinoSimOptions &options_) : options(options_), masterFd(-1), slaveFd(-1),
+	active(false)
+{
+}
+
+ArduinoSim::~ArduinoSim()
+{
+	stop();
+}
+
+bool ArduinoSim::start()
+{
+#ifdef _WIN32
+	return false;
+#else
+	if (active)
+	{
+		return true;
+	}
+	masterFd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (masterFd < 0)
+	{
+		return false;
+	}
+	fcntl(masterFd, F_SETFL, fcntl(masterFd, F_GETFL) | O_NONBLOCK);
+	if (grantpt(masterFd) != 0 || unlockpt(masterFd) != 0 || ptsname(masterFd) == NULL)
+	{
+		close(masterFd);
+		masterFd = -1;
+		return false;
+	}
+	slaveName = ptsname(masterFd);
+
+	// the slave stays open here so the master does not hang up between pc side sessions.
+	slaveFd = open(slaveName.c_str(), O_RDWR | O_NOCTTY);
+	if (slaveFd < 0)
+	{
+		close(masterFd);
+		masterFd = -1;
+		return false;
+	}
+	struct termios tio;
+	if (tcgetattr(slaveFd, &tio) == 0)
+	{
+		cfmakeraw(&tio);
+		tcsetattr(slaveFd, TCSANOW, &tio);
+	}
+
+	active = true;
+	thrd = boost::thread(boost::bind(&ArduinoSim::simLoop, this));
+	return true;
+#endif
+}
+
+void ArduinoSim::stop()
+{
+	{
+		boost::mutex::scoped_lock lock(simMutex);
+		if (!active)
+		{
+			return;
+		}
+		active = false;
+	}
+	thrd.join();
+#ifndef _WIN32
+	close(slaveFd);
+	close(masterFd);
+#endif
+	slaveFd = -1;
+	masterFd = -1;
+}
+
+std::string ArduinoSim::portName() const
+{
+	return slaveName;
+}
+
+void ArduinoSim::getStats(ArduinoSimStats &stats_)
+{
+	boost::mutex::scoped_lock lock(simMutex);
+	stats_ = stats;
+}
+
+void ArduinoSim::simLoop()
+{
+#ifndef _WIN32
+	SteadyClock::duration byteTime(SteadyClock::duration::zero());
+	if (options.baud > 0)
+	{
+		byteTime = std::chrono::duration_cast<SteadyClock::duration> (std::chrono::duration<double>(10.0 / options.baud));
+	}
+	std::mt19937 rng(options.seed);
+	std::uniform_real_distribution<double> jitter(0.0, options.jitterUs);
+
+	// when the wire (each way) and the firmware are free again.
+	SteadyClock::time_point rxFree(SteadyClock::now());
+	SteadyClock::time_point busyUntil(rxFree);
+	SteadyClock::time_point txFree(rxFree);
+
+	std::deque<PendingReply> replies;
+	std::vector<uint8_t> packet;
+	uint64_t packetCount(0);
+	uint8_t readBuffer[1024];
+	uint8_t replyBuffer[SIM_MAX_REPLY_LEN];
+	bool writeBlocked(false);
+
+	while (true)
+	{
+		{
+			boost::mutex::scoped_lock lock(simMutex);
+			if (!active)
+			{
+				break;
+			}
+		}
+
+		SteadyClock::time_point now(SteadyClock::now());
+		long waitUs(SIM_POLL_MAX_US);
+		if (!replies.empty() && !writeBlocked)
+		{
+			waitUs = std::min<long>(waitUs, std::max<long>(0,
+				std::chrono::duration_cast<std::chrono::microseconds> (replies.front().due - now).count()));
+		}
+		struct pollfd pfd;
+		pfd.fd = masterFd;
+		pfd.events = POLLIN | (writeBlocked ? POLLOUT : 0);
+		pfd.revents = 0;
+		struct timespec timeout;
+		timeout.tv_sec = 0;
+		timeout.tv_nsec = waitUs * 1000;
+		int ready(ppoll(&pfd, 1, &timeout, NULL));
+		now = SteadyClock::now();
+
+		if (ready > 0 && (pfd.revents & POLLIN))
+		{
+			ssize_t count(read(masterFd, readBuffer, sizeof(readBuffer)));
+			uint64_t packets(0);
+			uint64_t rejected(0);
+			for (ssize_t i(0); i < count; i++)
+			{
+				rxFree = std::max(rxFree, now) + byteTime;
+
+				// packets are framed by their header byte (the count of commands).
+				if (packet.empty() && !(readBuffer[i] >> 7))
+				{
+					rejected++;
+					continue;
+				}
+				packet.push_back(readBuffer[i]);
+				size_t cmdCount(packet[0] & 15);
+				if (packet.size() < PCK_LEN(cmdCount))
+				{
+					continue;
+				}
+
+				packets++;
+				size_t replyLen(arduinoReply(packet.data(), packet.size(), channels, replyBuffer));
+				if (replyLen == 0)
+				{
+					// writeError()
+					replyBuffer[0] = (8 << 4) + ((packet[0] >> 4) & 7);
+					replyLen = 1;
+					rejected++;
+				}
+				double processUs(options.processingUs + (options.jitterUs > 0.0 ? jitter(rng) : 0.0));
+				busyUntil = std::max(rxFree, busyUntil)
+					+ std::chrono::duration_cast<SteadyClock::duration> (std::chrono::duration<double, std::micro>(processUs));
+				txFree = std::max(busyUntil, txFree) + byteTime * replyLen;
+
+				packetCount++;
+				if (options.dropReply > 0 && packetCount % options.dropReply == 0)
+				{
+					packet.clear();
+					continue;
+				}
+				PendingReply reply;
+				reply.due = txFree;
+				reply.bytes.assign(replyBuffer, replyBuffer + replyLen);
+				replies.push_back(reply);
+				packet.clear();
+			}
+			if (count > 0)
+			{
+				boost::mutex::scoped_lock lock(simMutex);
+				stats.bytesIn += count;
+				stats.packetsIn += packets;
+				stats.packetsRejected += rejected;
+			}
+		}
+
+		// the replies that are through the wire.
+		uint64_t bytesOut(0);
+		writeBlocked = false;
+		while (!replies.empty() && replies.front().due <= now)
+		{
+			// the master is non blocking: when the pc side stops reading, the rest is kept for later.
+			std::vector<uint8_t> &bytes(replies.front().bytes);
+			ssize_t result(write(masterFd, bytes.data(), bytes.size()));
+			if (result <= 0)
+			{
+				writeBlocked = true;
+				break;
+			}
+			bytesOut += result;
+			if (static_cast<size_t> (result) < bytes.size())
+			{
+				bytes.erase(bytes.begin(), bytes.begin() + result);
+				writeBlocked = true;
+				break;
+			}
+			replies.pop_front();
+		}
+		if (bytesOut > 0)
+		{
+			boost::mutex::scoped_lock lock(simMutex);
+			stats.bytesOut += bytesOut;
+		}
+	}
+#endif
+}
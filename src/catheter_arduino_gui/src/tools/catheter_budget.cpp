@@ -0,0 +1,188 @@
+#include "com/command_sequence.h"
+#include "com/link_budget.h"
+#include "com/pc_utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+// Link budget preflight: tells whether a playfile fits the link before it is
+// played, where it falls behind and what baud or packet mode would fit it
+// (see link_budget.h). Exits with 3 when the playfile is infeasible.
+
+#define DEFAULT_SEGMENTS_SHOWN 10
+
+namespace
+{
+	void printUsage(const char *name)
+	{
+		LinkBudgetOptions defaults;
+		fprintf(stderr,
+			"usage: %s [options] playfile.play\n"
+			"  --baud N           link baud, 0 for native usb (default %u)\n"
+			"  --packet-us US     firmware time per packet (default %.0f)\n"
+			"  --dac-us US        firmware time per channel written (default %.0f)\n"
+			"  --adc-us US        firmware time per channel polled (default %.0f)\n"
+			"  --tolerance-us US  a set later than this is infeasible (default %.0f)\n"
+			"  --segments N       infeasible segments to print (default %d)\n"
+			"  --per-set FILE.csv write the wire time, firmware time and lag of every set\n",
+			name, defaults.baud, defaults.packetUs, defaults.dacUs, defaults.adcUs, defaults.lagToleranceUs,
+			DEFAULT_SEGMENTS_SHOWN);
+	}
+
+	bool writePerSet(const std::string &fileName, const std::vector<SetBudget> &perSet)
+	{
+		FILE *file(fopen(fileName.c_str(), "w"));
+		if (file == NULL)
+		{
+			return false;
+		}
+		fprintf(file, "set,wire_us,firmware_us,lag_us\n");
+		for (size_t index(0); index < perSet.size(); index++)
+		{
+			fprintf(file, "%zu,%.1f,%.1f,%.1f\n", index, perSet[index].wireUs, perSet[index].firmwareUs,
+				perSet[index].lagUs);
+		}
+		return fclose(file) == 0;
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	LinkBudgetOptions options;
+	std::string playfileName;
+	std::string perSetName;
+	int segmentsShown(DEFAULT_SEGMENTS_SHOWN);
+
+	for (int i(1); i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		bool hasValue(i + 1 < argc);
+		if (arg == "--baud" && hasValue)
+		{
+			options.baud = static_cast<unsigned int> (std::max(atoi(argv[++i]), 0));
+		}
+		else if (arg == "--packet-us" && hasValue)
+		{
+			options.packetUs = std::max(atof(argv[++i]), 0.0);
+		}
+		else if (arg == "--dac-us" && hasValue)
+		{
+			options.dacUs = std::max(atof(argv[++i]), 0.0);
+		}
+		else if (arg == "--adc-us" && hasValue)
+		{
+			options.adcUs = std::max(atof(argv[++i]), 0.0);
+		}
+		else if (arg == "--tolerance-us" && hasValue)
+		{
+			options.lagToleranceUs = std::max(atof(argv[++i]), 0.0);
+		}
+		else if (arg == "--segments" && hasValue)
+		{
+			segmentsShown = std::max(atoi(argv[++i]), 0);
+		}
+		else if (arg == "--per-set" && hasValue)
+		{
+			perSetName = argv[++i];
+		}
+		else if (arg == "--help" || arg == "-h")
+		{
+			printUsage(argv[0]);
+			return 0;
+		}
+		else if (!arg.empty() && arg[0] != '-' && playfileName.empty())
+		{
+			playfileName = arg;
+		}
+		else
+		{
+			fprintf(stderr, "unknown option: %s\n", arg.c_str());
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+	if (playfileName.empty())
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	CatheterCmdSequence cmdSequence;
+	std::chrono::steady_clock::time_point loadStart(std::chrono::steady_clock::now());
+	if (loadPlayFile(playfileName.c_str(), cmdSequence) < 0 || cmdSequence.empty())
+	{
+		fprintf(stderr, "Unable to load any commands from %s\n", playfileName.c_str());
+		return 1;
+	}
+	std::chrono::steady_clock::time_point analysisStart(std::chrono::steady_clock::now());
+	std::vector<SetBudget> perSet;
+	LinkBudgetReport report(analyzeLinkBudget(cmdSequence, options, perSetName.empty() ? NULL : &perSet));
+	std::chrono::steady_clock::time_point analysisEnd(std::chrono::steady_clock::now());
+
+	printf("playfile:        %s, %zu sets, %zu commands\n", playfileName.c_str(), report.sets,
+		cmdSequence.commandCount());
+	if (options.baud == 0)
+	{
+		printf("link:            native usb, %.0f us per packet, %.0f us per write, %.0f us per poll\n",
+			options.packetUs, options.dacUs, options.adcUs);
+	}
+	else
+	{
+		printf("link:            %u baud, %.0f us per packet, %.0f us per write, %.0f us per poll\n",
+			options.baud, options.packetUs, options.dacUs, options.adcUs);
+	}
+	printf("schedule:        %.3f s scheduled, %.3f s of link time, %zu sets shorter than their budget\n",
+		report.scheduledUs * 1.0e-6, report.busyUs * 1.0e-6, report.tightSets);
+	printf("timing error:    max %.1f ms, mean %.1f ms, last set %.1f ms late\n", report.maxLagUs * 1.0e-3,
+		report.meanLagUs * 1.0e-3, report.finalLagUs * 1.0e-3);
+	printf("verdict:         %s (%zu sets in %zu segments later than %.1f ms)\n",
+		report.feasible ? "feasible" : "INFEASIBLE", report.infeasibleSets, report.segmentCount,
+		options.lagToleranceUs * 1.0e-3);
+	for (size_t index(0); index < report.segments.size() && index < static_cast<size_t> (segmentsShown); index++)
+	{
+		const InfeasibleSegment &segment(report.segments[index]);
+		printf("  sets %zu-%zu from %.3f s, up to %.1f ms late\n", segment.first, segment.last,
+			segment.startUs * 1.0e-6, segment.maxLagUs * 1.0e-3);
+	}
+	if (report.segmentCount > std::min(report.segments.size(), static_cast<size_t> (segmentsShown)))
+	{
+		printf("  ...\n");
+	}
+	if (report.minBaud != 0)
+	{
+		printf("minimum baud:    %u\n", report.minBaud);
+	}
+	else
+	{
+		printf("minimum baud:    none of the standard rates (the firmware time alone is too long)\n");
+	}
+	printf("packet mode:     %s\n", report.suggestedMode == packetModeCount ? "none is feasible at this baud"
+		: packetModeName(report.suggestedMode));
+	printf("analysis:        %.1f ms (load %.1f ms)\n",
+		std::chrono::duration<double, std::milli>(analysisEnd - analysisStart).count(),
+		std::chrono::duration<double, std::milli>(analysisStart - loadStart).count());
+
+	if (!perSetName.empty() && !writePerSet(perSetName, perSet))
+	{
+		fprintf(stderr, "Unable to write %s\n", perSetName.c_str());
+		return 1;
+	}
+	return report.feasible ? 0 : 3;
+}
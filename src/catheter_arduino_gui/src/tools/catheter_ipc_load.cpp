@@ -0,0 +1,269 @@
+#include "ipc/ipc_client.h"
+#include "com/communication_definitions.h"
+
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+// Load generator for the setpoint server: every client streams one step
+// setpoints at a fixed rate (replacing the queue, like a controller would)
+// and reports the process to queue latency from the acks (queuedNs - sendNs,
+// both on the shared monotonic clock) and the ack round trip.
+
+#define DEFAULT_CLIENTS 1
+#define DEFAULT_RATE_HZ 1000.0
+#define DEFAULT_SECONDS 5.0
+
+#define READ_POLL_MS 10
+// acks still missing this long after the last send are counted as lost.
+#define ACK_WAIT_MS 500
+
+namespace
+{
+	void printUsage(const char *name)
+	{
+		fprintf(stderr,
+			"usage: %s [options]\n"
+			"  --socket PATH   server socket (default %s)\n"
+			"  --clients N     concurrent clients (default %d)\n"
+			"  --rate HZ       setpoints per second per client (default %.0f)\n"
+			"  --seconds S     run time (default %.0f)\n"
+			"  --channels N    channels per setpoint (default %d)\n"
+			"  --subscribe     also receive the telemetry\n"
+			"  --latest        write the setpoint mailbox instead of the queue (catheter_server --mailbox)\n",
+			name, IPC_DEFAULT_SOCKET, DEFAULT_CLIENTS, DEFAULT_RATE_HZ, DEFAULT_SECONDS, NCHANNELS);
+	}
+
+	struct ClientResult
+	{
+		uint64_t sent;
+		uint64_t acked;
+		uint64_t invalid;
+		uint64_t samples;
+		uint64_t samplesDropped;
+		uint64_t lateSends;
+		std::vector<double> queueUs;
+		std::vector<double> roundTripUs;
+		bool connected;
+
+		ClientResult() : sent(0), acked(0), invalid(0), samples(0), samplesDropped(0), lateSends(0), connected(false)
+		{};
+	};
+
+	struct LoadOptions
+	{
+		std::string socketPath;
+		double rateHz;
+		double seconds;
+		int nChannels;
+		bool subscribe;
+		bool latest;
+	};
+
+	void readAcks(IpcClient &client, ClientResult &result, const std::atomic<bool> &sending)
+	{
+		std::vector<IpcAckMessage> acks;
+		std::vector<CurrentSample> samples;
+		int waitedMs(0);
+		while (sending || (result.acked + result.invalid < result.sent && waitedMs < ACK_WAIT_MS))
+		{
+			acks.clear();
+			samples.clear();
+			if (!client.read(READ_POLL_MS, acks, samples, &result.samplesDropped))
+			{
+				break;
+			}
+			uint64_t now(ipcNowNs());
+			for (size_t i(0); i < acks.size(); i++)
+			{
+				if (acks[i].status != ipcOk)
+				{
+					result.invalid++;
+					continue;
+				}
+				result.acked++;
+				result.queueUs.push_back((acks[i].queuedNs - acks[i].sendNs) * 1.0e-3);
+				result.roundTripUs.push_back((now - acks[i].sendNs) * 1.0e-3);
+			}
+			result.samples += samples.size();
+			waitedMs = sending ? 0 : waitedMs + READ_POLL_MS;
+		}
+	}
+
+	void runClient(const LoadOptions &options, int index, ClientResult &result)
+	{
+		IpcClient client;
+		if (!client.connect(options.socketPath))
+		{
+			return;
+		}
+		result.connected = true;
+		if (options.subscribe)
+		{
+			client.subscribe(true);
+			result.sent++;
+		}
+		std::atomic<bool> sending(true);
+		boost::thread reader(boost::bind(&readAcks, boost::ref(client), boost::ref(result), boost::cref(sending)));
+
+		std::vector<double> milliAmp(options.nChannels);
+		double delayMS(0.0);
+		std::chrono::nanoseconds period(static_cast<int64_t> (1.0e9 / options.rateHz));
+		size_t nSends(static_cast<size_t> (options.seconds * options.rateHz));
+		std::chrono::steady_clock::time_point next(std::chrono::steady_clock::now());
+		for (size_t step(0); step < nSends; step++)
+		{
+			next += period;
+			for (int channel(0); channel < options.nChannels; channel++)
+			{
+				milliAmp[channel] = ((step + channel + index) % 2 ? 50.0 : -50.0) * (channel + 1);
+			}
+			if (client.sendSetpoints(milliAmp.data(), options.nChannels, 1, &delayMS, 1,
+				options.latest ? IPC_FLAG_LATEST : IPC_FLAG_FLUSH) == 0)
+			{
+				break;
+			}
+			result.sent++;
+			if (std::chrono::steady_clock::now() > next)
+			{
+				result.lateSends++;
+				continue;
+			}
+			std::this_thread::sleep_until(next);
+		}
+		sending = false;
+		reader.join();
+	}
+
+	double sortedPercentile(const std::vector<double> &values, double fraction)
+	{
+		if (values.empty())
+		{
+			return 0.0;
+		}
+		return values[static_cast<size_t> (fraction * (values.size() - 1) + 0.5)];
+	}
+
+	void printLatency(const char *name, std::vector<double> &values)
+	{
+		std::sort(values.begin(), values.end());
+		printf("%-16s p50 %8.1f  p99 %8.1f  p99.9 %8.1f  max %8.1f us\n", name, sortedPercentile(values, 0.5),
+			sortedPercentile(values, 0.99), sortedPercentile(values, 0.999), values.empty() ? 0.0 : values.back());
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	LoadOptions options;
+	options.socketPath = IPC_DEFAULT_SOCKET;
+	options.rateHz = DEFAULT_RATE_HZ;
+	options.seconds = DEFAULT_SECONDS;
+	options.nChannels = NCHANNELS;
+	options.subscribe = false;
+	options.latest = false;
+	int nClients(DEFAULT_CLIENTS);
+
+	for (int i(1); i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		bool hasValue(i + 1 < argc);
+		if (arg == "--socket" && hasValue)
+		{
+			options.socketPath = argv[++i];
+		}
+		else if (arg == "--clients" && hasValue)
+		{
+			nClients = std::max(atoi(argv[++i]), 1);
+		}
+		else if (arg == "--rate" && hasValue)
+		{
+			options.rateHz = std::max(atof(argv[++i]), 1.0);
+		}
+		else if (arg == "--seconds" && hasValue)
+		{
+			options.seconds = std::max(atof(argv[++i]), 0.1);
+		}
+		else if (arg == "--channels" && hasValue)
+		{
+			options.nChannels = std::min(std::max(atoi(argv[++i]), 1), NCHANNELS);
+		}
+		else if (arg == "--subscribe")
+		{
+			options.subscribe = true;
+		}
+		else if (arg == "--latest")
+		{
+			options.latest = true;
+		}
+		else
+		{
+			printUsage(argv[0]);
+			return (arg == "--help" || arg == "-h") ? 0 : 1;
+		}
+	}
+
+	std::vector<ClientResult> results(nClients);
+	boost::thread_group clients;
+	for (int index(0); index < nClients; index++)
+	{
+		clients.create_thread(boost::bind(&runClient, boost::cref(options), index, boost::ref(results[index])));
+	}
+	clients.join_all();
+
+	ClientResult total;
+	int connected(0);
+	for (int index(0); index < nClients; index++)
+	{
+		const ClientResult &result(results[index]);
+		connected += result.connected ? 1 : 0;
+		total.sent += result.sent;
+		total.acked += result.acked;
+		total.invalid += result.invalid;
+		total.samples += result.samples;
+		total.samplesDropped += result.samplesDropped;
+		total.lateSends += result.lateSends;
+		total.queueUs.insert(total.queueUs.end(), result.queueUs.begin(), result.queueUs.end());
+		total.roundTripUs.insert(total.roundTripUs.end(), result.roundTripUs.begin(), result.roundTripUs.end());
+	}
+	if (connected == 0)
+	{
+		fprintf(stderr, "Unable to connect to %s\n", options.socketPath.c_str());
+		return 2;
+	}
+
+	printf("clients:         %d of %d connected, %.0f Hz each, %d channels%s%s\n", connected, nClients, options.rateHz,
+		options.nChannels, options.subscribe ? ", subscribed" : "", options.latest ? ", latest value" : "");
+	printf("requests:        %llu sent, %llu acked, %llu invalid, %llu lost, %llu sent late\n",
+		static_cast<unsigned long long> (total.sent), static_cast<unsigned long long> (total.acked),
+		static_cast<unsigned long long> (total.invalid),
+		static_cast<unsigned long long> (total.sent - std::min(total.sent, total.acked + total.invalid)),
+		static_cast<unsigned long long> (total.lateSends));
+	printLatency("process to queue", total.queueUs);
+	printLatency("ack round trip", total.roundTripUs);
+	if (options.subscribe)
+	{
+		printf("telemetry:       %llu samples, %llu dropped by the server\n",
+			static_cast<unsigned long long> (total.samples), static_cast<unsigned long long> (total.samplesDropped));
+	}
+	return 0;
+}
@@ -0,0 +1,393 @@
+#include "com/catheter_commands.h"
+#include "com/current_sample.h"
+#include "hardware/digital_analog_conversions.h"
+#include "ser/serial_thread.h"
+#include "sim/arduino_sim.h"
+#include "util/console_log.h"
+#include "util/metrics.h"
+#include "util/trace.h"
+#include "util/spsc_ring.h"
+
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+// Link benchmark: plays synthetic playfiles through SerialThreadObject at
+// increasing rates against a simulated arduino (or a real port) and reports
+// the sustained throughput, the command to reply latency and the rate where
+// the replies fall behind for good.
+//
+// The round trips are the serial thread's own (write to parsed reply, matched
+// by packet index), the acknowledged rate comes from the telemetry ring.
+
+#define DEFAULT_PROC_US 200.0
+#define DEFAULT_JITTER_US 100.0
+#define DEFAULT_SETS 2000
+#define DEFAULT_DELAYS "20,10,5,2,1,0"
+
+// a real arduino resets when the port opens.
+#define REAL_PORT_SETTLE_MS 2000
+
+#define BENCH_POLL_MS 5
+#define REPLY_QUIET_MS 200
+#define BENCH_RING_SAMPLES 262144
+
+// a step is saturated when the latency grows by more than this from its first
+// to its last tenth (the replies are queueing up), or replies are missing or wrong.
+#define RTT_GROWTH_LIMIT_MS 1.0
+
+namespace
+{
+	struct StepResult
+	{
+		int delayMs;
+		size_t sets;
+		size_t replies;
+		double sentHz;
+		double ackedHz;
+		double rttP50Ms;
+		double rttP99Ms;
+		double rttP999Ms;
+		double rttGrowthMs;
+		double latenessP99Us;
+		uint64_t errors;
+		bool saturated;
+	};
+
+	void printUsage(const char *name)
+	{
+		fprintf(stderr,
+			"usage: %s [options]\n"
+			"  --baud N        simulated line rate in bits/s, 0 for native usb (default 0)\n"
+			"  --proc-us US    simulated firmware time per packet (default %.0f)\n"
+			"  --jitter-us US  uniform extra firmware time (default %.0f)\n"
+			"  --channels N    commands per set (default %d)\n"
+			"  --poll          poll every command (longer replies)\n"
+			"  --sets N        sets per rate step (default %d)\n"
+			"  --delays LIST   set delays in ms, one step each (default %s)\n"
+			"  --port NAME     run against a real port instead of the simulator\n"
+			"  --metrics NAME  publish the serial metrics (read with catheter_stat)\n"
+			"  --trace FILE    write a Chrome trace of every step (needs a CATHETER_TRACE build)\n",
+			name, DEFAULT_PROC_US, DEFAULT_JITTER_US, NCHANNELS, DEFAULT_SETS, DEFAULT_DELAYS);
+	}
+
+	void sleepMs(int ms)
+	{
+		boost::this_thread::sleep(boost::posix_time::milliseconds(ms));
+	}
+
+	// nearest rank percentile of sorted values.
+	double sortedPercentile(const std::vector<double> &values, double fraction)
+	{
+		if (values.empty())
+		{
+			return 0.0;
+		}
+		return values[static_cast<size_t> (fraction * (values.size() - 1) + 0.5)];
+	}
+
+	double median(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		return sortedPercentile(values, 0.5);
+	}
+
+	// one reply time per nChannels samples (every sample of a reply has its time).
+	void drainReplies(SpscRing<CurrentSample> &ring, int nChannels, size_t &samplesSeen, std::vector<double> &replyTimes)
+	{
+		CurrentSample sample;
+		while (ring.pop(sample))
+		{
+			if (samplesSeen % nChannels == 0)
+			{
+				replyTimes.push_back(sample.time);
+			}
+			samplesSeen++;
+		}
+	}
+
+	void buildSets(int nSets, int nChannels, int delayMs, bool poll, std::vector<CatheterChannelCmdSet> &cmdVect)
+	{
+		cmdVect.assign(nSets, CatheterChannelCmdSet());
+		for (int i(0); i < nSets; i++)
+		{
+			for (int channel(1); channel <= nChannels; channel++)
+			{
+				CatheterChannelCmd cmd;
+				cmd.channel = channel;
+				cmd.poll = poll;
+				setCmdMilliAmp(cmd, (((i + channel) % 2) ? 50.0 : -50.0) * channel);
+				cmdVect[i].commandList.push_back(cmd);
+			}
+			cmdVect[i].delayTime = delayMs;
+		}
+	}
+
+	StepResult runStep(SerialThreadObject &serialObject, SpscRing<CurrentSample> &ring, int nSets, int nChannels,
+		int delayMs, bool poll)
+	{
+		std::vector<CatheterChannelCmdSet> cmdVect;
+		buildSets(nSets, nChannels, delayMs, poll, cmdVect);
+
+		std::vector<double> replyTimes;
+		size_t samplesSeen(0);
+		CurrentSample stale;
+		while (ring.pop(stale))
+		{
+		}
+		serialObject.resetStats();
+		serialObject.queueCommands(cmdVect);
+
+		while (!serialObject.playbackIdle())
+		{
+			sleepMs(BENCH_POLL_MS);
+			drainReplies(ring, nChannels, samplesSeen, replyTimes);
+		}
+		// wait until every reply is in or none came for a while.
+		size_t lastCount(replyTimes.size());
+		for (int quietMs(0); replyTimes.size() < static_cast<size_t> (nSets) && quietMs < REPLY_QUIET_MS;)
+		{
+			sleepMs(BENCH_POLL_MS);
+			drainReplies(ring, nChannels, samplesSeen, replyTimes);
+			quietMs = (replyTimes.size() == lastCount) ? quietMs + BENCH_POLL_MS : 0;
+			lastCount = replyTimes.size();
+		}
+
+		PlaybackStats stats;
+		serialObject.getStats(stats);
+
+		StepResult result;
+		result.delayMs = delayMs;
+		result.sets = stats.setsSent;
+		result.replies = replyTimes.size();
+		double sendSpan(stats.lastSendTime - stats.firstSendTime);
+		result.sentHz = (sendSpan > 0.0) ? (stats.setsSent - 1) / sendSpan : 0.0;
+		double replySpan(replyTimes.empty() ? 0.0 : replyTimes.back() - replyTimes.front());
+		result.ackedHz = (replySpan > 0.0) ? (replyTimes.size() - 1) / replySpan : 0.0;
+		result.latenessP99Us = latenessPercentile(stats, 0.99);
+
+		result.errors = stats.echoMismatches + stats.replyTimeouts + stats.repliesUnmatched + stats.repliesInvalid;
+
+		// in reply order.
+		size_t matched(stats.rttUs.size());
+		std::vector<double> rttMs(matched);
+		for (size_t i(0); i < matched; i++)
+		{
+			rttMs[i] = stats.rttUs[i] * 1.0e-3;
+		}
+		size_t tenth(std::max<size_t>(1, matched / 10));
+		result.rttGrowthMs = (matched > 0) ?
+			median(std::vector<double>(rttMs.end() - tenth, rttMs.end())) - median(std::vector<double>(rttMs.begin(), rttMs.begin() + tenth)) : 0.0;
+
+		std::sort(rttMs.begin(), rttMs.end());
+		result.rttP50Ms = sortedPercentile(rttMs, 0.50);
+		result.rttP99Ms = sortedPercentile(rttMs, 0.99);
+		result.rttP999Ms = sortedPercentile(rttMs, 0.999);
+		result.saturated = (result.replies < result.sets) || (result.errors > 0) || (result.rttGrowthMs > RTT_GROWTH_LIMIT_MS);
+		return result;
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	ArduinoSimOptions simOptions;
+	simOptions.processingUs = DEFAULT_PROC_US;
+	simOptions.jitterUs = DEFAULT_JITTER_US;
+	int nChannels(NCHANNELS);
+	int nSets(DEFAULT_SETS);
+	bool poll(false);
+	std::string delayList(DEFAULT_DELAYS);
+	std::string portName;
+	std::string metricsName;
+	std::string traceName;
+
+	for (int i(1); i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		bool hasValue(i + 1 < argc);
+		if (arg == "--baud" && hasValue)
+		{
+			simOptions.baud = atoi(argv[++i]);
+		}
+		else if (arg == "--proc-us" && hasValue)
+		{
+			simOptions.processingUs = atof(argv[++i]);
+		}
+		else if (arg == "--jitter-us" && hasValue)
+		{
+			simOptions.jitterUs = atof(argv[++i]);
+		}
+		else if (arg == "--channels" && hasValue)
+		{
+			nChannels = std::min(std::max(atoi(argv[++i]), 1), NCHANNELS);
+		}
+		else if (arg == "--sets" && hasValue)
+		{
+			nSets = std::max(atoi(argv[++i]), 10);
+		}
+		else if (arg == "--delays" && hasValue)
+		{
+			delayList = argv[++i];
+		}
+		else if (arg == "--port" && hasValue)
+		{
+			portName = argv[++i];
+		}
+		else if (arg == "--metrics" && hasValue)
+		{
+			metricsName = argv[++i];
+		}
+		else if (arg == "--trace" && hasValue)
+		{
+			traceName = argv[++i];
+		}
+		else if (arg == "--poll")
+		{
+			poll = true;
+		}
+		else
+		{
+			printUsage(argv[0]);
+			return (arg == "--help" || arg == "-h") ? 0 : 1;
+		}
+	}
+
+	std::vector<int> delays;
+	std::stringstream delayStream(delayList);
+	std::string item;
+	while (std::getline(delayStream, item, ','))
+	{
+		delays.push_back(std::max(atoi(item.c_str()), 0));
+	}
+
+	ArduinoSim sim(simOptions);
+	if (portName.empty())
+	{
+		if (!sim.start())
+		{
+			fprintf(stderr, "Unable to open a pseudo terminal for the simulator.\n");
+			return 2;
+		}
+		portName = sim.portName();
+	}
+
+	ConsoleLog consoleLog;
+	SpscRing<CurrentSample> ring(BENCH_RING_SAMPLES);
+	MetricsRegistry metrics(metricsName);
+	SerialThreadObject serialObject(&metrics);
+	serialObject.setStatusTextPtr(&consoleLog);
+	serialObject.setSampleRing(&ring);
+	if (!serialObject.connectPort(portName))
+	{
+		fprintf(stderr, "Unable to open %s\n", portName.c_str());
+		serialObject.setSampleRing(NULL);
+		return 2;
+	}
+	if (portName != sim.portName())
+	{
+		sleepMs(REAL_PORT_SETTLE_MS);
+	}
+
+	printf("link:    %s", portName.c_str());
+	if (portName == sim.portName())
+	{
+		printf(" (simulated, %d baud, %.0f us + %.0f us jitter per packet)", simOptions.baud,
+			simOptions.processingUs, simOptions.jitterUs);
+	}
+	printf("\nsets:    %d per step, %d commands each%s\n\n", nSets, nChannels, poll ? ", polled" : "");
+	printf("%8s %10s %10s %10s %10s %10s %10s %12s %12s %8s  %s\n", "delay_ms", "offered/s", "sent/s", "acked/s",
+		"rtt_p50", "rtt_p99", "rtt_p999", "rtt_growth", "late_p99_us", "errors", "status");
+
+	if (!traceName.empty())
+	{
+		if (!traceCompiledIn())
+		{
+			fprintf(stderr, "Built without CATHETER_TRACE, the trace will be empty.\n");
+		}
+		traceEnable(true);
+	}
+
+	double sustainedHz(0.0);
+	int saturationDelay(-1);
+	for (size_t step(0); step < delays.size(); step++)
+	{
+		StepResult result(runStep(serialObject, ring, nSets, nChannels, delays[step], poll));
+		char offered[32];
+		if (result.delayMs > 0)
+		{
+			sprintf(offered, "%.1f", 1000.0 / result.delayMs);
+		}
+		else
+		{
+			sprintf(offered, "max");
+		}
+		printf("%8d %10s %10.1f %10.1f %10.3f %10.3f %10.3f %12.3f %12.1f %8llu  %s\n", result.delayMs, offered,
+			result.sentHz, result.ackedHz, result.rttP50Ms, result.rttP99Ms, result.rttP999Ms,
+			result.rttGrowthMs, result.latenessP99Us, static_cast<unsigned long long> (result.errors),
+			result.saturated ? ((result.replies < result.sets) ? "saturated (replies lost)" : "saturated") : "ok");
+		fflush(stdout);
+		if (!result.saturated)
+		{
+			sustainedHz = std::max(sustainedHz, result.ackedHz);
+		}
+		else if (saturationDelay < 0)
+		{
+			saturationDelay = result.delayMs;
+		}
+
+		// let a saturated link drain before the next step.
+		sleepMs(REPLY_QUIET_MS);
+	}
+
+	printf("\nsustained: %.1f sets/s\n", sustainedHz);
+	if (saturationDelay > 0)
+	{
+		printf("saturates: at %d ms per set (%.1f sets/s offered)\n", saturationDelay, 1000.0 / saturationDelay);
+	}
+	else if (saturationDelay == 0)
+	{
+		printf("saturates: only when sending back to back\n");
+	}
+	else
+	{
+		printf("saturates: not within the steps run\n");
+	}
+
+	if (!traceName.empty())
+	{
+		traceEnable(false);
+		if (!traceWriteJson(traceName))
+		{
+			fprintf(stderr, "Unable to write %s\n", traceName.c_str());
+		}
+	}
+
+	serialObject.setSampleRing(NULL);
+	if (portName == sim.portName())
+	{
+		ArduinoSimStats simStats;
+		sim.getStats(simStats);
+		printf("simulator: %llu packets (%llu rejected), %llu bytes in, %llu bytes out\n",
+			static_cast<unsigned long long> (simStats.packetsIn), static_cast<unsigned long long> (simStats.packetsRejected),
+			static_cast<unsigned long long> (simStats.bytesIn), static_cast<unsigned long long> (simStats.bytesOut));
+	}
+	return 0;
+}
@@ -0,0 +1,322 @@
+#include "ser/link_decode.h"
+#include "util/link_log.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+// Link log decoder: prints the packets of a link log (see link_log.h) as a
+// table or csv, one row per command packet, reply, mark or run of garbage,
+// with the round trip of every reply, followed by the totals.
+
+namespace
+{
+	void printUsage(const char *name)
+	{
+		fprintf(stderr,
+			"usage: %s [options] session.link\n"
+			"  --csv        one csv row per packet\n"
+			"  --raw        also print the bytes of every packet\n"
+			"  --from S     start S seconds into the log (found through the block index)\n"
+			"  --to S       stop S seconds into the log\n"
+			"  --summary    only print the totals\n",
+			name);
+	}
+
+	const char* kindName(const LinkPacket &packet)
+	{
+		switch (packet.kind)
+		{
+		case linkPacketCommand:
+			return "command";
+		case linkPacketReply:
+			return "reply";
+		case linkPacketMark:
+			return "mark";
+		default:
+			return "garbage";
+		}
+	}
+
+	std::string packetText(const LinkPacket &packet)
+	{
+		if (packet.kind == linkPacketMark)
+		{
+			return packet.text;
+		}
+		std::string text;
+		for (size_t index(0); index < packet.cmds.size(); index++)
+		{
+			text += (index > 0) ? "; " : "";
+			text += linkCommandText(packet.cmds[index], packet.kind == linkPacketReply);
+		}
+		return text;
+	}
+
+	// the bytes of the packet, found again in the records (a packet may span several).
+	std::string hexBytes(const std::vector<uint8_t> &stream, uint64_t streamBase, const LinkPacket &packet)
+	{
+		std::string text;
+		char byte[4];
+		for (uint64_t index(packet.streamOffset); index < packet.streamOffset + packet.length; index++)
+		{
+			if (index >= streamBase && index - streamBase < stream.size())
+			{
+				snprintf(byte, sizeof(byte), "%02x", stream[index - streamBase]);
+				text += byte;
+			}
+		}
+		return text;
+	}
+
+	struct DumpTotals
+	{
+		uint64_t commands;
+		uint64_t replies;
+		uint64_t marks;
+		uint64_t garbageRuns;
+		uint64_t bytesOut;
+		uint64_t bytesIn;
+		uint64_t unmatched;
+		double rttSum;
+		double rttMax;
+		uint64_t rttCount;
+
+		DumpTotals() : commands(0), replies(0), marks(0), garbageRuns(0), bytesOut(0), bytesIn(0), unmatched(0),
+			rttSum(0.0), rttMax(0.0), rttCount(0)
+		{};
+	};
+}
+
+
+int main(int argc, char** argv)
+{
+	std::string logName;
+	bool csv(false);
+	bool raw(false);
+	bool summaryOnly(false);
+	double fromSeconds(0.0);
+	double toSeconds(-1.0);
+
+	for (int i(1); i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		bool hasValue(i + 1 < argc);
+		if (arg == "--csv")
+		{
+			csv = true;
+		}
+		else if (arg == "--raw")
+		{
+			raw = true;
+		}
+		else if (arg == "--summary")
+		{
+			summaryOnly = true;
+		}
+		else if (arg == "--from" && hasValue)
+		{
+			fromSeconds = std::max(atof(argv[++i]), 0.0);
+		}
+		else if (arg == "--to" && hasValue)
+		{
+			toSeconds = atof(argv[++i]);
+		}
+		else if (arg == "--help" || arg == "-h")
+		{
+			printUsage(argv[0]);
+			return 0;
+		}
+		else if (!arg.empty() && arg[0] != '-' && logName.empty())
+		{
+			logName = arg;
+		}
+		else
+		{
+			fprintf(stderr, "unknown option: %s\n", arg.c_str());
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+	if (logName.empty())
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	LinkLogReader reader;
+	if (!reader.open(logName))
+	{
+		fprintf(stderr, "Unable to read a link log from %s\n", logName.c_str());
+		return 1;
+	}
+	const LinkLogHeader &header(reader.header());
+	uint64_t startNs(header.startNs);
+	uint64_t fromNs(startNs + static_cast<uint64_t> (fromSeconds * 1.0e9));
+	uint64_t toNs((toSeconds >= 0.0) ? startNs + static_cast<uint64_t> (toSeconds * 1.0e9) : UINT64_MAX);
+
+	if (!summaryOnly)
+	{
+		if (csv)
+		{
+			printf("time_s,dir,kind,index,bytes,rtt_us,commands%s\n", raw ? ",raw" : "");
+		}
+		else
+		{
+			printf("# %s: %s\n", logName.c_str(), header.note);
+			printf("%12s %3s %-8s %5s %5s %9s  %s\n", "time_s", "dir", "kind", "index", "bytes", "rtt_us", "commands");
+		}
+	}
+
+	LinkPacketDecoder decoder;
+	DumpTotals totals;
+	std::vector<LinkPacket> packets;
+	// the stream bytes still referenced by undecoded packets (for --raw).
+	std::vector<uint8_t> streams[2];
+	uint64_t streamBase[2] = { 0, 0 };
+	uint64_t lastNs(fromNs);
+
+	uint64_t offset((fromSeconds > 0.0) ? reader.seek(fromNs) : reader.begin());
+	LinkRecordView record;
+	while (reader.next(offset, record))
+	{
+		if (record.timeNs < fromNs)
+		{
+			continue;
+		}
+		if (record.timeNs > toNs)
+		{
+			break;
+		}
+		lastNs = record.timeNs;
+		bool outgoing(record.type == linkRecordOut);
+		if (raw && (outgoing || record.type == linkRecordIn))
+		{
+			std::vector<uint8_t> &stream(streams[outgoing ? 0 : 1]);
+			stream.insert(stream.end(), record.bytes, record.bytes + record.length);
+		}
+		packets.clear();
+		decoder.feed(record, packets);
+		if (packets.empty())
+		{
+			continue;
+		}
+		for (size_t index(0); index < packets.size(); index++)
+		{
+			const LinkPacket &packet(packets[index]);
+			switch (packet.kind)
+			{
+			case linkPacketCommand:
+				totals.commands++;
+				break;
+			case linkPacketReply:
+				totals.replies++;
+				if (packet.rttUs >= 0.0)
+				{
+					totals.rttSum += packet.rttUs;
+					totals.rttMax = std::max(totals.rttMax, packet.rttUs);
+					totals.rttCount++;
+				}
+				else
+				{
+					totals.unmatched++;
+				}
+				break;
+			case linkPacketMark:
+				totals.marks++;
+				break;
+			default:
+				totals.garbageRuns++;
+				break;
+			}
+			if (packet.kind != linkPacketMark)
+			{
+				(packet.outgoing ? totals.bytesOut : totals.bytesIn) += packet.length;
+			}
+			if (summaryOnly)
+			{
+				continue;
+			}
+			double seconds((packet.timeNs - startNs) * 1.0e-9);
+			const char *dir(packet.kind == linkPacketMark ? "--" : (packet.outgoing ? ">" : "<"));
+			std::string text(packetText(packet));
+			std::string bytes(raw ? hexBytes(streams[packet.outgoing ? 0 : 1], streamBase[packet.outgoing ? 0 : 1], packet) : "");
+			if (csv)
+			{
+				printf("%.6f,%s,%s,%d,%zu,%.1f,\"%s\"%s%s\n", seconds,
+					packet.kind == linkPacketMark ? "" : (packet.outgoing ? "out" : "in"), kindName(packet),
+					packet.packetIndex, packet.length, packet.rttUs, text.c_str(), raw ? "," : "", bytes.c_str());
+			}
+			else
+			{
+				char rtt[16] = "";
+				if (packet.rttUs >= 0.0)
+				{
+					snprintf(rtt, sizeof(rtt), "%.1f", packet.rttUs);
+				}
+				char packetIndex[8] = "";
+				if (packet.packetIndex >= 0)
+				{
+					snprintf(packetIndex, sizeof(packetIndex), "%d", packet.packetIndex);
+				}
+				printf("%12.6f %3s %-8s %5s %5zu %9s  %s%s%s\n", seconds, dir, kindName(packet), packetIndex,
+					packet.length, rtt, text.c_str(), raw ? "  " : "", bytes.c_str());
+			}
+		}
+		// the bytes of decoded packets are no longer needed.
+		if (raw)
+		{
+			for (int side(0); side < 2; side++)
+			{
+				if (streams[side].size() > 4096)
+				{
+					size_t drop(streams[side].size() - 1024);
+					streams[side].erase(streams[side].begin(), streams[side].begin() + drop);
+					streamBase[side] += drop;
+				}
+			}
+		}
+	}
+	packets.clear();
+	decoder.finish(lastNs, packets);
+	for (size_t index(0); index < packets.size(); index++)
+	{
+		totals.garbageRuns++;
+		(packets[index].outgoing ? totals.bytesOut : totals.bytesIn) += packets[index].length;
+		if (!summaryOnly)
+		{
+			printf(csv ? "%.6f,%s,garbage,-1,%zu,-1.0,\"\"\n" : "%12.6f %3s garbage        %5zu\n",
+				(packets[index].timeNs - startNs) * 1.0e-9, packets[index].outgoing ? (csv ? "out" : ">") : (csv ? "in" : "<"),
+				packets[index].length);
+		}
+	}
+
+	FILE *summary(csv ? stderr : stdout);
+	fprintf(summary, "records:        %llu in %.3f s (%llu dropped)\n",
+		static_cast<unsigned long long> (header.records.load()), (lastNs > startNs ? lastNs - startNs : 0) * 1.0e-9,
+		static_cast<unsigned long long> (header.dropped.load()));
+	fprintf(summary, "packets:        %llu commands (%llu bytes), %llu replies (%llu bytes), %llu marks\n",
+		static_cast<unsigned long long> (totals.commands), static_cast<unsigned long long> (totals.bytesOut),
+		static_cast<unsigned long long> (totals.replies), static_cast<unsigned long long> (totals.bytesIn),
+		static_cast<unsigned long long> (totals.marks));
+	fprintf(summary, "garbage:        %llu runs, %llu bytes\n", static_cast<unsigned long long> (totals.garbageRuns),
+		static_cast<unsigned long long> (decoder.garbageBytes()));
+	fprintf(summary, "round trip us:  mean %.1f, max %.1f (%llu replies unmatched)\n",
+		totals.rttCount > 0 ? totals.rttSum / totals.rttCount : 0.0, totals.rttMax,
+		static_cast<unsigned long long> (totals.unmatched));
+	return 0;
+}
@@ -0,0 +1,459 @@
+#include "com/catheter_commands.h"
+#include "com/current_sample.h"
+#include "com/pc_utils.h"
+#include "hardware/digital_analog_conversions.h"
+#include "ser/serial_sender.h"
+#include "ser/serial_thread.h"
+#include "util/async_log.h"
+#include "util/console_log.h"
+#include "util/link_log.h"
+#include "util/metrics.h"
+#include "util/trace.h"
+#include "util/spsc_ring.h"
+
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+// Headless playback: connects to the arduino, plays a playfile with the serial
+// thread's timing, optionally records the replies and prints a timing summary.
+// Nothing here depends on wx, so it runs on machines without a display.
+
+#define calibration_file "catheter_calibration.cal"
+
+// the arduino resets when the port opens, wait for the bootloader before sending.
+#define DEFAULT_SETTLE_MS 2000
+
+// main loop period (console output and telemetry draining).
+#define PLAY_POLL_MS 10
+
+// replies are collected until none arrive for this long after the last set.
+#define REPLY_QUIET_MS 100
+#define REPLY_WAIT_MAX_MS 1000
+
+#define RECORD_RING_SAMPLES 65536
+
+// period of the Prometheus text dump.
+#define PROM_DUMP_MS 1000
+
+namespace
+{
+	volatile std::sig_atomic_t interrupted(0);
+
+	void onInterrupt(int)
+	{
+		interrupted = 1;
+	}
+
+	void printUsage(const char *name)
+	{
+		fprintf(stderr,
+			"usage: %s [options] playfile.play\n"
+			"  --port NAME        serial port (default: the first port found)\n"
+			"  --list-ports       print the available ports and exit\n"
+			"  --record FILE.csv  write every reply channel to a csv file\n"
+			"  --poll             poll the channels of every set after its setpoints\n"
+			"  --coalesce         merge zero delay sets into the next set (drops superseded updates)\n"
+			"  --calibration FILE channel calibration (default: %s)\n"
+			"  --settle MS        wait after connecting (default: %d)\n"
+			"  --metrics NAME     publish the metrics as shared memory (read with catheter_stat)\n"
+			"  --prom FILE        write the metrics as Prometheus text every %d ms\n"
+			"  --trace FILE       write a Chrome trace of the playback (needs a CATHETER_TRACE build)\n"
+			"  --log FILE         append the serial log messages to a file\n"
+			"  --link-log FILE    record the raw link traffic here (default: catheter_play_<time>.link)\n"
+			"  --no-link-log      do not record the link traffic\n"
+			"  --quiet            do not echo the console messages\n",
+			name, calibration_file, DEFAULT_SETTLE_MS, PROM_DUMP_MS);
+	}
+
+	// copies new console lines to stderr.
+	void printConsole(const ConsoleLog &log, uint64_t &nextSeq, bool quiet)
+	{
+		uint64_t endSeq(log.endSeq());
+		nextSeq = std::max(nextSeq, log.firstSeq());
+		ConsoleLine line;
+		for (; nextSeq < endSeq; nextSeq++)
+		{
+			if (!quiet && log.getLine(nextSeq, line))
+			{
+				fprintf(stderr, "[%s] %s\n", logSeverity2String(line.severity), line.text);
+			}
+		}
+	}
+
+	// writes the queued samples, returns the number written.
+	size_t drainSamples(SpscRing<CurrentSample> &ring, FILE *recordFile, double startTime)
+	{
+		CurrentSample sample;
+		size_t count(0);
+		while (ring.pop(sample))
+		{
+			if (recordFile != NULL)
+			{
+				fprintf(recordFile, "%.6f,%d,%d,%u,%u,%.4f,%.4f,%d\n", sample.time - startTime, sample.channel,
+					static_cast<int> (sample.dir), sample.dacCounts, sample.adcCounts,
+					dac2MilliAmp(sample.dacCounts, sample.dir, sample.channel),
+					sample.polled ? adc2MilliAmp(sample.adcCounts, sample.channel) : 0.0, sample.polled ? 1 : 0);
+			}
+			count++;
+		}
+		return count;
+	}
+
+	void sleepMs(int ms)
+	{
+		boost::this_thread::sleep(boost::posix_time::milliseconds(ms));
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	std::string portName;
+	std::string recordName;
+	std::string calibrationName(calibration_file);
+	std::string playfileName;
+	std::string metricsName;
+	std::string promName;
+	std::string traceName;
+	std::string logName;
+	std::string linkLogName;
+	bool linkLog(true);
+	bool listPorts(false);
+	bool pollAll(false);
+	bool coalesce(false);
+	bool quiet(false);
+	int settleMs(DEFAULT_SETTLE_MS);
+
+	for (int i(1); i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		bool hasValue(i + 1 < argc);
+		if (arg == "--port" && hasValue)
+		{
+			portName = argv[++i];
+		}
+		else if (arg == "--record" && hasValue)
+		{
+			recordName = argv[++i];
+		}
+		else if (arg == "--calibration" && hasValue)
+		{
+			calibrationName = argv[++i];
+		}
+		else if (arg == "--settle" && hasValue)
+		{
+			settleMs = atoi(argv[++i]);
+		}
+		else if (arg == "--metrics" && hasValue)
+		{
+			metricsName = argv[++i];
+		}
+		else if (arg == "--prom" && hasValue)
+		{
+			promName = argv[++i];
+		}
+		else if (arg == "--trace" && hasValue)
+		{
+			traceName = argv[++i];
+		}
+		else if (arg == "--log" && hasValue)
+		{
+			logName = argv[++i];
+		}
+		else if (arg == "--link-log" && hasValue)
+		{
+			linkLogName = argv[++i];
+		}
+		else if (arg == "--no-link-log")
+		{
+			linkLog = false;
+		}
+		else if (arg == "--list-ports")
+		{
+			listPorts = true;
+		}
+		else if (arg == "--poll")
+		{
+			pollAll = true;
+		}
+		else if (arg == "--coalesce")
+		{
+			coalesce = true;
+		}
+		else if (arg == "--quiet")
+		{
+			quiet = true;
+		}
+		else if (arg == "--help" || arg == "-h")
+		{
+			printUsage(argv[0]);
+			return 0;
+		}
+		else if (!arg.empty() && arg[0] != '-' && playfileName.empty())
+		{
+			playfileName = arg;
+		}
+		else
+		{
+			fprintf(stderr, "unknown option: %s\n", arg.c_str());
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (listPorts)
+	{
+		CatheterSerialSender sender;
+		std::vector<std::string> ports;
+		sender.getAvailablePorts(ports);
+		for (size_t i(0); i < ports.size(); i++)
+		{
+			printf("%s\n", ports[i].c_str());
+		}
+		return 0;
+	}
+
+	if (playfileName.empty())
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	if (!logName.empty() && !logOpenFile(logName))
+	{
+		fprintf(stderr, "Unable to open %s\n", logName.c_str());
+		return 1;
+	}
+
+	// commands are converted with the calibration, so load it before the playfile.
+	int calibratedChannels(loadCalibrationFile(calibrationName.c_str()));
+	if (calibratedChannels > 0)
+	{
+		fprintf(stderr, "Loaded calibration for %d channels from %s\n", calibratedChannels, calibrationName.c_str());
+	}
+
+	std::vector<CatheterChannelCmdSet> cmdVect;
+	if (loadPlayFile(playfileName.c_str(), cmdVect) < 0 || cmdVect.empty())
+	{
+		fprintf(stderr, "Unable to load any commands from %s\n", playfileName.c_str());
+		return 1;
+	}
+	double scheduledSeconds(0.0);
+	for (size_t i(0); i < cmdVect.size(); i++)
+	{
+		if (pollAll)
+		{
+			appendPollCmds(cmdVect[i]);
+		}
+		// the last delay only holds the final state, nothing is sent after it.
+		if (i + 1 < cmdVect.size())
+		{
+			scheduledSeconds += cmdVect[i].delayTime * 1.0e-3;
+		}
+	}
+
+	FILE *recordFile(NULL);
+	if (!recordName.empty())
+	{
+		recordFile = fopen(recordName.c_str(), "w");
+		if (recordFile == NULL)
+		{
+			fprintf(stderr, "Unable to open %s\n", recordName.c_str());
+			return 1;
+		}
+		fprintf(recordFile, "time_s,channel,dir,dac_counts,adc_counts,set_ma,sensed_ma,polled\n");
+	}
+
+	ConsoleLog consoleLog;
+	uint64_t consoleSeq(0);
+	SpscRing<CurrentSample> sampleRing(RECORD_RING_SAMPLES);
+	MetricsRegistry metrics(metricsName);
+	if (!metricsName.empty() && !metrics.shared())
+	{
+		fprintf(stderr, "Unable to publish the metrics as %s (is another process using it?)\n", metricsName.c_str());
+	}
+	// the recorder is declared first, so it outlives the serial thread.
+	LinkRecorder linkRecorder;
+	if (linkLog)
+	{
+		// a default name is never overwritten, two runs can start within the same second.
+		bool defaultName(linkLogName.empty());
+		linkLogName = defaultName ? linkLogDefaultName("catheter_play") : linkLogName;
+		std::string note("catheter_play " + playfileName);
+		if (!(defaultName ? linkRecorder.openUnique(linkLogName, note) : linkRecorder.open(linkLogName, note)))
+		{
+			fprintf(stderr, "Unable to record the link traffic to %s\n", linkLogName.c_str());
+		}
+	}
+	SerialThreadObject serialObject(&metrics);
+	serialObject.setLinkRecorder(linkRecorder.isOpen() ? &linkRecorder : NULL);
+	serialObject.setStatusTextPtr(&consoleLog);
+	serialObject.setSampleRing(&sampleRing);
+	serialObject.setCoalescing(coalesce);
+
+	if (portName.empty())
+	{
+		serialObject.serialCommand(SerialThreadObject::resetSerial);
+	}
+	else
+	{
+		serialObject.connectPort(portName);
+	}
+	printConsole(consoleLog, consoleSeq, quiet);
+	if (!serialObject.isConnected())
+	{
+		fprintf(stderr, "Not connected, giving up.\n");
+		serialObject.setSampleRing(NULL);
+		if (recordFile != NULL)
+		{
+			fclose(recordFile);
+		}
+		return 2;
+	}
+
+	std::signal(SIGINT, onInterrupt);
+	std::signal(SIGTERM, onInterrupt);
+	sleepMs(settleMs);
+
+	// samples before the playback (the connection chatter) are not recorded.
+	drainSamples(sampleRing, NULL, 0.0);
+	if (!traceName.empty())
+	{
+		if (!traceCompiledIn())
+		{
+			fprintf(stderr, "Built without CATHETER_TRACE, the trace will be empty.\n");
+		}
+		CATHETER_TRACE_THREAD_NAME("main");
+		traceEnable(true);
+	}
+	serialObject.resetStats();
+	serialObject.queueCommands(cmdVect);
+
+	size_t samplesWritten(0);
+	double startTime(-1.0);
+	int sincePromMs(0);
+	PlaybackStats stats;
+	while (!interrupted && !serialObject.playbackIdle())
+	{
+		sleepMs(PLAY_POLL_MS);
+		sincePromMs += PLAY_POLL_MS;
+		if (!promName.empty() && sincePromMs >= PROM_DUMP_MS)
+		{
+			metrics.writePrometheus(promName);
+			sincePromMs = 0;
+		}
+		if (startTime < 0.0)
+		{
+			serialObject.getStats(stats);
+			if (stats.setsSent > 0)
+			{
+				startTime = stats.firstSendTime;
+			}
+		}
+		if (startTime >= 0.0)
+		{
+			samplesWritten += drainSamples(sampleRing, recordFile, startTime);
+		}
+		printConsole(consoleLog, consoleSeq, quiet);
+	}
+
+	if (interrupted)
+	{
+		// drop what is left and zero the currents.
+		fprintf(stderr, "Interrupted, resetting the catheter.\n");
+		serialObject.serialCommand(SerialThreadObject::resetArduino);
+		sleepMs(REPLY_QUIET_MS);
+	}
+
+	// let the last replies come in.
+	serialObject.getStats(stats);
+	uint64_t replies(stats.repliesValid + stats.repliesInvalid);
+	for (int waited(0); waited < REPLY_WAIT_MAX_MS; waited += REPLY_QUIET_MS)
+	{
+		sleepMs(REPLY_QUIET_MS);
+		serialObject.getStats(stats);
+		if (stats.repliesValid + stats.repliesInvalid == replies)
+		{
+			break;
+		}
+		replies = stats.repliesValid + stats.repliesInvalid;
+	}
+	if (startTime < 0.0)
+	{
+		startTime = stats.firstSendTime;
+	}
+	samplesWritten += drainSamples(sampleRing, recordFile, startTime);
+	serialObject.setSampleRing(NULL);
+	printConsole(consoleLog, consoleSeq, quiet);
+
+	double elapsed(stats.lastSendTime - stats.firstSendTime);
+	printf("playfile:       %s (%d sets)\n", playfileName.c_str(), static_cast<int> (cmdVect.size()));
+	printf("sets sent:      %llu\n", static_cast<unsigned long long> (stats.setsSent));
+	printf("replies:        %llu valid, %llu invalid\n", static_cast<unsigned long long> (stats.repliesValid),
+		static_cast<unsigned long long> (stats.repliesInvalid));
+	printf("elapsed:        %.3f s (scheduled %.3f s)\n", elapsed, scheduledSeconds);
+	printf("throughput:     %.1f sets/s\n", elapsed > 0.0 ? (stats.setsSent - 1) / elapsed : 0.0);
+	printf("lateness (us):  p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+		latenessPercentile(stats, 0.50), latenessPercentile(stats, 0.90),
+		latenessPercentile(stats, 0.99), stats.maxLatenessUs);
+	printf("rtt (us):       p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+		rttPercentile(stats, 0.50), rttPercentile(stats, 0.90),
+		rttPercentile(stats, 0.99), stats.maxRttUs);
+	printf("echo:           %llu matched, %llu mismatched, %llu unmatched, %llu timed out\n",
+		static_cast<unsigned long long> (stats.repliesMatched), static_cast<unsigned long long> (stats.echoMismatches),
+		static_cast<unsigned long long> (stats.repliesUnmatched), static_cast<unsigned long long> (stats.replyTimeouts));
+	if (coalesce)
+	{
+		printf("coalesced:      %llu sets, %llu channel updates\n", static_cast<unsigned long long> (stats.setsCoalesced),
+			static_cast<unsigned long long> (stats.updatesCoalesced));
+	}
+	if (!traceName.empty())
+	{
+		traceEnable(false);
+		if (!traceWriteJson(traceName))
+		{
+			fprintf(stderr, "Unable to write %s\n", traceName.c_str());
+		}
+		else if (traceDropped() > 0)
+		{
+			fprintf(stderr, "The trace buffers filled up, %llu events were dropped.\n",
+				static_cast<unsigned long long> (traceDropped()));
+		}
+	}
+	if (!promName.empty() && !metrics.writePrometheus(promName))
+	{
+		fprintf(stderr, "Unable to write %s\n", promName.c_str());
+	}
+	if (linkRecorder.isOpen())
+	{
+		printf("link log:       %llu records to %s (%llu dropped)\n", static_cast<unsigned long long> (linkRecorder.records()),
+			linkRecorder.fileName().c_str(), static_cast<unsigned long long> (linkRecorder.dropped()));
+	}
+	if (recordFile != NULL)
+	{
+		fclose(recordFile);
+		printf("telemetry:      %d samples to %s (%llu dropped)\n", static_cast<int> (samplesWritten), recordName.c_str(),
+			static_cast<unsigned long long> (sampleRing.droppedCount()));
+	}
+
+	return interrupted ? 3 : 0;
+}
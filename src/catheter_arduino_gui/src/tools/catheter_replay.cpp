@@ -0,0 +1,334 @@
+#include "ser/simple_serial.h"
+#include "sim/arduino_sim.h"
+#include "util/link_log.h"
+
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+// Link log replay: writes the bytes a session sent (see link_log.h) to a port
+// again, with the recorded timing or faster, and compares what comes back
+// with what the board sent in the session. Without --port the bytes go to a
+// simulated arduino, which answers like a board that was just reset.
+// Exits with 3 when the replies differ from the recording.
+
+// the arduino resets when the port opens, wait for the bootloader before sending.
+#define DEFAULT_SETTLE_MS 2000
+
+// replies are collected until none arrive for this long after the last write.
+#define REPLAY_QUIET_MS 200
+#define REPLAY_WAIT_MAX_MS 5000
+
+// longest sleep between looking for replies.
+#define REPLAY_POLL_US 1000
+
+namespace
+{
+	typedef std::chrono::steady_clock SteadyClock;
+
+	void printUsage(const char *name)
+	{
+		fprintf(stderr,
+			"usage: %s [options] session.link\n"
+			"  --port NAME        replay to this port (default: a simulated arduino)\n"
+			"  --baud N           port baud (default: as recorded, else 9600)\n"
+			"  --sim-baud N       wire rate of the simulated arduino, 0 for no limit (default 0)\n"
+			"  --sim-proc-us US   firmware time per packet of the simulated arduino (default 0)\n"
+			"  --speed X          replay X times faster than recorded (default 1)\n"
+			"  --asap             write every packet as soon as the previous one\n"
+			"  --from S           start S seconds into the log\n"
+			"  --to S             stop S seconds into the log\n"
+			"  --settle MS        wait after opening a port (default %d)\n"
+			"  --record FILE      write a link log of the replay\n",
+			name, DEFAULT_SETTLE_MS);
+	}
+
+	struct ReplayWrite
+	{
+		uint64_t timeNs;
+		const uint8_t *bytes;
+		uint32_t length;
+	};
+
+	// the baud of an "open NAME BAUD" mark, else the baud given.
+	unsigned int recordedBaud(const LinkRecordView &record, unsigned int baud)
+	{
+		std::string text(reinterpret_cast<const char*> (record.bytes), record.length);
+		if (text.compare(0, 5, "open ") != 0)
+		{
+			return baud;
+		}
+		size_t space(text.rfind(' '));
+		int parsed(atoi(text.c_str() + space + 1));
+		return (parsed > 0) ? static_cast<unsigned int> (parsed) : baud;
+	}
+
+	void collect(SerialPort &port, std::vector<uint8_t> &received)
+	{
+		std::vector<unsigned char> bytes(port.flushData());
+		received.insert(received.end(), bytes.begin(), bytes.end());
+	}
+
+	bool writeAll(SerialPort &port, const uint8_t *bytes, int length)
+	{
+		while (length > 0)
+		{
+			int written(port.write_some(reinterpret_cast<const char*> (bytes), length));
+			if (written <= 0)
+			{
+				return false;
+			}
+			bytes += written;
+			length -= written;
+		}
+		return true;
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	std::string logName;
+	std::string portName;
+	std::string recordName;
+	ArduinoSimOptions simOptions;
+	unsigned int baud(0);
+	double speed(1.0);
+	bool asap(false);
+	double fromSeconds(0.0);
+	double toSeconds(-1.0);
+	int settleMs(-1);
+
+	for (int i(1); i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		bool hasValue(i + 1 < argc);
+		if (arg == "--port" && hasValue)
+		{
+			portName = argv[++i];
+		}
+		else if (arg == "--baud" && hasValue)
+		{
+			baud = static_cast<unsigned int> (std::max(atoi(argv[++i]), 0));
+		}
+		else if (arg == "--sim-baud" && hasValue)
+		{
+			simOptions.baud = std::max(atoi(argv[++i]), 0);
+		}
+		else if (arg == "--sim-proc-us" && hasValue)
+		{
+			simOptions.processingUs = std::max(atof(argv[++i]), 0.0);
+		}
+		else if (arg == "--speed" && hasValue)
+		{
+			speed = atof(argv[++i]);
+		}
+		else if (arg == "--asap")
+		{
+			asap = true;
+		}
+		else if (arg == "--from" && hasValue)
+		{
+			fromSeconds = std::max(atof(argv[++i]), 0.0);
+		}
+		else if (arg == "--to" && hasValue)
+		{
+			toSeconds = atof(argv[++i]);
+		}
+		else if (arg == "--settle" && hasValue)
+		{
+			settleMs = std::max(atoi(argv[++i]), 0);
+		}
+		else if (arg == "--record" && hasValue)
+		{
+			recordName = argv[++i];
+		}
+		else if (arg == "--help" || arg == "-h")
+		{
+			printUsage(argv[0]);
+			return 0;
+		}
+		else if (!arg.empty() && arg[0] != '-' && logName.empty())
+		{
+			logName = arg;
+		}
+		else
+		{
+			fprintf(stderr, "unknown option: %s\n", arg.c_str());
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+	if (logName.empty() || speed <= 0.0)
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	LinkLogReader reader;
+	if (!reader.open(logName))
+	{
+		fprintf(stderr, "Unable to read a link log from %s\n", logName.c_str());
+		return 1;
+	}
+	uint64_t startNs(reader.header().startNs);
+	uint64_t fromNs(startNs + static_cast<uint64_t> (fromSeconds * 1.0e9));
+	uint64_t toNs((toSeconds >= 0.0) ? startNs + static_cast<uint64_t> (toSeconds * 1.0e9) : UINT64_MAX);
+
+	// what the session wrote, and what the board answered, in the replayed span.
+	std::vector<ReplayWrite> writes;
+	std::vector<uint8_t> recordedIn;
+	unsigned int sessionBaud(0);
+	int marks(0);
+	uint64_t offset(reader.begin());
+	LinkRecordView record;
+	while (reader.next(offset, record) && record.timeNs <= toNs)
+	{
+		if (record.type == linkRecordMark)
+		{
+			sessionBaud = recordedBaud(record, sessionBaud);
+			marks += (record.timeNs >= fromNs) ? 1 : 0;
+		}
+		if (record.timeNs < fromNs)
+		{
+			continue;
+		}
+		if (record.type == linkRecordOut)
+		{
+			ReplayWrite write = { record.timeNs, record.bytes, record.length };
+			writes.push_back(write);
+		}
+		else if (record.type == linkRecordIn)
+		{
+			recordedIn.insert(recordedIn.end(), record.bytes, record.bytes + record.length);
+		}
+	}
+	if (writes.empty())
+	{
+		fprintf(stderr, "Nothing was written in the replayed span of %s\n", logName.c_str());
+		return 1;
+	}
+	if (marks > 1)
+	{
+		fprintf(stderr, "The span holds %d port marks, the port is not reopened between them.\n", marks);
+	}
+
+	ArduinoSim sim(simOptions);
+	if (portName.empty())
+	{
+		if (!sim.start())
+		{
+			fprintf(stderr, "Unable to start the simulated arduino.\n");
+			return 1;
+		}
+		portName = sim.portName();
+		settleMs = std::max(settleMs, 0);
+	}
+	else if (settleMs < 0)
+	{
+		settleMs = DEFAULT_SETTLE_MS;
+	}
+	baud = (baud > 0) ? baud : ((sessionBaud > 0) ? sessionBaud : static_cast<unsigned int> (SerialPort::BR_9600));
+
+	LinkRecorder recorder;
+	if (!recordName.empty() && !recorder.open(recordName, "replay of " + logName))
+	{
+		fprintf(stderr, "Unable to open %s\n", recordName.c_str());
+		return 1;
+	}
+	SerialPort port;
+	port.setRecorder(recorder.isOpen() ? &recorder : NULL);
+	if (!port.start(portName.c_str(), static_cast<SerialPort::Baud> (baud)))
+	{
+		fprintf(stderr, "Unable to open %s\n", portName.c_str());
+		return 2;
+	}
+	boost::this_thread::sleep(boost::posix_time::milliseconds(settleMs));
+	port.flushData();
+
+	// the writes keep the recorded spacing (divided by the speed) from the first one.
+	std::vector<uint8_t> received;
+	double maxLateUs(0.0);
+	double sumLateUs(0.0);
+	uint64_t bytesWritten(0);
+	bool writeFailed(false);
+	SteadyClock::time_point replayStart(SteadyClock::now());
+	for (size_t index(0); index < writes.size() && !writeFailed; index++)
+	{
+		SteadyClock::time_point due(replayStart);
+		if (!asap)
+		{
+			due += std::chrono::nanoseconds(static_cast<int64_t> ((writes[index].timeNs - writes[0].timeNs) / speed));
+		}
+		SteadyClock::time_point now(SteadyClock::now());
+		while (now < due)
+		{
+			std::this_thread::sleep_until(std::min(due, now + std::chrono::microseconds(REPLAY_POLL_US)));
+			collect(port, received);
+			now = SteadyClock::now();
+		}
+		double lateUs(std::chrono::duration<double, std::micro> (now - due).count());
+		maxLateUs = std::max(maxLateUs, lateUs);
+		sumLateUs += lateUs;
+		writeFailed = !writeAll(port, writes[index].bytes, static_cast<int> (writes[index].length));
+		bytesWritten += writeFailed ? 0 : writes[index].length;
+	}
+	double replaySeconds(std::chrono::duration<double> (SteadyClock::now() - replayStart).count());
+
+	// the last replies, until the port goes quiet.
+	int quietMs(0);
+	for (int waited(0); waited < REPLAY_WAIT_MAX_MS && quietMs < REPLAY_QUIET_MS; waited++)
+	{
+		size_t before(received.size());
+		boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+		collect(port, received);
+		quietMs = (received.size() == before) ? quietMs + 1 : 0;
+	}
+	port.setRecorder(NULL);
+	port.stop();
+	recorder.close();
+
+	size_t common(std::min(received.size(), recordedIn.size()));
+	size_t firstDifference(std::mismatch(received.begin(), received.begin() + common, recordedIn.begin()).first - received.begin());
+	bool identical(firstDifference == common && received.size() == recordedIn.size());
+
+	double recordedSeconds((writes.back().timeNs - writes[0].timeNs) * 1.0e-9);
+	printf("replayed:       %zu writes, %llu bytes to %s at %u baud\n", writes.size(),
+		static_cast<unsigned long long> (bytesWritten), portName.c_str(), baud);
+	printf("timing:         %.3f s recorded, %.3f s replayed (%s)\n", recordedSeconds, replaySeconds,
+		asap ? "as fast as possible" : (speed == 1.0 ? "original" : "scaled"));
+	printf("write late us:  mean %.1f, max %.1f\n", sumLateUs / writes.size(), maxLateUs);
+	printf("replies:        %zu bytes received, %zu recorded\n", received.size(), recordedIn.size());
+	if (identical)
+	{
+		printf("replies match the recording\n");
+	}
+	else
+	{
+		printf("replies differ from the recording at byte %zu\n", firstDifference);
+	}
+	if (writeFailed)
+	{
+		fprintf(stderr, "Writing to %s failed.\n", portName.c_str());
+		return 2;
+	}
+	return identical ? 0 : 3;
+}
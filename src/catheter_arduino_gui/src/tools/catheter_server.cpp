@@ -0,0 +1,177 @@
+#include "ipc/ipc_server.h"
+#include "ser/serial_thread.h"
+#include "ser/setpoint_mailbox.h"
+#include "sim/arduino_sim.h"
+#include "util/console_log.h"
+#include "util/metrics.h"
+
+#include <boost/thread.hpp>
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+// Headless setpoint server: connects the serial thread to a port (or the
+// simulated arduino) and serves it on a unix socket until interrupted, for
+// controllers that run in their own process (see ipc_client.h).
+
+// a real arduino resets when the port opens.
+#define REAL_PORT_SETTLE_MS 2000
+
+#define STATUS_PERIOD_MS 1000
+
+namespace
+{
+	volatile std::sig_atomic_t interrupted(0);
+
+	void onInterrupt(int)
+	{
+		interrupted = 1;
+	}
+
+	void printUsage(const char *name)
+	{
+		fprintf(stderr,
+			"usage: %s [options]\n"
+			"  --socket PATH   unix socket to serve (default %s)\n"
+			"  --port NAME     serial port (default: the simulated arduino)\n"
+			"  --proc-us US    simulated firmware time per packet (default 0)\n"
+			"  --metrics NAME  publish the serial metrics (read with catheter_stat)\n"
+			"  --mailbox       accept latest value setpoints (IPC_FLAG_LATEST) for teleoperation\n"
+			"  --quiet         no status line\n",
+			name, IPC_DEFAULT_SOCKET);
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	std::string socketPath(IPC_DEFAULT_SOCKET);
+	std::string portName;
+	std::string metricsName;
+	ArduinoSimOptions simOptions;
+	bool quiet(false);
+	bool useMailbox(false);
+
+	for (int i(1); i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		bool hasValue(i + 1 < argc);
+		if (arg == "--socket" && hasValue)
+		{
+			socketPath = argv[++i];
+		}
+		else if (arg == "--port" && hasValue)
+		{
+			portName = argv[++i];
+		}
+		else if (arg == "--proc-us" && hasValue)
+		{
+			simOptions.processingUs = atof(argv[++i]);
+		}
+		else if (arg == "--metrics" && hasValue)
+		{
+			metricsName = argv[++i];
+		}
+		else if (arg == "--mailbox")
+		{
+			useMailbox = true;
+		}
+		else if (arg == "--quiet")
+		{
+			quiet = true;
+		}
+		else
+		{
+			printUsage(argv[0]);
+			return (arg == "--help" || arg == "-h") ? 0 : 1;
+		}
+	}
+
+	ArduinoSim sim(simOptions);
+	bool simulated(portName.empty());
+	if (simulated)
+	{
+		if (!sim.start())
+		{
+			fprintf(stderr, "Unable to open a pseudo terminal for the simulator.\n");
+			return 2;
+		}
+		portName = sim.portName();
+	}
+
+	// outlives the serial thread reading it.
+	SetpointMailbox mailbox;
+	ConsoleLog consoleLog;
+	MetricsRegistry metrics(metricsName);
+	SerialThreadObject serialObject(&metrics);
+	serialObject.setStatusTextPtr(&consoleLog);
+	if (!serialObject.connectPort(portName))
+	{
+		fprintf(stderr, "Unable to open %s\n", portName.c_str());
+		return 2;
+	}
+	if (!simulated)
+	{
+		boost::this_thread::sleep(boost::posix_time::milliseconds(REAL_PORT_SETTLE_MS));
+	}
+
+	IpcServer server(serialObject);
+	if (useMailbox)
+	{
+		serialObject.setMailbox(&mailbox);
+		server.setMailbox(&mailbox);
+	}
+	if (!server.start(socketPath))
+	{
+		fprintf(stderr, "Unable to serve %s (in use?)\n", socketPath.c_str());
+		return 2;
+	}
+	printf("serving %s on %s%s\n", portName.c_str(), socketPath.c_str(), simulated ? " (simulated)" : "");
+	fflush(stdout);
+
+	std::signal(SIGINT, onInterrupt);
+	std::signal(SIGTERM, onInterrupt);
+	while (!interrupted)
+	{
+		boost::this_thread::sleep(boost::posix_time::milliseconds(STATUS_PERIOD_MS));
+		if (quiet)
+		{
+			continue;
+		}
+		IpcServerStats stats;
+		server.getStats(stats);
+		PlaybackStats playback;
+		serialObject.getStats(playback);
+		printf("clients %d  frames %llu (%llu bad)  sets queued %llu sent %llu  telemetry %llu (%llu dropped)\n",
+			stats.clientsActive, static_cast<unsigned long long> (stats.framesIn),
+			static_cast<unsigned long long> (stats.framesBad), static_cast<unsigned long long> (stats.setsQueued),
+			static_cast<unsigned long long> (playback.setsSent), static_cast<unsigned long long> (stats.samplesOut),
+			static_cast<unsigned long long> (stats.samplesDropped));
+		if (useMailbox)
+		{
+			printf("  mailbox: %llu packets, %llu writes superseded, staleness p50 %.1f p99 %.1f max %.1f us\n",
+				static_cast<unsigned long long> (playback.mailboxSends),
+				static_cast<unsigned long long> (playback.mailboxSuperseded), stalenessPercentile(playback, 0.5),
+				stalenessPercentile(playback, 0.99), playback.maxStalenessUs);
+		}
+		fflush(stdout);
+	}
+	server.stop();
+	serialObject.setMailbox(NULL);
+	serialObject.serialCommand(SerialThreadObject::resetArduino);
+	return 0;
+}
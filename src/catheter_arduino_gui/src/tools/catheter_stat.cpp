@@ -0,0 +1,165 @@
+#include "util/metrics.h"
+
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+// Metrics reader: maps the metrics page of a running gui or catheter_play read
+// only and prints it, with the counter rates, every interval. It never writes
+// to the page or signals the control process.
+
+#define DEFAULT_INTERVAL_MS 1000
+
+namespace
+{
+	void printUsage(const char *name)
+	{
+		fprintf(stderr,
+			"usage: %s [options]\n"
+			"  --name NAME      shared memory name (default %s)\n"
+			"  --interval MS    time between samples (default %d)\n"
+			"  --count N        samples to print, 0 for no limit (default 0)\n"
+			"  --prom           print one Prometheus text sample and exit\n",
+			name, METRICS_DEFAULT_NAME, DEFAULT_INTERVAL_MS);
+	}
+
+	// the upper edge of the bin holding the given fraction of the samples.
+	double binPercentile(const std::vector<uint64_t> &bins, double fraction)
+	{
+		uint64_t total(0);
+		for (size_t bin(0); bin < bins.size(); bin++)
+		{
+			total += bins[bin];
+		}
+		if (total == 0)
+		{
+			return 0.0;
+		}
+		uint64_t rank(static_cast<uint64_t> (fraction * (total - 1)) + 1);
+		uint64_t cumulative(0);
+		for (size_t bin(0); bin < bins.size(); bin++)
+		{
+			cumulative += bins[bin];
+			if (cumulative >= rank)
+			{
+				return static_cast<double> (2ull << bin);
+			}
+		}
+		return static_cast<double> (2ull << (bins.size() - 1));
+	}
+
+	void printSample(const std::vector<MetricValue> &values, const std::vector<MetricValue> &previous, double seconds)
+	{
+		printf("%-40s %16s %12s\n", "metric", "value", "rate/s");
+		for (size_t i(0); i < values.size(); i++)
+		{
+			const MetricValue &value(values[i]);
+			// slots are only ever appended, so a metric keeps its index.
+			bool hasPrevious(i < previous.size() && seconds > 0.0);
+			if (value.type == metricGauge)
+			{
+				printf("%-40s %16lld\n", value.name.c_str(), static_cast<long long> (static_cast<int64_t> (value.value)));
+			}
+			else if (value.type == metricHistogram)
+			{
+				printf("%-40s %16llu %12.1f  p50 < %.0f  p99 < %.0f  mean %.1f\n", value.name.c_str(),
+					static_cast<unsigned long long> (value.value),
+					hasPrevious ? (value.value - previous[i].value) / seconds : 0.0,
+					binPercentile(value.bins, 0.50), binPercentile(value.bins, 0.99),
+					value.value > 0 ? static_cast<double> (value.sum) / value.value : 0.0);
+			}
+			else
+			{
+				printf("%-40s %16llu %12.1f\n", value.name.c_str(), static_cast<unsigned long long> (value.value),
+					hasPrevious ? (value.value - previous[i].value) / seconds : 0.0);
+			}
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	std::string shmName(METRICS_DEFAULT_NAME);
+	int intervalMs(DEFAULT_INTERVAL_MS);
+	int count(0);
+	bool prometheus(false);
+
+	for (int i(1); i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		bool hasValue(i + 1 < argc);
+		if (arg == "--name" && hasValue)
+		{
+			shmName = argv[++i];
+		}
+		else if (arg == "--interval" && hasValue)
+		{
+			intervalMs = std::max(atoi(argv[++i]), 1);
+		}
+		else if (arg == "--count" && hasValue)
+		{
+			count = atoi(argv[++i]);
+		}
+		else if (arg == "--prom")
+		{
+			prometheus = true;
+		}
+		else if (arg == "--help" || arg == "-h")
+		{
+			printUsage(argv[0]);
+			return 0;
+		}
+		else
+		{
+			fprintf(stderr, "unknown option: %s\n", arg.c_str());
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	MetricsView view;
+	if (!view.open(shmName))
+	{
+		fprintf(stderr, "No metrics published as %s\n", shmName.c_str());
+		return 2;
+	}
+
+	std::vector<MetricValue> values;
+	std::vector<MetricValue> previous;
+	metricsSnapshot(*view.page(), values);
+	if (prometheus)
+	{
+		printf("%s", metricsPrometheusText(values).c_str());
+		return 0;
+	}
+
+	printf("pid %u\n", view.page()->pid);
+	printSample(values, previous, 0.0);
+	for (int printed(1); count <= 0 || printed < count; printed++)
+	{
+		boost::this_thread::sleep(boost::posix_time::milliseconds(intervalMs));
+		previous.swap(values);
+		metricsSnapshot(*view.page(), values);
+		printSample(values, previous, intervalMs * 1.0e-3);
+	}
+	return 0;
+}
@@ -0,0 +1,346 @@
+#include "com/command_sequence.h"
+#include "com/pc_utils.h"
+#include "com/tracking_error.h"
+#include "hardware/digital_analog_conversions.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+// Tracking analysis: compares the sensed current of a recorded session (the
+// catheter_play --record csv) with the current its playfile commanded, per
+// channel and per step (see tracking_error.h). Prints a table, csv or json.
+
+#define calibration_file "catheter_calibration.cal"
+
+namespace
+{
+	enum OutputFormat
+	{
+		formatTable,
+		formatCsv,
+		formatJson
+	};
+
+	void printUsage(const char *name)
+	{
+		TrackingOptions defaults;
+		fprintf(stderr,
+			"usage: %s [options] playfile.play telemetry.csv\n"
+			"  --format F         table, csv or json (default table)\n"
+			"  --output FILE      write the report here (default: stdout)\n"
+			"  --steps FILE.csv   write every step of every channel\n"
+			"  --calibration FILE channel calibration, as in the session (default: %s)\n"
+			"  --offset-ms MS     added to the telemetry times (default %.0f)\n"
+			"  --no-anchor        time the steps by the playfile schedule, not by set_ma\n"
+			"  --min-step-ma MA   smallest change analyzed as a step (default %.1f)\n"
+			"  --band-pct P       settling band, percent of the step (default %.0f)\n"
+			"  --band-ma MA       settling band floor (default %.1f)\n"
+			"  --threads N        parser threads, 0 for one per core (default 0)\n",
+			name, calibration_file, defaults.offsetMs, defaults.minStepMa, defaults.bandFraction * 100.0,
+			defaults.bandMa);
+	}
+
+	std::string jsonString(const std::string &text)
+	{
+		std::string quoted("\"");
+		for (size_t index(0); index < text.size(); index++)
+		{
+			char c(text[index]);
+			if (c == '"' || c == '\\')
+			{
+				quoted += '\\';
+			}
+			quoted += (static_cast<unsigned char> (c) < 32) ? ' ' : c;
+		}
+		return quoted + "\"";
+	}
+
+	void writeTable(FILE *file, const TrackingReport &report)
+	{
+		fprintf(file, "%4s %9s %9s %9s %9s %10s %6s %8s %10s %10s %10s %10s\n", "ch", "samples", "mean_ma", "rms_ma",
+			"max_ma", "max_at_s", "steps", "settled", "settle_ms", "settle_max", "lag_ms", "lag_med");
+		for (size_t index(0); index < report.channels.size(); index++)
+		{
+			const ChannelTracking &channel(report.channels[index]);
+			fprintf(file, "%4d %9zu %9.3f %9.3f %9.3f %10.3f %6zu %8zu %10.1f %10.1f %10.1f %10.1f\n", channel.channel,
+				channel.samples, channel.meanErrorMa, channel.rmsErrorMa, channel.maxErrorMa, channel.maxErrorMs * 1.0e-3,
+				channel.steps, channel.settledSteps, channel.meanSettleMs, channel.maxSettleMs, channel.meanLagMs,
+				channel.medianLagMs);
+		}
+	}
+
+	void writeCsv(FILE *file, const TrackingReport &report)
+	{
+		fprintf(file, "channel,samples,mean_error_ma,rms_error_ma,max_error_ma,max_error_s,steps,settled_steps,"
+			"mean_settle_ms,max_settle_ms,lag_steps,mean_lag_ms,median_lag_ms,max_lag_ms\n");
+		for (size_t index(0); index < report.channels.size(); index++)
+		{
+			const ChannelTracking &channel(report.channels[index]);
+			fprintf(file, "%d,%zu,%.4f,%.4f,%.4f,%.6f,%zu,%zu,%.3f,%.3f,%zu,%.3f,%.3f,%.3f\n", channel.channel,
+				channel.samples, channel.meanErrorMa, channel.rmsErrorMa, channel.maxErrorMa, channel.maxErrorMs * 1.0e-3,
+				channel.steps, channel.settledSteps, channel.meanSettleMs, channel.maxSettleMs, channel.lagSteps,
+				channel.meanLagMs, channel.medianLagMs, channel.maxLagMs);
+		}
+	}
+
+	void writeJson(FILE *file, const TrackingReport &report, const TrackingOptions &options,
+		const std::string &playfileName, const std::string &telemetryName)
+	{
+		fprintf(file, "{\n  \"playfile\": %s,\n  \"telemetry\": %s,\n", jsonString(playfileName).c_str(),
+			jsonString(telemetryName).c_str());
+		fprintf(file, "  \"options\": {\"offset_ms\": %g, \"anchor_steps\": %s, \"min_step_ma\": %g, \"band_fraction\": %g, "
+			"\"band_ma\": %g},\n", options.offsetMs, options.anchorSteps ? "true" : "false", options.minStepMa,
+			options.bandFraction, options.bandMa);
+		fprintf(file, "  \"rows\": %zu,\n  \"samples\": %zu,\n  \"skipped_rows\": %zu,\n  \"first_s\": %.6f,\n"
+			"  \"last_s\": %.6f,\n", report.rows, report.samples, report.skippedRows, report.firstMs * 1.0e-3,
+			report.lastMs * 1.0e-3);
+		fprintf(file, "  \"anchored\": %s,\n  \"anchored_steps\": %zu,\n  \"max_drift_ms\": %.3f,\n",
+			report.anchored ? "true" : "false", report.anchoredSteps, report.maxDriftMs);
+		fprintf(file, "  \"channels\": [");
+		for (size_t index(0); index < report.channels.size(); index++)
+		{
+			const ChannelTracking &channel(report.channels[index]);
+			fprintf(file, "%s\n    {\"channel\": %d, \"samples\": %zu, \"mean_error_ma\": %.4f, \"rms_error_ma\": %.4f, "
+				"\"max_error_ma\": %.4f, \"max_error_s\": %.6f, \"steps\": %zu, \"settled_steps\": %zu, "
+				"\"mean_settle_ms\": %.3f, \"max_settle_ms\": %.3f, \"lag_steps\": %zu, \"mean_lag_ms\": %.3f, "
+				"\"median_lag_ms\": %.3f, \"max_lag_ms\": %.3f}", (index > 0) ? "," : "", channel.channel,
+				channel.samples, channel.meanErrorMa, channel.rmsErrorMa, channel.maxErrorMa, channel.maxErrorMs * 1.0e-3,
+				channel.steps, channel.settledSteps, channel.meanSettleMs, channel.maxSettleMs, channel.lagSteps,
+				channel.meanLagMs, channel.medianLagMs, channel.maxLagMs);
+		}
+		fprintf(file, "\n  ],\n  \"steps\": [");
+		for (size_t index(0); index < report.steps.size(); index++)
+		{
+			const StepTracking &step(report.steps[index]);
+			fprintf(file, "%s\n    {\"channel\": %d, \"set\": %zu, \"start_s\": %.6f, \"drift_ms\": %.3f, \"anchored\": %s, "
+				"\"from_ma\": %.3f, \"to_ma\": %.3f, \"samples\": %zu, \"settle_ms\": %.3f, \"lag_ms\": %.3f, "
+				"\"max_error_ma\": %.4f}", (index > 0) ? "," : "", step.channel, step.set, step.startMs * 1.0e-3,
+				step.driftMs, step.anchored ? "true" : "false", step.fromMa, step.toMa, step.samples, step.settleMs,
+				step.lagMs, step.maxErrorMa);
+		}
+		fprintf(file, "\n  ]\n}\n");
+	}
+
+	bool writeSteps(const std::string &fileName, const TrackingReport &report)
+	{
+		FILE *file(fopen(fileName.c_str(), "w"));
+		if (file == NULL)
+		{
+			return false;
+		}
+		fprintf(file, "channel,set,start_s,drift_ms,anchored,from_ma,to_ma,samples,settle_ms,lag_ms,max_error_ma\n");
+		for (size_t index(0); index < report.steps.size(); index++)
+		{
+			const StepTracking &step(report.steps[index]);
+			fprintf(file, "%d,%zu,%.6f,%.3f,%d,%.3f,%.3f,%zu,%.3f,%.3f,%.4f\n", step.channel, step.set,
+				step.startMs * 1.0e-3, step.driftMs, step.anchored ? 1 : 0, step.fromMa, step.toMa, step.samples,
+				step.settleMs, step.lagMs, step.maxErrorMa);
+		}
+		return fclose(file) == 0;
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	TrackingOptions options;
+	OutputFormat format(formatTable);
+	std::string playfileName;
+	std::string telemetryName;
+	std::string outputName;
+	std::string stepsName;
+	std::string calibrationName(calibration_file);
+
+	for (int i(1); i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		bool hasValue(i + 1 < argc);
+		if (arg == "--format" && hasValue)
+		{
+			std::string name(argv[++i]);
+			if (name == "table")
+			{
+				format = formatTable;
+			}
+			else if (name == "csv")
+			{
+				format = formatCsv;
+			}
+			else if (name == "json")
+			{
+				format = formatJson;
+			}
+			else
+			{
+				fprintf(stderr, "unknown format: %s\n", name.c_str());
+				return 1;
+			}
+		}
+		else if (arg == "--output" && hasValue)
+		{
+			outputName = argv[++i];
+		}
+		else if (arg == "--steps" && hasValue)
+		{
+			stepsName = argv[++i];
+		}
+		else if (arg == "--calibration" && hasValue)
+		{
+			calibrationName = argv[++i];
+		}
+		else if (arg == "--offset-ms" && hasValue)
+		{
+			options.offsetMs = atof(argv[++i]);
+		}
+		else if (arg == "--no-anchor")
+		{
+			options.anchorSteps = false;
+		}
+		else if (arg == "--min-step-ma" && hasValue)
+		{
+			options.minStepMa = std::max(atof(argv[++i]), 0.0);
+		}
+		else if (arg == "--band-pct" && hasValue)
+		{
+			options.bandFraction = std::max(atof(argv[++i]), 0.0) * 1.0e-2;
+		}
+		else if (arg == "--band-ma" && hasValue)
+		{
+			options.bandMa = std::max(atof(argv[++i]), 0.0);
+		}
+		else if (arg == "--threads" && hasValue)
+		{
+			options.threads = static_cast<unsigned int> (std::max(atoi(argv[++i]), 0));
+		}
+		else if (arg == "--help" || arg == "-h")
+		{
+			printUsage(argv[0]);
+			return 0;
+		}
+		else if (!arg.empty() && arg[0] != '-' && playfileName.empty())
+		{
+			playfileName = arg;
+		}
+		else if (!arg.empty() && arg[0] != '-' && telemetryName.empty())
+		{
+			telemetryName = arg;
+		}
+		else
+		{
+			fprintf(stderr, "unknown option: %s\n", arg.c_str());
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+	if (playfileName.empty() || telemetryName.empty())
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	// the commanded currents depend on the calibration, so load it before the playfile.
+	int calibratedChannels(loadCalibrationFile(calibrationName.c_str()));
+	if (calibratedChannels > 0)
+	{
+		fprintf(stderr, "Loaded calibration for %d channels from %s\n", calibratedChannels, calibrationName.c_str());
+	}
+	CatheterCmdSequence cmdSequence;
+	if (loadPlayFile(playfileName.c_str(), cmdSequence) < 0 || cmdSequence.empty())
+	{
+		fprintf(stderr, "Unable to load any commands from %s\n", playfileName.c_str());
+		return 1;
+	}
+
+	TrackingReport report;
+	std::chrono::steady_clock::time_point analysisStart(std::chrono::steady_clock::now());
+	int result(analyzeTrackingFile(cmdSequence, telemetryName.c_str(), options, report));
+	double seconds(std::chrono::duration<double> (std::chrono::steady_clock::now() - analysisStart).count());
+	if (result == -1)
+	{
+		fprintf(stderr, "Unable to read %s\n", telemetryName.c_str());
+		return 1;
+	}
+	if (result == -2)
+	{
+		fprintf(stderr, "%s needs the columns time_s, channel and sensed_ma\n", telemetryName.c_str());
+		return 1;
+	}
+
+	FILE *output(stdout);
+	if (!outputName.empty())
+	{
+		output = fopen(outputName.c_str(), "w");
+		if (output == NULL)
+		{
+			fprintf(stderr, "Unable to open %s\n", outputName.c_str());
+			return 1;
+		}
+	}
+	switch (format)
+	{
+	case formatCsv:
+		writeCsv(output, report);
+		break;
+	case formatJson:
+		writeJson(output, report, options, playfileName, telemetryName);
+		break;
+	default:
+		fprintf(output, "playfile:   %s, %zu sets\n", playfileName.c_str(), cmdSequence.size());
+		fprintf(output, "telemetry:  %s, %zu rows, %zu samples from %.3f s to %.3f s (%zu skipped)\n",
+			telemetryName.c_str(), report.rows, report.samples, report.firstMs * 1.0e-3, report.lastMs * 1.0e-3,
+			report.skippedRows);
+		if (report.anchored)
+		{
+			fprintf(output, "steps:      %zu of %zu anchored on set_ma, largest drift from the schedule %.1f ms\n",
+				report.anchoredSteps, report.steps.size(), report.maxDriftMs);
+		}
+		writeTable(output, report);
+		break;
+	}
+	if (output != stdout && fclose(output) != 0)
+	{
+		fprintf(stderr, "Unable to write %s\n", outputName.c_str());
+		return 1;
+	}
+	if (!stepsName.empty() && !writeSteps(stepsName, report))
+	{
+		fprintf(stderr, "Unable to write %s\n", stepsName.c_str());
+		return 1;
+	}
+
+	std::ifstream telemetry(telemetryName.c_str(), std::ios::binary | std::ios::ate);
+	double megaBytes(static_cast<double> (telemetry.tellg()) * 1.0e-6);
+	fprintf(stderr, "analyzed %.1f MB in %.3f s (%.0f MB/s, %u threads, %zu chunks)\n", megaBytes, seconds,
+		seconds > 0.0 ? megaBytes / seconds : 0.0, report.threads, report.chunks);
+	if (report.samples == 0)
+	{
+		fprintf(stderr, "No sensed samples, record with catheter_play --poll.\n");
+	}
+	else if (options.anchorSteps && !report.anchored)
+	{
+		fprintf(stderr, "No set_ma column, the steps follow the playfile schedule and the lags include the link delays.\n");
+	}
+	else if (report.anchored && report.anchoredSteps < report.steps.size())
+	{
+		fprintf(stderr, "%zu steps were not echoed in set_ma, they keep the drift of the step before.\n",
+			report.steps.size() - report.anchoredSteps);
+	}
+	return 0;
+}
@@ -0,0 +1,477 @@
+#include "util/async_log.h"
+#include "util/spsc_ring.h"
+
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <vector>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+std::atomic<int> logMinSeverity(logInfo);
+
+namespace
+{
+	enum RingState
+	{
+		ringFree = 0, ringOwned, ringRetired
+	};
+
+	// written by its own thread only, drained by the log thread.
+	struct LogRing
+	{
+		SpscRing<LogRecord> records;
+		std::atomic<int> state;
+
+		LogRing() : records(LOG_RING_RECORDS), state(ringFree)
+		{};
+	};
+
+	// state shared with the log thread, guarded by logMutex.
+	boost::mutex logMutex;
+	boost::condition_variable logWake;
+	boost::condition_variable logFlushed;
+	LogRing *logRings[LOG_MAX_THREADS];
+	int logRingCount(0);
+	boost::thread logThread;
+	bool logRunning(false);
+	bool logStopping(false);
+	uint64_t flushRequested(0);
+	uint64_t flushDone(0);
+
+	// sinks, only touched by the log thread (and by the setters with logMutex held).
+	FILE *logFile(NULL);
+	bool logStdout(true);
+
+	// consoles with a rate limit summary still to write, guarded by watchMutex
+	// (taken after logMutex, before the console's own mutex).
+	boost::mutex watchMutex;
+	std::vector<ConsoleLog*> watchedConsoles;
+
+	// records of threads that found no free ring.
+	std::atomic<uint64_t> unringedRecords(0);
+
+	const uint64_t logStartNs(static_cast<uint64_t> (std::chrono::duration_cast<std::chrono::nanoseconds> (
+		std::chrono::steady_clock::now().time_since_epoch()).count()));
+
+	// gives the ring back when its thread exits, the log thread frees it once drained.
+	struct ThreadRing
+	{
+		LogRing *ring;
+		bool unringed;
+
+		ThreadRing() : ring(NULL), unringed(false)
+		{};
+
+		~ThreadRing()
+		{
+			if (ring != NULL)
+			{
+				ring->state.store(ringRetired, std::memory_order_release);
+			}
+		}
+	};
+
+	thread_local ThreadRing threadRing;
+
+	void writeRecord(const LogRecord &record)
+	{
+		char message[LOG_LINE_LEN_MAX];
+		logFormat(record, message, sizeof(message));
+		double seconds(record.timeNs >= logStartNs ? (record.timeNs - logStartNs) * 1.0e-9 : 0.0);
+		if (logFile != NULL)
+		{
+			fprintf(logFile, "%12.6f %-7s %s\n", seconds, logSeverity2String(record.severity), message);
+		}
+		if (record.console != NULL)
+		{
+			record.console->appendText(message, record.severity);
+		}
+		else if (logStdout)
+		{
+			fprintf(stdout, "%s\n", message);
+		}
+	}
+
+	bool earlier(const LogRecord &first, const LogRecord &second)
+	{
+		return first.timeNs < second.timeNs;
+	}
+
+	// drains every ring, writes the records in time order.
+	void drainRings(std::vector<LogRecord> &batch)
+	{
+		batch.clear();
+		int ringCount;
+		{
+			boost::mutex::scoped_lock lock(logMutex);
+			ringCount = logRingCount;
+		}
+		LogRecord record;
+		for (int index(0); index < ringCount; index++)
+		{
+			LogRing *ring(logRings[index]);
+			// read the state first: a retired ring gets no more records.
+			bool retired(ring->state.load(std::memory_order_acquire) == ringRetired);
+			while (ring->records.pop(record))
+			{
+				batch.push_back(record);
+			}
+			if (retired)
+			{
+				ring->state.store(ringFree, std::memory_order_release);
+			}
+		}
+		std::stable_sort(batch.begin(), batch.end(), earlier);
+		boost::mutex::scoped_lock lock(logMutex);
+		for (size_t index(0); index < batch.size(); index++)
+		{
+			writeRecord(batch[index]);
+		}
+		if (!batch.empty())
+		{
+			fflush(stdout);
+			if (logFile != NULL)
+			{
+				fflush(logFile);
+			}
+		}
+	}
+
+	// writes the summaries of the windows that have ended (outside logMutex, a notify may log).
+	void flushWatched()
+	{
+		boost::mutex::scoped_lock lock(watchMutex);
+		size_t index(0);
+		while (index < watchedConsoles.size())
+		{
+			if (watchedConsoles[index]->flushSuppressed())
+			{
+				watchedConsoles.erase(watchedConsoles.begin() + index);
+			}
+			else
+			{
+				index++;
+			}
+		}
+	}
+
+	void logLoop()
+	{
+		std::vector<LogRecord> batch;
+		batch.reserve(LOG_RING_RECORDS);
+		while (true)
+		{
+			uint64_t request;
+			bool stopping;
+			{
+				boost::mutex::scoped_lock lock(logMutex);
+				if (flushRequested == flushDone && !logStopping)
+				{
+					logWake.timed_wait(lock, boost::posix_time::milliseconds(LOG_DRAIN_PERIOD_MS));
+				}
+				request = flushRequested;
+				stopping = logStopping;
+			}
+			drainRings(batch);
+			flushWatched();
+			{
+				boost::mutex::scoped_lock lock(logMutex);
+				flushDone = request;
+			}
+			logFlushed.notify_all();
+			if (stopping)
+			{
+				return;
+			}
+		}
+	}
+
+	LogRing* attachThread()
+	{
+		boost::mutex::scoped_lock lock(logMutex);
+		LogRing *ring(NULL);
+		for (int index(0); index < logRingCount && ring == NULL; index++)
+		{
+			int expected(ringFree);
+			if (logRings[index]->state.compare_exchange_strong(expected, ringOwned, std::memory_order_acquire))
+			{
+				ring = logRings[index];
+			}
+		}
+		if (ring == NULL)
+		{
+			if (logRingCount == LOG_MAX_THREADS)
+			{
+				threadRing.unringed = true;
+				return NULL;
+			}
+			ring = new LogRing;
+			ring->state.store(ringOwned, std::memory_order_relaxed);
+			logRings[logRingCount++] = ring;
+		}
+		if (!logRunning && !logStopping)
+		{
+			logRunning = true;
+			logThread = boost::thread(&logLoop);
+		}
+		threadRing.ring = ring;
+		return ring;
+	}
+
+	// stops the log thread (writing what is left) before the statics above go away.
+	struct LogShutdown
+	{
+		~LogShutdown()
+		{
+			{
+				boost::mutex::scoped_lock lock(logMutex);
+				logStopping = true;
+			}
+			logWake.notify_all();
+			if (logThread.joinable())
+			{
+				logThread.join();
+			}
+			boost::mutex::scoped_lock lock(logMutex);
+			if (logFile != NULL)
+			{
+				fclose(logFile);
+				logFile = NULL;
+			}
+		}
+	};
+
+	LogShutdown logShutdown;
+
+	// appends formatted output, keeps the position at the end of what fits.
+	void appendFormatted(char *out, size_t size, size_t &position, const char *spec, ...)
+	{
+		if (position + 1 >= size)
+		{
+			return;
+		}
+		va_list args;
+		va_start(args, spec);
+		int written(vsnprintf(out + position, size - position, spec, args));
+		va_end(args);
+		if (written > 0)
+		{
+			position = std::min(position + static_cast<size_t> (written), size - 1);
+		}
+	}
+}
+
+
+void logPush(const LogRecord &record)
+{
+	LogRing *ring(threadRing.ring);
+	if (ring == NULL)
+	{
+		ring = threadRing.unringed ? NULL : attachThread();
+		if (ring == NULL)
+		{
+			unringedRecords.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	}
+	ring->records.push(record);
+}
+
+size_t logFormat(const LogRecord &record, char *out, size_t size)
+{
+	if (size == 0)
+	{
+		return 0;
+	}
+	size_t position(0);
+	int argIndex(0);
+	const char *cursor(record.format != NULL ? record.format : "");
+	while (*cursor != '\0' && position + 1 < size)
+	{
+		if (*cursor != '%')
+		{
+			out[position++] = *cursor++;
+			continue;
+		}
+		if (cursor[1] == '%')
+		{
+			out[position++] = '%';
+			cursor += 2;
+			continue;
+		}
+		// %[flags][width][.precision][length]conversion, the length is replaced by what was captured.
+		char spec[32];
+		size_t specLength(0);
+		spec[specLength++] = *cursor++;
+		while (*cursor != '\0' && strchr("-+ #0123456789.", *cursor) != NULL && specLength < sizeof(spec) - 4)
+		{
+			spec[specLength++] = *cursor++;
+		}
+		while (*cursor != '\0' && strchr("hlLqjzt", *cursor) != NULL)
+		{
+			cursor++;
+		}
+		char conversion(*cursor);
+		if (conversion == '\0')
+		{
+			break;
+		}
+		cursor++;
+		if (argIndex >= record.nArgs)
+		{
+			appendFormatted(out, size, position, "%s", "(missing)");
+			continue;
+		}
+		uint8_t type(record.types[argIndex]);
+		const LogRecord::ArgValue &value(record.args[argIndex]);
+		argIndex++;
+		switch (conversion)
+		{
+		case 'd':
+		case 'i':
+		case 'u':
+		case 'x':
+		case 'X':
+		case 'o':
+		case 'c':
+		{
+			bool isSigned(conversion == 'd' || conversion == 'i' || conversion == 'c');
+			spec[specLength++] = 'l';
+			spec[specLength++] = 'l';
+			spec[specLength++] = (conversion == 'c') ? 'd' : conversion;
+			spec[specLength] = '\0';
+			long long signedValue(type == logArgDouble ? static_cast<long long> (value.d) : value.i);
+			unsigned long long unsignedValue(type == logArgDouble ? static_cast<unsigned long long> (value.d) : value.u);
+			if (conversion == 'c')
+			{
+				char text[2] = { static_cast<char> (signedValue), '\0' };
+				appendFormatted(out, size, position, "%s", text);
+			}
+			else if (isSigned)
+			{
+				appendFormatted(out, size, position, spec, signedValue);
+			}
+			else
+			{
+				appendFormatted(out, size, position, spec, unsignedValue);
+			}
+			break;
+		}
+		case 'f':
+		case 'F':
+		case 'e':
+		case 'E':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+		{
+			spec[specLength++] = conversion;
+			spec[specLength] = '\0';
+			double number(type == logArgDouble ? value.d
+				: (type == logArgSigned ? static_cast<double> (value.i) : static_cast<double> (value.u)));
+			appendFormatted(out, size, position, spec, number);
+			break;
+		}
+		case 's':
+			spec[specLength++] = 's';
+			spec[specLength] = '\0';
+			appendFormatted(out, size, position, spec,
+				type == logArgText ? record.text + std::min<uint64_t>(value.u, LOG_TEXT_LEN - 1) : "(not text)");
+			break;
+		case 'p':
+			appendFormatted(out, size, position, "%p", reinterpret_cast<const void*> (static_cast<uintptr_t> (value.u)));
+			break;
+		default:
+			appendFormatted(out, size, position, "%s", "(bad format)");
+			break;
+		}
+	}
+	out[position] = '\0';
+	return position;
+}
+
+void logSetLevel(logSeverity severity)
+{
+	logMinSeverity.store(severity, std::memory_order_relaxed);
+}
+
+bool logOpenFile(const std::string &fileName)
+{
+	FILE *file(NULL);
+	if (!fileName.empty())
+	{
+		file = fopen(fileName.c_str(), "a");
+		if (file == NULL)
+		{
+			return false;
+		}
+	}
+	boost::mutex::scoped_lock lock(logMutex);
+	if (logFile != NULL)
+	{
+		fclose(logFile);
+	}
+	logFile = file;
+	return true;
+}
+
+void logSetStdout(bool enable)
+{
+	boost::mutex::scoped_lock lock(logMutex);
+	logStdout = enable;
+}
+
+void logFlush()
+{
+	boost::mutex::scoped_lock lock(logMutex);
+	if (!logRunning || logStopping || boost::this_thread::get_id() == logThread.get_id())
+	{
+		return;
+	}
+	uint64_t request(++flushRequested);
+	logWake.notify_all();
+	while (flushDone < request && !logStopping)
+	{
+		logFlushed.wait(lock);
+	}
+}
+
+uint64_t logDropped()
+{
+	boost::mutex::scoped_lock lock(logMutex);
+	uint64_t dropped(unringedRecords.load(std::memory_order_relaxed));
+	for (int index(0); index < logRingCount; index++)
+	{
+		dropped += logRings[index]->records.droppedCount();
+	}
+	return dropped;
+}
+
+void logWatchConsole(ConsoleLog *console)
+{
+	boost::mutex::scoped_lock lock(watchMutex);
+	if (std::find(watchedConsoles.begin(), watchedConsoles.end(), console) == watchedConsoles.end())
+	{
+		watchedConsoles.push_back(console);
+	}
+}
+
+void logForgetConsole(ConsoleLog *console)
+{
+	boost::mutex::scoped_lock lock(watchMutex);
+	watchedConsoles.erase(std::remove(watchedConsoles.begin(), watchedConsoles.end(), console), watchedConsoles.end());
+}
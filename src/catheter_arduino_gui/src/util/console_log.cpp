@@ -0,0 +1,241 @@
+#include "util/console_log.h"
+#include "util/async_log.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+
+const char* logSeverity2String(logSeverity severity)
+{
+	switch (severity)
+	{
+	case logDebug:
+		return "debug";
+	case logInfo:
+		return "info";
+	case logWarning:
+		return "warning";
+	case logError:
+		return "error";
+	}
+	return "unknown";
+}
+
+
+ConsoleLog::ConsoleLog(size_t capacity_) : lines(capacity_ > 0 ? capacity_ : 1),
+	nextSeq(0), oldestSeq(0), updated(false),
+	rateLimit(0), windowStart(0.0), windowCount(0), windowSuppressed(0), totalSuppressed(0),
+	startTime(boost::posix_time::microsec_clock::local_time())
+{
+}
+
+ConsoleLog::~ConsoleLog()
+{
+	logFlush();
+	logForgetConsole(this);
+}
+
+void ConsoleLog::appendText(const std::string &newText, logSeverity severity)
+{
+	bool firstSuppressed(false);
+	{
+		boost::mutex::scoped_lock lock(logMutex);
+		double timeStamp(elapsed());
+		if (rateLimited(severity, timeStamp))
+		{
+			firstSuppressed = (windowSuppressed == 1);
+		}
+		else
+		{
+			// one line per newline, empty lines are dropped.
+			size_t start(0);
+			while (start <= newText.size())
+			{
+				size_t end(newText.find('\n', start));
+				if (end == std::string::npos)
+				{
+					end = newText.size();
+				}
+				if (end > start)
+				{
+					addLine(newText.data() + start, end - start, severity, timeStamp);
+				}
+				start = end + 1;
+			}
+
+			updated = true;
+			if (notify)
+			{
+				notify();
+			}
+		}
+	}
+	// the log thread writes the summary when the window ends, even if nothing else comes in.
+	if (firstSuppressed)
+	{
+		logWatchConsole(this);
+	}
+}
+
+void ConsoleLog::addLine(const char *text, size_t length, logSeverity severity, double timeStamp)
+{
+	if (length >= LOG_LINE_LEN)
+	{
+		length = LOG_LINE_LEN - 1;
+	}
+	ConsoleLine &line(lines[nextSeq % lines.size()]);
+	line.seq = nextSeq;
+	line.timeStamp = timeStamp;
+	line.severity = severity;
+	line.length = static_cast<uint16_t> (length);
+	memcpy(line.text, text, length);
+	line.text[length] = 0;
+
+	nextSeq++;
+	if (nextSeq - oldestSeq > lines.size())
+	{
+		oldestSeq = nextSeq - lines.size();
+	}
+}
+
+bool ConsoleLog::rateLimited(logSeverity severity, double timeStamp)
+{
+	if (rateLimit == 0)
+	{
+		return false;
+	}
+
+	// start a new one second window, reporting what was dropped in the last one.
+	if (timeStamp - windowStart >= 1.0)
+	{
+		writeSuppressed(timeStamp);
+		windowStart = timeStamp;
+		windowCount = 0;
+	}
+
+	if (severity < logError && windowCount >= rateLimit)
+	{
+		windowSuppressed++;
+		totalSuppressed++;
+		return true;
+	}
+	windowCount++;
+	return false;
+}
+
+double ConsoleLog::elapsed() const
+{
+	return (boost::posix_time::microsec_clock::local_time() - startTime).total_microseconds() * 1.0e-6;
+}
+
+// writes the summary of a finished window, returns true if it wrote one.
+bool ConsoleLog::writeSuppressed(double timeStamp)
+{
+	if (windowSuppressed == 0 || timeStamp - windowStart < 1.0)
+	{
+		return false;
+	}
+	char summary[LOG_LINE_LEN];
+	int length(snprintf(summary, LOG_LINE_LEN, "(%u messages suppressed)", windowSuppressed));
+	addLine(summary, static_cast<size_t> (length), logWarning, timeStamp);
+	windowSuppressed = 0;
+	return true;
+}
+
+bool ConsoleLog::flushSuppressed()
+{
+	boost::mutex::scoped_lock lock(logMutex);
+	if (writeSuppressed(elapsed()))
+	{
+		updated = true;
+		if (notify)
+		{
+			notify();
+		}
+	}
+	return windowSuppressed == 0;
+}
+
+uint64_t ConsoleLog::firstSeq() const
+{
+	boost::mutex::scoped_lock lock(logMutex);
+	return oldestSeq;
+}
+
+uint64_t ConsoleLog::endSeq() const
+{
+	boost::mutex::scoped_lock lock(logMutex);
+	return nextSeq;
+}
+
+size_t ConsoleLog::size() const
+{
+	boost::mutex::scoped_lock lock(logMutex);
+	return static_cast<size_t> (nextSeq - oldestSeq);
+}
+
+size_t ConsoleLog::capacity() const
+{
+	return lines.size();
+}
+
+bool ConsoleLog::getLine(uint64_t seq, ConsoleLine &line) const
+{
+	boost::mutex::scoped_lock lock(logMutex);
+	if (seq < oldestSeq || seq >= nextSeq)
+	{
+		return false;
+	}
+	line = lines[seq % lines.size()];
+	return true;
+}
+
+bool ConsoleLog::takeUpdate()
+{
+	boost::mutex::scoped_lock lock(logMutex);
+	if (writeSuppressed(elapsed()))
+	{
+		updated = true;
+	}
+	bool wasUpdated(updated);
+	updated = false;
+	return wasUpdated;
+}
+
+void ConsoleLog::setRateLimit(unsigned int linesPerSecond)
+{
+	boost::mutex::scoped_lock lock(logMutex);
+	rateLimit = linesPerSecond;
+}
+
+uint64_t ConsoleLog::suppressedLines() const
+{
+	boost::mutex::scoped_lock lock(logMutex);
+	return totalSuppressed;
+}
+
+void ConsoleLog::setNotify(const boost::function<void()> &notifyFcn)
+{
+	boost::mutex::scoped_lock lock(logMutex);
+	notify = notifyFcn;
+}
+
+void ConsoleLog::clear()
+{
+	boost::mutex::scoped_lock lock(logMutex);
+	// the sequence numbers keep counting so that old indices stay invalid.
+	oldestSeq = nextSeq;
+	updated = true;
+}
@@ -0,0 +1,95 @@
+#include "util/decimate.h"
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+
+size_t decimateMinMax(const float *values, size_t count, size_t buckets, float *minOut, float *maxOut)
+{
+	if (count == 0 || buckets == 0)
+	{
+		return 0;
+	}
+	if (count <= buckets)
+	{
+		for (size_t index(0); index < count; index++)
+		{
+			minOut[index] = values[index];
+			maxOut[index] = values[index];
+		}
+		return count;
+	}
+
+	size_t start(0);
+	for (size_t bucket(0); bucket < buckets; bucket++)
+	{
+		size_t end(((bucket + 1) * count) / buckets);
+		// branch free inner loop (the compiler turns it into min/max instructions).
+		float low(values[start]);
+		float high(values[start]);
+		for (size_t index(start + 1); index < end; index++)
+		{
+			float value(values[index]);
+			low = (value < low) ? value : low;
+			high = (value > high) ? value : high;
+		}
+		minOut[bucket] = low;
+		maxOut[bucket] = high;
+		start = end;
+	}
+	return buckets;
+}
+
+
+SampleHistory::SampleHistory(size_t capacity_) : values(2 * (capacity_ > 0 ? capacity_ : 1), 0.0f),
+	cap(capacity_ > 0 ? capacity_ : 1), next(0), filled(0)
+{
+}
+
+void SampleHistory::push(float value)
+{
+	values[next] = value;
+	values[next + cap] = value;
+	next = (next + 1 == cap) ? 0 : next + 1;
+	filled = (filled < cap) ? filled + 1 : cap;
+}
+
+void SampleHistory::clear()
+{
+	next = 0;
+	filled = 0;
+}
+
+size_t SampleHistory::size() const
+{
+	return filled;
+}
+
+size_t SampleHistory::capacity() const
+{
+	return cap;
+}
+
+float SampleHistory::latest() const
+{
+	if (filled == 0)
+	{
+		return 0.0f;
+	}
+	return values[next + cap - 1];
+}
+
+const float* SampleHistory::newest(size_t count) const
+{
+	// [next, next + cap) holds the last cap samples in order.
+	return &values[next + cap - count];
+}
@@ -0,0 +1,490 @@
+#include "util/link_log.h"
+#include "util/async_log.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+namespace
+{
+	const uint64_t recordHeaderBytes(sizeof(LinkRecordHeader));
+	const uint64_t indexRecordBytes(sizeof(LinkRecordHeader) + sizeof(LinkIndexEntry));
+
+	uint64_t paddedLength(uint64_t length)
+	{
+		return (length + 7) & ~static_cast<uint64_t> (7);
+	}
+
+	// bytes into the block holding the offset.
+	uint64_t blockOffset(uint64_t offset)
+	{
+		return (offset - LINK_LOG_HEADER_BYTES) % LINK_LOG_BLOCK_BYTES;
+	}
+
+	uint64_t blockStart(uint64_t block)
+	{
+		return LINK_LOG_HEADER_BYTES + block * LINK_LOG_BLOCK_BYTES;
+	}
+}
+
+std::string linkLogDefaultName(const std::string &prefix)
+{
+	time_t now(time(NULL));
+	struct tm local;
+#ifdef _WIN32
+	localtime_s(&local, &now);
+#else
+	localtime_r(&now, &local);
+#endif
+	char stamp[32];
+	strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &local);
+	return prefix + "_" + stamp + ".link";
+}
+
+
+LinkRecorder::LinkRecorder() : fd(-1), header(NULL), window(NULL), windowStart(0), offset(0),
+	recordCount(0), bytesOut(0), bytesIn(0), failed(false)
+{
+}
+
+LinkRecorder::~LinkRecorder()
+{
+	close();
+}
+
+bool LinkRecorder::open(const std::string &fileName, const std::string &note)
+{
+	return create(fileName, note, false);
+}
+
+bool LinkRecorder::openUnique(const std::string &fileName, const std::string &note)
+{
+	// the suffix goes before the extension (not a dot in a directory name).
+	size_t dot(fileName.rfind('.'));
+	size_t slash(fileName.find_last_of("/\\"));
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+	{
+		dot = fileName.size();
+	}
+	for (int suffix(1); suffix <= LINK_LOG_MAX_SUFFIX; suffix++)
+	{
+		std::string candidate(fileName);
+		if (suffix > 1)
+		{
+			char number[16];
+			snprintf(number, sizeof(number), "_%d", suffix);
+			candidate = fileName.substr(0, dot) + number + fileName.substr(dot);
+		}
+		if (create(candidate, note, true))
+		{
+			return true;
+		}
+		if (errno != EEXIST)
+		{
+			return false;
+		}
+	}
+	return false;
+}
+
+bool LinkRecorder::create(const std::string &fileName, const std::string &note, bool exclusive)
+{
+	close();
+#ifdef _WIN32
+	(void) fileName;
+	(void) note;
+	(void) exclusive;
+	return false;
+#else
+	boost::mutex::scoped_lock lock(recordMutex);
+	int file(::open(fileName.c_str(), O_RDWR | O_CREAT | (exclusive ? O_EXCL : O_TRUNC), 0644));
+	if (file < 0)
+	{
+		return false;
+	}
+	void *mapped(MAP_FAILED);
+	if (ftruncate(file, LINK_LOG_HEADER_BYTES) == 0)
+	{
+		mapped = mmap(NULL, LINK_LOG_HEADER_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	}
+	if (mapped == MAP_FAILED)
+	{
+		::close(file);
+		return false;
+	}
+	fd = file;
+	name = fileName;
+	header = static_cast<LinkLogHeader*> (mapped);
+	header->version = LINK_LOG_VERSION;
+	header->headerBytes = LINK_LOG_HEADER_BYTES;
+	header->blockBytes = LINK_LOG_BLOCK_BYTES;
+	header->startNs = linkLogNowNs();
+	header->startTime = std::chrono::duration_cast<std::chrono::microseconds> (
+		std::chrono::system_clock::now().time_since_epoch()).count() * 1.0e-6;
+	header->used.store(LINK_LOG_HEADER_BYTES, std::memory_order_relaxed);
+	header->records.store(0, std::memory_order_relaxed);
+	header->dropped.store(0, std::memory_order_relaxed);
+	strncpy(header->note, note.c_str(), LINK_LOG_NOTE_LEN - 1);
+	// the magic last: a reader that sees it sees the rest of the header.
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = LINK_LOG_MAGIC;
+
+	offset = LINK_LOG_HEADER_BYTES;
+	recordCount = 0;
+	bytesOut = 0;
+	bytesIn = 0;
+	failed = !mapWindow(offset);
+	return true;
+#endif
+}
+
+void LinkRecorder::close()
+{
+	boost::mutex::scoped_lock lock(recordMutex);
+	if (header == NULL)
+	{
+		return;
+	}
+#ifndef _WIN32
+	unmapWindow();
+	uint64_t used(header->used.load(std::memory_order_relaxed));
+	munmap(header, LINK_LOG_HEADER_BYTES);
+	// the file grew a whole window at a time.
+	if (ftruncate(fd, static_cast<off_t> (used)) != 0)
+	{
+		logMessage(logError, "Unable to trim the link log %s", name);
+	}
+	::close(fd);
+#endif
+	header = NULL;
+	fd = -1;
+}
+
+bool LinkRecorder::isOpen() const
+{
+	boost::mutex::scoped_lock lock(recordMutex);
+	return header != NULL;
+}
+
+void LinkRecorder::record(LinkRecordType type, const void *bytes, size_t length)
+{
+	boost::mutex::scoped_lock lock(recordMutex);
+	if (header != NULL)
+	{
+		// stamped with the lock held, so the records of different threads are in time order.
+		append(type, linkLogNowNs(), static_cast<const uint8_t*> (bytes), length);
+	}
+}
+
+void LinkRecorder::record(LinkRecordType type, uint64_t timeNs, const void *bytes, size_t length)
+{
+	boost::mutex::scoped_lock lock(recordMutex);
+	if (header != NULL)
+	{
+		append(type, timeNs, static_cast<const uint8_t*> (bytes), length);
+	}
+}
+
+void LinkRecorder::mark(const std::string &text)
+{
+	record(linkRecordMark, text.data(), text.size());
+}
+
+void LinkRecorder::append(LinkRecordType type, uint64_t timeNs, const uint8_t *bytes, size_t length)
+{
+	do
+	{
+		size_t part((length < LINK_LOG_MAX_PAYLOAD) ? length : LINK_LOG_MAX_PAYLOAD);
+		appendRecord(type, timeNs, bytes, part);
+		bytes += part;
+		length -= part;
+	} while (length > 0);
+}
+
+void LinkRecorder::appendRecord(LinkRecordType type, uint64_t timeNs, const uint8_t *bytes, size_t length)
+{
+	if (failed)
+	{
+		header->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	uint64_t recordBytes(recordHeaderBytes + paddedLength(length));
+	uint64_t inBlock(blockOffset(offset));
+	if (inBlock != 0 && inBlock + recordBytes > LINK_LOG_BLOCK_BYTES)
+	{
+		// the rest of the block stays zero (linkRecordEnd).
+		offset += LINK_LOG_BLOCK_BYTES - inBlock;
+		inBlock = 0;
+	}
+	if (inBlock == 0)
+	{
+		if (offset >= windowStart + LINK_LOG_MAP_BYTES && !mapWindow(offset))
+		{
+			failed = true;
+			header->dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		LinkRecordHeader *index(reinterpret_cast<LinkRecordHeader*> (window + (offset - windowStart)));
+		index->timeNs = timeNs;
+		index->length = sizeof(LinkIndexEntry);
+		index->type = linkRecordIndex;
+		LinkIndexEntry *entry(reinterpret_cast<LinkIndexEntry*> (index + 1));
+		entry->records = recordCount;
+		entry->bytesOut = bytesOut;
+		entry->bytesIn = bytesIn;
+		offset += indexRecordBytes;
+	}
+
+	LinkRecordHeader *record(reinterpret_cast<LinkRecordHeader*> (window + (offset - windowStart)));
+	record->timeNs = timeNs;
+	record->length = static_cast<uint32_t> (length);
+	record->type = type;
+	memcpy(record + 1, bytes, length);
+	offset += recordBytes;
+	recordCount++;
+	bytesOut += (type == linkRecordOut) ? length : 0;
+	bytesIn += (type == linkRecordIn) ? length : 0;
+	header->records.store(recordCount, std::memory_order_relaxed);
+	header->used.store(offset, std::memory_order_release);
+}
+
+bool LinkRecorder::mapWindow(uint64_t offset_)
+{
+#ifdef _WIN32
+	(void) offset_;
+	return false;
+#else
+	unmapWindow();
+	uint64_t start(LINK_LOG_HEADER_BYTES + ((offset_ - LINK_LOG_HEADER_BYTES) / LINK_LOG_MAP_BYTES) * LINK_LOG_MAP_BYTES);
+	// the new part of the file reads as zeros, which ends every block.
+	if (ftruncate(fd, static_cast<off_t> (start + LINK_LOG_MAP_BYTES)) != 0)
+	{
+		return false;
+	}
+	void *mapped(mmap(NULL, LINK_LOG_MAP_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t> (start)));
+	if (mapped == MAP_FAILED)
+	{
+		return false;
+	}
+	window = static_cast<uint8_t*> (mapped);
+	windowStart = start;
+	return true;
+#endif
+}
+
+void LinkRecorder::unmapWindow()
+{
+#ifndef _WIN32
+	if (window != NULL)
+	{
+		munmap(window, LINK_LOG_MAP_BYTES);
+	}
+#endif
+	window = NULL;
+	windowStart = 0;
+}
+
+uint64_t LinkRecorder::records() const
+{
+	boost::mutex::scoped_lock lock(recordMutex);
+	return (header != NULL) ? recordCount : 0;
+}
+
+uint64_t LinkRecorder::bytesUsed() const
+{
+	boost::mutex::scoped_lock lock(recordMutex);
+	return (header != NULL) ? offset : 0;
+}
+
+uint64_t LinkRecorder::dropped() const
+{
+	boost::mutex::scoped_lock lock(recordMutex);
+	return (header != NULL) ? header->dropped.load(std::memory_order_relaxed) : 0;
+}
+
+std::string LinkRecorder::fileName() const
+{
+	boost::mutex::scoped_lock lock(recordMutex);
+	return name;
+}
+
+
+LinkLogReader::LinkLogReader() : mapped(NULL), mappedBytes(0)
+{
+}
+
+LinkLogReader::~LinkLogReader()
+{
+	close();
+}
+
+bool LinkLogReader::open(const std::string &fileName)
+{
+	close();
+#ifdef _WIN32
+	(void) fileName;
+	return false;
+#else
+	int file(::open(fileName.c_str(), O_RDONLY));
+	if (file < 0)
+	{
+		return false;
+	}
+	struct stat info;
+	void *map(MAP_FAILED);
+	if (fstat(file, &info) == 0 && static_cast<uint64_t> (info.st_size) >= LINK_LOG_HEADER_BYTES)
+	{
+		map = mmap(NULL, static_cast<size_t> (info.st_size), PROT_READ, MAP_SHARED, file, 0);
+	}
+	::close(file);
+	if (map == MAP_FAILED)
+	{
+		return false;
+	}
+	const LinkLogHeader *fileHeader(static_cast<const LinkLogHeader*> (map));
+	if (fileHeader->magic != LINK_LOG_MAGIC || fileHeader->version != LINK_LOG_VERSION
+		|| fileHeader->headerBytes != LINK_LOG_HEADER_BYTES || fileHeader->blockBytes != LINK_LOG_BLOCK_BYTES)
+	{
+		munmap(map, static_cast<size_t> (info.st_size));
+		return false;
+	}
+	mapped = static_cast<const uint8_t*> (map);
+	mappedBytes = static_cast<uint64_t> (info.st_size);
+	return true;
+#endif
+}
+
+void LinkLogReader::close()
+{
+#ifndef _WIN32
+	if (mapped != NULL)
+	{
+		munmap(const_cast<uint8_t*> (mapped), static_cast<size_t> (mappedBytes));
+	}
+#endif
+	mapped = NULL;
+	mappedBytes = 0;
+}
+
+const LinkLogHeader& LinkLogReader::header() const
+{
+	return *reinterpret_cast<const LinkLogHeader*> (mapped);
+}
+
+uint64_t LinkLogReader::endOffset() const
+{
+	if (mapped == NULL)
+	{
+		return 0;
+	}
+	uint64_t used(header().used.load(std::memory_order_acquire));
+	return (used < mappedBytes) ? used : mappedBytes;
+}
+
+uint64_t LinkLogReader::begin() const
+{
+	return LINK_LOG_HEADER_BYTES;
+}
+
+bool LinkLogReader::next(uint64_t &offset, LinkRecordView &view) const
+{
+	uint64_t end(endOffset());
+	while (offset + recordHeaderBytes <= end)
+	{
+		uint64_t inBlock(blockOffset(offset));
+		const LinkRecordHeader *record(reinterpret_cast<const LinkRecordHeader*> (mapped + offset));
+		if (inBlock + recordHeaderBytes > LINK_LOG_BLOCK_BYTES || record->type == linkRecordEnd)
+		{
+			offset += LINK_LOG_BLOCK_BYTES - inBlock;
+			continue;
+		}
+		uint64_t recordBytes(recordHeaderBytes + paddedLength(record->length));
+		if (inBlock + recordBytes > LINK_LOG_BLOCK_BYTES || offset + recordBytes > end)
+		{
+			// corrupt, or the writer died in the middle of it.
+			return false;
+		}
+		uint64_t recordOffset(offset);
+		offset += recordBytes;
+		if (record->type == linkRecordIndex)
+		{
+			continue;
+		}
+		view.offset = recordOffset;
+		view.timeNs = record->timeNs;
+		view.type = static_cast<LinkRecordType> (record->type);
+		view.bytes = reinterpret_cast<const uint8_t*> (record + 1);
+		view.length = record->length;
+		return true;
+	}
+	return false;
+}
+
+uint64_t LinkLogReader::blocks() const
+{
+	uint64_t end(endOffset());
+	if (end <= LINK_LOG_HEADER_BYTES)
+	{
+		return 0;
+	}
+	return (end - LINK_LOG_HEADER_BYTES + LINK_LOG_BLOCK_BYTES - 1) / LINK_LOG_BLOCK_BYTES;
+}
+
+bool LinkLogReader::blockIndex(uint64_t block, uint64_t &timeNs, LinkIndexEntry &entry) const
+{
+	uint64_t start(blockStart(block));
+	if (block >= blocks() || start + indexRecordBytes > endOffset())
+	{
+		return false;
+	}
+	const LinkRecordHeader *record(reinterpret_cast<const LinkRecordHeader*> (mapped + start));
+	if (record->type != linkRecordIndex || record->length != sizeof(LinkIndexEntry))
+	{
+		return false;
+	}
+	timeNs = record->timeNs;
+	memcpy(&entry, record + 1, sizeof(entry));
+	return true;
+}
+
+uint64_t LinkLogReader::seek(uint64_t timeNs) const
+{
+	// the last block that starts at or before the time (block times only grow).
+	uint64_t low(0);
+	uint64_t high(blocks());
+	LinkIndexEntry entry;
+	uint64_t blockTime;
+	while (high - low > 1)
+	{
+		uint64_t middle(low + (high - low) / 2);
+		if (blockIndex(middle, blockTime, entry) && blockTime <= timeNs)
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return blockStart(low);
+}
@@ -0,0 +1,393 @@
+#include "util/metrics.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <time.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+namespace
+{
+#ifndef _WIN32
+	// true if the page was left by a process that is gone (a page still being
+	// set up, or one that cannot be read, belongs to someone else).
+	bool stalePage(const std::string &shmName)
+	{
+		int fd(shm_open(shmName.c_str(), O_RDONLY, 0));
+		if (fd < 0)
+		{
+			return false;
+		}
+		struct stat info;
+		void *mapped(MAP_FAILED);
+		if (fstat(fd, &info) == 0 && info.st_size >= static_cast<off_t> (sizeof(MetricsPage)))
+		{
+			mapped = mmap(NULL, sizeof(MetricsPage), PROT_READ, MAP_SHARED, fd, 0);
+		}
+		::close(fd);
+		if (mapped == MAP_FAILED)
+		{
+			return false;
+		}
+		const MetricsPage *page(static_cast<const MetricsPage*> (mapped));
+		bool stale(page->magic == METRICS_MAGIC && page->pid != 0
+			&& kill(static_cast<pid_t> (page->pid), 0) != 0 && errno == ESRCH);
+		munmap(mapped, sizeof(MetricsPage));
+		return stale;
+	}
+#endif
+
+	const char* typeName(MetricType type)
+	{
+		switch (type)
+		{
+		case metricCounter:
+			return "counter";
+		case metricGauge:
+			return "gauge";
+		case metricHistogram:
+			return "histogram";
+		default:
+			return "untyped";
+		}
+	}
+
+	void initPage(MetricsPage *page)
+	{
+		memset(static_cast<void*> (page), 0, sizeof(MetricsPage));
+		page->version = METRICS_VERSION;
+		page->pageSize = sizeof(MetricsPage);
+#ifndef _WIN32
+		page->pid = static_cast<uint32_t> (getpid());
+#endif
+		page->startTime = static_cast<double> (time(NULL));
+		page->count.store(0, std::memory_order_relaxed);
+		// the magic last: a reader that sees it sees the rest of the header.
+		std::atomic_thread_fence(std::memory_order_release);
+		page->magic = METRICS_MAGIC;
+	}
+}
+
+int metricBin(double sample)
+{
+	int bin(0);
+	while (bin + 1 < METRICS_HISTOGRAM_BINS && sample >= static_cast<double> (2 << bin))
+	{
+		bin++;
+	}
+	return bin;
+}
+
+void MetricHistogram::record(double sample)
+{
+	if (slot == NULL)
+	{
+		return;
+	}
+	bins->bins[metricBin(sample)].fetch_add(1, std::memory_order_relaxed);
+	bins->sum.fetch_add(sample > 0.0 ? static_cast<uint64_t> (sample + 0.5) : 0, std::memory_order_relaxed);
+	slot->value.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+MetricsRegistry::MetricsRegistry(const std::string &shmName_) : metricsPage(NULL), localBlock(NULL),
+	histogramCount(0)
+{
+#ifndef _WIN32
+	if (!shmName_.empty())
+	{
+		// never take over the page of a live process, only one left by a crash.
+		int fd(shm_open(shmName_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644));
+		if (fd < 0 && errno == EEXIST && stalePage(shmName_))
+		{
+			shm_unlink(shmName_.c_str());
+			fd = shm_open(shmName_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+		}
+		if (fd >= 0)
+		{
+			void *mapped(MAP_FAILED);
+			if (ftruncate(fd, sizeof(MetricsPage)) == 0)
+			{
+				mapped = mmap(NULL, sizeof(MetricsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			}
+			::close(fd);
+			if (mapped != MAP_FAILED)
+			{
+				metricsPage = static_cast<MetricsPage*> (mapped);
+				shmName = shmName_;
+			}
+			else
+			{
+				shm_unlink(shmName_.c_str());
+			}
+		}
+	}
+#endif
+	if (metricsPage == NULL)
+	{
+		// malloc does not promise cache line alignment.
+		localBlock = malloc(sizeof(MetricsPage) + METRICS_CACHE_LINE);
+		if (localBlock == NULL)
+		{
+			throw std::bad_alloc();
+		}
+		uintptr_t address(reinterpret_cast<uintptr_t> (localBlock));
+		address = (address + METRICS_CACHE_LINE - 1) & ~static_cast<uintptr_t> (METRICS_CACHE_LINE - 1);
+		metricsPage = reinterpret_cast<MetricsPage*> (address);
+	}
+	initPage(metricsPage);
+}
+
+MetricsRegistry::~MetricsRegistry()
+{
+#ifndef _WIN32
+	// the name is only set when this registry created the page.
+	if (!shmName.empty())
+	{
+		munmap(metricsPage, sizeof(MetricsPage));
+		shm_unlink(shmName.c_str());
+	}
+#endif
+	free(localBlock);
+}
+
+bool MetricsRegistry::shared() const
+{
+	return !shmName.empty();
+}
+
+std::string MetricsRegistry::name() const
+{
+	return shmName;
+}
+
+MetricSlot* MetricsRegistry::slotFor(const std::string &metricName, MetricType type)
+{
+	boost::mutex::scoped_lock lock(registryMutex);
+	uint32_t count(metricsPage->count.load(std::memory_order_relaxed));
+	for (uint32_t i(0); i < count; i++)
+	{
+		MetricSlot &slot(metricsPage->slots[i]);
+		if (metricName == slot.name)
+		{
+			return (slot.type.load(std::memory_order_relaxed) == type) ? &slot : NULL;
+		}
+	}
+	if (count == METRICS_MAX || metricName.empty() || metricName.size() >= METRICS_NAME_LEN
+		|| (type == metricHistogram && histogramCount == METRICS_MAX_HISTOGRAMS))
+	{
+		return NULL;
+	}
+
+	MetricSlot &slot(metricsPage->slots[count]);
+	strncpy(slot.name, metricName.c_str(), METRICS_NAME_LEN - 1);
+	slot.value.store(0, std::memory_order_relaxed);
+	if (type == metricHistogram)
+	{
+		slot.histogram = histogramCount++;
+	}
+	slot.type.store(type, std::memory_order_release);
+	metricsPage->count.store(count + 1, std::memory_order_release);
+	return &slot;
+}
+
+MetricCounter MetricsRegistry::counter(const std::string &metricName)
+{
+	return MetricCounter(slotFor(metricName, metricCounter));
+}
+
+MetricGauge MetricsRegistry::gauge(const std::string &metricName)
+{
+	return MetricGauge(slotFor(metricName, metricGauge));
+}
+
+MetricHistogram MetricsRegistry::histogram(const std::string &metricName)
+{
+	MetricSlot *slot(slotFor(metricName, metricHistogram));
+	if (slot == NULL)
+	{
+		return MetricHistogram();
+	}
+	return MetricHistogram(slot, &metricsPage->histograms[slot->histogram]);
+}
+
+const MetricsPage& MetricsRegistry::page() const
+{
+	return *metricsPage;
+}
+
+bool MetricsRegistry::writePrometheus(const std::string &fileName) const
+{
+	std::vector<MetricValue> values;
+	metricsSnapshot(*metricsPage, values);
+	std::string text(metricsPrometheusText(values));
+
+	std::string tempName(fileName + ".tmp");
+	FILE *file(fopen(tempName.c_str(), "w"));
+	if (file == NULL)
+	{
+		return false;
+	}
+	bool written(fwrite(text.data(), 1, text.size(), file) == text.size());
+	written = (fclose(file) == 0) && written;
+	if (!written)
+	{
+		remove(tempName.c_str());
+		return false;
+	}
+#ifdef _WIN32
+	// rename does not replace on windows.
+	remove(fileName.c_str());
+#endif
+	return rename(tempName.c_str(), fileName.c_str()) == 0;
+}
+
+
+void metricsSnapshot(const MetricsPage &page, std::vector<MetricValue> &values)
+{
+	values.clear();
+	uint32_t count(page.count.load(std::memory_order_acquire));
+	if (count > METRICS_MAX)
+	{
+		return;
+	}
+	values.resize(count);
+	for (uint32_t i(0); i < count; i++)
+	{
+		const MetricSlot &slot(page.slots[i]);
+		MetricValue &value(values[i]);
+		value.type = static_cast<MetricType> (slot.type.load(std::memory_order_acquire));
+		value.name.assign(slot.name, strnlen(slot.name, METRICS_NAME_LEN));
+		value.value = slot.value.load(std::memory_order_relaxed);
+		if (value.type == metricHistogram && slot.histogram < METRICS_MAX_HISTOGRAMS)
+		{
+			const MetricBins &bins(page.histograms[slot.histogram]);
+			value.sum = bins.sum.load(std::memory_order_relaxed);
+			value.bins.resize(METRICS_HISTOGRAM_BINS);
+			for (int bin(0); bin < METRICS_HISTOGRAM_BINS; bin++)
+			{
+				value.bins[bin] = bins.bins[bin].load(std::memory_order_relaxed);
+			}
+		}
+	}
+}
+
+std::string metricsPrometheusText(const std::vector<MetricValue> &values)
+{
+	std::ostringstream text;
+	for (size_t i(0); i < values.size(); i++)
+	{
+		const MetricValue &value(values[i]);
+		text << "# TYPE " << value.name << " " << typeName(value.type) << "\n";
+		if (value.type == metricGauge)
+		{
+			text << value.name << " " << static_cast<int64_t> (value.value) << "\n";
+		}
+		else if (value.type == metricHistogram)
+		{
+			// the buckets are cumulative, and the sample count can run ahead of the bins read before it.
+			uint64_t cumulative(0);
+			for (size_t bin(0); bin + 1 < value.bins.size(); bin++)
+			{
+				cumulative += value.bins[bin];
+				text << value.name << "_bucket{le=\"" << (2ull << bin) << "\"} " << cumulative << "\n";
+			}
+			cumulative += value.bins.empty() ? 0 : value.bins.back();
+			text << value.name << "_bucket{le=\"+Inf\"} " << cumulative << "\n";
+			text << value.name << "_sum " << value.sum << "\n";
+			text << value.name << "_count " << cumulative << "\n";
+		}
+		else
+		{
+			text << value.name << " " << value.value << "\n";
+		}
+	}
+	return text.str();
+}
+
+
+MetricsView::MetricsView() : mappedPage(NULL), mappedSize(0)
+{
+}
+
+MetricsView::~MetricsView()
+{
+	close();
+}
+
+bool MetricsView::open(const std::string &shmName)
+{
+	close();
+#ifdef _WIN32
+	return false;
+#else
+	int fd(shm_open(shmName.c_str(), O_RDONLY, 0));
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || static_cast<size_t> (info.st_size) < sizeof(MetricsPage))
+	{
+		::close(fd);
+		return false;
+	}
+	void *mapped(mmap(NULL, sizeof(MetricsPage), PROT_READ, MAP_SHARED, fd, 0));
+	::close(fd);
+	if (mapped == MAP_FAILED)
+	{
+		return false;
+	}
+	const MetricsPage *page_(static_cast<const MetricsPage*> (mapped));
+	bool valid(page_->magic == METRICS_MAGIC);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (!valid || page_->version != METRICS_VERSION || page_->pageSize != sizeof(MetricsPage))
+	{
+		munmap(mapped, sizeof(MetricsPage));
+		return false;
+	}
+	mappedPage = page_;
+	mappedSize = sizeof(MetricsPage);
+	return true;
+#endif
+}
+
+void MetricsView::close()
+{
+#ifndef _WIN32
+	if (mappedPage != NULL)
+	{
+		munmap(const_cast<MetricsPage*> (mappedPage), mappedSize);
+	}
+#endif
+	mappedPage = NULL;
+	mappedSize = 0;
+}
+
+const MetricsPage* MetricsView::page() const
+{
+	return mappedPage;
+}
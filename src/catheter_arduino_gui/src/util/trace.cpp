@@ -0,0 +1,206 @@
+#include "util/trace.h"
+
+#include <boost/thread/mutex.hpp>
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#ifdef _MSC_VER
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#ifdef _DEBUG
+   #ifndef DBG_NEW
+      #define DBG_NEW new ( _NORMAL_BLOCK , __FILE__ , __LINE__ )
+      #define new DBG_NEW
+   #endif
+#endif  // _DEBUG
+#endif  // __MSC_VER
+
+std::atomic<bool> traceActive(false);
+
+namespace
+{
+	// written by its own thread only, count is published with release so a
+	// dump sees whole events.
+	struct TraceBuffer
+	{
+		std::atomic<size_t> count;
+		std::atomic<uint64_t> dropped;
+		int threadIndex;
+		char name[TRACE_NAME_LEN];
+		TraceEvent events[TRACE_BUFFER_EVENTS];
+	};
+
+	boost::mutex traceMutex;
+
+	// the buffers are kept when their thread exits, so its events can still be written.
+	TraceBuffer *traceBuffers[TRACE_MAX_THREADS];
+	int traceBufferCount(0);
+
+	// events of threads past TRACE_MAX_THREADS.
+	std::atomic<uint64_t> untracedEvents(0);
+
+	thread_local TraceBuffer *threadBuffer(NULL);
+	thread_local bool threadUntraced(false);
+	thread_local char threadName[TRACE_NAME_LEN] = "";
+
+	TraceBuffer* attachThread()
+	{
+		boost::mutex::scoped_lock lock(traceMutex);
+		if (traceBufferCount == TRACE_MAX_THREADS)
+		{
+			threadUntraced = true;
+			return NULL;
+		}
+		TraceBuffer *buffer(new TraceBuffer);
+		buffer->count.store(0, std::memory_order_relaxed);
+		buffer->dropped.store(0, std::memory_order_relaxed);
+		buffer->threadIndex = traceBufferCount + 1;
+		strncpy(buffer->name, threadName, TRACE_NAME_LEN);
+		traceBuffers[traceBufferCount++] = buffer;
+		threadBuffer = buffer;
+		return buffer;
+	}
+
+	// the names are literals and ours, only quotes and backslashes need escaping.
+	void writeEscaped(FILE *file, const char *text)
+	{
+		for (; *text != '\0'; text++)
+		{
+			if (*text == '"' || *text == '\\')
+			{
+				fputc('\\', file);
+			}
+			fputc(*text, file);
+		}
+	}
+}
+
+void traceEnable(bool enable)
+{
+	traceActive.store(enable, std::memory_order_relaxed);
+}
+
+bool traceCompiledIn()
+{
+#ifdef CATHETER_TRACE
+	return true;
+#else
+	return false;
+#endif
+}
+
+void traceRecord(const char *name, char phase, uint64_t startNs, uint64_t durationNs, int64_t value)
+{
+	TraceBuffer *buffer(threadBuffer);
+	if (buffer == NULL)
+	{
+		buffer = threadUntraced ? NULL : attachThread();
+		if (buffer == NULL)
+		{
+			untracedEvents.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	}
+	size_t index(buffer->count.load(std::memory_order_relaxed));
+	if (index >= TRACE_BUFFER_EVENTS)
+	{
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	TraceEvent &event(buffer->events[index]);
+	event.name = name;
+	event.startNs = startNs;
+	event.durationNs = durationNs;
+	event.value = value;
+	event.phase = phase;
+	buffer->count.store(index + 1, std::memory_order_release);
+}
+
+void traceThreadName(const char *name)
+{
+	strncpy(threadName, name, TRACE_NAME_LEN - 1);
+	if (threadBuffer != NULL)
+	{
+		boost::mutex::scoped_lock lock(traceMutex);
+		strncpy(threadBuffer->name, threadName, TRACE_NAME_LEN);
+	}
+}
+
+void traceClear()
+{
+	boost::mutex::scoped_lock lock(traceMutex);
+	for (int i(0); i < traceBufferCount; i++)
+	{
+		traceBuffers[i]->count.store(0, std::memory_order_relaxed);
+		traceBuffers[i]->dropped.store(0, std::memory_order_relaxed);
+	}
+	untracedEvents.store(0, std::memory_order_relaxed);
+}
+
+uint64_t traceDropped()
+{
+	boost::mutex::scoped_lock lock(traceMutex);
+	uint64_t dropped(untracedEvents.load(std::memory_order_relaxed));
+	for (int i(0); i < traceBufferCount; i++)
+	{
+		dropped += traceBuffers[i]->dropped.load(std::memory_order_relaxed);
+	}
+	return dropped;
+}
+
+bool traceWriteJson(const std::string &fileName)
+{
+	FILE *file(fopen(fileName.c_str(), "w"));
+	if (file == NULL)
+	{
+		return false;
+	}
+	int pid(static_cast<int> (getpid()));
+	boost::mutex::scoped_lock lock(traceMutex);
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	bool first(true);
+	for (int i(0); i < traceBufferCount; i++)
+	{
+		const TraceBuffer &buffer(*traceBuffers[i]);
+		if (buffer.name[0] != '\0')
+		{
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"",
+				first ? "" : ",\n", pid, buffer.threadIndex);
+			writeEscaped(file, buffer.name);
+			fprintf(file, "\"}}");
+			first = false;
+		}
+		size_t count(buffer.count.load(std::memory_order_acquire));
+		for (size_t index(0); index < count; index++)
+		{
+			const TraceEvent &event(buffer.events[index]);
+			// chrome trace times are microseconds.
+			fprintf(file, "%s{\"name\":\"", first ? "" : ",\n");
+			writeEscaped(file, event.name);
+			fprintf(file, "\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d", event.phase, event.startNs * 1.0e-3,
+				pid, buffer.threadIndex);
+			if (event.phase == 'X')
+			{
+				fprintf(file, ",\"dur\":%.3f", event.durationNs * 1.0e-3);
+			}
+			else
+			{
+				fprintf(file, "%s,\"args\":{\"value\":%lld}", (event.phase == 'i') ? ",\"s\":\"t\"" : "",
+					static_cast<long long> (event.value));
+			}
+			fprintf(file, "}");
+			first = false;
+		}
+	}
+	fprintf(file, "\n]}\n");
+	return fclose(file) == 0;
+}
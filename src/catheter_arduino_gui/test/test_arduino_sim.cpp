@@ -0,0 +1,374 @@
+/*
+ * tests of the simulated arduino, alone and behind the serial thread.
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include "com/catheter_commands.h"
+#include "com/command_sequence.h"
+#include "com/pc_utils.h"
+#include "hardware/digital_analog_conversions.h"
+#include "ser/serial_thread.h"
+#include "ser/setpoint_mailbox.h"
+#include "sim/arduino_sim.h"
+#include "test_cmd_sets.h"
+
+/**
+ * \brief the firmware reply parses back to the commands sent, and bad packets are rejected.
+ */
+TEST(arduino_sim, testReply){
+
+	ArduinoChannelState channels[NCHANNELS];
+	uint8_t reply[SIM_MAX_REPLY_LEN];
+
+	CatheterChannelCmdSet cmdSet(milliAmpSet(4, -30.0));
+	std::vector<uint8_t> packet(encodeCommandSet(cmdSet, 5));
+	size_t replyLen(arduinoReply(packet.data(), packet.size(), channels, reply));
+	ASSERT_EQ(RESPONSE_LEN(4, false, 0), replyLen);
+
+	std::vector<uint8_t> replyBytes(reply, reply + replyLen);
+	std::vector<CatheterChannelCmd> parsed;
+	ASSERT_EQ(valid, parseBytes2Cmds(replyBytes, parsed));
+	ASSERT_EQ(4, parsed.size());
+	for (size_t i(0); i < parsed.size(); i++)
+	{
+		EXPECT_EQ(cmdSet.commandList[i].channel, parsed[i].channel);
+		EXPECT_EQ(cmdSet.commandList[i].dacCounts, parsed[i].dacCounts);
+		EXPECT_EQ(cmdSet.commandList[i].dir, parsed[i].dir);
+		EXPECT_EQ(cmdSet.commandList[i].dacCounts, channels[i].dacCounts);
+	}
+
+	// a global poll answers for every channel.
+	CatheterChannelCmdSet pollSet(pollCmd());
+	packet = encodeCommandSet(pollSet, 6);
+	replyLen = arduinoReply(packet.data(), packet.size(), channels, reply);
+	EXPECT_EQ(RESPONSE_LEN(1, true, 1), replyLen);
+
+	packet[1] ^= 1;
+	EXPECT_EQ(0, arduinoReply(packet.data(), packet.size(), channels, reply));
+}
+
+/**
+ * \brief a polled command leaves the channel alone, the polls appended after a set read back its setpoints.
+ */
+TEST(arduino_sim, testAppendPoll){
+
+	ArduinoChannelState channels[NCHANNELS];
+	uint8_t reply[SIM_MAX_REPLY_LEN];
+
+	CatheterChannelCmdSet polledSet(milliAmpSet(2, 100.0));
+	for (size_t i(0); i < polledSet.commandList.size(); i++)
+	{
+		polledSet.commandList[i].poll = true;
+	}
+	std::vector<uint8_t> packet(encodeCommandSet(polledSet, 1));
+	ASSERT_LT(0, arduinoReply(packet.data(), packet.size(), channels, reply));
+	EXPECT_EQ(0, channels[0].dacCounts);
+
+	CatheterChannelCmdSet cmdSet(milliAmpSet(2, 100.0));
+	appendPollCmds(cmdSet);
+	ASSERT_EQ(4, cmdSet.commandList.size());
+	packet = encodeCommandSet(cmdSet, 2);
+	size_t replyLen(arduinoReply(packet.data(), packet.size(), channels, reply));
+	ASSERT_EQ(RESPONSE_LEN(4, false, 2), replyLen);
+	EXPECT_EQ(1280, channels[0].dacCounts);
+	EXPECT_EQ(2560, channels[1].dacCounts);
+
+	std::vector<uint8_t> replyBytes(reply, reply + replyLen);
+	std::vector<CatheterChannelCmd> parsed;
+	ASSERT_EQ(valid, parseBytes2Cmds(replyBytes, parsed));
+	ASSERT_EQ(4, parsed.size());
+	EXPECT_TRUE(parsed[2].poll);
+	EXPECT_EQ(1280, parsed[2].dacCounts);
+	EXPECT_EQ(2560, parsed[3].dacCounts);
+	EXPECT_LT(0, parsed[2].adcCounts);
+
+	// a set writing the global channel gets one global poll.
+	CatheterChannelCmdSet globalSet(milliAmpSet(1, 10.0));
+	globalSet.commandList[0].channel = GLOBAL_ADDR;
+	appendPollCmds(globalSet);
+	ASSERT_EQ(2, globalSet.commandList.size());
+	EXPECT_EQ(GLOBAL_ADDR, globalSet.commandList[1].channel);
+	EXPECT_TRUE(globalSet.commandList[1].poll);
+
+	// copies that would not fit in a packet become one global poll, a full set is left alone.
+	CatheterChannelCmdSet wideSet(milliAmpSet(NCHANNELS, 10.0));
+	CatheterChannelCmdSet moreSet(milliAmpSet(NCHANNELS, 20.0));
+	wideSet.commandList.insert(wideSet.commandList.end(), moreSet.commandList.begin(), moreSet.commandList.end());
+	appendPollCmds(wideSet);
+	ASSERT_EQ(2 * NCHANNELS + 1, wideSet.commandList.size());
+	EXPECT_EQ(GLOBAL_ADDR, wideSet.commandList.back().channel);
+	EXPECT_TRUE(wideSet.commandList.back().poll);
+	packet = encodeCommandSet(wideSet, 3);
+	EXPECT_LT(0, arduinoReply(packet.data(), packet.size(), channels, reply));
+
+	while (wideSet.commandList.size() < PCK_MAX_CMDS)
+	{
+		wideSet.commandList.push_back(moreSet.commandList[0]);
+	}
+	appendPollCmds(wideSet);
+	EXPECT_EQ(PCK_MAX_CMDS, wideSet.commandList.size());
+}
+
+/**
+ * \brief a polled current matrix drives the channels and reads them back.
+ */
+TEST(arduino_sim, testPolledCurrentMatrix){
+
+	ArduinoChannelState channels[NCHANNELS];
+	uint8_t reply[SIM_MAX_REPLY_LEN];
+
+	const double milliAmp[4] = {100.0, -50.0, 20.0, 0.0};
+	const double delayMS(5.0);
+	CatheterCmdSequence cmdSequence;
+	ASSERT_EQ(0, currentMatrix2Sequence(milliAmp, 2, 2, &delayMS, 1, true, cmdSequence));
+
+	std::vector<uint8_t> bytes(encodedLength(cmdSequence));
+	std::vector<uint32_t> offsets(cmdSequence.size() + 1);
+	encodeSequence(cmdSequence, 0, bytes.data(), offsets.data());
+	size_t replyLen(arduinoReply(bytes.data(), offsets[1], channels, reply));
+	ASSERT_EQ(RESPONSE_LEN(4, false, 2), replyLen);
+	EXPECT_EQ(1280, channels[0].dacCounts);
+	EXPECT_TRUE(channels[0].dir);
+	EXPECT_EQ(640, channels[1].dacCounts);
+	EXPECT_FALSE(channels[1].dir);
+
+	std::vector<uint8_t> replyBytes(reply, reply + replyLen);
+	std::vector<CatheterChannelCmd> parsed;
+	ASSERT_EQ(valid, parseBytes2Cmds(replyBytes, parsed));
+	ASSERT_EQ(4, parsed.size());
+	EXPECT_TRUE(parsed[2].poll);
+	EXPECT_EQ(1280, parsed[2].dacCounts);
+
+	ASSERT_LT(0, arduinoReply(bytes.data() + offsets[1], offsets[2] - offsets[1], channels, reply));
+	EXPECT_EQ(256, channels[0].dacCounts);
+	EXPECT_EQ(0, channels[1].dacCounts);
+}
+
+/**
+ * \brief a polled mailbox update is applied by the firmware, not only polled.
+ */
+TEST(arduino_sim, testPolledMailboxUpdate){
+
+	ArduinoChannelState channels[NCHANNELS];
+	uint8_t reply[SIM_MAX_REPLY_LEN];
+
+	SetpointMailbox mailbox;
+	double milliAmp[2] = {100.0, -50.0};
+	mailbox.write(milliAmp, 2, true);
+	MailboxSetpoints setpoints;
+	mailbox.read(setpoints);
+	MailboxChannelState sent[NCHANNELS];
+	CatheterChannelCmdSet cmdSet;
+	ASSERT_EQ(2 * NCHANNELS, mailboxChangedCommands(setpoints, sent, cmdSet));
+
+	std::vector<uint8_t> packet(encodeCommandSet(cmdSet, 3));
+	ASSERT_EQ(RESPONSE_LEN(2 * NCHANNELS, false, NCHANNELS), arduinoReply(packet.data(), packet.size(), channels, reply));
+	EXPECT_EQ(1280, channels[0].dacCounts);
+	EXPECT_EQ(640, channels[1].dacCounts);
+	EXPECT_FALSE(channels[1].dir);
+}
+
+/**
+ * \brief every set played through the serial thread is answered over the pseudo terminal.
+ */
+TEST(arduino_sim, testSerialThreadLink){
+
+	ArduinoSimOptions options;
+	options.processingUs = 100.0;
+	ArduinoSim sim(options);
+	ASSERT_TRUE(sim.start());
+
+	SpscRing<CurrentSample> ring(4096);
+	SerialThreadObject serialObject;
+	serialObject.setSampleRing(&ring);
+	ASSERT_TRUE(serialObject.connectPort(sim.portName()));
+
+	std::vector<CatheterChannelCmdSet> sets;
+	for (int i(0); i < 50; i++)
+	{
+		sets.push_back(milliAmpSet(NCHANNELS, (i % 2) ? 40.0 : -40.0));
+	}
+	serialObject.queueCommands(sets);
+
+	PlaybackStats stats;
+	for (int waited(0); waited < 2000; waited++)
+	{
+		serialObject.getStats(stats);
+		if (stats.repliesValid == sets.size())
+		{
+			break;
+		}
+		boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+	}
+	EXPECT_EQ(sets.size(), stats.setsSent);
+	EXPECT_EQ(sets.size(), stats.repliesValid);
+	EXPECT_EQ(0, stats.repliesInvalid);
+	EXPECT_EQ(sets.size(), stats.repliesMatched);
+	EXPECT_EQ(0, stats.echoMismatches);
+	EXPECT_EQ(0, stats.replyTimeouts);
+	EXPECT_EQ(sets.size(), stats.rttUs.size());
+	EXPECT_GT(rttPercentile(stats, 0.5), 0.0);
+	serialObject.setSampleRing(NULL);
+	EXPECT_EQ(sets.size() * NCHANNELS, ring.size());
+
+	ArduinoSimStats simStats;
+	sim.getStats(simStats);
+	EXPECT_EQ(sets.size(), simStats.packetsIn);
+	EXPECT_EQ(0, simStats.packetsRejected);
+}
+
+/**
+ * \brief a reset goes out at once, it does not wait for the delay of the set before it.
+ */
+TEST(arduino_sim, testResetSkipsDelay){
+
+	ArduinoSim sim;
+	ASSERT_TRUE(sim.start());
+
+	SerialThreadObject serialObject;
+	ASSERT_TRUE(serialObject.connectPort(sim.portName()));
+
+	std::vector<CatheterChannelCmdSet> sets(2, milliAmpSet(NCHANNELS, 40.0));
+	sets[0].delayTime = 5000;
+	serialObject.queueCommands(sets);
+	PlaybackStats stats;
+	for (int waited(0); waited < 2000 && stats.setsSent == 0; waited++)
+	{
+		boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+		serialObject.getStats(stats);
+	}
+	ASSERT_EQ(1, stats.setsSent);
+
+	// returns once the reset is written, the second set is dropped.
+	serialObject.serialCommand(SerialThreadObject::resetArduino);
+	serialObject.getStats(stats);
+	EXPECT_EQ(2, stats.setsSent);
+	EXPECT_EQ(0, serialObject.queuedSets());
+}
+
+/**
+ * \brief a mailbox packet whose reply is lost is sent again, its channels are not taken as set.
+ */
+TEST(arduino_sim, testMailboxLostReply){
+
+	ArduinoSimOptions options;
+	options.dropReply = 2;
+	ArduinoSim sim(options);
+	ASSERT_TRUE(sim.start());
+
+	SetpointMailbox mailbox;
+	SerialThreadObject serialObject;
+	ASSERT_TRUE(serialObject.connectPort(sim.portName()));
+	serialObject.setMailbox(&mailbox);
+
+	double milliAmp[NCHANNELS] = {10.0, 20.0, 30.0, 40.0, 50.0, 60.0};
+	PlaybackStats stats;
+	for (int write(0); write < 2; write++)
+	{
+		milliAmp[0] += write;
+		mailbox.write(milliAmp, NCHANNELS);
+		for (int waited(0); waited < 100 && stats.mailboxSends <= static_cast<uint64_t> (write); waited++)
+		{
+			boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+			serialObject.getStats(stats);
+		}
+	}
+	ASSERT_EQ(2, stats.mailboxSends);
+
+	// the second reply is dropped: the packet expires and the same setpoints go out again.
+	for (int waited(0); waited < 2 * REPLY_TIMEOUT_MS && stats.repliesMatched < 2; waited++)
+	{
+		boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+		serialObject.getStats(stats);
+	}
+	serialObject.setMailbox(NULL);
+	EXPECT_EQ(3, stats.mailboxSends);
+	EXPECT_EQ(2, stats.repliesMatched);
+	EXPECT_EQ(1, stats.replyTimeouts);
+}
+
+/**
+ * \brief a producer writing much faster than the link leaves no backlog: the writes it outran
+ * are superseded, every mailbox packet is acked and the board ends at the last setpoints.
+ */
+TEST(arduino_sim, testMailbox){
+
+	ArduinoSimOptions options;
+	options.processingUs = 500.0;
+	ArduinoSim sim(options);
+	ASSERT_TRUE(sim.start());
+
+	SpscRing<CurrentSample> ring(65536);
+	SetpointMailbox mailbox;
+	SerialThreadObject serialObject;
+	serialObject.setSampleRing(&ring);
+	ASSERT_TRUE(serialObject.connectPort(sim.portName()));
+	serialObject.setMailbox(&mailbox);
+
+	const int writes(2000);
+	double milliAmp[NCHANNELS];
+	for (int write(0); write < writes; write++)
+	{
+		for (int channel(0); channel < NCHANNELS; channel++)
+		{
+			milliAmp[channel] = ((write + channel) % 40) * 2.0 - 40.0;
+		}
+		mailbox.write(milliAmp, NCHANNELS);
+		boost::this_thread::sleep(boost::posix_time::microseconds(20));
+	}
+
+	PlaybackStats stats;
+	for (int waited(0); waited < 1000; waited++)
+	{
+		serialObject.getStats(stats);
+		if (stats.mailboxSends > 0 && stats.repliesMatched == stats.mailboxSends)
+		{
+			break;
+		}
+		boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+	}
+	serialObject.setMailbox(NULL);
+	EXPECT_GT(stats.mailboxSends, 0);
+	EXPECT_LT(stats.mailboxSends, writes);
+	EXPECT_GT(stats.mailboxSuperseded, 0);
+	// reads that found the setpoints unchanged send nothing.
+	EXPECT_LE(stats.mailboxSends + stats.mailboxSuperseded, writes);
+	EXPECT_EQ(stats.mailboxSends, stats.repliesMatched);
+	EXPECT_EQ(0, stats.echoMismatches);
+	EXPECT_EQ(stats.mailboxSends, stats.stalenessUs.size());
+	EXPECT_EQ(0, stats.setsSent);
+	// at most a packet in flight, so a setpoint is never older than a few round trips.
+	EXPECT_LT(stalenessPercentile(stats, 0.5), 4 * REPLY_TIMEOUT_MS * 1.0e3);
+
+	// the channels the firmware echoes to a global poll are the last written.
+	CurrentSample sample;
+	while (ring.pop(sample))
+	{
+	}
+	serialObject.serialCommand(SerialThreadObject::poll);
+	std::vector<CurrentSample> polled;
+	for (int waited(0); polled.size() < NCHANNELS && waited < 1000; waited++)
+	{
+		while (ring.pop(sample))
+		{
+			polled.push_back(sample);
+		}
+		boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+	}
+	serialObject.setSampleRing(NULL);
+	ASSERT_EQ(NCHANNELS, polled.size());
+	for (int index(0); index < NCHANNELS; index++)
+	{
+		CatheterChannelCmd expected;
+		expected.channel = polled[index].channel;
+		setCmdMilliAmp(expected, milliAmp[polled[index].channel - 1]);
+		EXPECT_EQ(expected.dacCounts, polled[index].dacCounts);
+		EXPECT_EQ(expected.dir, polled[index].dir);
+	}
+}
+
+int main(int argc, char** argv){
+	testing::InitGoogleTest(&argc,argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,160 @@
+/*
+ * tests of the asynchronous log.
+ */
+
+#include <cstdio>
+#include <string>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <gtest/gtest.h>
+#include "util/async_log.h"
+#include "util/console_log.h"
+
+namespace
+{
+	template <typename... Args>
+	std::string formatted(const char *format, const Args&... args)
+	{
+		static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+		LogRecord record;
+		record.format = format;
+		record.nArgs = 0;
+		record.textUsed = 0;
+		logDetail::captureArgs(record, args...);
+		char out[LOG_LINE_LEN_MAX];
+		size_t length(logFormat(record, out, sizeof(out)));
+		EXPECT_EQ(strlen(out), length);
+		return out;
+	}
+
+	void logLines(ConsoleLog *console, int thread, int count)
+	{
+		for (int index(0); index < count; index++)
+		{
+			logToConsole(console, logInfo, "thread %d line %d", thread, index);
+		}
+	}
+
+	std::string readFile(const std::string &fileName)
+	{
+		std::string text;
+		FILE *file(fopen(fileName.c_str(), "r"));
+		if (file == NULL)
+		{
+			return text;
+		}
+		char buffer[256];
+		size_t count;
+		while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		{
+			text.append(buffer, count);
+		}
+		fclose(file);
+		return text;
+	}
+}
+
+/**
+ * \brief the captured arguments are formatted printf style.
+ */
+TEST(async_log, testFormat){
+
+	EXPECT_EQ("plain 100%", formatted("plain 100%%"));
+	EXPECT_EQ("-3 7 ff 2.50", formatted("%d %u %x %.2f", -3, 7u, 255, 2.5));
+	EXPECT_EQ("x", formatted("%c", 'x'));
+	EXPECT_EQ("[   42] [1.5e+00]", formatted("[%5ld] [%.1e]", 42L, 1.5));
+	EXPECT_EQ("18446744073709551615", formatted("%llu", 18446744073709551615ULL));
+	std::string port("/dev/ttyACM0");
+	EXPECT_EQ("port /dev/ttyACM0: open failed", formatted("port %s: %s", port, "open failed"));
+	// the arguments are converted to what the format asks for.
+	EXPECT_EQ("3 2.000000", formatted("%d %f", 3.7, 2));
+	EXPECT_EQ("1 (missing)", formatted("%d %d", 1));
+	EXPECT_EQ("(not text)", formatted("%s", 5));
+
+	// long strings are cut to the record text.
+	std::string longText(200, 'a');
+	std::string out(formatted("%s|%s", longText, "b"));
+	EXPECT_EQ(LOG_TEXT_LEN - 1 + 1, out.size());
+	EXPECT_EQ('|', out[LOG_TEXT_LEN - 1]);
+}
+
+/**
+ * \brief records reach their console in order, flush waits for them.
+ */
+TEST(async_log, testConsole){
+
+	ConsoleLog console;
+	logToConsole(&console, logWarning, "warning %d", 1);
+	logToConsole(&console, logDebug, "not recorded");
+	logToConsole(&console, logInfo, "info %s", "two");
+	logFlush();
+	ASSERT_EQ(2, console.endSeq());
+	ConsoleLine line;
+	ASSERT_TRUE(console.getLine(0, line));
+	EXPECT_STREQ("warning 1", line.text);
+	EXPECT_EQ(logWarning, line.severity);
+	ASSERT_TRUE(console.getLine(1, line));
+	EXPECT_STREQ("info two", line.text);
+
+	logSetLevel(logDebug);
+	logToConsole(&console, logDebug, "debug");
+	logFlush();
+	logSetLevel(logInfo);
+	EXPECT_EQ(3, console.endSeq());
+}
+
+/**
+ * \brief every thread's records arrive, each thread's in order.
+ */
+TEST(async_log, testThreads){
+
+	ConsoleLog console(8192);
+	const int threads(4);
+	const int lines(500);
+	boost::thread_group writers;
+	for (int thread(0); thread < threads; thread++)
+	{
+		writers.create_thread(boost::bind(&logLines, &console, thread, lines));
+	}
+	writers.join_all();
+	logFlush();
+	uint64_t dropped(logDropped());
+	EXPECT_EQ(threads * lines, console.endSeq() + dropped);
+
+	int next[threads] = { 0 };
+	size_t outOfOrder(0);
+	ConsoleLine line;
+	for (uint64_t seq(0); seq < console.endSeq(); seq++)
+	{
+		ASSERT_TRUE(console.getLine(seq, line));
+		int thread(-1), index(-1);
+		ASSERT_EQ(2, sscanf(line.text, "thread %d line %d", &thread, &index));
+		ASSERT_TRUE(thread >= 0 && thread < threads);
+		outOfOrder += (index < next[thread]) ? 1 : 0;
+		next[thread] = index + 1;
+	}
+	EXPECT_EQ(0, outOfOrder);
+}
+
+/**
+ * \brief the log file gets every record with its time and severity.
+ */
+TEST(async_log, testFile){
+
+	std::string fileName("test_async_log.local.log");
+	remove(fileName.c_str());
+	ASSERT_TRUE(logOpenFile(fileName));
+	logSetStdout(false);
+	logMessage(logError, "port %s failed (%d)", "COM3", 5);
+	logFlush();
+	logOpenFile("");
+	logSetStdout(true);
+	std::string text(readFile(fileName));
+	EXPECT_NE(std::string::npos, text.find(" error   port COM3 failed (5)\n"));
+	remove(fileName.c_str());
+}
+
+int main(int argc, char** argv){
+	testing::InitGoogleTest(&argc,argv);
+	return RUN_ALL_TESTS();
+}
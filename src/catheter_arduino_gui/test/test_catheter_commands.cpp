@@ -0,0 +1,306 @@
+/*
+ * tests of the command packet encoding and reply parsing.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <gtest/gtest.h>
+#include "com/catheter_commands.h"
+#include "com/command_sequence.h"
+#include "hardware/digital_analog_conversions.h"
+
+/**
+ * \brief builds the reply the arduino sends back for a (non polling) packet.
+ */
+std::vector<uint8_t> echoPacket(const CatheterChannelCmdSet& cmds, int pseqnum)
+{
+	std::vector<uint8_t> reply;
+	reply.push_back(128 + 64 + (pseqnum & 15));
+	reply.push_back(cmds.commandList.size() << 4);
+	for (size_t i(0); i < cmds.commandList.size(); i++)
+	{
+		const CatheterChannelCmd &cmd(cmds.commandList[i]);
+		uint8_t cmdVal((1 << UPD_BIT) | (cmd.enable << ENA_BIT) | (cmd.dir << DIR_BIT));
+		reply.push_back((cmd.channel << 4) | cmdVal);
+		reply.push_back((cmd.dacCounts >> 6) & 63);
+		reply.push_back(cmd.dacCounts & 63);
+	}
+	reply.push_back(fletcher8(reply.size(), reply.data()));
+	return reply;
+}
+
+/**
+ * \brief the in place encoder matches the piecewise encoding.
+ */
+TEST(catheter_commands, testEncodeCommandSet){
+
+	resetChannelCalibration();
+
+	CatheterChannelCmdSet cmdSet;
+	for (int channel(1); channel <= NCHANNELS; channel++)
+	{
+		CatheterChannelCmd cmd;
+		cmd.channel = channel;
+		setCmdMilliAmp(cmd, 37.5 * (channel - 3));
+		cmdSet.commandList.push_back(cmd);
+	}
+
+	for (int pseqnum(0); pseqnum < 8; pseqnum++)
+	{
+		std::vector<uint8_t> expected(encodePreamble(pseqnum, cmdSet.commandList.size()));
+		for (size_t i(0); i < cmdSet.commandList.size(); i++)
+		{
+			std::vector<uint8_t> single(encodeSingleCommand(cmdSet.commandList[i]));
+			expected.insert(expected.end(), single.begin(), single.end());
+		}
+		std::vector<uint8_t> post(encodePostamble(pseqnum));
+		expected.insert(expected.end(), post.begin(), post.end());
+		expected.push_back(fletcher8(expected.size(), expected.data()));
+
+		std::vector<uint8_t> encoded(encodeCommandSet(cmdSet, pseqnum));
+		ASSERT_EQ(PCK_LEN(NCHANNELS), encoded.size());
+		ASSERT_TRUE(expected == encoded);
+	}
+}
+
+/**
+ * \brief the integer path round trips exactly and matches the old milliAmp path.
+ */
+TEST(catheter_commands, testRoundTrip){
+
+	resetChannelCalibration();
+
+	int pseqnum(0);
+	for (double mA(-320.0); mA <= 320.0; mA += 0.173)
+	{
+		CatheterChannelCmdSet cmdSet;
+		for (int channel(1); channel <= NCHANNELS; channel++)
+		{
+			CatheterChannelCmd cmd;
+			cmd.channel = channel;
+			setCmdMilliAmp(cmd, mA);
+			cmdSet.commandList.push_back(cmd);
+		}
+		std::vector<uint8_t> encoded(encodeCommandSet(cmdSet, pseqnum));
+		std::vector<uint8_t> reply(echoPacket(cmdSet, pseqnum));
+		pseqnum = (pseqnum + 1) & 7;
+
+		std::vector<CatheterChannelCmd> parsed;
+		ASSERT_EQ(valid, parseBytes2Cmds(reply, parsed));
+		ASSERT_EQ(cmdSet.commandList.size(), parsed.size());
+		ASSERT_TRUE(reply.empty());
+
+		dir_t dir((mA > 0.0) ? DIR_POS : DIR_NEG);
+		for (size_t i(0); i < parsed.size(); i++)
+		{
+			ASSERT_EQ(cmdSet.commandList[i].channel, parsed[i].channel);
+			ASSERT_EQ(cmdSet.commandList[i].dacCounts, parsed[i].dacCounts);
+			ASSERT_EQ(dir, parsed[i].dir);
+
+			// the double path: mA -> DAC -> mA
+			double legacyMilliAmp(dac2MilliAmp(milliAmp2Dac(mA, parsed[i].channel), dir, parsed[i].channel));
+			ASSERT_DOUBLE_EQ(legacyMilliAmp, cmdMilliAmp(parsed[i]));
+			if (std::fabs(mA) < 319.0)
+			{
+				ASSERT_NEAR(mA, cmdMilliAmp(parsed[i]), 1.0 / 12.8 + 1e-9);
+			}
+		}
+	}
+}
+
+/**
+ * \brief a corrupted reply is rejected.
+ */
+TEST(catheter_commands, testBadChecksum){
+
+	CatheterChannelCmdSet cmdSet;
+	CatheterChannelCmd cmd;
+	cmd.channel = 2;
+	setCmdMilliAmp(cmd, 50.0);
+	cmdSet.commandList.push_back(cmd);
+
+	std::vector<uint8_t> reply(echoPacket(cmdSet, 3));
+	reply[3] ^= 1;
+	std::vector<CatheterChannelCmd> parsed;
+	EXPECT_EQ(invalid, parseBytes2Cmds(reply, parsed));
+	EXPECT_TRUE(parsed.empty());
+}
+
+/**
+ * \brief back to back replies decode from one buffer, garbage and bad packets are skipped.
+ */
+TEST(catheter_commands, testDecodeReplyStream){
+
+	std::vector<uint8_t> stream;
+	for (int pseqnum(0); pseqnum < 3; pseqnum++)
+	{
+		CatheterChannelCmdSet cmdSet;
+		for (int channel(1); channel <= 2; channel++)
+		{
+			CatheterChannelCmd cmd;
+			cmd.channel = channel;
+			setCmdMilliAmp(cmd, 20.0 * (pseqnum + channel));
+			cmdSet.commandList.push_back(cmd);
+		}
+		std::vector<uint8_t> reply(echoPacket(cmdSet, pseqnum));
+		if (pseqnum == 1)
+		{
+			// a bad checksum and some line noise before the packet.
+			reply[3] ^= 1;
+			stream.push_back(0x0a);
+		}
+		stream.insert(stream.end(), reply.begin(), reply.end());
+	}
+	// the head of a fourth packet.
+	stream.push_back(stream[0]);
+	stream.push_back(stream[1]);
+
+	std::vector<CatheterChannelCmd> cmds;
+	std::vector<uint32_t> packetIndex;
+	size_t skipped(0);
+	size_t consumed(decodeReplyStream(stream.data(), stream.size(), cmds, packetIndex, skipped));
+	EXPECT_EQ(stream.size() - 2, consumed);
+	EXPECT_EQ(1 + PCK_LEN(2), skipped);
+	ASSERT_EQ(4, cmds.size());
+	ASSERT_EQ(4, packetIndex.size());
+	EXPECT_EQ(1, packetIndex[2]);
+	EXPECT_EQ(2, cmds[3].channel);
+	EXPECT_EQ(milliAmp2Dac(20.0 * 4, 2), cmds[3].dacCounts);
+}
+
+/**
+ * \brief a command packet decodes back to what was encoded, a damaged or cut packet does not.
+ */
+TEST(catheter_commands, testDecodeCommandPacket){
+
+	CatheterChannelCmdSet cmdSet;
+	for (int channel(0); channel <= 3; channel++)
+	{
+		CatheterChannelCmd cmd;
+		cmd.channel = channel;
+		cmd.poll = (channel == 2);
+		cmd.enable = (channel != 3);
+		cmd.dir = (channel % 2) ? DIR_POS : DIR_NEG;
+		cmd.dacCounts = static_cast<uint16_t> (1000 * channel + 7);
+		cmdSet.commandList.push_back(cmd);
+	}
+	std::vector<uint8_t> packet(encodeCommandSet(cmdSet, 5));
+
+	CatheterChannelCmdSet decoded;
+	int pseqnum(-1);
+	ASSERT_EQ(packet.size(), decodeCommandPacket(packet.data(), packet.size(), decoded, pseqnum));
+	EXPECT_EQ(5, pseqnum);
+	ASSERT_EQ(cmdSet.commandList.size(), decoded.commandList.size());
+	for (size_t index(0); index < cmdSet.commandList.size(); index++)
+	{
+		EXPECT_EQ(cmdSet.commandList[index].channel, decoded.commandList[index].channel);
+		EXPECT_EQ(cmdSet.commandList[index].poll, decoded.commandList[index].poll);
+		EXPECT_EQ(cmdSet.commandList[index].enable, decoded.commandList[index].enable);
+		EXPECT_EQ(cmdSet.commandList[index].dir, decoded.commandList[index].dir);
+		EXPECT_EQ(cmdSet.commandList[index].dacCounts, decoded.commandList[index].dacCounts);
+	}
+	EXPECT_EQ(packet, encodeCommandSet(decoded, pseqnum));
+
+	// trailing bytes are left alone.
+	std::vector<uint8_t> longer(packet);
+	longer.push_back(0xff);
+	EXPECT_EQ(packet.size(), decodeCommandPacket(longer.data(), longer.size(), decoded, pseqnum));
+
+	EXPECT_EQ(0, decodeCommandPacket(packet.data(), packet.size() - 1, decoded, pseqnum));
+	packet[2] ^= 1;
+	EXPECT_EQ(0, decodeCommandPacket(packet.data(), packet.size(), decoded, pseqnum));
+}
+
+/**
+ * \brief the packed commands keep every field and encode to the same bytes.
+ */
+TEST(catheter_commands, testPackedSequence){
+
+	resetChannelCalibration();
+
+	std::vector<CatheterChannelCmdSet> cmdVect;
+	for (int setIndex(0); setIndex < 50; setIndex++)
+	{
+		CatheterChannelCmdSet cmdSet;
+		for (int channel(setIndex % 2); channel <= NCHANNELS; channel += 1 + (setIndex % 3))
+		{
+			CatheterChannelCmd cmd;
+			cmd.channel = channel;
+			cmd.poll = (setIndex % 5) == 0;
+			cmd.enable = (setIndex % 7) != 0;
+			cmd.adcCounts = (setIndex * 97) % ADC_RES;
+			setCmdMilliAmp(cmd, 6.1 * setIndex - 150.0);
+			cmdSet.commandList.push_back(cmd);
+		}
+		cmdSet.delayTime = setIndex;
+		cmdVect.push_back(cmdSet);
+	}
+
+	CatheterCmdSequence cmdSequence;
+	cmdSequence.assign(cmdVect);
+	ASSERT_EQ(cmdVect.size(), cmdSequence.size());
+	EXPECT_EQ(4, sizeof(PackedChannelCmd));
+
+	uint8_t bytes[PCK_LEN(15)];
+	for (size_t i(0); i < cmdVect.size(); i++)
+	{
+		CatheterChannelCmdSet unpacked(cmdSequence.getSet(i));
+		ASSERT_EQ(cmdVect[i].delayTime, unpacked.delayTime);
+		ASSERT_EQ(cmdVect[i].commandList.size(), unpacked.commandList.size());
+		for (size_t j(0); j < unpacked.commandList.size(); j++)
+		{
+			const CatheterChannelCmd &a(cmdVect[i].commandList[j]), &b(unpacked.commandList[j]);
+			ASSERT_EQ(a.channel, b.channel);
+			ASSERT_EQ(a.poll, b.poll);
+			ASSERT_EQ(a.enable, b.enable);
+			ASSERT_EQ(a.dir, b.dir);
+			ASSERT_EQ(a.dacCounts, b.dacCounts);
+			ASSERT_EQ(a.adcCounts, b.adcCounts);
+		}
+
+		std::vector<uint8_t> expected(encodeCommandSet(cmdVect[i], i));
+		int len(encodeCommandSet(cmdSequence[i], i, bytes));
+		ASSERT_EQ(expected.size(), len);
+		ASSERT_TRUE(std::equal(expected.begin(), expected.end(), bytes));
+	}
+
+	// appending batches gives the same sequence, the pending commands of a batch are left out.
+	CatheterCmdSequence appended, batch;
+	for (size_t i(0); i < cmdVect.size(); i++)
+	{
+		batch.push_back(cmdVect[i]);
+		if (batch.size() == 7 || i + 1 == cmdVect.size())
+		{
+			batch.addCommand(cmdVect[0].commandList[0]);
+			appended.append(batch);
+			batch.clear();
+		}
+	}
+	ASSERT_EQ(cmdSequence.size(), appended.size());
+	EXPECT_EQ(cmdSequence.commandCount(), appended.commandCount());
+	for (size_t i(0); i < cmdVect.size(); i++)
+	{
+		ASSERT_EQ(cmdSequence[i].size(), appended[i].size());
+		EXPECT_EQ(cmdSequence[i].delayTime, appended[i].delayTime);
+		for (size_t j(0); j < cmdSequence[i].size(); j++)
+		{
+			EXPECT_EQ(cmdSequence[i][j].bits, appended[i][j].bits);
+			EXPECT_EQ(cmdSequence[i].milliAmp(j), appended[i].milliAmp(j));
+		}
+	}
+
+	batch.swap(appended);
+	EXPECT_TRUE(appended.empty());
+	EXPECT_EQ(cmdVect.size(), batch.size());
+
+	cmdSequence.clear();
+	EXPECT_TRUE(cmdSequence.empty());
+	EXPECT_EQ(0, cmdSequence.commandCount());
+}
+
+
+ int main(int argc, char** argv){
+ 	testing::InitGoogleTest(&argc,argv);
+ 	return RUN_ALL_TESTS();
+ }
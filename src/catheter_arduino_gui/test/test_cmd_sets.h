@@ -0,0 +1,70 @@
+/*
+ * command sets shared by the tests.
+ */
+
+#pragma once
+#ifndef CATHETER_TEST_CMD_SETS_H
+#define CATHETER_TEST_CMD_SETS_H
+
+#include <cstdint>
+#include <initializer_list>
+#include "com/catheter_commands.h"
+#include "hardware/digital_analog_conversions.h"
+
+/**
+ * \brief a set of the given commands.
+ */
+inline CatheterChannelCmdSet cmdSetOf(long delayTime, std::initializer_list<CatheterChannelCmd> cmds)
+{
+	CatheterChannelCmdSet cmdSet;
+	cmdSet.commandList.assign(cmds.begin(), cmds.end());
+	cmdSet.delayTime = delayTime;
+	return cmdSet;
+}
+
+/**
+ * \brief a set of one default command on channel (a poll if poll).
+ */
+inline CatheterChannelCmdSet channelSet(long delayTime, int channel, bool poll = false)
+{
+	CatheterChannelCmd cmd;
+	cmd.channel = channel;
+	cmd.poll = poll;
+	return cmdSetOf(delayTime, { cmd });
+}
+
+/**
+ * \brief channels 1..nChannels at milliAmp times the channel, 1 ms delay.
+ */
+inline CatheterChannelCmdSet milliAmpSet(int nChannels, double milliAmp)
+{
+	CatheterChannelCmdSet cmdSet;
+	for (int channel(1); channel <= nChannels; channel++)
+	{
+		CatheterChannelCmd cmd;
+		cmd.channel = channel;
+		setCmdMilliAmp(cmd, milliAmp * channel);
+		cmdSet.commandList.push_back(cmd);
+	}
+	cmdSet.delayTime = 1;
+	return cmdSet;
+}
+
+/**
+ * \brief channels 1..nChannels at dacCounts plus the channel, 1 ms delay.
+ */
+inline CatheterChannelCmdSet dacCountsSet(int nChannels, uint16_t dacCounts)
+{
+	CatheterChannelCmdSet cmdSet;
+	for (int channel(1); channel <= nChannels; channel++)
+	{
+		CatheterChannelCmd cmd;
+		cmd.channel = channel;
+		cmd.dacCounts = static_cast<uint16_t> (dacCounts + channel);
+		cmdSet.commandList.push_back(cmd);
+	}
+	cmdSet.delayTime = 1;
+	return cmdSet;
+}
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * tests of the typed command grid model.
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include "com/catheter_commands.h"
+#include "com/command_sequence.h"
+#include "gui/command_grid_model.h"
+#include "hardware/digital_analog_conversions.h"
+
+/**
+ * \brief commands survive a round trip through the grid.
+ */
+TEST(command_grid_model, testRoundTrip){
+
+	resetChannelCalibration();
+
+	std::vector<CatheterChannelCmdSet> cmdVect(2);
+	for (int channel(1); channel <= 3; channel++)
+	{
+		CatheterChannelCmd cmd;
+		cmd.channel = channel;
+		setCmdMilliAmp(cmd, channel * -25.0);
+		cmdVect[channel == 3].commandList.push_back(cmd);
+	}
+	cmdVect[0].delayTime = 10;
+	cmdVect[1].delayTime = 20;
+
+	CommandGridModel model;
+	model.setCommands(cmdVect);
+	EXPECT_EQ(3, model.commandCount());
+	EXPECT_EQ(4, model.rowCount());
+	EXPECT_EQ("0", model.cellText(0, DELAY_COL));
+	EXPECT_EQ("10", model.cellText(1, DELAY_COL));
+	EXPECT_EQ("-50.000", model.cellText(1, CURRENT_COL));
+	EXPECT_EQ("neg", model.cellText(1, DIRECTION_COL));
+	EXPECT_EQ("", model.cellText(3, CHANNEL_COL));
+
+	std::vector<CatheterChannelCmdSet> result;
+	model.getCommands(result);
+	ASSERT_EQ(2, result.size());
+	ASSERT_EQ(2, result[0].commandList.size());
+	EXPECT_EQ(10, result[0].delayTime);
+	EXPECT_EQ(2, result[0].commandList[1].channel);
+	EXPECT_EQ(cmdVect[0].commandList[1].dacCounts, result[0].commandList[1].dacCounts);
+	EXPECT_EQ(20, result[1].delayTime);
+
+	// a packed sequence gives the same rows.
+	CatheterCmdSequence cmdSequence;
+	cmdSequence.assign(cmdVect);
+	CommandGridModel packed;
+	packed.setCommands(cmdSequence);
+	ASSERT_EQ(model.rowCount(), packed.rowCount());
+	EXPECT_EQ(model.commandCount(), packed.commandCount());
+	for (size_t row(0); row < model.rowCount(); row++)
+	{
+		for (int col(0); col < NFIELDS; col++)
+		{
+			EXPECT_EQ(model.cellText(row, col), packed.cellText(row, col));
+		}
+	}
+}
+
+/**
+ * \brief editing keeps the sign and direction consistent and grows the grid.
+ */
+TEST(command_grid_model, testEdit){
+
+	CommandGridModel model;
+	EXPECT_FALSE(model.setCellText(1, CHANNEL_COL, "2"));
+	EXPECT_FALSE(model.setCellText(0, CHANNEL_COL, "9"));
+
+	EXPECT_TRUE(model.setCellText(0, CHANNEL_COL, "global"));
+	EXPECT_TRUE(model.setCellText(0, CURRENT_COL, "12.5"));
+	EXPECT_EQ("pos", model.cellText(0, DIRECTION_COL));
+	EXPECT_EQ(1, model.commandCount());
+	EXPECT_EQ(2, model.rowCount());
+	EXPECT_TRUE(model.isRowEditable(1));
+
+	EXPECT_TRUE(model.setCellText(0, DIRECTION_COL, "neg"));
+	EXPECT_EQ("-12.500", model.cellText(0, CURRENT_COL));
+	EXPECT_EQ(GLOBAL_ADDR, model.getRow(0).channel);
+
+	// a zero current leaves the direction to be picked.
+	EXPECT_TRUE(model.setCurrent(1, 0.0));
+	EXPECT_TRUE(model.isCellEmpty(1, DIRECTION_COL));
+	EXPECT_TRUE(model.setChannel(1, 4));
+	EXPECT_EQ(1, model.commandCount());
+	EXPECT_TRUE(model.setDirection(1, DIR_POS));
+	EXPECT_EQ(2, model.commandCount());
+
+	model.reset();
+	EXPECT_EQ(0, model.commandCount());
+	EXPECT_EQ(1, model.rowCount());
+}
+
+
+ int main(int argc, char** argv){
+ 	testing::InitGoogleTest(&argc,argv);
+ 	return RUN_ALL_TESTS();
+ }
@@ -0,0 +1,134 @@
+/*
+ * tests of the fixed capacity console log.
+ */
+
+#include <atomic>
+#include <string>
+#include <gtest/gtest.h>
+#include "util/async_log.h"
+#include "util/console_log.h"
+
+/**
+ * \brief lines are split at newlines, truncated, and the oldest lines are overwritten.
+ */
+TEST(console_log, testRing){
+
+	ConsoleLog log(4);
+	EXPECT_EQ(0, log.size());
+	EXPECT_FALSE(log.takeUpdate());
+
+	log.appendText("first\nsecond", logWarning);
+	EXPECT_EQ(2, log.size());
+	EXPECT_TRUE(log.takeUpdate());
+	EXPECT_FALSE(log.takeUpdate());
+
+	ConsoleLine line;
+	ASSERT_TRUE(log.getLine(1, line));
+	EXPECT_STREQ("second", line.text);
+	EXPECT_EQ(logWarning, line.severity);
+
+	for (int index(0); index < 5; index++)
+	{
+		log.appendText(std::string(LOG_LINE_LEN * 2, 'x'));
+	}
+	EXPECT_EQ(4, log.size());
+	EXPECT_EQ(7, log.endSeq());
+	EXPECT_EQ(3, log.firstSeq());
+	EXPECT_FALSE(log.getLine(2, line));
+	ASSERT_TRUE(log.getLine(6, line));
+	EXPECT_EQ(LOG_LINE_LEN - 1, line.length);
+
+	log.clear();
+	EXPECT_EQ(0, log.size());
+	EXPECT_FALSE(log.getLine(6, line));
+}
+
+/**
+ * \brief messages over the rate limit are dropped, errors are not.
+ */
+TEST(console_log, testRateLimit){
+
+	ConsoleLog log(64);
+	log.setRateLimit(3);
+	for (int index(0); index < 10; index++)
+	{
+		log.appendText("flood");
+	}
+	log.appendText("failure", logError);
+
+	EXPECT_EQ(4, log.size());
+	EXPECT_EQ(7, log.suppressedLines());
+
+	ConsoleLine line;
+	ASSERT_TRUE(log.getLine(3, line));
+	EXPECT_STREQ("failure", line.text);
+}
+
+/**
+ * \brief the summary of the last burst is written when the log is read, not only on the next message.
+ */
+TEST(console_log, testSuppressedSummary){
+
+	ConsoleLog log(64);
+	log.setRateLimit(2);
+	for (int index(0); index < 5; index++)
+	{
+		log.appendText("flood");
+	}
+	EXPECT_TRUE(log.takeUpdate());
+	EXPECT_EQ(2, log.endSeq());
+	EXPECT_FALSE(log.takeUpdate());
+
+	boost::this_thread::sleep(boost::posix_time::milliseconds(1100));
+	EXPECT_TRUE(log.takeUpdate());
+	ASSERT_EQ(3, log.endSeq());
+	ConsoleLine line;
+	ASSERT_TRUE(log.getLine(2, line));
+	EXPECT_STREQ("(3 messages suppressed)", line.text);
+	EXPECT_EQ(logWarning, line.severity);
+
+	// written once.
+	EXPECT_EQ(3, log.endSeq());
+	EXPECT_FALSE(log.takeUpdate());
+}
+
+namespace
+{
+	std::atomic<int> notifyCount(0);
+
+	void countNotify()
+	{
+		notifyCount++;
+	}
+}
+
+/**
+ * \brief the log thread writes the summary of a burst on its own and notifies the reader.
+ */
+TEST(console_log, testSuppressedSummaryDrain){
+
+	ConsoleLog log(64);
+	log.setRateLimit(2);
+	log.setNotify(&countNotify);
+	for (int index(0); index < 5; index++)
+	{
+		logToConsole(&log, logInfo, "flood");
+	}
+	logFlush();
+	EXPECT_EQ(2, notifyCount.load());
+
+	// no reader touches the log, the summary still shows up.
+	boost::this_thread::sleep(boost::posix_time::milliseconds(1100));
+	logFlush();
+	EXPECT_EQ(3, notifyCount.load());
+	ASSERT_EQ(3, log.endSeq());
+	ConsoleLine line;
+	ASSERT_TRUE(log.getLine(2, line));
+	EXPECT_STREQ("(3 messages suppressed)", line.text);
+}
+
+
+ int main(int argc, char** argv){
+ 	testing::InitGoogleTest(&argc,argv);
+ 	return RUN_ALL_TESTS();
+ }
@@ -0,0 +1,55 @@
+/*
+ * tests of the min/max decimation and the sample history.
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include "util/decimate.h"
+
+/**
+ * \brief each bucket keeps the extremes of its samples.
+ */
+TEST(decimate, testMinMax){
+
+	std::vector<float> values(100, 0.0f);
+	values[3] = 5.0f;
+	values[42] = -7.0f;
+	values[99] = 1.0f;
+
+	std::vector<float> low(10), high(10);
+	ASSERT_EQ(10, decimateMinMax(values.data(), values.size(), 10, low.data(), high.data()));
+	EXPECT_EQ(5.0f, high[0]);
+	EXPECT_EQ(0.0f, low[0]);
+	EXPECT_EQ(-7.0f, low[4]);
+	EXPECT_EQ(1.0f, high[9]);
+
+	// fewer samples than buckets.
+	EXPECT_EQ(3, decimateMinMax(values.data(), 3, 10, low.data(), high.data()));
+	EXPECT_EQ(0, decimateMinMax(values.data(), 0, 10, low.data(), high.data()));
+}
+
+/**
+ * \brief the newest samples are contiguous across the wrap.
+ */
+TEST(decimate, testHistory){
+
+	SampleHistory history(4);
+	EXPECT_EQ(0.0f, history.latest());
+	for (int index(1); index <= 6; index++)
+	{
+		history.push(static_cast<float> (index));
+	}
+	EXPECT_EQ(4, history.size());
+	EXPECT_EQ(6.0f, history.latest());
+
+	const float *newest(history.newest(4));
+	EXPECT_EQ(3.0f, newest[0]);
+	EXPECT_EQ(6.0f, newest[3]);
+	EXPECT_EQ(5.0f, history.newest(2)[0]);
+}
+
+
+ int main(int argc, char** argv){
+ 	testing::InitGoogleTest(&argc,argv);
+ 	return RUN_ALL_TESTS();
+ }
@@ -0,0 +1,127 @@
+/*
+ * tests of the calibrated current conversions.
+ */
+
+#include <cmath>
+#include <vector>
+#include <gtest/gtest.h>
+#include "com/catheter_commands.h"
+#include "hardware/digital_analog_conversions.h"
+
+/**
+ * \brief the nominal profile matches the original board constants.
+ */
+TEST(digital_analog_conversions, testNominal){
+
+	resetChannelCalibration();
+
+	EXPECT_EQ(1280, milliAmp2Dac(100.0));
+	EXPECT_EQ(1280, milliAmp2Dac(-100.0));
+	EXPECT_EQ(DAC_RES - 1, milliAmp2Dac(1000.0));
+	EXPECT_DOUBLE_EQ(100.0, dac2MilliAmp(1280, DIR_POS));
+	EXPECT_DOUBLE_EQ(-100.0, dac2MilliAmp(1280, DIR_NEG));
+	EXPECT_NEAR(500.0, adc2MilliAmp(4095), 1e-9);
+
+	// the counts are truncated, as the board was always sent.
+	EXPECT_EQ(1280, milliAmp2Dac(100.07));
+	EXPECT_EQ(0, milliAmp2Dac(0.07));
+	EXPECT_EQ(12, milliAmp2Dac(-1.0));
+
+	// so the round trip is within one DAC count, towards zero.
+	for (double mA(-300.0); mA <= 300.0; mA += 0.37)
+	{
+		dir_t dir((mA > 0.0) ? DIR_POS : DIR_NEG);
+		double roundTrip(dac2MilliAmp(milliAmp2Dac(mA), dir));
+		EXPECT_NEAR(mA, roundTrip, 1.0 / 12.8 + 1e-9);
+		EXPECT_LE(std::fabs(roundTrip), std::fabs(mA) + 1e-9);
+	}
+}
+
+/**
+ * \brief the batch conversions agree with the scalar ones.
+ */
+TEST(digital_analog_conversions, testBatch){
+
+	resetChannelCalibration();
+
+	std::vector<double> milliAmp;
+	std::vector<dir_t> dir;
+	std::vector<uint16_t> adc;
+	for (int i(0); i < 1000; i++)
+	{
+		milliAmp.push_back(0.61 * (i - 500));
+		dir.push_back((i > 500) ? DIR_POS : DIR_NEG);
+		adc.push_back(static_cast<uint16_t> ((i * 7) % ADC_RES));
+	}
+	std::vector<uint16_t> dacOut(milliAmp.size());
+	std::vector<double> dacMilliAmp(milliAmp.size());
+	std::vector<double> adcMilliAmp(milliAmp.size());
+
+	milliAmp2DacBatch(milliAmp.data(), dacOut.data(), milliAmp.size(), 2);
+	dac2MilliAmpBatch(dacOut.data(), dir.data(), dacMilliAmp.data(), dacOut.size(), 2);
+	adc2MilliAmpBatch(adc.data(), adcMilliAmp.data(), adc.size(), 2);
+
+	for (size_t i(0); i < milliAmp.size(); i++)
+	{
+		ASSERT_EQ(milliAmp2Dac(milliAmp[i], 2), dacOut[i]);
+		ASSERT_DOUBLE_EQ(dac2MilliAmp(dacOut[i], dir[i], 2), dacMilliAmp[i]);
+		ASSERT_DOUBLE_EQ(adc2MilliAmp(adc[i], 2), adcMilliAmp[i]);
+	}
+}
+
+/**
+ * \brief counts past the tables are evaluated from the profile on every path, not wrapped.
+ */
+TEST(digital_analog_conversions, testOutOfRange){
+
+	resetChannelCalibration();
+
+	const uint16_t dac[2] = { DAC_RES + 100, 65535 };
+	const dir_t dir[2] = { DIR_POS, DIR_NEG };
+	const uint16_t adc[2] = { ADC_RES + 100, 65535 };
+	double dacMilliAmp[2];
+	double adcMilliAmp[2];
+	dac2MilliAmpBatch(dac, dir, dacMilliAmp, 2, 1);
+	adc2MilliAmpBatch(adc, adcMilliAmp, 2, 1);
+
+	ChannelCalibration nominal;
+	EXPECT_DOUBLE_EQ((DAC_RES + 100) / nominal.dacGain, dac2MilliAmp(DAC_RES + 100, DIR_POS, 1));
+	EXPECT_DOUBLE_EQ(-65535 / nominal.dacGain, dac2MilliAmp(65535, DIR_NEG, 1));
+	EXPECT_GT(dac2MilliAmp(DAC_RES + 100, DIR_POS, 1), dac2MilliAmp(DAC_RES - 1, DIR_POS, 1));
+	EXPECT_DOUBLE_EQ((ADC_RES + 100) * nominal.adcGain, adc2MilliAmp(ADC_RES + 100, 1));
+	for (int i(0); i < 2; i++)
+	{
+		EXPECT_DOUBLE_EQ(dac2MilliAmp(dac[i], dir[i], 1), dacMilliAmp[i]);
+		EXPECT_DOUBLE_EQ(adc2MilliAmp(adc[i], 1), adcMilliAmp[i]);
+	}
+}
+
+/**
+ * \brief a calibration file changes only the channels it lists.
+ */
+TEST(digital_analog_conversions, testCalibrationFile){
+
+	resetChannelCalibration();
+	ASSERT_EQ(7, loadCalibrationFile("data/test_calibration.cal"));
+
+	// channel 1 is nominal
+	EXPECT_EQ(1280, milliAmp2Dac(100.0, 1));
+
+	// channel 2 has a gain and an offset
+	EXPECT_EQ(1314, milliAmp2Dac(100.0, 2));
+	EXPECT_NEAR(100.0, dac2MilliAmp(1314, DIR_POS, 2), 0.5 / 13.1);
+	EXPECT_NEAR(0.1198 * 1000.0 - 0.35, adc2MilliAmp(1000, 2), 1e-9);
+
+	// channel 3 has a quadratic ADC term
+	EXPECT_NEAR(0.1221001221 * 2000.0 + 1.0e-6 * 2000.0 * 2000.0, adc2MilliAmp(2000, 3), 1e-9);
+
+	EXPECT_EQ(-2, loadCalibrationFile("data/does_not_exist.cal"));
+	resetChannelCalibration();
+	EXPECT_EQ(1280, milliAmp2Dac(100.0, 2));
+}
+
+
+ int main(int argc, char** argv){
+ 	testing::InitGoogleTest(&argc,argv);
+ 	return RUN_ALL_TESTS();
+ }
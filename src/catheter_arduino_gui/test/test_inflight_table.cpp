@@ -0,0 +1,180 @@
+/*
+ * tests of the table matching arduino replies to the packets sent.
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include "ser/inflight_table.h"
+#include "test_cmd_sets.h"
+
+namespace
+{
+	CatheterChannelCmd makeCmd(int channel, int dacCounts, dir_t dir)
+	{
+		CatheterChannelCmd cmd;
+		cmd.channel = channel;
+		cmd.dacCounts = dacCounts;
+		cmd.dir = dir;
+		cmd.enable = true;
+		return cmd;
+	}
+}
+
+/**
+ * \brief a reply echoing the packet matches and gives its round trip, a wrong echo does not.
+ */
+TEST(inflight_table, testMatch){
+
+	InFlightTable table;
+	CatheterChannelCmdSet cmdSet(cmdSetOf(0, { makeCmd(1, 100, DIR_POS), makeCmd(3, 2000, DIR_NEG) }));
+	EXPECT_FALSE(table.sent(2, cmdSet, 1.0));
+	EXPECT_FALSE(table.sent(3, cmdSet, 1.5));
+	EXPECT_EQ(2, table.pending());
+
+	double rttUs(0.0);
+	int lost(0);
+	EXPECT_EQ(replyMatched, table.reply(2, cmdSet.commandList, 1.00025, rttUs, lost));
+	EXPECT_NEAR(250.0, rttUs, 1.0e-3);
+	EXPECT_EQ(1, table.pending());
+
+	// the same index again has nothing waiting.
+	EXPECT_EQ(replyUnmatched, table.reply(2, cmdSet.commandList, 1.1, rttUs, lost));
+
+	std::vector<CatheterChannelCmd> echo(cmdSet.commandList);
+	echo[1].dir = DIR_POS;
+	EXPECT_EQ(replyMismatch, table.reply(3, echo, 1.6, rttUs, lost));
+	EXPECT_NEAR(1.0e5, rttUs, 1.0e-3);
+	EXPECT_EQ(0, table.pending());
+}
+
+/**
+ * \brief global commands expect every channel, polls only check the channel.
+ */
+TEST(inflight_table, testGlobalAndPoll){
+
+	InFlightTable table;
+	CatheterChannelCmdSet pollSet(pollCmd());
+	table.sent(0, pollSet, 0.0);
+
+	std::vector<CatheterChannelCmd> echo;
+	for (int channel(1); channel <= NCHANNELS; channel++)
+	{
+		echo.push_back(makeCmd(channel, 50 * channel, (channel % 2) ? DIR_NEG : DIR_POS));
+	}
+	double rttUs(0.0);
+	int lost(0);
+	EXPECT_EQ(replyMatched, table.reply(0, echo, 0.001, rttUs, lost));
+
+	table.sent(1, pollSet, 0.0);
+	echo.pop_back();
+	EXPECT_EQ(replyMismatch, table.reply(1, echo, 0.001, rttUs, lost));
+}
+
+/**
+ * \brief unanswered packets time out, and a full slot reports the packet it drops.
+ */
+TEST(inflight_table, testExpire){
+
+	InFlightTable table;
+	CatheterChannelCmdSet cmdSet(cmdSetOf(0, { makeCmd(1, 100, DIR_POS), makeCmd(3, 2000, DIR_NEG) }));
+	table.sent(1, cmdSet, 0.0);
+	table.sent(2, cmdSet, 0.4);
+	EXPECT_EQ(0, table.expire(0.3, 0.5));
+	EXPECT_EQ(1, table.expire(0.6, 0.5));
+	EXPECT_EQ(1, table.pending());
+
+	// index 10 wraps onto the slot of 2 and queues behind it until the slot is full.
+	for (int i(1); i < INFLIGHT_DEPTH; i++)
+	{
+		EXPECT_FALSE(table.sent(2 + i * INFLIGHT_SLOTS, cmdSet, 0.7));
+	}
+	EXPECT_EQ(INFLIGHT_DEPTH, table.pending());
+	EXPECT_TRUE(table.sent(10, cmdSet, 0.8));
+	EXPECT_EQ(INFLIGHT_DEPTH, table.pending());
+	table.clear();
+	EXPECT_EQ(0, table.pending());
+}
+
+/**
+ * \brief a reply matches the oldest packet of a reused slot, not the newest.
+ */
+TEST(inflight_table, testReusedSlot){
+
+	InFlightTable table;
+	CatheterChannelCmdSet first(cmdSetOf(0, { makeCmd(1, 100, DIR_POS), makeCmd(3, 2000, DIR_NEG) }));
+	CatheterChannelCmdSet second(cmdSetOf(0, { makeCmd(1, 100, DIR_POS), makeCmd(3, 2000, DIR_NEG) }));
+	second.commandList[0].dacCounts = 900;
+	table.sent(3, first, 1.0);
+	EXPECT_FALSE(table.sent(11, second, 1.002));
+
+	double rttUs(0.0);
+	int lost(0);
+	EXPECT_EQ(replyMatched, table.reply(3, first.commandList, 1.004, rttUs, lost));
+	EXPECT_NEAR(4000.0, rttUs, 1.0e-3);
+	EXPECT_EQ(replyMatched, table.reply(11, second.commandList, 1.008, rttUs, lost));
+	EXPECT_NEAR(6000.0, rttUs, 1.0e-3);
+	EXPECT_EQ(0, table.pending());
+
+	// the reply of a dropped packet is skipped, not matched to the packet behind it.
+	for (int i(0); i <= INFLIGHT_DEPTH; i++)
+	{
+		table.sent(4 + i * INFLIGHT_SLOTS, (i == 0) ? first : second, 2.0 + i * 0.001);
+	}
+	EXPECT_EQ(replyLate, table.reply(4, first.commandList, 2.01, rttUs, lost));
+	EXPECT_EQ(replyMatched, table.reply(4, second.commandList, 2.012, rttUs, lost));
+	EXPECT_NEAR(11000.0, rttUs, 1.0e-3);
+
+	// so is the reply of an expired packet, until it is assumed lost.
+	table.clear();
+	table.sent(5, first, 3.0);
+	EXPECT_EQ(1, table.expire(3.6, 0.5));
+	table.sent(5, second, 3.7);
+	EXPECT_EQ(replyLate, table.reply(5, first.commandList, 3.71, rttUs, lost));
+	EXPECT_EQ(replyMatched, table.reply(5, second.commandList, 3.72, rttUs, lost));
+	table.sent(6, first, 4.0);
+	EXPECT_EQ(1, table.expire(4.6, 0.5));
+	EXPECT_EQ(0, table.expire(5.1, 0.5));
+	table.sent(6, second, 5.1);
+	EXPECT_EQ(replyMatched, table.reply(6, second.commandList, 5.11, rttUs, lost));
+}
+
+/**
+ * \brief a lost reply does not hold up its slot: the next reply matches its own packet
+ * and the packet before it is retired as lost, an invalid reply retires the oldest packet.
+ */
+TEST(inflight_table, testLostReply){
+
+	InFlightTable table;
+	CatheterChannelCmdSet first(cmdSetOf(0, { makeCmd(1, 100, DIR_POS), makeCmd(3, 2000, DIR_NEG) }));
+	CatheterChannelCmdSet second(cmdSetOf(0, { makeCmd(1, 100, DIR_POS), makeCmd(3, 2000, DIR_NEG) }));
+	second.commandList[0].dacCounts = 900;
+	table.sent(2, first, 1.0);
+	table.sent(10, second, 1.002);
+	table.sent(18, first, 1.004);
+
+	// the reply of the first packet never arrives.
+	double rttUs(0.0);
+	int lost(0);
+	EXPECT_EQ(replyMatched, table.reply(10, second.commandList, 1.005, rttUs, lost));
+	EXPECT_NEAR(3000.0, rttUs, 1.0e-3);
+	EXPECT_EQ(1, lost);
+	EXPECT_EQ(1, table.pending());
+	EXPECT_EQ(replyMatched, table.reply(18, first.commandList, 1.006, rttUs, lost));
+	EXPECT_NEAR(2000.0, rttUs, 1.0e-3);
+	EXPECT_EQ(0, lost);
+	EXPECT_EQ(0, table.pending());
+
+	// a garbled reply answered the oldest packet of any slot.
+	EXPECT_FALSE(table.replyInvalid());
+	table.sent(4, first, 2.0);
+	table.sent(5, second, 2.001);
+	EXPECT_TRUE(table.replyInvalid());
+	EXPECT_EQ(1, table.pending());
+	EXPECT_EQ(replyUnmatched, table.reply(4, first.commandList, 2.002, rttUs, lost));
+	EXPECT_EQ(replyMatched, table.reply(5, second.commandList, 2.003, rttUs, lost));
+}
+
+int main(int argc, char** argv){
+	testing::InitGoogleTest(&argc,argv);
+	return RUN_ALL_TESTS();
+}
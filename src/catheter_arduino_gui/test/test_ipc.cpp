@@ -0,0 +1,230 @@
+/*
+ * tests of the setpoint server framing, and of server and client over a unix socket.
+ */
+
+#include <cstring>
+#include <sstream>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "ipc/ipc_client.h"
+#include "ipc/ipc_server.h"
+#include "hardware/digital_analog_conversions.h"
+#include "sim/arduino_sim.h"
+
+namespace
+{
+	std::string testSocket()
+	{
+		std::stringstream path;
+		path << "/tmp/test_ipc_" << getpid() << ".sock";
+		return path.str();
+	}
+
+	int rawConnect(const std::string &path)
+	{
+		struct sockaddr_un address;
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+		int fd(socket(AF_UNIX, SOCK_STREAM, 0));
+		if (fd >= 0 && connect(fd, reinterpret_cast<struct sockaddr*> (&address), sizeof(address)) != 0)
+		{
+			close(fd);
+			return -1;
+		}
+		return fd;
+	}
+
+	// reads until count acks arrived or the time is up.
+	bool waitAcks(IpcClient &client, size_t count, std::vector<IpcAckMessage> &acks)
+	{
+		std::vector<CurrentSample> samples;
+		for (int waited(0); acks.size() < count && waited < 2000; waited += 10)
+		{
+			if (!client.read(10, acks, samples))
+			{
+				return false;
+			}
+		}
+		return acks.size() == count;
+	}
+}
+
+/**
+ * \brief frames survive being split anywhere, invalid sizes and bad headers are refused.
+ */
+TEST(ipc, testFraming){
+
+	double milliAmp[6] = {10.0, -20.0, 30.0, 40.0, -50.0, 60.0};
+	double delayMS[2] = {5.0, 7.0};
+	IpcRequest request;
+	request.sequence = 42;
+	request.sendNs = 1234;
+
+	std::vector<uint8_t> stream;
+	EXPECT_FALSE(ipcAppendSetpoints(stream, request, milliAmp, 3, 2, delayMS, 3, 0));
+	EXPECT_FALSE(ipcAppendSetpoints(stream, request, milliAmp, NCHANNELS + 1, 1, delayMS, 1, 0));
+	EXPECT_TRUE(stream.empty());
+	ASSERT_TRUE(ipcAppendSetpoints(stream, request, milliAmp, 3, 2, delayMS, 2, IPC_FLAG_POLL));
+	ipcAppendFrame(stream, ipcAbort, 0, &request, sizeof(request));
+
+	IpcFrameReader reader;
+	IpcHeader header;
+	const uint8_t *payload(NULL);
+	std::vector<IpcHeader> headers;
+	IpcSetpoints setpoints;
+	double decoded[8];
+	for (size_t i(0); i < stream.size(); i++)
+	{
+		reader.feed(&stream[i], 1);
+		while (reader.next(header, payload) == ipcFrameReady)
+		{
+			headers.push_back(header);
+			if (header.type == ipcSetpoints)
+			{
+				memcpy(&setpoints, payload, sizeof(setpoints));
+				memcpy(decoded, payload + sizeof(setpoints), sizeof(decoded));
+			}
+		}
+	}
+	ASSERT_EQ(2, headers.size());
+	EXPECT_EQ(ipcSetpoints, headers[0].type);
+	EXPECT_EQ(IPC_FLAG_POLL, headers[0].flags);
+	EXPECT_EQ(sizeof(IpcSetpoints) + 8 * sizeof(double), headers[0].length);
+	EXPECT_EQ(42, setpoints.request.sequence);
+	EXPECT_EQ(3, setpoints.nChannels);
+	EXPECT_EQ(2, setpoints.nSteps);
+	EXPECT_EQ(2, setpoints.nDelays);
+	EXPECT_EQ(-50.0, decoded[4]);
+	EXPECT_EQ(7.0, decoded[7]);
+	EXPECT_EQ(ipcAbort, headers[1].type);
+	EXPECT_EQ(0, reader.buffered());
+
+	uint8_t garbage[IPC_HEADER_LEN] = {1, 2, 3, 4, 5, 6, 7, 8};
+	reader.feed(garbage, sizeof(garbage));
+	EXPECT_EQ(ipcFrameBad, reader.next(header, payload));
+}
+
+/**
+ * \brief setpoints reach the serial queue and are acked, abort empties it, a broken client is dropped.
+ */
+TEST(ipc, testSetpointsAndControl){
+
+	SerialThreadObject serialObject;
+	IpcServer server(serialObject);
+	ASSERT_TRUE(server.start(testSocket()));
+	IpcServer second(serialObject);
+	EXPECT_FALSE(second.start(testSocket()));
+
+	IpcClient client;
+	ASSERT_TRUE(client.connect(testSocket()));
+
+	// long delays, so the sets are still queued when checked.
+	double milliAmp[6] = {10.0, 20.0, 30.0, -10.0, -20.0, -30.0};
+	double delayMS(200.0);
+	uint64_t sequence(client.sendSetpoints(milliAmp, 3, 2, &delayMS, 1, IPC_FLAG_FLUSH));
+	EXPECT_NE(0, sequence);
+	std::vector<IpcAckMessage> acks;
+	ASSERT_TRUE(waitAcks(client, 1, acks));
+	EXPECT_EQ(sequence, acks[0].sequence);
+	EXPECT_EQ(ipcOk, acks[0].status);
+	EXPECT_EQ(2, acks[0].queuedSets);
+	EXPECT_GE(acks[0].queuedNs, acks[0].sendNs);
+	EXPECT_GE(serialObject.queuedSets(), 1);
+
+	client.abort();
+	ASSERT_TRUE(waitAcks(client, 2, acks));
+	EXPECT_EQ(ipcOk, acks[1].status);
+	EXPECT_EQ(0, serialObject.queuedSets());
+
+	// a setpoint frame that claims one current but carries none is refused, the client stays.
+	IpcSetpoints setpoints;
+	memset(&setpoints, 0, sizeof(setpoints));
+	setpoints.request.sequence = 99;
+	setpoints.nChannels = 1;
+	setpoints.nSteps = 1;
+	setpoints.nDelays = 1;
+	std::vector<uint8_t> frame;
+	ipcAppendFrame(frame, ipcSetpoints, 0, &setpoints, sizeof(setpoints));
+	int fd(rawConnect(testSocket()));
+	ASSERT_GE(fd, 0);
+	ASSERT_EQ(static_cast<ssize_t> (frame.size()), write(fd, frame.data(), frame.size()));
+	IpcHeader header;
+	IpcAckMessage ack;
+	ASSERT_EQ(static_cast<ssize_t> (sizeof(header)), read(fd, &header, sizeof(header)));
+	ASSERT_EQ(static_cast<ssize_t> (sizeof(ack)), read(fd, &ack, sizeof(ack)));
+	EXPECT_EQ(ipcAck, header.type);
+	EXPECT_EQ(99, ack.sequence);
+	EXPECT_EQ(ipcInvalid, ack.status);
+
+	// a bad header drops the client.
+	uint8_t garbage[IPC_HEADER_LEN] = {1, 2, 3, 4, 5, 6, 7, 8};
+	ASSERT_EQ(static_cast<ssize_t> (sizeof(garbage)), write(fd, garbage, sizeof(garbage)));
+	EXPECT_EQ(0, read(fd, &header, sizeof(header)));
+	close(fd);
+
+	IpcServerStats stats;
+	server.getStats(stats);
+	EXPECT_EQ(1, stats.clientsActive);
+	// the second server probed the socket with a connection too.
+	EXPECT_EQ(3, stats.clientsAccepted);
+	EXPECT_EQ(3, stats.framesIn);
+	EXPECT_EQ(1, stats.framesBad);
+
+	server.stop();
+	EXPECT_FALSE(server.running());
+	EXPECT_NE(0, access(testSocket().c_str(), F_OK));
+}
+
+/**
+ * \brief a subscriber receives every reply of the polled setpoints from the simulated arduino.
+ */
+TEST(ipc, testTelemetry){
+
+	ArduinoSimOptions options;
+	options.processingUs = 100.0;
+	ArduinoSim sim(options);
+	ASSERT_TRUE(sim.start());
+	SerialThreadObject serialObject;
+	ASSERT_TRUE(serialObject.connectPort(sim.portName()));
+
+	IpcServer server(serialObject);
+	ASSERT_TRUE(server.start(testSocket()));
+	IpcClient client;
+	ASSERT_TRUE(client.connect(testSocket()));
+	client.subscribe(true);
+
+	std::vector<double> milliAmp(NCHANNELS * 20);
+	for (size_t i(0); i < milliAmp.size(); i++)
+	{
+		milliAmp[i] = (i % 2) ? 40.0 : -40.0;
+	}
+	double delayMS(1.0);
+	ASSERT_NE(0, client.sendSetpoints(milliAmp.data(), NCHANNELS, 20, &delayMS, 1, IPC_FLAG_POLL));
+
+	std::vector<IpcAckMessage> acks;
+	std::vector<CurrentSample> samples;
+	uint64_t dropped(0);
+	// each step is answered by its setpoints and then by the polls.
+	for (int waited(0); samples.size() < 2 * milliAmp.size() && waited < 2000; waited += 10)
+	{
+		ASSERT_TRUE(client.read(10, acks, samples, &dropped));
+	}
+	ASSERT_EQ(2, acks.size());
+	EXPECT_EQ(20, acks[1].queuedSets);
+	EXPECT_EQ(0, dropped);
+	ASSERT_EQ(2 * milliAmp.size(), samples.size());
+	EXPECT_FALSE(samples[0].polled);
+	EXPECT_TRUE(samples[NCHANNELS].polled);
+	EXPECT_EQ(1, samples[NCHANNELS].channel);
+	EXPECT_EQ(milliAmp2Dac(-40.0, 1), samples[NCHANNELS].dacCounts);
+	server.stop();
+}
+
+int main(int argc, char** argv){
+	testing::InitGoogleTest(&argc,argv);
+	return RUN_ALL_TESTS();
+}
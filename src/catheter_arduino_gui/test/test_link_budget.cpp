@@ -0,0 +1,223 @@
+/*
+ * tests of the playfile link budget preflight.
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include "com/link_budget.h"
+#include "test_cmd_sets.h"
+
+namespace
+{
+	// one channel command at 9600 baud: 6 + 6 bytes on the wire, 50 + 10 us of firmware.
+	const double oneCmdUs(12.0 * 10 * 1.0e6 / 9600 + 60.0);
+}
+
+/**
+ * \brief the wire time follows PCK_LEN and RESPONSE_LEN.
+ */
+TEST(link_budget, testWireTime){
+
+	EXPECT_DOUBLE_EQ(12500.0, setWireUs(1, false, 0, 9600));
+	EXPECT_DOUBLE_EQ(14.0 * 10 * 1.0e6 / 9600, setWireUs(1, false, 1, 9600));
+	// a global poll is answered for every channel.
+	EXPECT_DOUBLE_EQ(39.0 * 10 * 1.0e6 / 115200, setWireUs(1, true, 1, 115200));
+	EXPECT_DOUBLE_EQ(0.0, setWireUs(6, false, 6, 0));
+}
+
+/**
+ * \brief sets that fit their delays are not late.
+ */
+TEST(link_budget, testFeasible){
+
+	std::vector<CatheterChannelCmdSet> cmdSets;
+	for (int index(0); index < 100; index++)
+	{
+		cmdSets.push_back(channelSet(20, 1 + index % NCHANNELS));
+	}
+	std::vector<SetBudget> perSet;
+	LinkBudgetReport report(analyzeLinkBudget(cmdSets, LinkBudgetOptions(), &perSet));
+	EXPECT_TRUE(report.feasible);
+	EXPECT_EQ(100, report.sets);
+	EXPECT_DOUBLE_EQ(2.0e6, report.scheduledUs);
+	EXPECT_NEAR(100 * oneCmdUs, report.busyUs, 1.0e-3);
+	EXPECT_EQ(0, report.tightSets);
+	EXPECT_EQ(0, report.segmentCount);
+	EXPECT_DOUBLE_EQ(0.0, report.maxLagUs);
+	EXPECT_EQ(9600, report.minBaud);
+	EXPECT_EQ(packetAsIs, report.suggestedMode);
+	ASSERT_EQ(100, perSet.size());
+	EXPECT_FLOAT_EQ(12500.0f, perSet[0].wireUs);
+	EXPECT_FLOAT_EQ(60.0f, perSet[0].firmwareUs);
+}
+
+/**
+ * \brief delays shorter than the budget accumulate lag, a faster baud fixes it.
+ */
+TEST(link_budget, testInfeasible){
+
+	std::vector<CatheterChannelCmdSet> cmdSets;
+	for (int index(0); index < 100; index++)
+	{
+		cmdSets.push_back(channelSet(10, 1));
+	}
+	std::vector<SetBudget> perSet;
+	LinkBudgetReport report(analyzeLinkBudget(cmdSets, LinkBudgetOptions(), &perSet));
+	double deficitUs(oneCmdUs - 10000.0);
+	EXPECT_FALSE(report.feasible);
+	EXPECT_EQ(100, report.tightSets);
+	EXPECT_EQ(99, report.infeasibleSets);
+	ASSERT_EQ(1, report.segmentCount);
+	ASSERT_EQ(1, report.segments.size());
+	EXPECT_EQ(1, report.segments[0].first);
+	EXPECT_EQ(99, report.segments[0].last);
+	EXPECT_DOUBLE_EQ(10000.0, report.segments[0].startUs);
+	EXPECT_NEAR(99 * deficitUs, report.maxLagUs, 1.0e-3);
+	EXPECT_NEAR(99 * deficitUs, report.finalLagUs, 1.0e-3);
+	EXPECT_NEAR(49.5 * deficitUs, report.meanLagUs, 1.0e-3);
+	EXPECT_NEAR(deficitUs, perSet[1].lagUs, 1.0e-2);
+	EXPECT_EQ(19200, report.minBaud);
+	// nothing to coalesce or stop polling.
+	EXPECT_EQ(packetModeCount, report.suggestedMode);
+
+	// the native port has no wire time.
+	LinkBudgetOptions usb;
+	usb.baud = 0;
+	EXPECT_TRUE(analyzeLinkBudget(cmdSets, usb).feasible);
+}
+
+/**
+ * \brief a burst that the dwell after it absorbs is one segment, the next burst another.
+ */
+TEST(link_budget, testSegments){
+
+	std::vector<CatheterChannelCmdSet> cmdSets;
+	for (int burst(0); burst < 2; burst++)
+	{
+		// each set updates its channel and polls it after.
+		for (int channel(1); channel <= 3; channel++)
+		{
+			cmdSets.push_back(channelSet(channel == 3 ? 100 : 0, channel));
+			cmdSets.back().commandList.push_back(channelSet(0, channel, true).commandList[0]);
+		}
+	}
+	LinkBudgetReport report(analyzeLinkBudget(cmdSets, LinkBudgetOptions()));
+	EXPECT_FALSE(report.feasible);
+	EXPECT_EQ(4, report.infeasibleSets);
+	ASSERT_EQ(2, report.segments.size());
+	EXPECT_EQ(1, report.segments[0].first);
+	EXPECT_EQ(2, report.segments[0].last);
+	EXPECT_EQ(4, report.segments[1].first);
+	EXPECT_EQ(5, report.segments[1].last);
+	EXPECT_DOUBLE_EQ(100000.0, report.segments[1].startUs);
+	EXPECT_DOUBLE_EQ(report.segments[0].maxLagUs, report.segments[1].maxLagUs);
+	// a burst only fits as one packet, and polled sets are not coalesced.
+	EXPECT_EQ(packetCoalescedNoPoll, report.suggestedMode);
+}
+
+/**
+ * \brief zero delay bursts fit once they are coalesced.
+ */
+TEST(link_budget, testCoalescedMode){
+
+	std::vector<CatheterChannelCmdSet> cmdSets;
+	for (int group(0); group < 20; group++)
+	{
+		for (int channel(1); channel < NCHANNELS; channel++)
+		{
+			cmdSets.push_back(channelSet(0, channel));
+		}
+		cmdSets.push_back(channelSet(50, NCHANNELS));
+	}
+	LinkBudgetReport report(analyzeLinkBudget(cmdSets, LinkBudgetOptions()));
+	EXPECT_FALSE(report.feasible);
+	EXPECT_EQ(packetCoalesced, report.suggestedMode);
+	// as is, the five packets of a burst must go out within the tolerance.
+	EXPECT_EQ(921600, report.minBaud);
+	EXPECT_STREQ("coalesced", packetModeName(report.suggestedMode));
+}
+
+/**
+ * \brief a global poll writes nothing, so the zero delay sets before it are not merged into it.
+ */
+TEST(link_budget, testGlobalPollNotMerged){
+
+	std::vector<CatheterChannelCmdSet> cmdSets;
+	for (int group(0); group < 20; group++)
+	{
+		for (int channel(1); channel < NCHANNELS; channel++)
+		{
+			cmdSets.push_back(channelSet(0, channel));
+		}
+		cmdSets.push_back(channelSet(50, GLOBAL_ADDR, true));
+	}
+	// coalesced, a burst still takes two packets and the global poll goes out late.
+	LinkBudgetReport report(analyzeLinkBudget(cmdSets, LinkBudgetOptions()));
+	EXPECT_FALSE(report.feasible);
+	EXPECT_EQ(packetCoalescedNoPoll, report.suggestedMode);
+
+	// a global write does supersede them.
+	for (size_t index(NCHANNELS - 1); index < cmdSets.size(); index += NCHANNELS)
+	{
+		cmdSets[index].commandList[0].poll = false;
+	}
+	report = analyzeLinkBudget(cmdSets, LinkBudgetOptions());
+	EXPECT_EQ(packetCoalesced, report.suggestedMode);
+}
+
+/**
+ * \brief without polling, the polled copies appended after the setpoints are not sent.
+ */
+TEST(link_budget, testNoPollDropsCopies){
+
+	// 6 updates and their 6 polled copies: 93.75 ms as is, 43.75 ms without the copies at 9600 baud.
+	CatheterChannelCmdSet cmdSet;
+	for (int channel(1); channel <= NCHANNELS; channel++)
+	{
+		cmdSet.commandList.push_back(channelSet(60, channel).commandList[0]);
+	}
+	for (int channel(1); channel <= NCHANNELS; channel++)
+	{
+		cmdSet.commandList.push_back(channelSet(60, channel, true).commandList[0]);
+	}
+	cmdSet.delayTime = 60;
+	std::vector<CatheterChannelCmdSet> cmdSets(20, cmdSet);
+	LinkBudgetReport report(analyzeLinkBudget(cmdSets, LinkBudgetOptions()));
+	EXPECT_FALSE(report.feasible);
+	EXPECT_EQ(packetNoPoll, report.suggestedMode);
+}
+
+/**
+ * \brief the packed sequence gives the same report as the legacy structures.
+ */
+TEST(link_budget, testSequence){
+
+	std::vector<CatheterChannelCmdSet> cmdSets;
+	for (int index(0); index < 500; index++)
+	{
+		cmdSets.push_back(channelSet(index % 3 == 0 ? 25 : 0, 1 + index % NCHANNELS, index % 5 == 0));
+		if (index % 7 == 0)
+		{
+			cmdSets.back().commandList.push_back(cmdSets.back().commandList[0]);
+			cmdSets.back().commandList.back().channel = GLOBAL_ADDR;
+		}
+	}
+	CatheterCmdSequence cmdSequence;
+	cmdSequence.assign(cmdSets);
+	LinkBudgetOptions options;
+	options.baud = 57600;
+	LinkBudgetReport fromSets(analyzeLinkBudget(cmdSets, options));
+	LinkBudgetReport fromSequence(analyzeLinkBudget(cmdSequence, options));
+	EXPECT_EQ(fromSets.sets, fromSequence.sets);
+	EXPECT_DOUBLE_EQ(fromSets.busyUs, fromSequence.busyUs);
+	EXPECT_DOUBLE_EQ(fromSets.maxLagUs, fromSequence.maxLagUs);
+	EXPECT_EQ(fromSets.infeasibleSets, fromSequence.infeasibleSets);
+	EXPECT_EQ(fromSets.segmentCount, fromSequence.segmentCount);
+	EXPECT_EQ(fromSets.minBaud, fromSequence.minBaud);
+	EXPECT_EQ(fromSets.suggestedMode, fromSequence.suggestedMode);
+}
+
+int main(int argc, char** argv){
+	testing::InitGoogleTest(&argc,argv);
+	return RUN_ALL_TESTS();
+}
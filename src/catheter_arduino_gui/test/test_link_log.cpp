@@ -0,0 +1,353 @@
+/*
+ * tests of the link log, its packet decoder and the serial port recording into it.
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <gtest/gtest.h>
+#include "com/catheter_commands.h"
+#include "hardware/digital_analog_conversions.h"
+#include "ser/link_decode.h"
+#include "ser/serial_thread.h"
+#include "sim/arduino_sim.h"
+#include "util/link_log.h"
+#include "test_cmd_sets.h"
+
+namespace
+{
+	const char *logName("test_link_log.local.link");
+
+	std::vector<LinkRecordView> readAll(const LinkLogReader &reader)
+	{
+		std::vector<LinkRecordView> records;
+		uint64_t offset(reader.begin());
+		LinkRecordView view;
+		while (reader.next(offset, view))
+		{
+			records.push_back(view);
+		}
+		return records;
+	}
+
+	uint64_t fileSize(const char *fileName)
+	{
+		struct stat info;
+		return (stat(fileName, &info) == 0) ? static_cast<uint64_t> (info.st_size) : 0;
+	}
+
+	void recordMany(LinkRecorder *recorder, LinkRecordType type, int count)
+	{
+		for (int index(0); index < count; index++)
+		{
+			uint32_t value(static_cast<uint32_t> (index));
+			recorder->record(type, &value, sizeof(value));
+		}
+	}
+
+	LinkRecordView makeRecord(LinkRecordType type, uint64_t timeNs, const std::vector<uint8_t> &bytes)
+	{
+		LinkRecordView view;
+		view.offset = 0;
+		view.timeNs = timeNs;
+		view.type = type;
+		view.bytes = bytes.data();
+		view.length = static_cast<uint32_t> (bytes.size());
+		return view;
+	}
+}
+
+/**
+ * \brief records read back with their type, time and bytes, the file is trimmed on close.
+ */
+TEST(link_log, testRoundTrip){
+
+	LinkRecorder recorder;
+	ASSERT_TRUE(recorder.open(logName, "round trip"));
+	recorder.mark("open /dev/null 9600");
+	uint8_t packet[5] = { 1, 2, 3, 4, 5 };
+	recorder.record(linkRecordOut, packet, sizeof(packet));
+	recorder.record(linkRecordIn, 1234, packet, 2);
+	// a long write is split into records that fit the payload limit.
+	std::vector<uint8_t> longWrite(LINK_LOG_MAX_PAYLOAD * 2 + 10, 7);
+	recorder.record(linkRecordOut, longWrite.data(), longWrite.size());
+	EXPECT_EQ(6, recorder.records());
+	uint64_t used(recorder.bytesUsed());
+	recorder.close();
+	EXPECT_EQ(used, fileSize(logName));
+
+	LinkLogReader reader;
+	ASSERT_TRUE(reader.open(logName));
+	EXPECT_STREQ("round trip", reader.header().note);
+	EXPECT_EQ(6, reader.header().records.load());
+	std::vector<LinkRecordView> records(readAll(reader));
+	ASSERT_EQ(6, records.size());
+	EXPECT_EQ(linkRecordMark, records[0].type);
+	EXPECT_EQ("open /dev/null 9600", std::string(reinterpret_cast<const char*> (records[0].bytes), records[0].length));
+	EXPECT_EQ(linkRecordOut, records[1].type);
+	ASSERT_EQ(5, records[1].length);
+	EXPECT_EQ(0, memcmp(packet, records[1].bytes, 5));
+	EXPECT_GE(records[1].timeNs, reader.header().startNs);
+	EXPECT_EQ(linkRecordIn, records[2].type);
+	EXPECT_EQ(1234, records[2].timeNs);
+	EXPECT_EQ(2, records[2].length);
+	EXPECT_EQ(LINK_LOG_MAX_PAYLOAD, records[3].length);
+	EXPECT_EQ(LINK_LOG_MAX_PAYLOAD, records[4].length);
+	EXPECT_EQ(10, records[5].length);
+	reader.close();
+	remove(logName);
+}
+
+/**
+ * \brief openUnique() never overwrites a log, it adds a suffix before the extension.
+ */
+TEST(link_log, testUniqueName){
+
+	LinkRecorder first;
+	ASSERT_TRUE(first.openUnique(logName, "first"));
+	EXPECT_EQ(logName, first.fileName());
+	LinkRecorder second;
+	ASSERT_TRUE(second.openUnique(logName, "second"));
+	EXPECT_EQ("test_link_log.local_2.link", second.fileName());
+	first.close();
+	second.close();
+
+	LinkLogReader reader;
+	ASSERT_TRUE(reader.open(logName));
+	EXPECT_STREQ("first", reader.header().note);
+	reader.close();
+	remove(logName);
+	remove("test_link_log.local_2.link");
+}
+
+/**
+ * \brief a log past several blocks and map windows keeps every record, the index finds them by time.
+ */
+TEST(link_log, testBlocksAndSeek){
+
+	LinkRecorder recorder;
+	ASSERT_TRUE(recorder.open(logName));
+	// 16 byte payloads (32 bytes on disk with the header), past one map window.
+	const uint64_t count(LINK_LOG_MAP_BYTES / 32 + 1000);
+	std::vector<uint8_t> bytes(16, 0);
+	for (uint64_t index(0); index < count; index++)
+	{
+		memcpy(bytes.data(), &index, sizeof(index));
+		recorder.record((index % 3) ? linkRecordIn : linkRecordOut, 1000 + index * 10, bytes.data(), bytes.size());
+	}
+	EXPECT_EQ(0, recorder.dropped());
+	EXPECT_GT(recorder.bytesUsed(), static_cast<uint64_t> (LINK_LOG_MAP_BYTES));
+	recorder.close();
+
+	LinkLogReader reader;
+	ASSERT_TRUE(reader.open(logName));
+	std::vector<LinkRecordView> records(readAll(reader));
+	ASSERT_EQ(count, records.size());
+	size_t wrong(0);
+	for (uint64_t index(0); index < count; index++)
+	{
+		uint64_t value;
+		memcpy(&value, records[index].bytes, sizeof(value));
+		wrong += (value != index || records[index].timeNs != 1000 + index * 10) ? 1 : 0;
+	}
+	EXPECT_EQ(0, wrong);
+
+	// every block starts with its index: the first record time and the stream bytes before it.
+	ASSERT_GT(reader.blocks(), 2);
+	uint64_t timeNs;
+	LinkIndexEntry entry;
+	ASSERT_TRUE(reader.blockIndex(2, timeNs, entry));
+	EXPECT_EQ(1000 + entry.records * 10, timeNs);
+	EXPECT_EQ(entry.records, entry.bytesOut / bytes.size() + entry.bytesIn / bytes.size());
+	EXPECT_FALSE(reader.blockIndex(reader.blocks(), timeNs, entry));
+
+	const uint64_t target(count / 2);
+	uint64_t offset(reader.seek(1000 + target * 10));
+	LinkRecordView view;
+	ASSERT_TRUE(reader.next(offset, view));
+	EXPECT_LE(view.timeNs, 1000 + target * 10);
+	EXPECT_GT(view.timeNs + LINK_LOG_BLOCK_BYTES / 32 * 10, 1000 + target * 10);
+	EXPECT_EQ(reader.begin(), reader.seek(0));
+	reader.close();
+	remove(logName);
+}
+
+/**
+ * \brief the records committed before a crash (no close) read back.
+ */
+TEST(link_log, testUnclosed){
+
+	LinkRecorder recorder;
+	ASSERT_TRUE(recorder.open(logName));
+	recordMany(&recorder, linkRecordOut, 100);
+
+	LinkLogReader reader;
+	ASSERT_TRUE(reader.open(logName));
+	EXPECT_EQ(100, readAll(reader).size());
+	reader.close();
+	recorder.close();
+	remove(logName);
+}
+
+/**
+ * \brief records of two threads (the writer and the port reader) all arrive, in time order.
+ */
+TEST(link_log, testTwoThreads){
+
+	LinkRecorder recorder;
+	ASSERT_TRUE(recorder.open(logName));
+	const int count(20000);
+	boost::thread reads(boost::bind(&recordMany, &recorder, linkRecordIn, count));
+	recordMany(&recorder, linkRecordOut, count);
+	reads.join();
+	recorder.close();
+
+	LinkLogReader reader;
+	ASSERT_TRUE(reader.open(logName));
+	std::vector<LinkRecordView> records(readAll(reader));
+	ASSERT_EQ(2 * count, records.size());
+	uint32_t next[2] = { 0, 0 };
+	size_t outOfOrder(0);
+	size_t backwards(0);
+	for (size_t index(0); index < records.size(); index++)
+	{
+		uint32_t value;
+		memcpy(&value, records[index].bytes, sizeof(value));
+		int side(records[index].type == linkRecordOut ? 0 : 1);
+		outOfOrder += (value != next[side]) ? 1 : 0;
+		next[side] = value + 1;
+		backwards += (index > 0 && records[index].timeNs < records[index - 1].timeNs) ? 1 : 0;
+	}
+	EXPECT_EQ(0, outOfOrder);
+	EXPECT_EQ(0, backwards);
+	reader.close();
+	remove(logName);
+}
+
+/**
+ * \brief packets are framed across chunks, garbage is reported and replies get their round trip.
+ */
+TEST(link_decode, testFraming){
+
+	LinkPacketDecoder decoder;
+	std::vector<LinkPacket> packets;
+
+	std::vector<uint8_t> command(encodeCommandSet(dacCountsSet(3, 100), 4));
+	decoder.feed(makeRecord(linkRecordOut, 1000, command), packets);
+	ASSERT_EQ(1, packets.size());
+	EXPECT_EQ(linkPacketCommand, packets[0].kind);
+	EXPECT_TRUE(packets[0].outgoing);
+	EXPECT_EQ(4, packets[0].packetIndex);
+	ASSERT_EQ(3, packets[0].cmds.size());
+	EXPECT_EQ(102, packets[0].cmds[1].dacCounts);
+
+	// the reply comes in two chunks after a stray byte.
+	ArduinoChannelState channels[NCHANNELS];
+	uint8_t reply[SIM_MAX_REPLY_LEN];
+	size_t replyLen(arduinoReply(command.data(), command.size(), channels, reply));
+	std::vector<uint8_t> first(1, 0x01);
+	first.insert(first.end(), reply, reply + 4);
+	std::vector<uint8_t> second(reply + 4, reply + replyLen);
+	packets.clear();
+	decoder.feed(makeRecord(linkRecordIn, 2000, first), packets);
+	EXPECT_EQ(0, packets.size());
+	decoder.feed(makeRecord(linkRecordIn, 5000, second), packets);
+	ASSERT_EQ(2, packets.size());
+	EXPECT_EQ(linkPacketGarbage, packets[0].kind);
+	EXPECT_EQ(1, packets[0].length);
+	EXPECT_EQ(linkPacketReply, packets[1].kind);
+	EXPECT_FALSE(packets[1].outgoing);
+	EXPECT_EQ(1, packets[1].streamOffset);
+	EXPECT_EQ(4, packets[1].packetIndex);
+	EXPECT_DOUBLE_EQ(4.0, packets[1].rttUs);
+	ASSERT_EQ(3, packets[1].cmds.size());
+	EXPECT_EQ(103, packets[1].cmds[2].dacCounts);
+
+	// a reply whose command was not seen has no round trip, a cut packet ends as garbage.
+	packets.clear();
+	decoder.feed(makeRecord(linkRecordIn, 6000, std::vector<uint8_t>(reply, reply + replyLen)), packets);
+	ASSERT_EQ(1, packets.size());
+	EXPECT_LT(packets[0].rttUs, 0.0);
+	packets.clear();
+	decoder.feed(makeRecord(linkRecordOut, 7000, std::vector<uint8_t>(command.begin(), command.begin() + 5)), packets);
+	EXPECT_EQ(0, packets.size());
+	decoder.finish(8000, packets);
+	ASSERT_EQ(1, packets.size());
+	EXPECT_EQ(linkPacketGarbage, packets[0].kind);
+	EXPECT_EQ(5, packets[0].length);
+	EXPECT_EQ(6, decoder.garbageBytes());
+
+	EXPECT_EQ("ch2 -102 en", linkCommandText(dacCountsSet(3, 100).commandList[1], false));
+}
+
+/**
+ * \brief a playback against the simulated arduino is recorded and decodes to matched packets.
+ */
+TEST(link_log, testSerialRecording){
+
+	ArduinoSim sim;
+	ASSERT_TRUE(sim.start());
+	LinkRecorder recorder;
+	ASSERT_TRUE(recorder.open(logName, "simulated playback"));
+
+	{
+		SerialThreadObject serialObject;
+		serialObject.setLinkRecorder(&recorder);
+		ASSERT_TRUE(serialObject.connectPort(sim.portName()));
+		std::vector<CatheterChannelCmdSet> sets;
+		for (int i(0); i < 40; i++)
+		{
+			sets.push_back(dacCountsSet(NCHANNELS, static_cast<uint16_t> (i * 50)));
+		}
+		serialObject.queueCommands(sets);
+		PlaybackStats stats;
+		for (int waited(0); waited < 2000; waited++)
+		{
+			serialObject.getStats(stats);
+			if (stats.repliesValid == sets.size())
+			{
+				break;
+			}
+			boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+		}
+		EXPECT_EQ(sets.size(), stats.repliesValid);
+		serialObject.setLinkRecorder(NULL);
+	}
+	recorder.close();
+
+	LinkLogReader reader;
+	ASSERT_TRUE(reader.open(logName));
+	LinkPacketDecoder decoder;
+	std::vector<LinkPacket> packets;
+	uint64_t offset(reader.begin());
+	LinkRecordView view;
+	while (reader.next(offset, view))
+	{
+		decoder.feed(view, packets);
+	}
+	decoder.finish(0, packets);
+
+	size_t commands(0), replies(0), matched(0), marks(0);
+	for (size_t index(0); index < packets.size(); index++)
+	{
+		commands += (packets[index].kind == linkPacketCommand) ? 1 : 0;
+		replies += (packets[index].kind == linkPacketReply) ? 1 : 0;
+		matched += (packets[index].kind == linkPacketReply && packets[index].rttUs >= 0.0) ? 1 : 0;
+		marks += (packets[index].kind == linkPacketMark) ? 1 : 0;
+	}
+	EXPECT_GE(commands, 40);
+	EXPECT_EQ(commands, replies);
+	EXPECT_EQ(replies, matched);
+	EXPECT_GE(marks, 1);
+	EXPECT_EQ(0, decoder.garbageBytes());
+	reader.close();
+	remove(logName);
+}
+
+int main(int argc, char** argv){
+	testing::InitGoogleTest(&argc,argv);
+	return RUN_ALL_TESTS();
+}
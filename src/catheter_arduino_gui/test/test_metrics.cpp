@@ -0,0 +1,151 @@
+/*
+ * tests of the metrics registry and its shared memory page.
+ */
+
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "util/metrics.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+/**
+ * \brief counters, gauges and histograms read back, and a name registered twice is one metric.
+ */
+TEST(metrics, testRegistry){
+
+	MetricsRegistry registry;
+	EXPECT_FALSE(registry.shared());
+
+	MetricCounter sent(registry.counter("test_sent_total"));
+	sent.add();
+	sent.add(4);
+	registry.counter("test_sent_total").add();
+	EXPECT_EQ(6, sent.value());
+
+	// the same name with another type is refused.
+	MetricGauge wrongType(registry.gauge("test_sent_total"));
+	wrongType.set(3);
+	EXPECT_EQ(0, wrongType.value());
+
+	MetricGauge depth(registry.gauge("test_depth"));
+	depth.set(-2);
+	EXPECT_EQ(-2, depth.value());
+
+	MetricHistogram rtt(registry.histogram("test_rtt_us"));
+	rtt.record(0.5);
+	rtt.record(300.0);
+	rtt.record(310.0);
+	EXPECT_EQ(3, rtt.count());
+	EXPECT_EQ(0, metricBin(1.9));
+	EXPECT_EQ(8, metricBin(300.0));
+	EXPECT_EQ(METRICS_HISTOGRAM_BINS - 1, metricBin(1.0e12));
+
+	std::vector<MetricValue> values;
+	metricsSnapshot(registry.page(), values);
+	ASSERT_EQ(3, values.size());
+	EXPECT_EQ("test_rtt_us", values[2].name);
+	EXPECT_EQ(2, values[2].bins[8]);
+	EXPECT_EQ(611, values[2].sum);
+
+	std::string text(metricsPrometheusText(values));
+	EXPECT_NE(std::string::npos, text.find("# TYPE test_sent_total counter\ntest_sent_total 6\n"));
+	EXPECT_NE(std::string::npos, text.find("test_depth -2\n"));
+	EXPECT_NE(std::string::npos, text.find("test_rtt_us_bucket{le=\"512\"} 3\n"));
+	EXPECT_NE(std::string::npos, text.find("test_rtt_us_count 3\n"));
+
+	// an invalid handle does nothing.
+	MetricCounter none;
+	none.add();
+	EXPECT_EQ(0, none.value());
+}
+
+#ifndef _WIN32
+/**
+ * \brief a reader mapping the page sees the writer's updates.
+ */
+TEST(metrics, testSharedPage){
+
+	std::string name("/catheter_metrics_test_" + std::to_string(getpid()));
+	MetricsRegistry registry(name);
+	ASSERT_TRUE(registry.shared());
+	MetricCounter bytes(registry.counter("test_bytes_total"));
+
+	MetricsView view;
+	ASSERT_TRUE(view.open(name));
+	bytes.add(42);
+	std::vector<MetricValue> values;
+	metricsSnapshot(*view.page(), values);
+	ASSERT_EQ(1, values.size());
+	EXPECT_EQ(42, values[0].value);
+	EXPECT_EQ(static_cast<uint32_t> (getpid()), view.page()->pid);
+	view.close();
+
+	EXPECT_FALSE(view.open("/catheter_metrics_test_missing"));
+}
+
+/**
+ * \brief a second registry does not wipe or unlink a page that is in use.
+ */
+TEST(metrics, testNameTaken){
+
+	std::string name("/catheter_metrics_taken_" + std::to_string(getpid()));
+	MetricsRegistry registry(name);
+	ASSERT_TRUE(registry.shared());
+	MetricCounter bytes(registry.counter("test_bytes_total"));
+	bytes.add(7);
+	{
+		MetricsRegistry second(name);
+		EXPECT_FALSE(second.shared());
+		second.counter("test_other_total").add();
+	}
+	EXPECT_EQ(7, bytes.value());
+
+	MetricsView view;
+	ASSERT_TRUE(view.open(name));
+	std::vector<MetricValue> values;
+	metricsSnapshot(*view.page(), values);
+	ASSERT_EQ(1, values.size());
+	EXPECT_EQ(7, values[0].value);
+	view.close();
+}
+
+/**
+ * \brief a page left by a process that is gone is replaced.
+ */
+TEST(metrics, testStalePage){
+
+	std::string name("/catheter_metrics_stale_" + std::to_string(getpid()));
+	int fd(shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644));
+	ASSERT_LE(0, fd);
+	ASSERT_EQ(0, ftruncate(fd, sizeof(MetricsPage)));
+	void *mapped(mmap(NULL, sizeof(MetricsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+	::close(fd);
+	ASSERT_NE(MAP_FAILED, mapped);
+	MetricsPage *page(static_cast<MetricsPage*> (mapped));
+	page->magic = METRICS_MAGIC;
+	// a child that has exited and been reaped leaves its pid unused.
+	pid_t child(fork());
+	if (child == 0)
+	{
+		_exit(0);
+	}
+	waitpid(child, NULL, 0);
+	page->pid = static_cast<uint32_t> (child);
+	munmap(mapped, sizeof(MetricsPage));
+
+	MetricsRegistry registry(name);
+	EXPECT_TRUE(registry.shared());
+	EXPECT_EQ(static_cast<uint32_t> (getpid()), registry.page().pid);
+}
+#endif
+
+int main(int argc, char** argv){
+	testing::InitGoogleTest(&argc,argv);
+	return RUN_ALL_TESTS();
+}
@@ -2,11 +2,16 @@
  * created by Li Shao 11/15/2016
  */
 
+#include <cstdio>
 #include <iostream>
+#include <fstream>
+#include <iterator>
 #include <string>
+#include <algorithm>
 #include <gtest/gtest.h>
 #include "com/catheter_commands.h"
 #include "com/pc_utils.h"
+#include "hardware/digital_analog_conversions.h"
 
 /**
  * \brief test
@@ -43,6 +48,149 @@ TEST(pc_utils, testCurrentGen){
 	ASSERT_TRUE(expectedCurrent4 == actualCurrent4);
 }
 
+/**
+ * \brief the packed loader reads the same commands as the vector loader.
+ */
+TEST(pc_utils, testLoadSequence){
+
+	std::vector<CatheterChannelCmdSet> commandVect;
+	CatheterCmdSequence commandSequence;
+	loadPlayFile("data/test_case.play", commandVect);
+	loadPlayFile("data/test_case.play", commandSequence);
+
+	ASSERT_EQ(commandVect.size(), commandSequence.size());
+	for (size_t i(0); i < commandVect.size(); i++)
+	{
+		CmdSetView cmdSet(commandSequence[i]);
+		ASSERT_EQ(commandVect[i].delayTime, cmdSet.delayTime);
+		ASSERT_EQ(commandVect[i].commandList.size(), cmdSet.size());
+		for (size_t j(0); j < cmdSet.size(); j++)
+		{
+			ASSERT_EQ(commandVect[i].commandList[j].channel, cmdSet[j].channel());
+			ASSERT_EQ(commandVect[i].commandList[j].dacCounts, cmdSet[j].dacCounts());
+			ASSERT_EQ(commandVect[i].commandList[j].dir, cmdSet[j].dir());
+		}
+	}
+}
+
+/**
+ * \brief both writers write a loaded playfile back the same, without quantizing it.
+ */
+TEST(pc_utils, testWriteSequence){
+
+	std::vector<CatheterChannelCmdSet> commandVect;
+	CatheterCmdSequence commandSequence;
+	loadPlayFile("data/test_case.play", commandVect);
+	loadPlayFile("data/test_case.play", commandSequence);
+
+	ASSERT_TRUE(writePlayFile("test_write_vector.local.play", commandVect));
+	ASSERT_TRUE(writePlayFile("test_write_sequence.local.play", commandSequence));
+	std::ifstream vectFile("test_write_vector.local.play");
+	std::ifstream sequenceFile("test_write_sequence.local.play");
+	std::string vectText((std::istreambuf_iterator<char>(vectFile)), std::istreambuf_iterator<char>());
+	std::string sequenceText((std::istreambuf_iterator<char>(sequenceFile)), std::istreambuf_iterator<char>());
+	EXPECT_FALSE(vectText.empty());
+	EXPECT_EQ(vectText, sequenceText);
+	EXPECT_NE(std::string::npos, sequenceText.find("1, 10.691, 0"));
+
+	// a packed command has only its counts, a zero on DIR_NEG is written as 0.
+	CatheterCmdSequence packedSequence;
+	CatheterChannelCmd cmd;
+	cmd.channel = 2;
+	cmd.dir = DIR_NEG;
+	cmd.dacCounts = 0;
+	packedSequence.addCommand(packCmd(cmd));
+	packedSequence.endSet(5);
+	ASSERT_TRUE(writePlayFile("test_write_sequence.local.play", packedSequence));
+	std::ifstream packedFile("test_write_sequence.local.play");
+	std::string packedText((std::istreambuf_iterator<char>(packedFile)), std::istreambuf_iterator<char>());
+	EXPECT_EQ("2, 0, 5\n", packedText);
+
+	std::remove("test_write_vector.local.play");
+	std::remove("test_write_sequence.local.play");
+}
+
+/**
+ * \brief a current matrix is encoded in one buffer, packet by packet the same as encodeCommandSet.
+ */
+TEST(pc_utils, testEncodeCurrentMatrix){
+
+	// 3 channels x 4 steps, column major.
+	const double milliAmp[12] = {
+		10.0, -20.0, 0.0,
+		50.0, 50.0, -50.0,
+		-100.0, 0.0, 100.0,
+		0.0, 0.0, 0.0};
+	const double delayMS[4] = {5.0, 10.0, 15.0, 20.0};
+
+	CatheterCmdSequence commandSequence;
+	ASSERT_EQ(0, currentMatrix2Sequence(milliAmp, 3, 4, delayMS, 4, true, commandSequence));
+	ASSERT_EQ(4, commandSequence.size());
+	EXPECT_EQ(24, commandSequence.commandCount());
+	EXPECT_EQ(15, commandSequence[2].delayTime);
+	EXPECT_EQ(3, commandSequence[1][2].channel());
+	EXPECT_EQ(DIR_NEG, commandSequence[1][2].dir());
+	EXPECT_FALSE(commandSequence[1][2].poll());
+	// the polls follow the setpoints.
+	EXPECT_EQ(3, commandSequence[1][5].channel());
+	EXPECT_TRUE(commandSequence[1][5].poll());
+
+	std::vector<uint8_t> bytes(encodedLength(commandSequence));
+	std::vector<uint32_t> offsets(commandSequence.size() + 1);
+	EXPECT_EQ(4 * PCK_LEN(6), encodeSequence(commandSequence, 6, bytes.data(), offsets.data()));
+	EXPECT_EQ(bytes.size(), offsets.back());
+	for (size_t i(0); i < commandSequence.size(); i++)
+	{
+		std::vector<uint8_t> packet(encodeCommandSet(commandSequence.getSet(i), 6 + static_cast<int> (i)));
+		ASSERT_EQ(packet.size(), offsets[i + 1] - offsets[i]);
+		EXPECT_TRUE(std::equal(packet.begin(), packet.end(), bytes.begin() + offsets[i]));
+	}
+
+	// a single delay applies to every step, bad sizes are refused.
+	ASSERT_EQ(0, currentMatrix2Sequence(milliAmp, 3, 4, delayMS + 1, 1, false, commandSequence));
+	EXPECT_EQ(10, commandSequence[3].delayTime);
+	EXPECT_EQ(-1, currentMatrix2Sequence(milliAmp, NCHANNELS + 1, 1, delayMS, 1, false, commandSequence));
+	EXPECT_EQ(-1, currentMatrix2Sequence(milliAmp, 3, 4, delayMS, 2, false, commandSequence));
+}
+
+/**
+ * \brief the timeline holds each channel until it is commanded again.
+ */
+TEST(pc_utils, testSequenceTimeline){
+
+	CatheterCmdSequence commandSequence;
+	CatheterChannelCmd cmd;
+	cmd.channel = 2;
+	setCmdMilliAmp(cmd, 100.0);
+	commandSequence.addCommand(cmd);
+	commandSequence.endSet(5);
+	cmd.channel = GLOBAL_ADDR;
+	setCmdMilliAmp(cmd, -50.0);
+	commandSequence.addCommand(cmd);
+	cmd.channel = 1;
+	setCmdMilliAmp(cmd, 25.0);
+	commandSequence.addCommand(cmd);
+	commandSequence.endSet(10);
+	cmd.channel = 3;
+	setCmdMilliAmp(cmd, 0.0);
+	commandSequence.addCommand(cmd);
+	commandSequence.endSet(0);
+
+	std::vector<double> timeMS(commandSequence.size());
+	std::vector<double> milliAmp(commandSequence.size() * NCHANNELS);
+	sequenceTimeline(commandSequence, timeMS.data(), milliAmp.data());
+
+	EXPECT_EQ(0.0, timeMS[0]);
+	EXPECT_EQ(5.0, timeMS[1]);
+	EXPECT_EQ(15.0, timeMS[2]);
+	EXPECT_EQ(0.0, milliAmp[0]);
+	EXPECT_NEAR(100.0, milliAmp[1], 0.1);
+	EXPECT_NEAR(25.0, milliAmp[NCHANNELS], 0.1);
+	EXPECT_NEAR(-50.0, milliAmp[NCHANNELS + 1], 0.1);
+	EXPECT_NEAR(-50.0, milliAmp[2 * NCHANNELS + 5], 0.1);
+	EXPECT_NEAR(0.0, milliAmp[2 * NCHANNELS + 2], 0.1);
+}
+
 
  int main(int argc, char** argv){
  	testing::InitGoogleTest(&argc,argv);
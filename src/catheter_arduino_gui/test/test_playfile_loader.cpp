@@ -0,0 +1,134 @@
+/*
+ * tests of the background playfile loader.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <vector>
+#include <gtest/gtest.h>
+#include "com/catheter_commands.h"
+#include "com/command_sequence.h"
+#include "com/pc_utils.h"
+#include "gui/command_grid_model.h"
+#include "gui/playfile_loader.h"
+
+/**
+ * \brief the loader produces the same sets as loadPlayFile, and the grid model.
+ */
+TEST(playfile_loader, testLoad){
+
+	std::vector<CatheterChannelCmdSet> expected;
+	loadPlayFile("data/test_case.play", expected);
+
+	PlayfileLoader loader;
+	int finished(0);
+	loader.setNotify(boost::function<void()>(), [&finished]() { finished++; });
+	ASSERT_TRUE(loader.start("data/test_case.play"));
+	loader.wait();
+	EXPECT_EQ(1, finished);
+	EXPECT_EQ(PlayfileLoader::done, loader.getState());
+	EXPECT_DOUBLE_EQ(1.0, loader.getProgress());
+
+	std::vector<CatheterChannelCmdSet> head;
+	EXPECT_EQ(2, loader.copySets(0, 2, head));
+
+	CommandGridModel model;
+	CatheterCmdSequence loaded;
+	ASSERT_TRUE(loader.takeResult(model, loaded));
+	EXPECT_EQ(PlayfileLoader::idle, loader.getState());
+	ASSERT_EQ(expected.size(), loaded.size());
+	for (size_t i(0); i < expected.size(); i++)
+	{
+		CatheterChannelCmdSet loadedSet(loaded.getSet(i));
+		ASSERT_EQ(expected[i].commandList.size(), loadedSet.commandList.size());
+		EXPECT_EQ(expected[i].delayTime, loadedSet.delayTime);
+		for (size_t j(0); j < expected[i].commandList.size(); j++)
+		{
+			EXPECT_EQ(expected[i].commandList[j].dacCounts, loadedSet.commandList[j].dacCounts);
+			EXPECT_NEAR(expected[i].commandList[j].currentMilliAmp, loadedSet.commandList[j].currentMilliAmp, 1.0e-4);
+		}
+	}
+	EXPECT_EQ(expected[0].commandList.size(), head[0].commandList.size());
+
+	std::vector<CatheterChannelCmdSet> fromModel;
+	model.getCommands(fromModel);
+	EXPECT_EQ(expected.size(), fromModel.size());
+
+	EXPECT_FALSE(loader.start("data/does_not_exist.play"));
+}
+
+namespace
+{
+	void writeLongPlayfile(const char *fname)
+	{
+		FILE *f(fopen(fname, "w"));
+		ASSERT_TRUE(f != NULL);
+		for (int i(0); i < 200000; i++)
+		{
+			fprintf(f, "%d, %.3f, %d\n", (i % NCHANNELS) + 1, (i % 100) * 1.5, 1);
+		}
+		fclose(f);
+	}
+}
+
+/**
+ * \brief a cancelled load keeps what was loaded.
+ */
+TEST(playfile_loader, testCancel){
+
+	const char *fname("test_loader_cancel.local.play");
+	writeLongPlayfile(fname);
+
+	PlayfileLoader loader;
+	ASSERT_TRUE(loader.start(fname));
+	loader.cancel();
+	loader.wait();
+	PlayfileLoader::LoadState state(loader.getState());
+	EXPECT_TRUE(state == PlayfileLoader::cancelled || state == PlayfileLoader::done);
+
+	CommandGridModel model;
+	CatheterCmdSequence loaded;
+	ASSERT_TRUE(loader.takeResult(model, loaded));
+	EXPECT_EQ(loaded.size(), model.commandCount());
+	EXPECT_LE(loaded.size(), 200000);
+	remove(fname);
+}
+
+/**
+ * \brief a new load replaces a running one without waiting for it, only the new one finishes.
+ */
+TEST(playfile_loader, testReplace){
+
+	const char *fname("test_loader_replace.local.play");
+	writeLongPlayfile(fname);
+
+	PlayfileLoader loader;
+	std::atomic<int> finished(0);
+	loader.setNotify(boost::function<void()>(), [&finished]() { finished++; });
+	ASSERT_TRUE(loader.start(fname));
+	ASSERT_TRUE(loader.start("data/test_case.play"));
+	loader.wait();
+	EXPECT_EQ(PlayfileLoader::done, loader.getState());
+	EXPECT_EQ(1, finished);
+
+	std::vector<CatheterChannelCmdSet> expected;
+	loadPlayFile("data/test_case.play", expected);
+	CommandGridModel model;
+	CatheterCmdSequence loaded;
+	ASSERT_TRUE(loader.takeResult(model, loaded));
+	EXPECT_EQ(expected.size(), loaded.size());
+
+	// a discarded load is dropped at once and never reports.
+	ASSERT_TRUE(loader.start(fname));
+	loader.discard();
+	EXPECT_EQ(PlayfileLoader::idle, loader.getState());
+	EXPECT_EQ(0, loader.setsLoaded());
+	EXPECT_FALSE(loader.takeResult(model, loaded));
+	remove(fname);
+}
+
+
+ int main(int argc, char** argv){
+ 	testing::InitGoogleTest(&argc,argv);
+ 	return RUN_ALL_TESTS();
+ }
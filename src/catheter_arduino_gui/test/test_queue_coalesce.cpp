@@ -0,0 +1,137 @@
+/*
+ * tests of the coalescing pass over the serial thread queue.
+ */
+
+#include <deque>
+#include <gtest/gtest.h>
+#include "ser/queue_coalesce.h"
+#include "test_cmd_sets.h"
+
+namespace
+{
+	CatheterChannelCmd makeCmd(int channel, uint16_t dacCounts, bool poll = false)
+	{
+		CatheterChannelCmd cmd;
+		cmd.channel = channel;
+		cmd.dacCounts = dacCounts;
+		cmd.poll = poll;
+		return cmd;
+	}
+}
+
+/**
+ * \brief zero delay sets fold into the next set, the later command of a channel wins.
+ */
+TEST(queue_coalesce, testMerge){
+
+	std::deque<CatheterChannelCmdSet> queue;
+	queue.push_back(cmdSetOf(0, { makeCmd(1, 100) }));
+	queue.back().commandList.push_back(makeCmd(2, 200));
+	queue.push_back(cmdSetOf(0, { makeCmd(2, 201) }));
+	queue.push_back(cmdSetOf(5, { makeCmd(3, 300) }));
+
+	CoalesceCounts counts(coalesceQueue(queue));
+	EXPECT_EQ(2, counts.setsMerged);
+	EXPECT_EQ(1, counts.updatesDropped);
+	ASSERT_EQ(1, queue.size());
+	EXPECT_EQ(5, queue[0].delayTime);
+	ASSERT_EQ(3, queue[0].commandList.size());
+	EXPECT_EQ(1, queue[0].commandList[0].channel);
+	EXPECT_EQ(2, queue[0].commandList[1].channel);
+	EXPECT_EQ(201, queue[0].commandList[1].dacCounts);
+	EXPECT_EQ(3, queue[0].commandList[2].channel);
+
+	// the last set has nothing to merge into.
+	queue.push_back(cmdSetOf(0, { makeCmd(4, 400) }));
+	EXPECT_EQ(0, coalesceQueue(queue).setsMerged);
+	EXPECT_EQ(2, queue.size());
+}
+
+/**
+ * \brief dwells, polls and global commands are kept, a global set drops the zero delay set before it.
+ */
+TEST(queue_coalesce, testPreserved){
+
+	std::deque<CatheterChannelCmdSet> queue;
+	queue.push_back(cmdSetOf(10, { makeCmd(1, 100) }));
+	queue.push_back(cmdSetOf(0, { makeCmd(1, 101, true) }));
+	queue.push_back(cmdSetOf(0, { makeCmd(GLOBAL_ADDR, 0) }));
+	queue.push_back(cmdSetOf(0, { makeCmd(2, 200) }));
+	queue.push_back(cmdSetOf(0, { makeCmd(GLOBAL_ADDR, 0) }));
+	queue.push_back(cmdSetOf(0, { makeCmd(3, 300) }));
+
+	CoalesceCounts counts(coalesceQueue(queue));
+	EXPECT_EQ(1, counts.setsMerged);
+	EXPECT_EQ(1, counts.updatesDropped);
+	ASSERT_EQ(5, queue.size());
+	EXPECT_EQ(10, queue[0].delayTime);
+	EXPECT_TRUE(queue[1].commandList[0].poll);
+	EXPECT_EQ(GLOBAL_ADDR, queue[2].commandList[0].channel);
+	EXPECT_EQ(GLOBAL_ADDR, queue[3].commandList[0].channel);
+	EXPECT_EQ(1, queue[3].commandList.size());
+	EXPECT_EQ(3, queue[4].commandList[0].channel);
+
+	// sets before first are left alone.
+	std::deque<CatheterChannelCmdSet> tail;
+	tail.push_back(cmdSetOf(0, { makeCmd(1, 1) }));
+	tail.push_back(cmdSetOf(0, { makeCmd(1, 2) }));
+	tail.push_back(cmdSetOf(0, { makeCmd(1, 3) }));
+	EXPECT_EQ(1, coalesceQueue(tail, 1).setsMerged);
+	EXPECT_EQ(2, tail.size());
+	EXPECT_EQ(1, tail[0].commandList[0].dacCounts);
+	EXPECT_EQ(3, tail[1].commandList[0].dacCounts);
+}
+
+/**
+ * \brief polls write nothing, so the updates before them are still sent.
+ */
+TEST(queue_coalesce, testPollAfterStream){
+
+	// the end of a stream followed by the global poll ipcPoll queues.
+	std::deque<CatheterChannelCmdSet> queue;
+	queue.push_back(cmdSetOf(0, { makeCmd(1, 100) }));
+	queue.push_back(cmdSetOf(0, { makeCmd(2, 200) }));
+	queue.push_back(pollCmd());
+
+	CoalesceCounts counts(coalesceQueue(queue));
+	EXPECT_EQ(1, counts.setsMerged);
+	EXPECT_EQ(0, counts.updatesDropped);
+	ASSERT_EQ(2, queue.size());
+	ASSERT_EQ(2, queue[0].commandList.size());
+	EXPECT_EQ(100, queue[0].commandList[0].dacCounts);
+	EXPECT_EQ(200, queue[0].commandList[1].dacCounts);
+	EXPECT_TRUE(queue[1].commandList[0].poll);
+
+	// a channel poll after the update of its channel.
+	queue.clear();
+	queue.push_back(cmdSetOf(0, { makeCmd(1, 100) }));
+	queue.push_back(cmdSetOf(5, { makeCmd(1, 0, true) }));
+	counts = coalesceQueue(queue);
+	EXPECT_EQ(1, counts.setsMerged);
+	EXPECT_EQ(0, counts.updatesDropped);
+	ASSERT_EQ(1, queue.size());
+	ASSERT_EQ(2, queue[0].commandList.size());
+	EXPECT_EQ(100, queue[0].commandList[0].dacCounts);
+	EXPECT_TRUE(queue[0].commandList[1].poll);
+}
+
+/**
+ * \brief a merge that would not fit in one packet is skipped.
+ */
+TEST(queue_coalesce, testPacketLimit){
+
+	std::deque<CatheterChannelCmdSet> queue;
+	queue.push_back(cmdSetOf(0, { makeCmd(1, 100) }));
+	queue.push_back(cmdSetOf(0, { makeCmd(2, 200) }));
+	for (int i(1); i < COALESCE_MAX_CMDS; i++)
+	{
+		queue.back().commandList.push_back(makeCmd(2, 200 + i));
+	}
+	EXPECT_EQ(0, coalesceQueue(queue).setsMerged);
+	EXPECT_EQ(2, queue.size());
+}
+
+int main(int argc, char** argv){
+	testing::InitGoogleTest(&argc,argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,114 @@
+/*
+ * tests of the sequence lock and the setpoint mailbox built on it.
+ */
+
+#include <boost/thread.hpp>
+#include <gtest/gtest.h>
+#include "ser/setpoint_mailbox.h"
+#include "util/seqlock.h"
+
+namespace
+{
+	// every field holds the same number, a torn read mixes two.
+	struct Pattern
+	{
+		uint64_t values[9];
+		uint32_t tail;
+	};
+
+	Pattern makePattern(uint64_t value)
+	{
+		Pattern pattern;
+		for (int i(0); i < 9; i++)
+		{
+			pattern.values[i] = value;
+		}
+		pattern.tail = static_cast<uint32_t> (value);
+		return pattern;
+	}
+
+	void writePatterns(Seqlock<Pattern> &lock, uint64_t first, uint64_t count)
+	{
+		for (uint64_t value(first); value < first + count; value++)
+		{
+			lock.write(makePattern(value));
+		}
+	}
+}
+
+/**
+ * \brief readers racing two writers only ever see complete values, and the versions count the writes.
+ */
+TEST(seqlock, testConcurrentReaders){
+
+	Seqlock<Pattern> lock(makePattern(0));
+	EXPECT_EQ(0, lock.version());
+
+	const uint64_t writes(200000);
+	boost::thread writerA(boost::bind(&writePatterns, boost::ref(lock), 1, writes));
+	boost::thread writerB(boost::bind(&writePatterns, boost::ref(lock), 1000000, writes));
+
+	uint64_t torn(0);
+	uint64_t lastVersion(0);
+	bool ordered(true);
+	Pattern pattern;
+	while (lastVersion < 2 * writes)
+	{
+		uint64_t version(lock.read(pattern));
+		ordered = ordered && version >= lastVersion;
+		lastVersion = version;
+		for (int i(1); i < 9; i++)
+		{
+			torn += (pattern.values[i] != pattern.values[0]) ? 1 : 0;
+		}
+		torn += (pattern.tail != static_cast<uint32_t> (pattern.values[0])) ? 1 : 0;
+	}
+	writerA.join();
+	writerB.join();
+	EXPECT_EQ(0, torn);
+	EXPECT_TRUE(ordered);
+	EXPECT_EQ(2 * writes, lock.version());
+}
+
+/**
+ * \brief the mailbox keeps the channels not written, and only changed channels become commands.
+ */
+TEST(seqlock, testMailboxChanges){
+
+	SetpointMailbox mailbox;
+	double first[3] = {10.0, -20.0, 30.0};
+	EXPECT_EQ(1, mailbox.write(first, 3, true));
+	EXPECT_EQ(2, mailbox.writeChannel(2, 25.0));
+	EXPECT_EQ(2, mailbox.writeChannel(NCHANNELS + 1, 25.0));
+
+	MailboxSetpoints setpoints;
+	EXPECT_EQ(2, mailbox.read(setpoints));
+	EXPECT_EQ(10.0, setpoints.milliAmp[0]);
+	EXPECT_EQ(25.0, setpoints.milliAmp[1]);
+	EXPECT_EQ(0.0, setpoints.milliAmp[NCHANNELS - 1]);
+	EXPECT_TRUE(setpoints.poll);
+	EXPECT_GT(setpoints.writeNs, 0);
+
+	// nothing was sent yet, so every channel goes out.
+	MailboxChannelState sent[NCHANNELS];
+	CatheterChannelCmdSet cmdSet;
+	// polled, so every update is followed by a poll.
+	EXPECT_EQ(2 * NCHANNELS, mailboxChangedCommands(setpoints, sent, cmdSet));
+	EXPECT_FALSE(cmdSet.commandList[0].poll);
+	EXPECT_TRUE(cmdSet.commandList[NCHANNELS].poll);
+	EXPECT_EQ(1, cmdSet.commandList[NCHANNELS].channel);
+	EXPECT_EQ(0, mailboxChangedCommands(setpoints, sent, cmdSet));
+
+	double second[3] = {10.0, 25.0, -30.0};
+	mailbox.write(second, 3);
+	mailbox.read(setpoints);
+	ASSERT_EQ(1, mailboxChangedCommands(setpoints, sent, cmdSet));
+	EXPECT_EQ(3, cmdSet.commandList[0].channel);
+	EXPECT_EQ(DIR_NEG, cmdSet.commandList[0].dir);
+	EXPECT_FALSE(cmdSet.commandList[0].poll);
+}
+
+int main(int argc, char** argv){
+	testing::InitGoogleTest(&argc,argv);
+	return RUN_ALL_TESTS();
+}
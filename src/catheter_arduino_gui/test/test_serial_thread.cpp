@@ -0,0 +1,147 @@
+/*
+ * tests of the serial thread scheduling (no port is opened).
+ */
+
+#include <vector>
+#include <gtest/gtest.h>
+#include "ser/serial_thread.h"
+#include "ser/serial_session.h"
+
+namespace
+{
+	std::vector<CatheterChannelCmdSet> makeSets(size_t count, unsigned int delayMS)
+	{
+		std::vector<CatheterChannelCmdSet> sets(count, resetCmd());
+		for (size_t i(0); i < count; i++)
+		{
+			sets[i].delayTime = delayMS;
+		}
+		return sets;
+	}
+
+	bool waitIdle(SerialThreadObject &serialObject, int timeoutMs)
+	{
+		for (int waited(0); waited < timeoutMs; waited++)
+		{
+			if (serialObject.playbackIdle())
+			{
+				return true;
+			}
+			boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+		}
+		return false;
+	}
+}
+
+/**
+ * \brief every set is sent, and the deadlines do not drift with the loop overhead.
+ */
+TEST(serial_thread, testDeadlines){
+
+	SerialThreadObject serialObject;
+	EXPECT_FALSE(serialObject.isConnected());
+	EXPECT_TRUE(waitIdle(serialObject, 100));
+
+	serialObject.queueCommands(makeSets(20, 5));
+	ASSERT_TRUE(waitIdle(serialObject, 2000));
+	EXPECT_EQ(0, serialObject.queuedSets());
+
+	PlaybackStats stats;
+	serialObject.getStats(stats);
+	EXPECT_EQ(20, stats.setsSent);
+	ASSERT_EQ(20, stats.latenessUs.size());
+
+	// 19 delays between the first and the last set.
+	double elapsed(stats.lastSendTime - stats.firstSendTime);
+	EXPECT_GE(elapsed, 0.095);
+	EXPECT_LT(elapsed, 0.095 + 0.050);
+	EXPECT_EQ(0.0, stats.latenessUs[0]);
+
+	serialObject.resetStats();
+	serialObject.getStats(stats);
+	EXPECT_EQ(0, stats.setsSent);
+	EXPECT_TRUE(stats.latenessUs.empty());
+}
+
+/**
+ * \brief a set queued after the last delay has passed is sent right away.
+ */
+TEST(serial_thread, testIdleRestart){
+
+	SerialThreadObject serialObject;
+	serialObject.queueCommands(makeSets(1, 1));
+	ASSERT_TRUE(waitIdle(serialObject, 1000));
+	boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+
+	serialObject.queueCommand(makeSets(1, 1)[0]);
+	ASSERT_TRUE(waitIdle(serialObject, 1000));
+
+	PlaybackStats stats;
+	serialObject.getStats(stats);
+	ASSERT_EQ(2, stats.setsSent);
+	// no catch up is attempted after an idle period.
+	EXPECT_EQ(0.0, stats.latenessUs[1]);
+}
+
+/**
+ * \brief with coalescing, updates arriving during a dwell collapse into one set instead of a backlog.
+ */
+TEST(serial_thread, testCoalescing){
+
+	SerialThreadObject serialObject;
+	serialObject.setCoalescing(true);
+	serialObject.queueCommands(makeSets(1, 200));
+
+	CatheterChannelCmdSet update;
+	update.commandList.resize(NCHANNELS);
+	for (int burst(0); burst < 100; burst++)
+	{
+		for (int channel(1); channel <= NCHANNELS; channel++)
+		{
+			update.commandList[channel - 1].channel = channel;
+			update.commandList[channel - 1].dacCounts = static_cast<uint16_t> (burst);
+		}
+		serialObject.queueCommand(update);
+		EXPECT_GE(2, serialObject.queuedSets());
+	}
+	PlaybackStats stats;
+	serialObject.getStats(stats);
+	EXPECT_EQ(99, stats.setsCoalesced);
+	EXPECT_EQ(99 * NCHANNELS, stats.updatesCoalesced);
+	ASSERT_TRUE(waitIdle(serialObject, 2000));
+	serialObject.getStats(stats);
+	EXPECT_EQ(2, stats.setsSent);
+}
+
+/**
+ * \brief a session queues a current matrix as one set per column.
+ */
+TEST(serial_thread, testSessionEnqueue){
+
+	SerialSession session(16);
+	EXPECT_FALSE(session.isOpen());
+
+	const double milliAmp[6] = {10.0, -10.0, 20.0, -20.0, 0.0, 0.0};
+	const double delayMS(2.0);
+	EXPECT_EQ(-1, session.enqueue(milliAmp, NCHANNELS + 1, 1, &delayMS, 1, false));
+	ASSERT_EQ(0, session.enqueue(milliAmp, 2, 3, &delayMS, 1, false));
+
+	for (int waited(0); waited < 1000 && !session.idle(); waited++)
+	{
+		boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+	}
+	PlaybackStats stats;
+	session.getStats(stats);
+	EXPECT_EQ(3, stats.setsSent);
+	EXPECT_EQ(0, session.queuedSets());
+
+	CurrentSample samples[4];
+	EXPECT_EQ(0, session.pollTelemetry(samples, 4));
+	EXPECT_EQ(0, session.droppedTelemetry());
+}
+
+
+ int main(int argc, char** argv){
+ 	testing::InitGoogleTest(&argc,argv);
+ 	return RUN_ALL_TESTS();
+ }
@@ -0,0 +1,76 @@
+/*
+ * tests of the lock free single producer, single consumer ring.
+ */
+
+#include <vector>
+#include <boost/thread.hpp>
+#include <gtest/gtest.h>
+#include "util/spsc_ring.h"
+
+/**
+ * \brief fills, overflows and drains a ring on one thread.
+ */
+TEST(spsc_ring, testSingleThread){
+
+	SpscRing<int> ring(6);
+	EXPECT_EQ(8, ring.capacity());
+
+	for (int index(0); index < 8; index++)
+	{
+		EXPECT_TRUE(ring.push(index));
+	}
+	EXPECT_FALSE(ring.push(8));
+	EXPECT_EQ(1, ring.droppedCount());
+	EXPECT_EQ(8, ring.size());
+
+	int value(-1);
+	ASSERT_TRUE(ring.pop(value));
+	EXPECT_EQ(0, value);
+
+	std::vector<int> values(16);
+	EXPECT_EQ(7, ring.popBulk(values.data(), values.size()));
+	EXPECT_EQ(7, values[6]);
+	EXPECT_FALSE(ring.pop(value));
+}
+
+/**
+ * \brief every pushed item arrives once and in order across threads.
+ */
+TEST(spsc_ring, testTwoThreads){
+
+	const int nItems(20000);
+	SpscRing<int> ring(64);
+	boost::thread producer([&ring, nItems]() {
+		for (int index(0); index < nItems; index++)
+		{
+			while (!ring.push(index))
+			{
+				boost::this_thread::yield();
+			}
+		}
+	});
+
+	int expected(0);
+	while (expected < nItems)
+	{
+		int value;
+		if (ring.pop(value))
+		{
+			ASSERT_EQ(expected, value);
+			expected++;
+		}
+		else
+		{
+			// let the producer run (the test machine may have a single core).
+			boost::this_thread::yield();
+		}
+	}
+	producer.join();
+	EXPECT_EQ(0, ring.size());
+}
+
+
+ int main(int argc, char** argv){
+ 	testing::InitGoogleTest(&argc,argv);
+ 	return RUN_ALL_TESTS();
+ }
@@ -0,0 +1,206 @@
+/*
+ * tests of the triple buffer and the status snapshot built on it.
+ */
+
+#include <atomic>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <gtest/gtest.h>
+#include "com/status_data.h"
+#include "util/triple_buffer.h"
+
+namespace
+{
+	// every field holds the same value, a torn copy would mix two.
+	struct Block
+	{
+		uint64_t values[32];
+	};
+
+	void writeBlocks(TripleBuffer<Block> *buffer, uint64_t count)
+	{
+		for (uint64_t value(1); value <= count; value++)
+		{
+			Block &block(buffer->writeBuffer());
+			for (int index(0); index < 32; index++)
+			{
+				block.values[index] = value;
+			}
+			buffer->publish();
+		}
+	}
+
+	CatheterChannelCmd makeReply(int channel, uint16_t adcCounts)
+	{
+		CatheterChannelCmd cmd;
+		cmd.channel = channel;
+		cmd.adcCounts = adcCounts;
+		return cmd;
+	}
+
+	void countNotify(int *count)
+	{
+		(*count)++;
+	}
+}
+
+/**
+ * \brief the reader gets the latest published value once.
+ */
+TEST(triple_buffer, testSingleThread){
+
+	TripleBuffer<int> buffer;
+	int value(-1);
+	EXPECT_FALSE(buffer.read(value));
+
+	buffer.write(1);
+	buffer.write(2);
+	EXPECT_TRUE(buffer.read(value));
+	EXPECT_EQ(2, value);
+	EXPECT_FALSE(buffer.read(value));
+	EXPECT_EQ(2, value);
+
+	buffer.write(3);
+	EXPECT_TRUE(buffer.update());
+	EXPECT_EQ(3, buffer.readBuffer());
+	EXPECT_FALSE(buffer.update());
+}
+
+/**
+ * \brief values cross threads whole and in order.
+ */
+TEST(triple_buffer, testTwoThreads){
+
+	const uint64_t count(200000);
+	TripleBuffer<Block> buffer;
+	boost::thread writer(boost::bind(&writeBlocks, &buffer, count));
+	uint64_t last(0);
+	size_t torn(0);
+	size_t backwards(0);
+	Block block;
+	while (last < count)
+	{
+		if (!buffer.read(block))
+		{
+			continue;
+		}
+		for (int index(1); index < 32; index++)
+		{
+			torn += (block.values[index] != block.values[0]) ? 1 : 0;
+		}
+		backwards += (block.values[0] <= last) ? 1 : 0;
+		last = block.values[0];
+	}
+	writer.join();
+	EXPECT_EQ(0, torn);
+	EXPECT_EQ(0, backwards);
+	EXPECT_EQ(count, last);
+}
+
+/**
+ * \brief replies are folded per channel, every reader sees the latest snapshot.
+ */
+TEST(status_data, testSnapshot){
+
+	statusData status;
+	int notified(0);
+	status.setNotify(boost::bind(&countNotify, &notified));
+
+	StatusReader first(status);
+	ASSERT_TRUE(first.attached());
+	StatusSnapshot snapshot;
+	EXPECT_FALSE(first.read(snapshot));
+	EXPECT_FALSE(snapshot.hasChannel(1));
+
+	std::vector<CatheterChannelCmd> reply;
+	reply.push_back(makeReply(1, 100));
+	reply.push_back(makeReply(3, 300));
+	status.updateCmdList(reply);
+	reply.clear();
+	reply.push_back(makeReply(3, 301));
+	reply.push_back(makeReply(GLOBAL_ADDR, 7));
+	status.updateCmdList(reply);
+	EXPECT_EQ(2, notified);
+
+	EXPECT_TRUE(first.read(snapshot));
+	EXPECT_EQ(2, snapshot.replies);
+	EXPECT_TRUE(snapshot.hasChannel(1));
+	EXPECT_FALSE(snapshot.hasChannel(2));
+	EXPECT_TRUE(snapshot.hasChannel(3));
+	EXPECT_EQ(100, snapshot.channels[0].adcCounts);
+	EXPECT_EQ(301, snapshot.channels[2].adcCounts);
+	EXPECT_FALSE(first.read(snapshot));
+
+	// a reader attached later starts from the latest snapshot.
+	StatusReader second(status);
+	EXPECT_TRUE(second.read(snapshot));
+	EXPECT_EQ(2, snapshot.replies);
+}
+
+/**
+ * \brief readers beyond STATUS_MAX_READERS are not attached until a slot is released.
+ */
+TEST(status_data, testReaderSlots){
+
+	statusData status;
+	std::vector<StatusReader*> readers;
+	for (int index(0); index < STATUS_MAX_READERS; index++)
+	{
+		readers.push_back(new StatusReader(status));
+		EXPECT_TRUE(readers.back()->attached());
+	}
+	StatusSnapshot snapshot;
+	{
+		StatusReader extra(status);
+		EXPECT_FALSE(extra.attached());
+		EXPECT_FALSE(extra.read(snapshot));
+	}
+	delete readers[3];
+	readers[3] = new StatusReader(status);
+	EXPECT_TRUE(readers[3]->attached());
+	for (size_t index(0); index < readers.size(); index++)
+	{
+		delete readers[index];
+	}
+}
+
+/**
+ * \brief the writer keeps publishing while readers on other threads copy snapshots.
+ */
+TEST(status_data, testConcurrentReaders){
+
+	statusData status;
+	std::atomic<bool> done(false);
+	std::atomic<size_t> inconsistent(0);
+	boost::thread_group readers;
+	for (int index(0); index < 3; index++)
+	{
+		readers.create_thread([&status, &done, &inconsistent]() {
+			StatusReader reader(status);
+			StatusSnapshot snapshot;
+			while (!done)
+			{
+				if (reader.read(snapshot) && snapshot.channels[0].adcCounts != snapshot.channels[1].adcCounts)
+				{
+					inconsistent++;
+				}
+			}
+		});
+	}
+	std::vector<CatheterChannelCmd> reply(2);
+	for (uint16_t value(0); value < 50000; value++)
+	{
+		reply[0] = makeReply(1, value & 4095);
+		reply[1] = makeReply(2, value & 4095);
+		status.updateCmdList(reply);
+	}
+	done = true;
+	readers.join_all();
+	EXPECT_EQ(0, inconsistent);
+}
+
+int main(int argc, char** argv){
+	testing::InitGoogleTest(&argc,argv);
+	return RUN_ALL_TESTS();
+}
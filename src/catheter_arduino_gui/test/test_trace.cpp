@@ -0,0 +1,85 @@
+/*
+ * tests of the trace event buffers and their json dump.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <boost/thread.hpp>
+#include <gtest/gtest.h>
+#include "util/trace.h"
+
+namespace
+{
+	std::string readFile(const std::string &fileName)
+	{
+		std::ifstream file(fileName.c_str());
+		std::stringstream text;
+		text << file.rdbuf();
+		return text.str();
+	}
+
+	void recordWorker()
+	{
+		traceThreadName("worker");
+		TraceScope scope("worker span");
+		traceRecord("worker count", 'C', traceNowNs(), 0, 7);
+	}
+}
+
+/**
+ * \brief spans, instants and counters of several threads end up in one chrome trace.
+ */
+TEST(trace, testWriteJson){
+
+	traceClear();
+	{
+		TraceScope off("not recorded");
+	}
+	traceEnable(true);
+	traceThreadName("main");
+	{
+		TraceScope scope("main span");
+		traceRecord("short write", 'i', traceNowNs(), 0, 3);
+	}
+	boost::thread worker(recordWorker);
+	worker.join();
+	traceEnable(false);
+
+	std::string fileName("test_trace.json");
+	ASSERT_TRUE(traceWriteJson(fileName));
+	std::string text(readFile(fileName));
+	remove(fileName.c_str());
+
+	EXPECT_EQ(0, text.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+	EXPECT_EQ(std::string::npos, text.find("not recorded"));
+	EXPECT_NE(std::string::npos, text.find("\"args\":{\"name\":\"main\"}"));
+	EXPECT_NE(std::string::npos, text.find("\"args\":{\"name\":\"worker\"}"));
+	EXPECT_NE(std::string::npos, text.find("{\"name\":\"main span\",\"ph\":\"X\""));
+	EXPECT_NE(std::string::npos, text.find("\"ph\":\"i\""));
+	EXPECT_NE(std::string::npos, text.find("\"s\":\"t\",\"args\":{\"value\":3}"));
+	EXPECT_NE(std::string::npos, text.find("{\"name\":\"worker span\",\"ph\":\"X\""));
+	EXPECT_NE(std::string::npos, text.find("\"args\":{\"value\":7}"));
+	EXPECT_EQ(0, traceDropped());
+}
+
+/**
+ * \brief a full buffer drops (and counts) the later events.
+ */
+TEST(trace, testDropped){
+
+	traceClear();
+	for (int i(0); i < TRACE_BUFFER_EVENTS + 5; i++)
+	{
+		traceRecord("filler", 'i', traceNowNs(), 0, i);
+	}
+	EXPECT_EQ(5, traceDropped());
+	traceClear();
+	EXPECT_EQ(0, traceDropped());
+}
+
+int main(int argc, char** argv){
+	testing::InitGoogleTest(&argc,argv);
+	return RUN_ALL_TESTS();
+}
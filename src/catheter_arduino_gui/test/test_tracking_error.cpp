@@ -0,0 +1,352 @@
+/*
+ * tests of the offline tracking analysis.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "com/pc_utils.h"
+#include "com/tracking_error.h"
+#include "hardware/digital_analog_conversions.h"
+
+namespace
+{
+	const char *telemetryName("test_tracking_error.local.csv");
+
+	const char *header("time_s,channel,dir,dac_counts,adc_counts,set_ma,sensed_ma,polled\n");
+
+	void addSet(CatheterCmdSequence &cmdSequence, int channel, uint16_t dacCounts, dir_t dir, long delayTime)
+	{
+		CatheterChannelCmd cmd;
+		cmd.channel = channel;
+		cmd.dacCounts = dacCounts;
+		cmd.dir = dir;
+		cmdSequence.addCommand(cmd);
+		cmdSequence.endSet(delayTime);
+	}
+
+	// channel 1 steps up at 0 ms and back to 0 at 100 ms, channel 2 steps negative at 50 ms.
+	void stepSequence(CatheterCmdSequence &cmdSequence)
+	{
+		addSet(cmdSequence, 1, 2000, DIR_POS, 50);
+		addSet(cmdSequence, 2, 1000, DIR_NEG, 50);
+		addSet(cmdSequence, 1, 0, DIR_POS, 100);
+	}
+
+	double commanded(int channel, double timeMs)
+	{
+		if (channel == 1)
+		{
+			return (timeMs >= 0.0 && timeMs < 100.0) ? dac2MilliAmp(2000, DIR_POS, 1) : 0.0;
+		}
+		return (timeMs >= 50.0) ? dac2MilliAmp(1000, DIR_NEG, 2) : 0.0;
+	}
+
+	// a row every ms on both channels (half way between the ms), the board takes the sets linkMs late
+	// and the sensed current is delayMs behind the board.
+	std::string stepTelemetry(double delayMs, int rows = 200, double linkMs = 0.0)
+	{
+		std::string csv(header);
+		char line[128];
+		for (int index(0); index < rows; index++)
+		{
+			double timeMs(index + 0.5);
+			for (int channel(1); channel <= 2; channel++)
+			{
+				double sensed(commanded(channel, timeMs - linkMs - delayMs));
+				snprintf(line, sizeof(line), "%.6f,%d,%d,0,0,%.4f,%.4f,1\n", timeMs * 1.0e-3, channel,
+					sensed < 0.0 ? 0 : 1, commanded(channel, timeMs - linkMs), fabs(sensed));
+				csv += line;
+			}
+		}
+		return csv;
+	}
+}
+
+/**
+ * \brief a channel that follows its command has no error, no lag and settles at once.
+ */
+TEST(tracking_error, testPerfectTracking){
+
+	CatheterCmdSequence cmdSequence;
+	stepSequence(cmdSequence);
+	std::string csv(stepTelemetry(0.0));
+	TrackingReport report;
+	ASSERT_TRUE(analyzeTracking(cmdSequence, csv.data(), csv.size(), TrackingOptions(), report));
+	EXPECT_EQ(400, report.rows);
+	EXPECT_EQ(400, report.samples);
+	EXPECT_EQ(0, report.skippedRows);
+	EXPECT_DOUBLE_EQ(0.5, report.firstMs);
+	EXPECT_DOUBLE_EQ(199.5, report.lastMs);
+	ASSERT_EQ(NCHANNELS, report.channels.size());
+	for (int channel(0); channel < 2; channel++)
+	{
+		EXPECT_EQ(200, report.channels[channel].samples);
+		EXPECT_LT(report.channels[channel].rmsErrorMa, 1.0e-3);
+		EXPECT_LT(report.channels[channel].maxErrorMa, 1.0e-3);
+	}
+	EXPECT_EQ(0, report.channels[2].samples);
+
+	// the negative step is signed by the dir column.
+	ASSERT_EQ(3, report.steps.size());
+	EXPECT_EQ(1, report.steps[0].channel);
+	EXPECT_EQ(0, report.steps[0].set);
+	EXPECT_EQ(1, report.steps[1].channel);
+	EXPECT_EQ(2, report.steps[1].set);
+	EXPECT_DOUBLE_EQ(100.5, report.steps[1].startMs);
+	EXPECT_EQ(2, report.steps[2].channel);
+	EXPECT_LT(report.steps[2].toMa, 0.0);
+	for (size_t index(0); index < report.steps.size(); index++)
+	{
+		EXPECT_TRUE(report.steps[index].anchored);
+		EXPECT_DOUBLE_EQ(0.0, report.steps[index].lagMs);
+		EXPECT_DOUBLE_EQ(0.0, report.steps[index].settleMs);
+	}
+	EXPECT_EQ(2, report.channels[0].settledSteps);
+	EXPECT_DOUBLE_EQ(0.0, report.channels[0].medianLagMs);
+
+	// the rows are half a ms after the sets.
+	EXPECT_TRUE(report.anchored);
+	EXPECT_EQ(3, report.anchoredSteps);
+	EXPECT_DOUBLE_EQ(0.5, report.maxDriftMs);
+}
+
+/**
+ * \brief a delayed response shows as lag, settling time and error while it catches up.
+ */
+TEST(tracking_error, testDelayedStep){
+
+	CatheterCmdSequence cmdSequence;
+	stepSequence(cmdSequence);
+	std::string csv(stepTelemetry(5.0));
+	TrackingReport report;
+	ASSERT_TRUE(analyzeTracking(cmdSequence, csv.data(), csv.size(), TrackingOptions(), report));
+
+	// 5 samples behind after each of the two steps of channel 1.
+	double stepMa(dac2MilliAmp(2000, DIR_POS, 1));
+	const ChannelTracking &channel(report.channels[0]);
+	EXPECT_NEAR(0.0, channel.meanErrorMa, 1.0e-3);
+	EXPECT_NEAR(stepMa * sqrt(10.0 / 200.0), channel.rmsErrorMa, 1.0e-3);
+	EXPECT_NEAR(stepMa, channel.maxErrorMa, 1.0e-3);
+	EXPECT_EQ(2, channel.steps);
+	EXPECT_EQ(2, channel.settledSteps);
+	EXPECT_DOUBLE_EQ(4.0, channel.meanSettleMs);
+	EXPECT_DOUBLE_EQ(4.0, channel.maxSettleMs);
+	EXPECT_EQ(2, channel.lagSteps);
+	EXPECT_DOUBLE_EQ(5.0, channel.meanLagMs);
+	EXPECT_DOUBLE_EQ(5.0, channel.medianLagMs);
+	EXPECT_DOUBLE_EQ(5.0, report.steps[0].lagMs);
+	EXPECT_EQ(100, report.steps[0].samples);
+
+	// on the schedule, aligning the telemetry removes the delay.
+	TrackingOptions options;
+	options.anchorSteps = false;
+	options.offsetMs = -5.0;
+	ASSERT_TRUE(analyzeTracking(cmdSequence, csv.data(), csv.size(), options, report));
+	EXPECT_LT(report.channels[0].maxErrorMa, 1.0e-3);
+	EXPECT_FALSE(report.anchored);
+	EXPECT_DOUBLE_EQ(0.5, report.channels[0].meanLagMs);
+
+	// a step that is never followed does not settle (the step back to 0 then is met at once).
+	csv = stepTelemetry(1000.0);
+	ASSERT_TRUE(analyzeTracking(cmdSequence, csv.data(), csv.size(), TrackingOptions(), report));
+	EXPECT_EQ(1, report.channels[0].settledSteps);
+	EXPECT_EQ(1, report.channels[0].lagSteps);
+	EXPECT_DOUBLE_EQ(-1.0, report.steps[0].settleMs);
+	EXPECT_DOUBLE_EQ(-1.0, report.steps[0].lagMs);
+}
+
+/**
+ * \brief a link that delays the sets shows as drift, not as lag, once the steps are anchored on set_ma.
+ */
+TEST(tracking_error, testLinkDrift){
+
+	CatheterCmdSequence cmdSequence;
+	stepSequence(cmdSequence);
+	std::string csv(stepTelemetry(2.0, 200, 7.0));
+	TrackingReport report;
+	ASSERT_TRUE(analyzeTracking(cmdSequence, csv.data(), csv.size(), TrackingOptions(), report));
+	EXPECT_TRUE(report.anchored);
+	EXPECT_EQ(3, report.anchoredSteps);
+	EXPECT_DOUBLE_EQ(7.5, report.maxDriftMs);
+	ASSERT_EQ(3, report.steps.size());
+	for (size_t index(0); index < report.steps.size(); index++)
+	{
+		EXPECT_DOUBLE_EQ(7.5, report.steps[index].driftMs);
+		EXPECT_DOUBLE_EQ(2.0, report.steps[index].lagMs);
+	}
+	EXPECT_DOUBLE_EQ(107.5, report.steps[1].startMs);
+	EXPECT_DOUBLE_EQ(2.0, report.channels[0].maxLagMs);
+
+	// on the schedule the link is part of the lag.
+	TrackingOptions options;
+	options.anchorSteps = false;
+	ASSERT_TRUE(analyzeTracking(cmdSequence, csv.data(), csv.size(), options, report));
+	EXPECT_EQ(0, report.anchoredSteps);
+	EXPECT_DOUBLE_EQ(9.5, report.channels[0].maxLagMs);
+	EXPECT_DOUBLE_EQ(100.0, report.steps[1].startMs);
+
+	// a change that is never echoed starts with the drift of the one before it.
+	double stepMa(dac2MilliAmp(2000, DIR_POS, 1));
+	std::string stuck(header);
+	char line[128];
+	for (int index(0); index < 200; index++)
+	{
+		double timeMs(index + 0.5);
+		double sensed(commanded(1, timeMs - 9.0));
+		snprintf(line, sizeof(line), "%.6f,1,1,0,0,%.4f,%.4f,1\n", timeMs * 1.0e-3, (timeMs >= 7.0) ? stepMa : 0.0,
+			sensed);
+		stuck += line;
+	}
+	ASSERT_TRUE(analyzeTracking(cmdSequence, stuck.data(), stuck.size(), TrackingOptions(), report));
+	EXPECT_EQ(1, report.anchoredSteps);
+	EXPECT_TRUE(report.steps[0].anchored);
+	EXPECT_FALSE(report.steps[1].anchored);
+	EXPECT_DOUBLE_EQ(7.5, report.steps[1].driftMs);
+	EXPECT_DOUBLE_EQ(107.5, report.steps[1].startMs);
+	EXPECT_DOUBLE_EQ(2.0, report.steps[1].lagMs);
+}
+
+/**
+ * \brief small chunks on several threads give the report of one thread.
+ */
+TEST(tracking_error, testChunksAndThreads){
+
+	CatheterCmdSequence cmdSequence;
+	for (int index(0); index < 400; index++)
+	{
+		addSet(cmdSequence, 1 + index % NCHANNELS, static_cast<uint16_t> ((index * 397) % 4096),
+			(index % 3) ? DIR_POS : DIR_NEG, (index % NCHANNELS == NCHANNELS - 1) ? 10 : 0);
+	}
+	std::vector<double> timeMs(cmdSequence.size());
+	std::vector<double> milliAmp(cmdSequence.size() * NCHANNELS);
+	sequenceTimeline(cmdSequence, timeMs.data(), milliAmp.data());
+
+	// the sensed current lags the command by 3 ms plus some ripple.
+	std::string csv(header);
+	char line[128];
+	size_t set(0), delayed(0);
+	for (int index(0); index < 700 * NCHANNELS; index++)
+	{
+		double rowMs(index / static_cast<double> (NCHANNELS) + 0.25);
+		int channel(1 + index % NCHANNELS);
+		for (; set + 1 < timeMs.size() && timeMs[set + 1] <= rowMs; set++)
+		{
+		}
+		for (; delayed + 1 < timeMs.size() && timeMs[delayed + 1] <= rowMs - 3.0; delayed++)
+		{
+		}
+		double sensed((rowMs >= 3.0 ? milliAmp[delayed * NCHANNELS + channel - 1] : 0.0) + 0.1 * sin(index * 0.1));
+		snprintf(line, sizeof(line), "%.6f,%d,%d,0,0,%.4f,%.4f,1\n", rowMs * 1.0e-3, channel, sensed < 0.0 ? 0 : 1,
+			milliAmp[set * NCHANNELS + channel - 1], fabs(sensed));
+		csv += line;
+	}
+
+	TrackingOptions options;
+	options.threads = 1;
+	options.chunkBytes = csv.size();
+	TrackingReport single;
+	ASSERT_TRUE(analyzeTracking(cmdSequence, csv.data(), csv.size(), options, single));
+	EXPECT_EQ(1, single.chunks);
+	EXPECT_EQ(700 * NCHANNELS, single.samples);
+
+	options.threads = 4;
+	options.chunkBytes = 997;
+	TrackingReport parallel;
+	ASSERT_TRUE(analyzeTracking(cmdSequence, csv.data(), csv.size(), options, parallel));
+	EXPECT_EQ(4, parallel.threads);
+	EXPECT_GT(parallel.chunks, 100);
+	EXPECT_EQ(single.rows, parallel.rows);
+	EXPECT_EQ(single.samples, parallel.samples);
+	EXPECT_DOUBLE_EQ(single.firstMs, parallel.firstMs);
+	EXPECT_DOUBLE_EQ(single.lastMs, parallel.lastMs);
+	for (int channel(0); channel < NCHANNELS; channel++)
+	{
+		const ChannelTracking &expected(single.channels[channel]);
+		const ChannelTracking &actual(parallel.channels[channel]);
+		EXPECT_GT(expected.steps, 0);
+		EXPECT_EQ(expected.samples, actual.samples);
+		EXPECT_NEAR(expected.meanErrorMa, actual.meanErrorMa, 1.0e-9);
+		EXPECT_NEAR(expected.rmsErrorMa, actual.rmsErrorMa, 1.0e-9);
+		EXPECT_DOUBLE_EQ(expected.maxErrorMa, actual.maxErrorMa);
+		EXPECT_DOUBLE_EQ(expected.maxErrorMs, actual.maxErrorMs);
+		EXPECT_EQ(expected.steps, actual.steps);
+		EXPECT_EQ(expected.settledSteps, actual.settledSteps);
+		EXPECT_DOUBLE_EQ(expected.maxSettleMs, actual.maxSettleMs);
+		EXPECT_EQ(expected.lagSteps, actual.lagSteps);
+		EXPECT_DOUBLE_EQ(expected.medianLagMs, actual.medianLagMs);
+		EXPECT_DOUBLE_EQ(expected.maxLagMs, actual.maxLagMs);
+	}
+	ASSERT_EQ(single.steps.size(), parallel.steps.size());
+	for (size_t index(0); index < single.steps.size(); index++)
+	{
+		EXPECT_EQ(single.steps[index].samples, parallel.steps[index].samples);
+		EXPECT_DOUBLE_EQ(single.steps[index].settleMs, parallel.steps[index].settleMs);
+		EXPECT_DOUBLE_EQ(single.steps[index].lagMs, parallel.steps[index].lagMs);
+	}
+}
+
+/**
+ * \brief columns are found by name, unpolled and broken rows are not samples.
+ */
+TEST(tracking_error, testColumnsAndRows){
+
+	CatheterCmdSequence cmdSequence;
+	stepSequence(cmdSequence);
+	double stepMa(dac2MilliAmp(2000, DIR_POS, 1));
+	TrackingReport report;
+
+	std::string csv("channel,sensed_ma\n1,0\n");
+	EXPECT_FALSE(analyzeTracking(cmdSequence, csv.data(), csv.size(), TrackingOptions(), report));
+
+	// no dir or polled column, crlf lines, an exponent, a short row and another channel.
+	char line[128];
+	snprintf(line, sizeof(line), "sensed_ma , channel,time_s\r\n%.4f,1,0.0105\r\n%.4f,1,1.05e-2\r\n", stepMa, stepMa);
+	csv = line;
+	csv += "1.0,1\r\n1.0,9,0.2\r\n\r\n";
+	ASSERT_TRUE(analyzeTracking(cmdSequence, csv.data(), csv.size(), TrackingOptions(), report));
+	EXPECT_EQ(4, report.rows);
+	EXPECT_EQ(2, report.samples);
+	EXPECT_EQ(2, report.skippedRows);
+	EXPECT_EQ(2, report.channels[0].samples);
+	EXPECT_LT(report.channels[0].maxErrorMa, 1.0e-3);
+	EXPECT_DOUBLE_EQ(10.5, report.firstMs);
+
+	// unpolled rows carry no sensed current.
+	csv = header;
+	csv += "0.010,1,1,0,0,0,0,0\n0.011,1,1,0,0,0,0,0\n";
+	ASSERT_TRUE(analyzeTracking(cmdSequence, csv.data(), csv.size(), TrackingOptions(), report));
+	EXPECT_EQ(2, report.rows);
+	EXPECT_EQ(0, report.samples);
+	EXPECT_EQ(0, report.skippedRows);
+	EXPECT_EQ(0, report.channels[0].samples);
+	EXPECT_EQ(0, report.channels[0].lagSteps);
+}
+
+/**
+ * \brief a telemetry file is mapped and analyzed like the same bytes in memory.
+ */
+TEST(tracking_error, testFile){
+
+	CatheterCmdSequence cmdSequence;
+	stepSequence(cmdSequence);
+	std::string csv(stepTelemetry(5.0));
+	FILE *file(fopen(telemetryName, "wb"));
+	ASSERT_TRUE(file != NULL);
+	fwrite(csv.data(), 1, csv.size(), file);
+	fclose(file);
+
+	TrackingReport report;
+	EXPECT_EQ(0, analyzeTrackingFile(cmdSequence, telemetryName, TrackingOptions(), report));
+	EXPECT_EQ(400, report.samples);
+	EXPECT_DOUBLE_EQ(5.0, report.channels[0].meanLagMs);
+	remove(telemetryName);
+	EXPECT_EQ(-1, analyzeTrackingFile(cmdSequence, telemetryName, TrackingOptions(), report));
+}
+
+int main(int argc, char** argv){
+	testing::InitGoogleTest(&argc,argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,28 @@
+function [bytesOut, offsets] = fun_encode_current_list(currentList, delay, firstSeq)
+%
+% [bytesOut, offsets] = fun_encode_current_list(currentList, delay, firstSeq)
+%
+% Description:
+% This function encodes every packet of a current list in one mex call.
+%
+% Inputs:
+% currentList is a list of current (channels x steps), the same layout as
+%  fun_generate_play_file. Current is in A.
+% delay is the time after each current vector in ms (a scalar or one per step).
+% firstSeq is the sequence number of the first packet (optional, default 0).
+%
+% Outputs:
+% bytesOut holds all of the packets back to back (uint8).
+% packet i is bytesOut(offsets(i)+1:offsets(i+1)).
+%
+% Example (APRBS or chirp input y, one column per sample at Fs):
+%  [bytesOut, offsets] = fun_encode_current_list(y(:)', 1000/Fs);
+%
+
+if nargin < 3
+    firstSeq = 0;
+end
+
+[bytesOut, offsets] = mexEncodeCurrentMatrix(double(currentList)*1000, double(delay), firstSeq);
+offsets = double(offsets);
+end
@@ -0,0 +1,41 @@
+function [samples, s] = fun_stream_current_list(port, currentList, delay, poll)
+%
+% [samples, s] = fun_stream_current_list(port, currentList, delay, poll)
+%
+% Description:
+% This function streams a current list through the mex serial session.
+% The session keeps the port open and schedules the packets on its own
+% thread, MATLAB only collects the replies while the list plays.
+%
+% Inputs:
+% port is the serial port name (e.g. 'COM8' or '/dev/ttyACM0').
+% currentList is a list of current (channels x steps). Current is in A.
+% delay is the time after each current vector in ms (a scalar or one per step).
+% poll requests the sensed current in every reply (optional, default false).
+%
+% Outputs:
+% samples is N x 5 [time_s channel set_mA sensed_mA polled].
+% s holds the session counters (sets sent, replies, lateness percentiles).
+%
+
+if nargin < 4
+    poll = false;
+end
+
+mexCatheterSession('open', port);
+cleanup = onCleanup(@() mexCatheterSession('close'));
+pause(2); % the arduino resets when the port opens.
+
+mexCatheterSession('enqueue', double(currentList)*1000, double(delay), poll);
+
+samples = [];
+s = mexCatheterSession('stats');
+while ~s.idle
+    pause(0.05);
+    samples = [samples; mexCatheterSession('poll_telemetry')];
+    s = mexCatheterSession('stats');
+end
+pause(0.1); % the last replies.
+samples = [samples; mexCatheterSession('poll_telemetry')];
+s = mexCatheterSession('stats');
+end
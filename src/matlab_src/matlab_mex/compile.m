@@ -1,5 +1,38 @@
-mex -v -Iinccpp matlab_mex\mexPacketBytesFromCurrents.cpp ...
-                ..\catheter_arduino_gui\src\com\common_utils.cpp ...
-                matlab_mex\mex_utils.cpp ...
-                -outdir mex_bin ...
-                -I..\catheter_arduino_gui\inc\ ...
\ No newline at end of file
+% builds the mex files against the gui's command library (run from src/matlab_src).
+catheterSrc = fullfile('..', 'catheter_arduino_gui', 'src');
+librarySources = { ...
+    fullfile(catheterSrc, 'com', 'catheter_commands.cpp'), ...
+    fullfile(catheterSrc, 'com', 'command_sequence.cpp'), ...
+    fullfile(catheterSrc, 'com', 'pc_utils.cpp'), ...
+    fullfile(catheterSrc, 'hardware', 'digital_analog_conversions.cpp'), ...
+    fullfile('matlab_mex', 'mex_utils.cpp')};
+includeFlag = ['-I', fullfile('..', 'catheter_arduino_gui', 'inc')];
+
+if ~exist('mex_bin', 'dir')
+    mkdir('mex_bin');
+end
+
+mex('-v', includeFlag, fullfile('matlab_mex', 'mexPacketBytesFromCurrents.cpp'), ...
+    librarySources{:}, '-outdir', 'mex_bin');
+mex('-v', includeFlag, fullfile('matlab_mex', 'mexEncodeCurrentMatrix.cpp'), ...
+    librarySources{:}, '-outdir', 'mex_bin');
+
+% the serial session also needs the serial thread and boost (set BOOST_ROOT
+% to a boost install with built libraries, on windows they are auto linked).
+sessionSources = { ...
+    fullfile(catheterSrc, 'ser', 'serial_session.cpp'), ...
+    fullfile(catheterSrc, 'ser', 'serial_thread.cpp'), ...
+    fullfile(catheterSrc, 'ser', 'serial_sender.cpp'), ...
+    fullfile(catheterSrc, 'ser', 'simple_serial.cpp'), ...
+    fullfile(catheterSrc, 'com', 'status_data.cpp'), ...
+    fullfile(catheterSrc, 'util', 'console_log.cpp')};
+boostRoot = getenv('BOOST_ROOT');
+boostFlags = {};
+if ~isempty(boostRoot)
+    boostFlags = {['-I', boostRoot], ['-L', fullfile(boostRoot, 'lib')]};
+end
+if ~ispc
+    boostFlags = [boostFlags, {'-lboost_system', '-lboost_thread'}];
+end
+mex('-v', includeFlag, boostFlags{:}, fullfile('matlab_mex', 'mexCatheterSession.cpp'), ...
+    librarySources{:}, sessionSources{:}, '-outdir', 'mex_bin');
@@ -0,0 +1,201 @@
+//persistent serial session: the port stays open between calls
+
+#include "mex_utils.h"
+#include "com/catheter_commands.h"
+#include "com/current_sample.h"
+#include "hardware/digital_analog_conversions.h"
+#include "ser/serial_session.h"
+#include <string>
+#include <vector>
+
+// mexCatheterSession('open', port)             opens the port and starts the serial thread.
+// mexCatheterSession('enqueue', currents, delays [, poll])
+//                                              queues a nchannels x T milliamp matrix (non blocking).
+// samples = mexCatheterSession('poll_telemetry')
+//                                              N x 5 [time_s channel set_mA sensed_mA polled] of every
+//                                              reply channel since the last call (non blocking).
+// s = mexCatheterSession('stats')              counters of the session (see below).
+// mexCatheterSession('reset')                  drops the queue and zeroes every channel.
+// mexCatheterSession('close')                  closes the port.
+//
+// The sets are sent by the serial thread against absolute deadlines, so MATLAB
+// only has to keep the queue fed, its own timing does not matter.
+
+namespace
+{
+	SerialSession *session(NULL);
+
+	// telemetry times are relative to the first reply of the session.
+	double startTime(-1.0);
+
+	// poll_telemetry pops the ring in blocks of this many replies.
+	const size_t telemetryBlock(4096);
+
+	void closeSession()
+	{
+		if (session != NULL)
+		{
+			// the session zeroes every channel before it closes the port.
+			delete session;
+			session = NULL;
+			mexUnlock();
+		}
+	}
+
+	std::string getString(const mxArray *mexA, const char *name)
+	{
+		if (!mxIsChar(mexA))
+		{
+			mexErrMsgIdAndTxt("MATLAB:mexcpp:type", "%s must be a string", name);
+		}
+		char *text = mxArrayToString(mexA);
+		std::string result(text);
+		mxFree(text);
+		return result;
+	}
+
+	void requireSession()
+	{
+		if (session == NULL)
+		{
+			mexErrMsgIdAndTxt("MATLAB:mexcpp:session", "no session is open, call mexCatheterSession('open', port) first");
+		}
+	}
+
+	void openSession(int nrhs, const mxArray *prhs[])
+	{
+		if (nrhs != 2)
+		{
+			mexErrMsgIdAndTxt("MATLAB:mexcpp:nargin", "'open' requires a port name");
+		}
+		std::string port(getString(prhs[1], "port"));
+		closeSession();
+
+		session = new SerialSession;
+		startTime = -1.0;
+		mexLock();
+		if (!session->open(port))
+		{
+			closeSession();
+			mexErrMsgIdAndTxt("MATLAB:mexcpp:open", "unable to open %s", port.c_str());
+		}
+	}
+
+	void enqueue(int nrhs, const mxArray *prhs[])
+	{
+		requireSession();
+		if (nrhs < 3 || nrhs > 4)
+		{
+			mexErrMsgIdAndTxt("MATLAB:mexcpp:nargin", "'enqueue' requires currents and delays");
+		}
+		mexCheckDouble(prhs[1], "currents");
+		mexCheckDouble(prhs[2], "delays");
+		bool poll = (nrhs > 3) && (mxGetScalar(prhs[3]) != 0.0);
+
+		if (session->enqueue(mxGetPr(prhs[1]), mxGetM(prhs[1]), mxGetN(prhs[1]),
+			mxGetPr(prhs[2]), mxGetNumberOfElements(prhs[2]), poll) != 0)
+		{
+			mexErrMsgIdAndTxt("MATLAB:mexcpp:enqueue", "currents must have 1 to %d rows and delays one value per column (or a scalar)",
+				NCHANNELS);
+		}
+	}
+
+	mxArray* pollTelemetry()
+	{
+		requireSession();
+		std::vector<CurrentSample> samples;
+		size_t count(0);
+		do
+		{
+			samples.resize(samples.size() + telemetryBlock);
+			count = session->pollTelemetry(&samples[samples.size() - telemetryBlock], telemetryBlock);
+			samples.resize(samples.size() - telemetryBlock + count);
+		} while (count == telemetryBlock);
+		if (startTime < 0.0 && !samples.empty())
+		{
+			startTime = samples.front().time;
+		}
+
+		// column major N x 5
+		size_t n(samples.size());
+		mxArray *result = mxCreateDoubleMatrix(n, 5, mxREAL);
+		double *out = mxGetPr(result);
+		for (size_t i(0); i < n; i++)
+		{
+			const CurrentSample &s(samples[i]);
+			out[i] = s.time - startTime;
+			out[i + n] = s.channel;
+			out[i + 2 * n] = dac2MilliAmp(s.dacCounts, s.dir, s.channel);
+			out[i + 3 * n] = s.polled ? adc2MilliAmp(s.adcCounts, s.channel) : 0.0;
+			out[i + 4 * n] = s.polled ? 1.0 : 0.0;
+		}
+		return result;
+	}
+
+	mxArray* stats()
+	{
+		requireSession();
+		PlaybackStats playback;
+		session->getStats(playback);
+
+		const char *fields[] = {"connected", "queued", "idle", "setsSent", "repliesValid", "repliesInvalid",
+			"latenessP50Us", "latenessP99Us", "latenessMaxUs", "rttP50Us", "rttP99Us", "rttMaxUs", "echoMismatches",
+			"replyTimeouts", "telemetryDropped", "messages"};
+		const int nfields = sizeof(fields) / sizeof(fields[0]);
+		mxArray *result = mxCreateStructMatrix(1, 1, nfields, fields);
+		mxSetField(result, 0, "connected", mxCreateDoubleScalar(session->isOpen() ? 1.0 : 0.0));
+		mxSetField(result, 0, "queued", mxCreateDoubleScalar((double)session->queuedSets()));
+		mxSetField(result, 0, "idle", mxCreateDoubleScalar(session->idle() ? 1.0 : 0.0));
+		mxSetField(result, 0, "setsSent", mxCreateDoubleScalar((double)playback.setsSent));
+		mxSetField(result, 0, "repliesValid", mxCreateDoubleScalar((double)playback.repliesValid));
+		mxSetField(result, 0, "repliesInvalid", mxCreateDoubleScalar((double)playback.repliesInvalid));
+		mxSetField(result, 0, "latenessP50Us", mxCreateDoubleScalar(latenessPercentile(playback, 0.50)));
+		mxSetField(result, 0, "latenessP99Us", mxCreateDoubleScalar(latenessPercentile(playback, 0.99)));
+		mxSetField(result, 0, "latenessMaxUs", mxCreateDoubleScalar(playback.maxLatenessUs));
+		mxSetField(result, 0, "rttP50Us", mxCreateDoubleScalar(rttPercentile(playback, 0.50)));
+		mxSetField(result, 0, "rttP99Us", mxCreateDoubleScalar(rttPercentile(playback, 0.99)));
+		mxSetField(result, 0, "rttMaxUs", mxCreateDoubleScalar(playback.maxRttUs));
+		mxSetField(result, 0, "echoMismatches", mxCreateDoubleScalar((double)playback.echoMismatches));
+		mxSetField(result, 0, "replyTimeouts", mxCreateDoubleScalar((double)playback.replyTimeouts));
+		mxSetField(result, 0, "telemetryDropped", mxCreateDoubleScalar((double)session->droppedTelemetry()));
+
+		// the retained console messages, oldest first.
+		const ConsoleLog &log(session->log());
+		uint64_t first(log.firstSeq());
+		uint64_t end(log.endSeq());
+		mxArray *messages = mxCreateCellMatrix((mwSize)(end - first), 1);
+		ConsoleLine line;
+		for (uint64_t seq(first); seq < end; seq++)
+		{
+			mxSetCell(messages, (mwSize)(seq - first), mxCreateString(log.getLine(seq, line) ? line.text : ""));
+		}
+		mxSetField(result, 0, "messages", messages);
+		return result;
+	}
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs < 1) {
+        mexErrMsgIdAndTxt("MATLAB:mexcpp:nargin",
+            "mexCatheterSession requires a command ('open', 'enqueue', 'poll_telemetry', 'stats', 'reset' or 'close').");
+    }
+    mexAtExit(closeSession);
+    std::string command(getString(prhs[0], "command"));
+
+    if (command == "open") {
+        openSession(nrhs, prhs);
+    } else if (command == "enqueue") {
+        enqueue(nrhs, prhs);
+    } else if (command == "poll_telemetry") {
+        plhs[0] = pollTelemetry();
+    } else if (command == "stats") {
+        plhs[0] = stats();
+    } else if (command == "reset") {
+        requireSession();
+        session->reset();
+    } else if (command == "close") {
+        closeSession();
+    } else {
+        mexErrMsgIdAndTxt("MATLAB:mexcpp:command", "unknown command '%s'", command.c_str());
+    }
+}
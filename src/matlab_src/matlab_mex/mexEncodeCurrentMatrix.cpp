@@ -0,0 +1,74 @@
+//packet bytes for a whole current matrix (milliamps)
+
+#include "mex_utils.h"
+#include "com/catheter_commands.h"
+#include "com/command_sequence.h"
+#include "com/pc_utils.h"
+#include <stdint.h>
+
+// [bytes, offsets] = mexEncodeCurrentMatrix(currents, delays [, firstSeq [, poll]])
+//
+// currents: nchannels x T matrix in MILLIAMPS, column t is sent to channels 1..nchannels.
+// delays:   the delay (ms) after each column, T values or a single value for all of them.
+// firstSeq: the packet sequence number of the first column (default 0), column t uses firstSeq + t.
+// poll:     poll every channel after the setpoints of each step (default false).
+//
+// bytes:    every packet back to back (uint8 column vector).
+// offsets:  (T+1) x 1 uint32, packet t is bytes(offsets(t)+1 : offsets(t+1)).
+//
+// The packets are encoded straight into the output arrays, so an experiment
+// is one call and one allocation per output.
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+    if (nrhs < 2 || nrhs > 4) {
+        mexErrMsgIdAndTxt("MATLAB:mexcpp:nargin",
+            "mexEncodeCurrentMatrix requires 2 to 4 input arguments.");
+    } else if (nlhs > 2) {
+        mexErrMsgIdAndTxt("MATLAB:mexcpp:nargout",
+            "mexEncodeCurrentMatrix returns at most 2 output arguments.");
+    }
+    mexCheckDouble(prhs[0], "currents");
+    mexCheckDouble(prhs[1], "delays");
+
+    size_t nchannels = mxGetM(prhs[0]);
+    size_t nsteps = mxGetN(prhs[0]);
+    size_t ndelays = mxGetNumberOfElements(prhs[1]);
+    if (nchannels < 1 || nchannels > NCHANNELS) {
+        mexErrMsgIdAndTxt("MATLAB:mexcpp:currents", "currents must have 1 to %d rows (channels), found %d",
+            NCHANNELS, (int)nchannels);
+    }
+    if (ndelays != 1 && ndelays != nsteps) {
+        mexErrMsgIdAndTxt("MATLAB:mexcpp:delays", "delays must be a scalar or have one value per column (%d), found %d",
+            (int)nsteps, (int)ndelays);
+    }
+
+    int firstSeq = 0;
+    if (nrhs > 2) {
+        if (mxGetNumberOfElements(prhs[2]) != 1) {
+            mexErrMsgIdAndTxt("MATLAB:mexcpp:firstSeq", "firstSeq must be a scalar");
+        }
+        firstSeq = (int)(mxGetScalar(prhs[2]));
+    }
+    bool poll = false;
+    if (nrhs > 3) {
+        if (mxGetNumberOfElements(prhs[3]) != 1) {
+            mexErrMsgIdAndTxt("MATLAB:mexcpp:poll", "poll must be a scalar");
+        }
+        poll = mxGetScalar(prhs[3]) != 0.0;
+    }
+
+    CatheterCmdSequence cmdSequence;
+    if (currentMatrix2Sequence(mxGetPr(prhs[0]), nchannels, nsteps, mxGetPr(prhs[1]), ndelays, poll, cmdSequence) != 0) {
+        mexErrMsgIdAndTxt("MATLAB:mexcpp:encode", "failed to build the command sequence");
+    }
+
+    //allocate the return arrays and encode into them
+    plhs[0] = mxCreateNumericMatrix(encodedLength(cmdSequence), 1, mxUINT8_CLASS, mxREAL);
+    mxArray *offsets = mxCreateNumericMatrix(nsteps + 1, 1, mxUINT32_CLASS, mxREAL);
+    encodeSequence(cmdSequence, firstSeq, (uint8_t *)mxGetData(plhs[0]), (uint32_t *)mxGetData(offsets));
+
+    if (nlhs > 1) {
+        plhs[1] = offsets;
+    } else {
+        mxDestroyArray(offsets);
+    }
+}
@@ -1,33 +1,31 @@
 //packet bytes from current value (amps)
 
 #include "mex_utils.h"
-#include "com\common_utils.h"
+#include "com/catheter_commands.h"
+#include "hardware/digital_analog_conversions.h"
 #include <vector>
+#include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
 
 using namespace std;
 // currents supplied are in MILLIAMPS
+// (for whole experiments use mexEncodeCurrentMatrix, it encodes every step in one call)
 void mexPacketBytesFromCurrents(double *currents, int nchannels, int pseqnum, std::vector<std::vector<uint8_t>>& packetVect) {
     packetVect.clear();    
     
-	std::vector <CatheterChannelCmd> commands;
-	commands.clear();
+	CatheterChannelCmdSet commands;
     CatheterChannelCmd c;
 
     for (int i=0;  i<nchannels; i++) {
         c.channel = i+1;
-		c.currentMA = currents[i];
+		setCmdMilliAmp(c, currents[i]);
         c.poll = false;
-		commands.push_back(c);
-        mexSummarizeCmd(c);  
+		commands.commandList.push_back(c);
+        // mexSummarizeCmd(c);  
     }
 	
-    std::vector<int> pdelays;
-	std::vector<int> ncmdsPerPacket;
-	packetVect.clear();
-    // getPacketBytes(pseqnum, commandVect, packetVect, pdelays, ncmdsPerPacket);  
-    packetVect.push_back(compactPacketBytes(commands, pseqnum));
+    packetVect.push_back(encodeCommandSet(commands, pseqnum));
 }
 
 //inputs: array of current values in MilliAmps, the number of channels, and the packet number
@@ -36,10 +34,10 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     // Check for appropriate number of arguments 
     if (nrhs != 3) {
         mexErrMsgIdAndTxt("MATLAB:mexcpp:nargin", 
-            "getPacketStringsFromPlayfile requires 3 input arguments.");
+            "mexPacketBytesFromCurrents requires 3 input arguments.");
     } else if (nlhs != 1) {
         mexErrMsgIdAndTxt("MATLAB:mexcpp:nargout",
-            "getPacketStringsFromPlayfile requires 1 output arguments.");
+            "mexPacketBytesFromCurrents requires 1 output arguments.");
     } 
     // check for appropriate types of input arguments
     if (!(mxGetM(prhs[2])==1 && mxGetN(prhs[2])==1)) {
@@ -56,7 +54,11 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     
     mwSize m = mxGetM(prhs[0]);
     mwSize n = mxGetN(prhs[0]);    
-    if (!(m==nchannels && n==1) || (m==1 && n==nchannels)) {
+    if (nchannels < 1 || nchannels > NCHANNELS) {
+        mexErrMsgIdAndTxt("MATLAB:mexcpp:nchannels", "nchannels must be between 1 and %d", NCHANNELS);
+    }
+    mexCheckDouble(prhs[0], "currents");
+    if (!((m==nchannels && n==1) || (m==1 && n==nchannels))) {
         mexErrMsgIdAndTxt("MATLAB:mexcpp:mxGetN", "incorrect size of currents argument. Found array of size %d, %d", m, n);
     }    
     
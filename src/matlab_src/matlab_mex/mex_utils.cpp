@@ -13,9 +13,9 @@ void mexCopy2DIntArray(int * A, mxArray * mexA, int dim0, int dim1) {
     }
 }
 
-void mexSummarizeCmd(CatheterChannelCmd cmd) {
+void mexSummarizeCmd(const CatheterChannelCmd& cmd) {
     mexPrintf("channel: %d\n",cmd.channel);
-	mexPrintf("current: %f\n",cmd.currentMA);
+	mexPrintf("current: %f\n",cmd.currentMilliAmp);
     //mexPrintf("poll: %d\n", (cmd.cmd4 >> POL_B) & 1);
     //mexPrintf("enable: %d\n", (cmd.cmd4 >> ENA_B) & 1);
     //mexPrintf("update: %d\n", (cmd.cmd4 >> UPD_B) & 1);
@@ -25,4 +25,10 @@ void mexSummarizeCmd(CatheterChannelCmd cmd) {
     //    mexPrintf("EOP. delay: %dms\n", (int)cmd.waitTime);
 }
 
+void mexCheckDouble(const mxArray * mexA, const char * name) {
+    if (!mxIsDouble(mexA) || mxIsComplex(mexA) || mxIsSparse(mexA)) {
+        mexErrMsgIdAndTxt("MATLAB:mexcpp:type", "%s must be a real, full double array", name);
+    }
+}
+
 //#endif //MEXFILE
\ No newline at end of file
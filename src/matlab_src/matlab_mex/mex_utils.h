@@ -4,15 +4,18 @@
 #ifndef MEX_UTILS_H
 #define MEX_UTILS_H
 
-#include "com/common_utils.h"
+#include "com/catheter_commands.h"
 
 #include <tmwtypes.h>
 #include <mex.h>
 #include <matrix.h>
 
-void mexSummarizeCmd(CatheterChannelCmd cmd);
+void mexSummarizeCmd(const CatheterChannelCmd& cmd);
 
 void mexCopy2DIntArray(int * A, mxArray * mexA, int dim0, int dim1);
 
+// errors out unless the argument is a real double array.
+void mexCheckDouble(const mxArray * mexA, const char * name);
+
 #endif //MEX_UTILS_H
-//#endif //MEXFILE
\ No newline at end of file
+//#endif //MEXFILE